@@ -24,10 +24,29 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <float.h>
 #include <setjmp.h>
 #include <errno.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
 #include "json.h"
 
+#if defined(JSON_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define JSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef JSON_THREADS
+#include <pthread.h>
+#endif
+
 
 #define ASSERT(_test_condition)                                 \
        if (!(_test_condition)){                                 \
@@ -37,6 +56,14 @@
        }
 
 
+#ifdef JSON_CHECK_SIGNATURES
+#define ASSERT_SIGNATURE(_node, _signature)                     \
+       ASSERT((_node)->Signature == (_signature))
+#else
+#define ASSERT_SIGNATURE(_node, _signature)
+#endif
+
+
 #define JSON_VALUE_SIGNATURE 0x6C61764A
 
 
@@ -47,1421 +74,10352 @@ typedef struct _JSON_VALUE {
     union {
         char *String;
         double Number;
+        int64_t Integer;
         int Boolean;
         struct _JSON_MEMBER *Object;
+        struct _JSON_ARRAY *Array;
+        struct _LAZY_SPAN *Lazy;
     };
 
 } JSON_VALUE;
 
 
+//
+//  Objects and arrays nested in a document from JSON_ParseLazy() keep
+//  these types, and a LAZY_SPAN, until they are first read. They are
+//  never seen outside this file.
+//
+#define TYPE_LAZY_OBJECT ((JSON_TYPE)(TYPE_INTEGER + 1))
+#define TYPE_LAZY_ARRAY  ((JSON_TYPE)(TYPE_INTEGER + 2))
+
+
+#define JSON_ARRAY_SIGNATURE 0x7272614A
+
+
+//
+//  The elements of an array are kept side by side in Values, so any one
+//  of them is found in a single step. Capacity grows by doubling while
+//  the array is parsed.
+//
+typedef struct _JSON_ARRAY {
+
+    int Signature;
+    size_t Count;
+    size_t Capacity;
+    JSON_VALUE *Values;
+
+} JSON_ARRAY;
+
+
 #define JSON_MEMBER_SIGNATURE 0x6D656D4A
 
 
+//
+//  An object is the chain of its members. Index is only used on the
+//  first member of an object, and resolves by its signature to either
+//  the hash index of the member names, once one is built, or, in arena
+//  documents, the document that will own it. InNode is set on members
+//  allocated as a JSON_NODE.
+//
 typedef struct _JSON_MEMBER {
 
     int Signature;
+    int InNode;
     char *Name;
     JSON_VALUE *Value;
     struct _JSON_MEMBER *Next;
+    void *Index;
 
 } JSON_MEMBER;
 
 
-static jmp_buf parse_jmp_buffer;
-static jmp_buf stringify_jmp_buffer;
+//
+//  A member and its value in a single allocation, which is how members
+//  that come with a value are made. Value points at the value in the
+//  node unless a different one is put in its place.
+//
+typedef struct _JSON_NODE {
 
+    JSON_MEMBER Member;
+    JSON_VALUE Value;
 
-JSON_ERROR JSON_Errno;
+} JSON_NODE;
 
 
-JSON_ERROR JSON_GetErrno(void)
-{
-    return JSON_Errno;
-}
+//---------------------------------------------------------------------------
+//
+//  Arena storage for documents created by JSON_ParseArena().
+//
+//  Every node and string of such a document is carved out of a list of
+//  large chunks, so freeing the document releases the chunks and never
+//  walks the tree.
+//
+//---------------------------------------------------------------------------
+#define ARENA_FIRST_CHUNK_SIZE  (16 * 1024)
+#define ARENA_MAX_CHUNK_SIZE    (1024 * 1024)
+#define ARENA_ALIGN(_size)      (((_size) + 7) & ~((size_t)7))
 
 
-static JSON_VALUE *allocJsonValue(void)
-{
-    //--------------------------
-    JSON_VALUE *value;
-    //--------------------------
+typedef struct _JSON_ARENA {
 
-    value = (JSON_VALUE *)malloc(sizeof(JSON_VALUE));
-    if (!value) {
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        return NULL;
-    }
+    struct _JSON_ARENA *Next;
+    size_t Size;
+    size_t Used;
 
-    memset(value, 0, sizeof(JSON_VALUE));
-    value->Signature = JSON_VALUE_SIGNATURE;
+} JSON_ARENA;
 
-    return value;
-}
 
+#define ARENA_DATA(_chunk) ((char *)(_chunk) + ARENA_ALIGN(sizeof(JSON_ARENA)))
 
-static JSON_MEMBER *allocJsonMember(void)
-{
-    //---------------------
-    JSON_MEMBER *member;
-    //---------------------
 
-    member = (JSON_MEMBER*) malloc(sizeof(JSON_MEMBER));
-    if (!member){
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        return NULL;
-    }
+#define JSON_DOCUMENT_SIGNATURE 0x636F644A
 
-    memset(member, 0, sizeof(JSON_MEMBER));
-    member->Signature = JSON_MEMBER_SIGNATURE;
 
-    return member;
-}
+//
+//  A document either owns its nodes through an arena, or, when Arena is
+//  NULL, keeps them on the heap like a plain object. Buffer is set when
+//  the strings of the document point into text it borrowed from the
+//  caller instead of owning copies of them, or into a file mapping the
+//  document owns when Mapped is set. Keys is the document's own table of
+//  interned member names, if it has one.
+//
+typedef struct _JSON_DOCUMENT {
 
+    int Signature;
+    JSON_MEMBER *Root;
+    JSON_ARENA *Arena;
+    struct _MEMBER_INDEX *Indexes;
+    char *Buffer;
+    size_t BufferLength;
+    int Mapped;
+    struct _LAZY_TEXT *Lazy;
+    struct _KEY_TABLE *Keys;
+#ifdef JSON_STATS_COUNTERS
+    uint64_t ParseNanoseconds;
+    uint64_t Lookups;
+#endif
 
-// Forward declaration
-static JSON_MEMBER* parseJsonObject(char **cursor);
+} JSON_DOCUMENT;
 
 
-static void skipBlanks(char **cursor)
-{
-    while (isblank(**cursor)) {
-        (*cursor)++;
-    }
-}
+//
+//  A lazy document keeps a copy of its text, in its arena, and the
+//  positions of all of its structurals, on the heap. A LAZY_SPAN is the
+//  position of the bracket that opens a container not parsed yet.
+//
+typedef struct _LAZY_TEXT {
 
+    char *Start;
+    char *End;
+    uint32_t *Positions;
+    size_t Count;
+    size_t Capacity;
 
-static char* parseJsonString(char **cursor)
-{
-    char *start = NULL;
-    char *end = NULL;
-    char *new_string;
+} LAZY_TEXT;
 
-    // Find the first "
-    start = strstr(*cursor, "\"");
-    if (!start) {
-        JSON_Errno = ERROR_INVALID_STRING;
-        longjmp(parse_jmp_buffer, 1);
-    }
-    start++;
 
-    // Find the last \" and null terminate the string
-    end = strstr(start, "\"");
-    if (!end) {
-        JSON_Errno = ERROR_INVALID_STRING;
-        longjmp(parse_jmp_buffer, 1);
-    }
+typedef struct _LAZY_SPAN {
 
-    *cursor = end + 1;
+    JSON_DOCUMENT *Document;
+    size_t Position;
 
-    new_string = strndup(start, end - start);
-    if (!new_string){
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        longjmp(parse_jmp_buffer, 1);
-    }
+} LAZY_SPAN;
 
-    return new_string;
-}
 
+//
+//  Hash index of the member names of a large object, built the first
+//  time a lookup has to scan past JSON_INDEX_MIN_MEMBERS members. The
+//  slots keep each name's hash and length, and Last lets additions
+//  append without walking the chain. Index memory always comes from the
+//  heap, so indexes of arena documents are also kept on the document's
+//  Indexes list, through Next, to be freed with it.
+//
+#define MEMBER_INDEX_SIGNATURE 0x78646E49
 
-static int parseJsonBoolean(char **cursor)
-{
-    if (strncmp(*cursor, "true", 4) == 0) {
-        *cursor += 4;
-        return 1;
-    }
-    else if (strncmp(*cursor, "false", 5) == 0) {
-        *cursor += 5;
-        return 0;
-    }
-    else {
-        JSON_Errno = ERROR_INVALID_BOOLEAN;
-        longjmp(parse_jmp_buffer, 1);
-    }
-}
 
+typedef struct _INDEX_SLOT {
 
-static double parseJsonNumber(char **cursor)
-{
-    char *end = NULL;
-    double value = strtod(*cursor, &end);
-    *cursor = end;
-    return value;
-}
+    JSON_MEMBER *Member;
+    uint32_t Hash;
+    uint32_t Length;
 
+} INDEX_SLOT;
 
-// Forward declarations
-static JSON_VALUE* parseJsonValue(char **cursor);
-static JSON_MEMBER* parseJsonArrayMember(char **cursor);
 
+typedef struct _MEMBER_INDEX {
 
-static JSON_MEMBER* parseJsonArray(char **cursor)
-{
-    //------------------------------------
-    JSON_MEMBER *member;
-    JSON_MEMBER *new_member;
-    JSON_MEMBER *root_member = NULL;
-    int parsing_in_progress;
-    //------------------------------------
+    int Signature;
+    struct _MEMBER_INDEX *Next;
+    struct _JSON_DOCUMENT *Owner;
+    JSON_MEMBER *Last;
+    size_t Count;
+    size_t Mask;
+    INDEX_SLOT *Slots;
 
-    *cursor = strstr(*cursor, "[");
-    if ((*cursor) == NULL) {
-        JSON_Errno = ERROR_INVALID_ARRAY;
-        longjmp(parse_jmp_buffer, 1);
-    }
+} MEMBER_INDEX;
 
-    // Skip past the [
-    (*cursor)++;
 
-    do {
-        new_member = parseJsonArrayMember(cursor);
+//---------------------------------------------------------------------------
+//
+//  Everything a single parse needs lives here, on the stack of the
+//  calling thread, so independent parses never share any state.
+//
+//---------------------------------------------------------------------------
+//
+//  Positions of the structural characters of a document, built by the
+//  first parsing stage. Small documents fit in the inline storage.
+//
+#define STRUCTURAL_INLINE_SIZE 256
 
-        if (!root_member) {
-            root_member = new_member;
-            member = new_member;
-        }
-        else {
-            member->Next = new_member;
-            member = new_member;
-        }
 
-        // Find the next non-space character
-        skipBlanks(cursor);
+typedef struct _STRUCTURAL_INDEX {
 
-        if (**cursor == ',') {
-            parsing_in_progress = 1;
-            (*cursor)++;
-        }
-        else if (**cursor == ']') {
-            parsing_in_progress = 0;
-            (*cursor)++;
-        }
-        else {
-            JSON_Errno = ERROR_INVALID_OBJECT;
-            longjmp(parse_jmp_buffer, 1);
-        }
+    uint32_t *Positions;
+    size_t Count;
+    size_t Capacity;
+    uint32_t Inline[STRUCTURAL_INLINE_SIZE];
 
-    } while (parsing_in_progress);
+} STRUCTURAL_INDEX;
 
-    return root_member;
-}
 
+typedef struct _PARSE_STATE {
 
-static JSON_VALUE* parseJsonValue(char **cursor)
-{
-    //--------------------------
-    char *start = NULL;
-    JSON_VALUE *value;
-    //--------------------------
+    char *Start;
+    char *End;
+    STRUCTURAL_INDEX Index;
+    size_t Next;
+    JSON_MEMBER *Root;
+    JSON_DOCUMENT *Document;
+    JSON_CONTEXT *Context;
+    int Lazy;
+    struct _SELECT_NODE *Select;
+    struct _KEY_TABLE *Keys;
+    jmp_buf JmpBuffer;
 
-    value = allocJsonValue();
-    if (!value){
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        longjmp(parse_jmp_buffer, 1);
-    }
+} PARSE_STATE;
 
-    // Find the next non-space character
-    skipBlanks(cursor);
 
-    start = *cursor;
+//
+//  Context used by the functions that do not take one explicitly. It is
+//  per thread, so JSON_GetErrno() always reports the calling thread's
+//  last operation.
+//
+static _Thread_local JSON_CONTEXT default_context;
 
-    if (*start == '"') {
-        value->Type = TYPE_STRING;
-        value->String = parseJsonString(cursor);
-    }
-    else if (*start == 't') {
-        value->Type = TYPE_BOOLEAN;
-        value->Boolean = parseJsonBoolean(cursor);
-    }
-    else if (*start == 'f') {
-        value->Type = TYPE_BOOLEAN;
-        value->Boolean = parseJsonBoolean(cursor);
-    }
-    else if (isdigit(*start)) {
-        value->Type = TYPE_NUMBER;
-        value->Number = parseJsonNumber(cursor);
-    }
-    else if (*start == '[') {
-        value->Type = TYPE_ARRAY;
-        value->Object = parseJsonArray(cursor);
-    }
-    else if (*start == '{') {
-        value->Type = TYPE_OBJECT;
-        value->Object = parseJsonObject(cursor);
-    }
-    else {
-        JSON_Errno = ERROR_INVALID_VALUE_TYPE;
-        longjmp(parse_jmp_buffer, 1);
-    }
 
-    return value;
+JSON_ERROR JSON_GetErrno(void)
+{
+    return default_context.Errno;
 }
 
 
-static JSON_MEMBER* parseJsonObjectMember(char **cursor)
+void JSON_InitContext(JSON_CONTEXT *ctx)
 {
-    //---------------------
-    JSON_MEMBER *member;
-    //---------------------
-
-    member = allocJsonMember();
-    if (!member){
-        longjmp(parse_jmp_buffer, 1);
-    }
-
-    // Get the name
-    member->Name = parseJsonString(cursor);
-
-    // Find the :
-    *cursor = strstr(*cursor, ":");
-    if ((*cursor) == NULL){
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        longjmp(parse_jmp_buffer, 1);
-    }
-    // Skip past the :
-    (*cursor)++;
+    memset(ctx, 0, sizeof(JSON_CONTEXT));
+    ctx->Errno = SUCCESS;
+}
 
-    // Get the value
-    member->Value = parseJsonValue(cursor);
 
-    return member;
+JSON_ERROR JSON_GetErrnoCtx(JSON_CONTEXT *ctx)
+{
+    return ctx->Errno;
 }
 
 
-static JSON_MEMBER* parseJsonArrayMember(char **cursor)
+static JSON_ARENA *allocArenaChunk(size_t size)
 {
-    //---------------------
-    JSON_MEMBER *member;
-    //---------------------
+    //--------------------------
+    JSON_ARENA *chunk;
+    //--------------------------
 
-    member = allocJsonMember();
-    if (!member){
-        longjmp(parse_jmp_buffer, 1);
+    chunk = (JSON_ARENA *)malloc(ARENA_ALIGN(sizeof(JSON_ARENA)) + size);
+    if (!chunk) {
+        return NULL;
     }
 
-    // Get the value
-    member->Value = parseJsonValue(cursor);
+    chunk->Next = NULL;
+    chunk->Size = size;
+    chunk->Used = 0;
 
-    return member;
+    return chunk;
 }
 
 
-static JSON_MEMBER* parseJsonObject(char **cursor)
+static void *arenaAlloc(JSON_DOCUMENT *doc, size_t size)
 {
-    //-----------------------------------------
-    JSON_MEMBER *member;
-    JSON_MEMBER *new_member;
-    JSON_MEMBER *root_member = NULL;
-    int parsing_in_progress;
-    //-----------------------------------------
-
-    *cursor = strstr(*cursor, "{");
-    if ((*cursor) == NULL) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        longjmp(parse_jmp_buffer, 1);
-    }
+    //--------------------------
+    JSON_ARENA *chunk;
+    JSON_ARENA *new_chunk;
+    size_t new_size;
+    void *memory;
+    //--------------------------
 
-    // Skip past the {
-    (*cursor)++;
+    chunk = doc->Arena;
+    size = ARENA_ALIGN(size);
 
-    do {
-        new_member = parseJsonObjectMember(cursor);
+    if (chunk->Size - chunk->Used < size) {
 
-        if (!root_member) {
-            root_member = new_member;
-            member = new_member;
-        }
-        else {
-            member->Next = new_member;
-            member = new_member;
+        //  Oversized requests get a chunk of their own, linked in behind
+        //  the current one so its free space is not wasted.
+        if (size > chunk->Size / 2) {
+            new_chunk = allocArenaChunk(size);
+            if (!new_chunk) {
+                return NULL;
+            }
+            new_chunk->Used = size;
+            new_chunk->Next = chunk->Next;
+            chunk->Next = new_chunk;
+            return ARENA_DATA(new_chunk);
         }
 
-        // Find the next non-space character
-        skipBlanks(cursor);
-
-        if (**cursor == ',') {
-            parsing_in_progress = 1;
-            (*cursor)++;
+        new_size = chunk->Size * 2;
+        if (new_size > ARENA_MAX_CHUNK_SIZE) {
+            new_size = ARENA_MAX_CHUNK_SIZE;
         }
-        else if (**cursor == '}') {
-            parsing_in_progress = 0;
-            (*cursor)++;
-        }
-        else {
-            JSON_Errno = ERROR_INVALID_OBJECT;
-            longjmp(parse_jmp_buffer, 1);
+
+        new_chunk = allocArenaChunk(new_size);
+        if (!new_chunk) {
+            return NULL;
         }
+        new_chunk->Next = chunk;
+        doc->Arena = new_chunk;
+        chunk = new_chunk;
+    }
 
-    } while (parsing_in_progress);
+    memory = ARENA_DATA(chunk) + chunk->Used;
+    chunk->Used += size;
 
-    return root_member;
+    return memory;
 }
 
 
-JSON_OBJECT_HANDLE JSON_Parse(char *string)
+static JSON_DOCUMENT *allocJsonDocument(size_t first_chunk_size)
 {
-    //-----------------------
-    JSON_MEMBER *object;
-    int rc;
-    //-----------------------
-
-    JSON_Errno = SUCCESS;
+    //--------------------------
+    JSON_ARENA *chunk;
+    JSON_DOCUMENT *doc;
+    //--------------------------
 
-    rc = setjmp(parse_jmp_buffer);
-    if (rc == 0) {
-        object = parseJsonObject(&string);
-        return object;
-    }
-    else {
+    chunk = allocArenaChunk(first_chunk_size);
+    if (!chunk) {
         return NULL;
     }
-}
-
 
-# if defined (JSON_PRINT) || defined (JSON_DBG_PRINT)
+    // The document header lives at the start of its own first chunk.
+    doc = (JSON_DOCUMENT *)ARENA_DATA(chunk);
+    chunk->Used = ARENA_ALIGN(sizeof(JSON_DOCUMENT));
 
+    memset(doc, 0, sizeof(JSON_DOCUMENT));
+    doc->Signature = JSON_DOCUMENT_SIGNATURE;
+    doc->Arena = chunk;
 
-#define SPACES_PER_INDENTATION 4
+    return doc;
+}
 
 
-static void printIndent(int indent_level)
+//
+//  Documents of in-situ parses keep their nodes on the heap, so only the
+//  header is allocated here.
+//
+static JSON_DOCUMENT *allocInSituDocument(char *buffer, size_t length)
 {
-    int i, j;
-    for (i = 0; i < indent_level; i++)
-        for (j = 0; j < SPACES_PER_INDENTATION; j++)
-            printf(" ");
+    //--------------------------
+    JSON_DOCUMENT *doc;
+    //--------------------------
 
-}
-#endif
+    doc = (JSON_DOCUMENT *)malloc(sizeof(JSON_DOCUMENT));
+    if (!doc) {
+        return NULL;
+    }
 
+    memset(doc, 0, sizeof(JSON_DOCUMENT));
+    doc->Signature = JSON_DOCUMENT_SIGNATURE;
+    doc->Buffer = buffer;
+    doc->BufferLength = length;
 
-#ifdef JSON_PRINT
+    return doc;
+}
 
 
-// Forward dec'l
-static void printJsonObject(JSON_MEMBER *object, int *indent_level);
-static void printJsonValue(JSON_VALUE *value, int *indent_level);
+static inline int usesArena(JSON_DOCUMENT *doc)
+{
+    return doc && doc->Arena;
+}
 
 
-static void printJsonArray(JSON_MEMBER *member, int *indent_level)
+//
+//  Strings pointing into the borrowed buffer belong to the caller.
+//
+static inline int isBorrowed(JSON_DOCUMENT *doc, const char *string)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    return doc && doc->Buffer &&
+           (uintptr_t)string >= (uintptr_t)doc->Buffer &&
+           (uintptr_t)string < (uintptr_t)doc->Buffer + doc->BufferLength;
+}
 
-    printf("[\n");
-    (*indent_level)++;
 
-    while (member) {
+// Forward declaration
+static void freeJsonObject(JSON_DOCUMENT *doc, JSON_MEMBER *member);
 
-        printIndent(*indent_level);
-        printJsonValue(member->Value, indent_level);
-        member = member->Next;
-        if (member)
-            printf(",\n");
-        else
-            printf("\n");
-    }
 
-    (*indent_level)--;
-    printIndent(*indent_level);
-    printf("]");
-}
+// Forward declarations
+static void freeMemberIndexes(MEMBER_INDEX *index);
+static MEMBER_INDEX *getMemberIndex(JSON_MEMBER *head);
+static void freeKeyTable(struct _KEY_TABLE *keys);
 
 
-static void printJsonValue(JSON_VALUE *value, int *indent_level)
+static void freeArenaChunks(JSON_DOCUMENT *doc)
 {
-    ASSERT(value->Signature == JSON_VALUE_SIGNATURE);
-
-    switch (value->Type) {
+    //--------------------------
+    JSON_ARENA *chunk;
+    JSON_ARENA *next_chunk;
+    void *mapping = NULL;
+    size_t mapping_length = 0;
+    //--------------------------
 
-        case TYPE_OBJECT:
-            printJsonObject(value->Object, indent_level);
-            break;
+    freeMemberIndexes(doc->Indexes);
 
-        case TYPE_ARRAY:
-            printJsonArray(value->Object, indent_level);
-            break;
+    if (doc->Lazy)
+        free(doc->Lazy->Positions);
 
-        case TYPE_STRING:
-            printf("\"%s\"", value->String);
-            break;
+    if (doc->Keys)
+        freeKeyTable(doc->Keys);
 
-        case TYPE_BOOLEAN:
-            if (value->Boolean)
-                printf("true");
-            else
-                printf("false");
-            break;
+    //  The header goes with the first chunk.
+    if (doc->Mapped) {
+        mapping = doc->Buffer;
+        mapping_length = doc->BufferLength;
+    }
 
-        case TYPE_NUMBER:
-            printf("%f", value->Number);
-            break;
+    chunk = doc->Arena;
+    doc->Signature = 0;
 
-        default:
-            break;
+    while (chunk) {
+        next_chunk = chunk->Next;
+        free(chunk);
+        chunk = next_chunk;
     }
+
+    if (mapping)
+        munmap(mapping, mapping_length);
 }
 
 
-static void printJsonMember(JSON_MEMBER *member, int *indent_level)
+static void freeJsonDocument(JSON_DOCUMENT *doc)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    if (doc->Arena) {
+        freeArenaChunks(doc);
+        return;
+    }
 
-    printIndent(*indent_level);
-    printf("\"%s\":", member->Name);
-    printJsonValue(member->Value, indent_level);
+    if (doc->Root)
+        freeJsonObject(doc, doc->Root);
+
+    doc->Signature = 0;
+    free(doc);
 }
 
 
-static void printJsonObject(JSON_MEMBER *member, int *indent_level)
+//
+//  All node and string allocations go through these. Without an arena
+//  the memory comes from the heap and is owned by the node itself.
+//
+static void *jsonAlloc(JSON_DOCUMENT *doc, size_t size)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    if (usesArena(doc))
+        return arenaAlloc(doc, size);
+    else
+        return malloc(size);
+}
 
-    printf("{\n");
-    (*indent_level)++;
 
-    while (member) {
-        printJsonMember(member, indent_level);
-        member = member->Next;
-        if (member)
-            printf(",\n");
-        else
-            printf("\n");
-    }
-    (*indent_level)--;
-    printIndent(*indent_level);
-    printf("}");
+//
+//  Arena memory cannot grow in place, so it is copied to a new block and
+//  the old one is left to go with the arena.
+//
+static void *jsonRealloc(JSON_DOCUMENT *doc, void *ptr, size_t old_size,
+                         size_t new_size)
+{
+    //--------------------------
+    void *new_ptr;
+    //--------------------------
+
+    if (!usesArena(doc))
+        return realloc(ptr, new_size);
+
+    new_ptr = arenaAlloc(doc, new_size);
+    if (new_ptr && old_size)
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+
+    return new_ptr;
 }
 
 
-void JSON_Print(JSON_OBJECT_HANDLE object)
+static char *jsonStrndup(JSON_DOCUMENT *doc, const char *string, size_t length)
 {
     //--------------------------
-    int indent_level = 0;
-    JSON_MEMBER *member;
+    char *new_string;
     //--------------------------
 
-    JSON_Errno = SUCCESS;
-    member = object;
+    if (!usesArena(doc))
+        return strndup(string, length);
+
+    new_string = (char *)arenaAlloc(doc, length + 1);
+    if (!new_string) {
+        return NULL;
+    }
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE)
-        JSON_Errno = ERROR_INVALID_OBJECT;
+    memcpy(new_string, string, length);
+    new_string[length] = 0;
 
-    printJsonObject(member, &indent_level);
-    printf("\n");
+    return new_string;
 }
-#endif
 
 
-static void dbgPrintType(JSON_TYPE type)
+static char *jsonStrdup(JSON_DOCUMENT *doc, const char *string)
 {
-    printf("Value Type: ");
-    switch(type) {
-        case TYPE_UNKNOWN: printf("TYPE_UNKNOWN\n"); break;
-        case TYPE_OBJECT: printf("TYPE_OBJECT\n"); break;
-        case TYPE_STRING: printf("TYPE_STRING\n"); break;
-        case TYPE_BOOLEAN: printf("TYPE_BOOLEAN\n"); break;
-        case TYPE_ARRAY: printf("TYPE_ARRAY\n"); break;
-        case TYPE_NUMBER: printf("TYPE_NUMBER\n"); break;
-        default: printf("Invalid!!!\n"); break;
-    }
+    return jsonStrndup(doc, string, strlen(string));
 }
 
 
-#define SMART_BUFFER_SIGNATURE 0x53627566
+//
+//  Resolves a public handle, which is either a document or a plain
+//  object member, to the first member of the object.
+//
+static JSON_MEMBER *getJsonMember(JSON_OBJECT_HANDLE object, JSON_DOCUMENT **doc)
+{
+    //--------------------------
+    JSON_DOCUMENT *document;
+    JSON_MEMBER *member;
+    //--------------------------
 
+    if (doc)
+        *doc = NULL;
 
-typedef struct _SMART_BUFFER {
+    if (!object)
+        return NULL;
 
-    int Signature;
-    char *buffer;
-    int buffer_length;
-    int length_used;
+    document = object;
+    member = object;
 
-}SMART_BUFFER;
+    if (document->Signature == JSON_DOCUMENT_SIGNATURE) {
+        if (doc)
+            *doc = document;
+        return document->Root;
+    }
+    else if (member->Signature == JSON_MEMBER_SIGNATURE) {
+        return member;
+    }
+    else {
+        return NULL;
+    }
+}
 
 
-static void updateBuffer(SMART_BUFFER *sb)
+static JSON_VALUE *allocJsonValue(JSON_DOCUMENT *doc)
 {
-    //----------------------
-    char *new_buffer;
-    int new_length = -1;
-    int remaining_length;
-    //----------------------
+    //--------------------------
+    JSON_VALUE *value;
+    //--------------------------
 
-    if (sb->buffer_length <= 0) {
-        new_length = 1024;
+    value = (JSON_VALUE *)jsonAlloc(doc, sizeof(JSON_VALUE));
+    if (!value) {
+        return NULL;
     }
-    else {
-        remaining_length = sb->buffer_length - sb->length_used;
 
-        if (remaining_length < 512) {
-            new_length = sb->buffer_length + 1024;
-        }
-    }
+    memset(value, 0, sizeof(JSON_VALUE));
+    value->Signature = JSON_VALUE_SIGNATURE;
 
-    if (new_length > 0) {
-        new_buffer = (char*) realloc(sb->buffer, new_length);
-        if (!new_buffer) {
-            free(sb->buffer);
-            JSON_Errno = ERROR_ALLOC_FAILED;
-            longjmp(stringify_jmp_buffer, 1);
-        }
-        sb->buffer_length = new_length;
-        sb->buffer = new_buffer;
-    }
+    return value;
 }
 
 
-// Forward dec'l
-static void stringifyJsonObject(JSON_MEMBER *member, SMART_BUFFER *sb);
-static void stringifyJsonValue(JSON_VALUE *value, SMART_BUFFER *sb);
-
-
-static void stringifyJsonArray(JSON_MEMBER *member, SMART_BUFFER *sb)
+static JSON_ARRAY *allocJsonArray(JSON_DOCUMENT *doc)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
-
-    sb->length_used += sprintf( sb->buffer + sb->length_used, "[");
+    //--------------------------
+    JSON_ARRAY *array;
+    //--------------------------
 
-    while (member) {
-        stringifyJsonValue(member->Value, sb);
-        member = member->Next;
-        if (member)
-            sb->length_used += sprintf( sb->buffer + sb->length_used, ",");
+    array = (JSON_ARRAY *)jsonAlloc(doc, sizeof(JSON_ARRAY));
+    if (!array) {
+        return NULL;
     }
 
-    sb->length_used += sprintf( sb->buffer + sb->length_used, "]");
+    memset(array, 0, sizeof(JSON_ARRAY));
+    array->Signature = JSON_ARRAY_SIGNATURE;
+
+    return array;
 }
 
 
-static void stringifyJsonValue(JSON_VALUE *value, SMART_BUFFER *sb)
+//
+//  Makes room for at least one more element. Returns -1 if out of memory.
+//
+static int growJsonArray(JSON_DOCUMENT *doc, JSON_ARRAY *array)
 {
-    ASSERT(value->Signature == JSON_VALUE_SIGNATURE);
-    ASSERT(sb->Signature == SMART_BUFFER_SIGNATURE);
-
-    switch (value->Type) {
-
-        case TYPE_OBJECT:
-            stringifyJsonObject(value->Object, sb);
-            break;
-
-        case TYPE_ARRAY:
-            stringifyJsonArray(value->Object, sb);
-            break;
+    //--------------------------
+    JSON_VALUE *values;
+    size_t capacity;
+    //--------------------------
 
-        case TYPE_STRING:
-            sb->length_used += sprintf( sb->buffer + sb->length_used, "\"%s\"",
-                                        value->String);
-            break;
+    capacity = array->Capacity ? array->Capacity * 2 : 8;
 
-        case TYPE_BOOLEAN:
-            if (value->Boolean)
-                sb->length_used += sprintf( sb->buffer + sb->length_used,
-                                            "true");
-            else
-                sb->length_used += sprintf( sb->buffer + sb->length_used,
-                                            "false");
-            break;
+    if (capacity > SIZE_MAX / sizeof(JSON_VALUE))
+        return -1;
 
-        case TYPE_NUMBER:
-            sb->length_used += sprintf( sb->buffer + sb->length_used, "%f",
-                                        value->Number);
-            break;
+    values = (JSON_VALUE *)jsonRealloc(doc, array->Values,
+                                       array->Capacity * sizeof(JSON_VALUE),
+                                       capacity * sizeof(JSON_VALUE));
+    if (!values)
+        return -1;
 
-        default:
-            break;
-    }
+    array->Values = values;
+    array->Capacity = capacity;
 
-    updateBuffer(sb);
+    return 0;
 }
 
 
-static void stringifyJsonMember(JSON_MEMBER *member, SMART_BUFFER *sb)
+static JSON_MEMBER *allocJsonMember(JSON_DOCUMENT *doc)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
-    ASSERT(sb->Signature == SMART_BUFFER_SIGNATURE);
-
-    sb->length_used += sprintf( sb->buffer + sb->length_used, "\"%s\":",
-                                member->Name);
-    updateBuffer(sb);
-    stringifyJsonValue(member->Value, sb);
-}
+    //---------------------
+    JSON_MEMBER *member;
+    //---------------------
 
+    member = (JSON_MEMBER*) jsonAlloc(doc, sizeof(JSON_MEMBER));
+    if (!member){
+        return NULL;
+    }
 
-static void stringifyJsonObject(JSON_MEMBER *member, SMART_BUFFER *sb)
-{
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    memset(member, 0, sizeof(JSON_MEMBER));
+    member->Signature = JSON_MEMBER_SIGNATURE;
 
-    updateBuffer(sb);
-    sb->length_used += sprintf(sb->buffer + sb->length_used, "{");
+    //  Whichever member ends up first in its object needs this.
+    if (usesArena(doc))
+        member->Index = doc;
 
-    while (member) {
-        stringifyJsonMember(member, sb);
-        member = member->Next;
-        if (member) {
-            sb->length_used += sprintf(sb->buffer + sb->length_used, ",");
-        }
-    }
-    sb->length_used += sprintf(sb->buffer + sb->length_used, "}");
+    return member;
 }
 
 
-char* JSON_Stringify(JSON_OBJECT_HANDLE object)
+static JSON_MEMBER *allocJsonNode(JSON_DOCUMENT *doc)
 {
-    //-------------------------------
-    SMART_BUFFER sb = {0};
-    int rc;
-    JSON_MEMBER *member;
-    //-------------------------------
-
-    JSON_Errno = SUCCESS;
-    member = object;
-
-    sb.Signature = SMART_BUFFER_SIGNATURE;
+    //---------------------
+    JSON_NODE *node;
+    //---------------------
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
+    node = (JSON_NODE *) jsonAlloc(doc, sizeof(JSON_NODE));
+    if (!node){
         return NULL;
     }
 
-    rc = setjmp(stringify_jmp_buffer);
-    if (rc == 0) {
-        stringifyJsonObject(object, &sb);
-        return sb.buffer;
-    }
-    else {
-        return NULL;
-    }
-}
+    memset(node, 0, sizeof(JSON_NODE));
+    node->Member.Signature = JSON_MEMBER_SIGNATURE;
+    node->Member.InNode = 1;
+    node->Member.Value = &node->Value;
+    node->Value.Signature = JSON_VALUE_SIGNATURE;
 
+    if (usesArena(doc))
+        node->Member.Index = doc;
 
-// Forward declarations
-static void freeJsonObject(JSON_MEMBER *member);
-static void freeJsonValue(JSON_VALUE *value);
-static void freeJsonMember(JSON_MEMBER *member);
+    return &node->Member;
+}
 
 
-static void freeJsonArray(JSON_MEMBER *member)
-{
-    //-----------------------------
-    JSON_MEMBER *next_member;
-    //-----------------------------
+//---------------------------------------------------------------------------
+//
+//  Interned member names for JSON_ParseInterned().
+//
+//  Each distinct name is stored once, in Storage, and found again
+//  through an open addressing table of its hash and length, so every
+//  member of that name points at the same string. The table of a single
+//  document uses the document as Storage and goes with it. A shared one
+//  has a storage document of its own, and outlives the documents that
+//  point into it.
+//
+//---------------------------------------------------------------------------
+#define KEY_TABLE_SIGNATURE 0x7379654B
 
-    ASSERT(member != NULL);
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
 
-    while (member) {
-        next_member = member->Next;
-        freeJsonMember(member);
-        member = next_member;
-    }
-}
+typedef struct _KEY_SLOT {
 
+    const char *Name;
+    uint32_t Hash;
+    uint32_t Length;
 
-static void freeJsonValue(JSON_VALUE *value)
-{
-    ASSERT(value != NULL);
-    ASSERT(value->Signature == JSON_VALUE_SIGNATURE);
+} KEY_SLOT;
 
-    switch (value->Type) {
 
-        case TYPE_OBJECT:
-            freeJsonObject(value->Object);
-            break;
+typedef struct _KEY_TABLE {
 
-        case TYPE_ARRAY:
-            freeJsonArray(value->Object);
-            break;
+    int Signature;
+    JSON_DOCUMENT *Storage;
+    KEY_SLOT *Slots;
+    size_t Mask;
+    size_t Count;
 
-        case TYPE_STRING:
-            free(value->String);
-            break;
+} KEY_TABLE;
 
-        case TYPE_BOOLEAN:
-            break;
 
-        case TYPE_NUMBER:
-            break;
+//
+//  FNV-1a, the one hash of member names, so that key tables, member
+//  indexes, compiled paths and images all agree.
+//
+static inline uint32_t hashBytes(const char *bytes, size_t length)
+{
+    //-----------------------------
+    uint32_t hash = 2166136261u;
+    size_t i;
+    //-----------------------------
 
-        default:
-            break;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 16777619u;
     }
 
-    free(value);
+    return hash;
 }
 
 
-static void freeJsonMember(JSON_MEMBER *member)
+//
+//  Returns the slot holding name, or the empty slot where it would go.
+//
+static KEY_SLOT *findKeySlot(KEY_TABLE *keys, const char *name,
+                             size_t length, uint32_t hash)
 {
-    ASSERT(member != NULL);
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    //-----------------------------
+    KEY_SLOT *slot;
+    size_t i;
+    //-----------------------------
 
-    if (member->Name) {
-        free(member->Name);
-        member->Name = NULL;
+    for (i = hash & keys->Mask; ; i = (i + 1) & keys->Mask) {
+        slot = &keys->Slots[i];
+        if (!slot->Name)
+            return slot;
+        if (slot->Hash == hash && slot->Length == length &&
+            memcmp(slot->Name, name, length) == 0)
+            return slot;
     }
-
-    freeJsonValue(member->Value);
 }
 
 
-static void freeJsonObject(JSON_MEMBER *member)
+//
+//  Keeps the table at most half full. Returns -1 if it could not grow.
+//
+static int growKeyTable(KEY_TABLE *keys)
 {
-    //------------------------
-    JSON_MEMBER *next_member;
-    //------------------------
+    //-----------------------------
+    KEY_SLOT *old_slots;
+    KEY_SLOT *slot;
+    size_t old_size;
+    size_t new_size;
+    size_t i;
+    //-----------------------------
 
-    ASSERT(member != NULL);
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    old_slots = keys->Slots;
+    old_size = old_slots ? keys->Mask + 1 : 0;
+    new_size = old_size ? old_size * 2 : 64;
 
-    while (member) {
-        next_member = member->Next;
-        freeJsonMember(member);
-        member = next_member;
+    keys->Slots = (KEY_SLOT *)calloc(new_size, sizeof(KEY_SLOT));
+    if (!keys->Slots) {
+        keys->Slots = old_slots;
+        return -1;
     }
+
+    keys->Mask = new_size - 1;
+
+    for (i = 0; i < old_size; i++) {
+        if (!old_slots[i].Name)
+            continue;
+        slot = findKeySlot(keys, old_slots[i].Name, old_slots[i].Length,
+                           old_slots[i].Hash);
+        *slot = old_slots[i];
+    }
+
+    free(old_slots);
+
+    return 0;
 }
 
 
-void JSON_FreeObject(JSON_OBJECT_HANDLE object)
+static KEY_TABLE *createKeyTable(JSON_DOCUMENT *storage)
 {
-    //-------------------------------
-    JSON_MEMBER *member;
-    //-------------------------------
+    //-----------------------------
+    KEY_TABLE *keys;
+    //-----------------------------
 
-    JSON_Errno = SUCCESS;
-    member = object;
+    keys = (KEY_TABLE *)calloc(1, sizeof(KEY_TABLE));
+    if (!keys)
+        return NULL;
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return;
+    keys->Signature = KEY_TABLE_SIGNATURE;
+    keys->Storage = storage;
+
+    if (growKeyTable(keys) != 0) {
+        free(keys);
+        return NULL;
     }
 
-    freeJsonObject(object);
+    return keys;
 }
 
 
-static JSON_MEMBER *findJsonMemberInObject(JSON_MEMBER *member, char *name)
+static void freeKeyTable(KEY_TABLE *keys)
 {
-    ASSERT(member != NULL);
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
-
-    while (member) {
-        if (strcmp(member->Name, name) == 0){
-            return member;
-        }
-        member = member->Next;
-    }
-    return NULL;
+    keys->Signature = 0;
+    free(keys->Slots);
+    free(keys);
 }
 
 
-static void addJsonMemberToObject(JSON_MEMBER *member, JSON_MEMBER *new_member)
+//
+//  Returns the one copy of name, adding it if it is new, or NULL if out
+//  of memory.
+//
+static const char *internKey(KEY_TABLE *keys, const char *name, size_t length)
 {
-    ASSERT(member != NULL);
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
-    ASSERT(new_member != NULL);
-    ASSERT(new_member->Signature == JSON_MEMBER_SIGNATURE);
+    //-----------------------------
+    KEY_SLOT *slot;
+    uint32_t hash;
+    char *copy;
+    //-----------------------------
 
-    while (1) {
-        if (!member->Next) {
-            member->Next = new_member;
-            return;
-        }
-        member = member->Next;
+    if (length > UINT32_MAX)
+        return NULL;
+
+    hash = hashBytes(name, length);
+    slot = findKeySlot(keys, name, length, hash);
+
+    if (slot->Name)
+        return slot->Name;
+
+    if ((keys->Count + 1) * 2 > keys->Mask + 1) {
+        if (growKeyTable(keys) != 0)
+            return NULL;
+        slot = findKeySlot(keys, name, length, hash);
     }
-}
 
+    copy = jsonStrndup(keys->Storage, name, length);
+    if (!copy)
+        return NULL;
 
-enum DOB_BRACKET_ORDER {
-    DOB_LAST_ELEMENT,
-    DOB_NEXT_IS_OBJECT,
-    DOB_NEXT_IS_NAMED_ARRAY,
-    DOB_NEXT_IS_NESTED_ARRAY,
-};
+    slot->Name = copy;
+    slot->Hash = hash;
+    slot->Length = (uint32_t)length;
+    keys->Count++;
 
+    return copy;
+}
 
-typedef struct DotOrBracket_ {
-    char *Dot;
-    char *Bracket;
-    enum DOB_BRACKET_ORDER Order;
-    char *Path;
-    int ArrayIndex;
-}DotOrBracket;
+
+//---------------------------------------------------------------------------
+//
+//  Stage 1: structural index.
+//
+//  The input is classified 64 bytes at a time into bit masks of quotes,
+//  backslashes, operators and whitespace. Plain bit arithmetic on those
+//  masks then finds which quotes are escaped and which bytes are inside
+//  strings, leaving one bit per structural position: every operator
+//  outside a string, every unescaped quote and the first byte of every
+//  literal or number. Stage 2 walks these positions and never scans for
+//  structure itself.
+//
+//---------------------------------------------------------------------------
+#define CHAR_WHITESPACE 0x01
+#define CHAR_OPERATOR   0x02
+#define CHAR_QUOTE      0x04
+#define CHAR_BACKSLASH  0x08
 
 
-static int parseArrayIndex(DotOrBracket *dob)
+typedef struct _BLOCK_MASKS {
+
+    uint64_t Whitespace;
+    uint64_t Operator;
+    uint64_t Quote;
+    uint64_t Backslash;
+
+} BLOCK_MASKS;
+
+
+typedef struct _SCAN_STATE {
+
+    uint64_t PrevEndsOddBackslash;
+    uint64_t PrevInString;
+    uint64_t PrevEndsPseudoPred;
+
+} SCAN_STATE;
+
+
+static const unsigned char char_class[256] = {
+    [' '] = CHAR_WHITESPACE,
+    ['\t'] = CHAR_WHITESPACE,
+    ['\n'] = CHAR_WHITESPACE,
+    ['\r'] = CHAR_WHITESPACE,
+    ['{'] = CHAR_OPERATOR,
+    ['}'] = CHAR_OPERATOR,
+    ['['] = CHAR_OPERATOR,
+    [']'] = CHAR_OPERATOR,
+    [':'] = CHAR_OPERATOR,
+    [','] = CHAR_OPERATOR,
+    ['"'] = CHAR_QUOTE,
+    ['\\'] = CHAR_BACKSLASH,
+};
+
+
+static inline void classifyBlockScalar(const char *block, BLOCK_MASKS *masks)
 {
-    //-----------------
-    char *endptr;
-    long index;
-    //-----------------
+    //-----------------------------
+    uint64_t bit;
+    unsigned char c;
+    int i;
+    //-----------------------------
 
-    errno = 0;
+    memset(masks, 0, sizeof(BLOCK_MASKS));
 
-    index = strtol(dob->Path, &endptr, 0);
+    for (i = 0; i < 64; i++) {
 
-    if (*endptr != ']') {
-        JSON_Errno = ERROR_INVALID_ARRAY;
-        return -1;
+        c = char_class[(unsigned char)block[i]];
+        if (!c)
+            continue;
+
+        bit = (uint64_t)1 << i;
+
+        if (c & CHAR_WHITESPACE)
+            masks->Whitespace |= bit;
+        else if (c & CHAR_OPERATOR)
+            masks->Operator |= bit;
+        else if (c & CHAR_QUOTE)
+            masks->Quote |= bit;
+        else
+            masks->Backslash |= bit;
     }
-    else {
-        endptr++;
-        dob->Path = endptr;
+}
+
+
+#ifdef JSON_SIMD_X86
+
+
+//
+//  '[' and ']' differ from '{' and '}' only in bit 0x20, so or-ing it in
+//  matches all four brackets with two compares.
+//
+__attribute__((target("sse2")))
+static inline void classifyBlockSse2(const char *block, BLOCK_MASKS *masks)
+{
+    //-----------------------------
+    __m128i in;
+    __m128i lower;
+    __m128i op;
+    __m128i ws;
+    int shift;
+    //-----------------------------
+
+    memset(masks, 0, sizeof(BLOCK_MASKS));
+
+    for (shift = 0; shift < 64; shift += 16) {
+
+        in = _mm_loadu_si128((const __m128i *)(block + shift));
+        lower = _mm_or_si128(in, _mm_set1_epi8(0x20));
+
+        op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')),
+                             _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(':')),
+                             _mm_cmpeq_epi8(in, _mm_set1_epi8(','))));
+
+        ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(' ')),
+                             _mm_cmpeq_epi8(in, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('\n')),
+                             _mm_cmpeq_epi8(in, _mm_set1_epi8('\r'))));
+
+        masks->Operator |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+        masks->Whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << shift;
+        masks->Quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(in, _mm_set1_epi8('"'))) << shift;
+        masks->Backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(in, _mm_set1_epi8('\\'))) << shift;
     }
+}
 
-    if (errno) {
-        JSON_Errno = ERROR_INVALID_ARRAY;
-        return -1;
+
+__attribute__((target("avx2")))
+static inline void classifyBlockAvx2(const char *block, BLOCK_MASKS *masks)
+{
+    //-----------------------------
+    __m256i in;
+    __m256i lower;
+    __m256i op;
+    __m256i ws;
+    int shift;
+    //-----------------------------
+
+    memset(masks, 0, sizeof(BLOCK_MASKS));
+
+    for (shift = 0; shift < 64; shift += 32) {
+
+        in = _mm256_loadu_si256((const __m256i *)(block + shift));
+        lower = _mm256_or_si256(in, _mm256_set1_epi8(0x20));
+
+        op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')),
+                                _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(':')),
+                                _mm256_cmpeq_epi8(in, _mm256_set1_epi8(','))));
+
+        ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(' ')),
+                                _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('\n')),
+                                _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\r'))));
+
+        masks->Operator |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        masks->Whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << shift;
+        masks->Quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(in, _mm256_set1_epi8('"'))) << shift;
+        masks->Backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\\'))) << shift;
     }
+}
 
-    return (int)index;
+#endif
+
+
+//
+//  Returns the positions following an odd length run of backslashes,
+//  which are exactly the escaped characters. Runs may continue across
+//  blocks, which the carry in the scan state accounts for.
+//
+static inline uint64_t findEscaped(uint64_t backslash, SCAN_STATE *state)
+{
+    //-----------------------------
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    const uint64_t odd_bits = ~even_bits;
+    uint64_t start_edges;
+    uint64_t even_start_mask;
+    uint64_t even_starts;
+    uint64_t odd_starts;
+    uint64_t even_carries;
+    unsigned long long odd_carries;
+    uint64_t ends_odd;
+    //-----------------------------
+
+    start_edges = backslash & ~(backslash << 1);
+    even_start_mask = even_bits ^ state->PrevEndsOddBackslash;
+    even_starts = start_edges & even_start_mask;
+    odd_starts = start_edges & ~even_start_mask;
+
+    even_carries = backslash + even_starts;
+    ends_odd = __builtin_uaddll_overflow(backslash, odd_starts, &odd_carries);
+    odd_carries |= state->PrevEndsOddBackslash;
+    state->PrevEndsOddBackslash = ends_odd ? 1 : 0;
+
+    return ((even_carries & ~backslash) & odd_bits) |
+           ((odd_carries & ~backslash) & even_bits);
 }
 
 
-static char *getNextDotOrBracket(DotOrBracket *dob)
+static inline uint64_t prefixXor(uint64_t bits)
 {
-    //------------------
-    char *name;
-    //------------------
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
 
-    dob->Bracket = strchr(dob->Path, '[');
-    dob->Dot = strchr(dob->Path, '.');
 
-    if (!dob->Dot && !dob->Bracket) {
-        dob->Order = DOB_LAST_ELEMENT;
-        name = dob->Path;
+static inline uint64_t findStructurals(BLOCK_MASKS *masks, SCAN_STATE *state)
+{
+    //-----------------------------
+    uint64_t quotes;
+    uint64_t in_string;
+    uint64_t structurals;
+    uint64_t pseudo_pred;
+    uint64_t shifted_pred;
+    //-----------------------------
+
+    quotes = masks->Quote & ~findEscaped(masks->Backslash, state);
+
+    //  Set from an opening quote up to, not including, its closing quote.
+    in_string = prefixXor(quotes) ^ state->PrevInString;
+    state->PrevInString = (uint64_t)((int64_t)in_string >> 63);
+
+    structurals = (masks->Operator & ~in_string) | quotes;
+
+    //  Any other byte following whitespace or an operator starts a
+    //  literal or number.
+    pseudo_pred = structurals | masks->Whitespace;
+    shifted_pred = (pseudo_pred << 1) | state->PrevEndsPseudoPred;
+    state->PrevEndsPseudoPred = pseudo_pred >> 63;
+
+    structurals |= shifted_pred & ~masks->Whitespace & ~in_string;
+
+    return structurals;
+}
+
+
+#define STRUCTURAL_INDEX_GROWTH 4096
+
+
+static int reserveIndex(STRUCTURAL_INDEX *index, size_t needed)
+{
+    //-----------------------------
+    uint32_t *positions;
+    size_t capacity;
+    //-----------------------------
+
+    if (index->Capacity - index->Count >= needed)
+        return 1;
+
+    capacity = index->Capacity * 2 + STRUCTURAL_INDEX_GROWTH;
+    if (capacity - index->Count < needed)
+        capacity = index->Count + needed;
+
+    if (index->Positions == index->Inline) {
+        positions = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+        if (positions)
+            memcpy(positions, index->Inline, index->Count * sizeof(uint32_t));
     }
-    else if (!dob->Bracket) {
-        dob->Order = DOB_NEXT_IS_OBJECT;
-        name = dob->Path;
-        *(dob->Dot) = 0;
-        dob->Path = dob->Dot + 1;
+    else {
+        positions = (uint32_t *)realloc(index->Positions,
+                                        capacity * sizeof(uint32_t));
     }
-    else if (!dob->Dot) {
-        if (dob->Bracket == dob->Path) {
-            dob->Order = DOB_NEXT_IS_NESTED_ARRAY;
-            name = NULL;
-            *(dob->Bracket) = 0;
-            dob->Path = dob->Bracket + 1;
-            dob->ArrayIndex = parseArrayIndex(dob);
+
+    if (!positions)
+        return 0;
+
+    index->Positions = positions;
+    index->Capacity = capacity;
+
+    return 1;
+}
+
+
+static void initStructuralIndex(STRUCTURAL_INDEX *index)
+{
+    index->Positions = index->Inline;
+    index->Capacity = STRUCTURAL_INLINE_SIZE;
+    index->Count = 0;
+}
+
+
+static void freeStructuralIndex(STRUCTURAL_INDEX *index)
+{
+    if (index->Positions != index->Inline)
+        free(index->Positions);
+
+    index->Positions = index->Inline;
+}
+
+
+//
+//  The scanning loop is written once and inlined into each instruction
+//  set specific scanner, together with that scanner's classifier.
+//
+__attribute__((always_inline))
+static inline JSON_ERROR scanStructurals(const char *buffer, size_t length,
+                STRUCTURAL_INDEX *index,
+                void (*classify)(const char *, BLOCK_MASKS *))
+{
+    //-----------------------------
+    //  The text starts as if after whitespace, so a literal at byte 0 is
+    //  indexed, and rejected, like one anywhere else.
+    SCAN_STATE state = { 0, 0, 1 };
+    BLOCK_MASKS masks;
+    char tail[64];
+    size_t offset;
+    uint64_t bits;
+    uint32_t *positions;
+    size_t count;
+    size_t i;
+    int j;
+    //-----------------------------
+
+    for (offset = 0; offset < length; offset += 64) {
+
+        if (!reserveIndex(index, 64 + 8))
+            return ERROR_ALLOC_FAILED;
+
+        if (length - offset >= 64) {
+            classify(buffer + offset, &masks);
         }
         else {
-            dob->Order = DOB_NEXT_IS_NAMED_ARRAY;
-            name = dob->Path;
-            *(dob->Bracket) = 0;
-            dob->Path = dob->Bracket + 1;
-            dob->ArrayIndex = parseArrayIndex(dob);
-        }
-    }
-    else if (dob->Bracket > dob->Dot) {
-        dob->Order = DOB_NEXT_IS_OBJECT;
-        name = dob->Path;
-        *(dob->Dot) = 0;
-        dob->Path = dob->Dot + 1;
-    }
-    else {
-        if (dob->Bracket == dob->Path) {
-            dob->Order = DOB_NEXT_IS_NESTED_ARRAY;
-            name = NULL;
-            *(dob->Bracket) = 0;
-            dob->Path = dob->Bracket + 1;
-            dob->ArrayIndex = parseArrayIndex(dob);
+            // Pad the last block with whitespace, which is never indexed.
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, buffer + offset, length - offset);
+            classify(tail, &masks);
         }
-        else {
-            dob->Order = DOB_NEXT_IS_NAMED_ARRAY;
-            name = dob->Path;
-            *(dob->Bracket) = 0;
-            dob->Path = dob->Bracket + 1;
-            dob->ArrayIndex = parseArrayIndex(dob);
+
+        bits = findStructurals(&masks, &state);
+
+        //  Write positions eight at a time without testing each bit;
+        //  entries past the real count are garbage and get overwritten.
+        positions = index->Positions + index->Count;
+        count = __builtin_popcountll(bits);
+
+        for (i = 0; i < count; i += 8) {
+            for (j = 0; j < 8; j++) {
+                positions[i + j] = (uint32_t)(offset +
+                        __builtin_ctzll(bits | 0x8000000000000000ULL));
+                bits &= bits - 1;
+            }
         }
+
+        index->Count += count;
     }
 
-    return name;
+    if (state.PrevInString)
+        return ERROR_INVALID_STRING;
+
+    return SUCCESS;
 }
 
 
-JSON_VALUE *findJsonValueInArray(JSON_MEMBER *member, int index)
+static JSON_ERROR scanStructuralsScalar(const char *buffer, size_t length,
+                                        STRUCTURAL_INDEX *index)
 {
-    //------------------------
-    int i = 0;
-    //------------------------
+    return scanStructurals(buffer, length, index, classifyBlockScalar);
+}
 
-    while (i < index) {
-        member = member->Next;
-        if (!member)
-            return NULL;
-        i++;
-    }
 
-    return member->Value;
+#ifdef JSON_SIMD_X86
+
+__attribute__((target("sse2")))
+static JSON_ERROR scanStructuralsSse2(const char *buffer, size_t length,
+                                      STRUCTURAL_INDEX *index)
+{
+    return scanStructurals(buffer, length, index, classifyBlockSse2);
 }
 
 
-static JSON_VALUE *findJsonValue(char *path, JSON_MEMBER *member)
+__attribute__((target("avx2")))
+static JSON_ERROR scanStructuralsAvx2(const char *buffer, size_t length,
+                                      STRUCTURAL_INDEX *index)
 {
-    //------------------------
-    JSON_VALUE *value;
-    char *name;
-    char *path_copy;
-    DotOrBracket dob;
-    //------------------------
+    return scanStructurals(buffer, length, index, classifyBlockAvx2);
+}
 
-    path_copy = strdup(path);
-    dob.Path = path_copy;
+#endif
 
-    while (1) {
 
-        name = getNextDotOrBracket(&dob);
+typedef JSON_ERROR (*STRUCTURAL_SCANNER)(const char *, size_t,
+                                         STRUCTURAL_INDEX *);
 
-        switch(dob.Order) {
 
-            case DOB_LAST_ELEMENT:
+static STRUCTURAL_SCANNER structural_scanner;
 
-                member = findJsonMemberInObject(member, name);
-                if (!member) {
-                    goto FIND_FAILED;
-                }
-                else if (member->Value->Type == TYPE_OBJECT) {
-                    goto FIND_FAILED;
-                }
-                else {
-                    value = member->Value;
-                    goto EXIT;
-                }
 
-            case DOB_NEXT_IS_OBJECT:
+//
+//  Picks the widest scanner the CPU supports. Racing threads all pick
+//  the same one, so the first call needs no lock.
+//
+static STRUCTURAL_SCANNER selectStructuralScanner(void)
+{
+    //-----------------------------
+    STRUCTURAL_SCANNER scanner;
+    //-----------------------------
 
-                member = findJsonMemberInObject(member, name);
-                if (!member) {
-                    goto FIND_FAILED;
-                }
-                else if (member->Value->Type != TYPE_OBJECT) {
-                    goto FIND_FAILED;
-                }
-                else {
-                    member = member->Value->Object;
-                    break;
-                }
+    scanner = __atomic_load_n(&structural_scanner, __ATOMIC_ACQUIRE);
+    if (scanner)
+        return scanner;
 
-            case DOB_NEXT_IS_NAMED_ARRAY:
+    scanner = scanStructuralsScalar;
 
-                if (dob.ArrayIndex < 0) {
-                    goto FIND_FAILED;
-                }
+#ifdef JSON_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scanner = scanStructuralsAvx2;
+    else if (__builtin_cpu_supports("sse2"))
+        scanner = scanStructuralsSse2;
+#endif
 
-                value = findJsonValueInArray(member->Value->Object, dob.ArrayIndex);
-                if (!value)
-                    goto FIND_FAILED;
+    __atomic_store_n(&structural_scanner, scanner, __ATOMIC_RELEASE);
 
-                if (value->Type == TYPE_OBJECT) {
-                    member = value->Object;
-                    // Skip the next dot.
-                    dob.Path++;
-                }
-                else if (value->Type == TYPE_ARRAY) {
-                    // We have nested arrays here.
-                    member = value->Object;
-                }
-                else {
-                    //  We have the value. We can leave.
-                    goto EXIT;
-                }
-                break;
+    return scanner;
+}
 
-            case DOB_NEXT_IS_NESTED_ARRAY:
 
-                if (dob.ArrayIndex < 0) {
-                    goto FIND_FAILED;
-                }
+static JSON_ERROR buildStructuralIndex(const char *buffer, size_t length,
+                                       STRUCTURAL_INDEX *index)
+{
+    if (length >= UINT32_MAX)
+        return ERROR_INVALID_OBJECT;
 
-                value = findJsonValueInArray(member, dob.ArrayIndex);
-                if (!value)
-                    goto FIND_FAILED;
+    //  Typical documents have a structural every four bytes or more, so
+    //  this usually avoids growing the index while scanning.
+    if (!reserveIndex(index, length / 4 + 64 + 8))
+        return ERROR_ALLOC_FAILED;
 
-                if (value->Type == TYPE_OBJECT) {
-                    member = value->Object;
-                    // Skip the next dot.
-                    dob.Path++;
-                }
-                else if (value->Type == TYPE_ARRAY) {
-                    // We have nested arrays here.
-                    member = value->Object;
-                }
-                else {
-                    //  We have the value. We can leave.
-                    goto EXIT;
-                }
-                break;
+    return selectStructuralScanner()(buffer, length, index);
+}
 
-            default:
-                break;
-        }
+
+//---------------------------------------------------------------------------
+//
+//  Stage 2: build the tree by walking the structural index.
+//
+//  Every node is linked into its parent before its contents are parsed,
+//  so a failed parse always leaves one consistent partial tree behind,
+//  rooted at ps->Root, for the caller to free.
+//
+//---------------------------------------------------------------------------
+
+
+static void parseError(PARSE_STATE *ps, JSON_ERROR error)
+{
+    ps->Context->Errno = error;
+    longjmp(ps->JmpBuffer, 1);
+}
+
+
+static char *nextToken(PARSE_STATE *ps, JSON_ERROR error)
+{
+    if (ps->Next >= ps->Index.Count) {
+        parseError(ps, error);
     }
 
-EXIT:
-    // If we make it here, we found the value.
-    free(path_copy);
-    return value;
+    return ps->Start + ps->Index.Positions[ps->Next++];
+}
+
+
+//
+//  Takes the next token only if it is c, which is how empty objects and
+//  arrays are told apart right after their opening bracket.
+//
+static int nextTokenIs(PARSE_STATE *ps, char c)
+{
+    if (ps->Next < ps->Index.Count &&
+        ps->Start[ps->Index.Positions[ps->Next]] == c) {
+        ps->Next++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static inline int isJsonBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+
+static char *skipBlanks(char *cursor, char *end)
+{
+    while (cursor < end && isJsonBlank(*cursor)) {
+        cursor++;
+    }
+    return cursor;
+}
+
+
+//
+//  Literals and numbers are not delimited in the index, so make sure
+//  nothing but whitespace follows one before the next structural.
+//
+static void checkScalarEnd(PARSE_STATE *ps, char *cursor, JSON_ERROR error)
+{
+    //-----------------------------
+    char *next;
+    //-----------------------------
+
+    if (ps->Next < ps->Index.Count)
+        next = ps->Start + ps->Index.Positions[ps->Next];
+    else
+        next = ps->End;
+
+    if (skipBlanks(cursor, next) != next) {
+        parseError(ps, error);
+    }
+}
+
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    else if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    else
+        return -1;
+}
+
+
+static long parseHex4(const char *cursor, const char *end)
+{
+    //-----------------------------
+    long code = 0;
+    int digit;
+    int i;
+    //-----------------------------
+
+    if (end - cursor < 4)
+        return -1;
+
+    for (i = 0; i < 4; i++) {
+        digit = hexValue(cursor[i]);
+        if (digit < 0)
+            return -1;
+        code = (code << 4) | digit;
+    }
+
+    return code;
+}
+
+
+static char *encodeUtf8(char *dest, long code)
+{
+    if (code < 0x80) {
+        *dest++ = (char)code;
+    }
+    else if (code < 0x800) {
+        *dest++ = (char)(0xC0 | (code >> 6));
+        *dest++ = (char)(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000) {
+        *dest++ = (char)(0xE0 | (code >> 12));
+        *dest++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *dest++ = (char)(0x80 | (code & 0x3F));
+    }
+    else {
+        *dest++ = (char)(0xF0 | (code >> 18));
+        *dest++ = (char)(0x80 | ((code >> 12) & 0x3F));
+        *dest++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *dest++ = (char)(0x80 | (code & 0x3F));
+    }
+
+    return dest;
+}
+
+
+//
+//  Copies the text between the quotes of a string to dest, resolving the
+//  escape sequences, and returns the length of the result or -1 if an
+//  escape is invalid. The result is never longer than the source, so
+//  dest may be the source itself.
+//
+static long unescapeJsonString(char *dest, const char *source, size_t length)
+{
+    //-----------------------------
+    const char *end = source + length;
+    const char *escape;
+    char *out = dest;
+    long code;
+    long low;
+    size_t run;
+    //-----------------------------
+
+    while (source < end) {
+
+        escape = memchr(source, '\\', end - source);
+        if (!escape)
+            escape = end;
+
+        run = escape - source;
+        if (out != source)
+            memmove(out, source, run);
+        out += run;
+        source = escape;
+
+        if (source == end)
+            break;
+
+        // Stage 1 never ends a string on a backslash.
+        source++;
+
+        switch (*source++) {
+            case '"':  *out++ = '"';  break;
+            case '\\': *out++ = '\\'; break;
+            case '/':  *out++ = '/';  break;
+            case 'b':  *out++ = '\b'; break;
+            case 'f':  *out++ = '\f'; break;
+            case 'n':  *out++ = '\n'; break;
+            case 'r':  *out++ = '\r'; break;
+            case 't':  *out++ = '\t'; break;
+
+            case 'u':
+                code = parseHex4(source, end);
+                if (code < 0)
+                    return -1;
+                source += 4;
+
+                //  Characters outside the BMP come as a surrogate pair.
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    if (end - source < 6 || source[0] != '\\' ||
+                        source[1] != 'u')
+                        return -1;
+                    low = parseHex4(source + 2, end);
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        return -1;
+                    source += 6;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (code >= 0xDC00 && code <= 0xDFFF) {
+                    return -1;
+                }
+                //  Strings are NUL terminated, so one cannot hold a NUL.
+                else if (code == 0) {
+                    return -1;
+                }
+
+                out = encodeUtf8(out, code);
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    return out - dest;
+}
+
+
+//
+//  In-situ parses terminate and unescape the string where it is in the
+//  borrowed buffer, the others copy it out.
+//
+static char* parseJsonString(PARSE_STATE *ps, char *start)
+{
+    //-----------------------------
+    char *end;
+    char *new_string;
+    long length;
+    //-----------------------------
+
+    if (*start != '"') {
+        parseError(ps, ERROR_INVALID_STRING);
+    }
+
+    // Stage 1 guarantees the next position is the closing quote.
+    end = nextToken(ps, ERROR_INVALID_STRING);
+    start++;
+
+    if (ps->Document && ps->Document->Buffer) {
+        new_string = start;
+    }
+    else {
+        new_string = (char *)jsonAlloc(ps->Document, end - start + 1);
+        if (!new_string){
+            parseError(ps, ERROR_ALLOC_FAILED);
+        }
+    }
+
+    length = unescapeJsonString(new_string, start, end - start);
+    if (length < 0) {
+        if (new_string != start && !usesArena(ps->Document))
+            free(new_string);
+        parseError(ps, ERROR_INVALID_STRING);
+    }
+
+    new_string[length] = 0;
+
+    return new_string;
+}
+
+
+//
+//  Member names of interned parses. Names without escapes are looked up
+//  where they are in the text, so each distinct one is copied once.
+//
+#define KEY_SCRATCH_SIZE 256
+
+
+static char *parseJsonKey(PARSE_STATE *ps, char *start)
+{
+    //-----------------------------
+    char scratch[KEY_SCRATCH_SIZE];
+    const char *name;
+    char *unescaped = NULL;
+    char *end;
+    long length;
+    //-----------------------------
+
+    if (*start != '"') {
+        parseError(ps, ERROR_INVALID_STRING);
+    }
+
+    // Stage 1 guarantees the next position is the closing quote.
+    end = nextToken(ps, ERROR_INVALID_STRING);
+    start++;
+    length = end - start;
+
+    if (memchr(start, '\\', length)) {
+
+        unescaped = scratch;
+        if (length >= KEY_SCRATCH_SIZE) {
+            unescaped = (char *)malloc(length);
+            if (!unescaped)
+                parseError(ps, ERROR_ALLOC_FAILED);
+        }
+
+        length = unescapeJsonString(unescaped, start, length);
+        start = unescaped;
+    }
+
+    name = (length < 0) ? NULL : internKey(ps->Keys, start, length);
+
+    if (unescaped && unescaped != scratch)
+        free(unescaped);
+
+    if (!name)
+        parseError(ps, (length < 0) ? ERROR_INVALID_STRING :
+                                      ERROR_ALLOC_FAILED);
+
+    //  The tree never changes names in place.
+    return (char *)name;
+}
+
+
+static int parseJsonBoolean(PARSE_STATE *ps, char *start)
+{
+    if (ps->End - start >= 4 && strncmp(start, "true", 4) == 0) {
+        checkScalarEnd(ps, start + 4, ERROR_INVALID_BOOLEAN);
+        return 1;
+    }
+    else if (ps->End - start >= 5 && strncmp(start, "false", 5) == 0) {
+        checkScalarEnd(ps, start + 5, ERROR_INVALID_BOOLEAN);
+        return 0;
+    }
+    else {
+        parseError(ps, ERROR_INVALID_BOOLEAN);
+        return 0;
+    }
+}
+
+
+//---------------------------------------------------------------------------
+//
+//  Numbers.
+//
+//  The lexer follows the RFC 8259 grammar exactly and collects up to 19
+//  significant digits into a 64 bit integer w and a decimal exponent q,
+//  so the value is w * 10^q. Numbers without fraction or exponent that
+//  fit in 64 bits become TYPE_INTEGER. The rest are converted with the
+//  Eisel-Lemire algorithm, which multiplies w by a 128 bit approximation
+//  of 10^q and is exact whenever it does not give up. When it gives up,
+//  on halfway cases, subnormals, overflow or more than 19 digits, the
+//  digits go to strtod() in a form that does not depend on the locale.
+//
+//---------------------------------------------------------------------------
+#define POWER_OF_FIVE_MIN -342
+#define POWER_OF_FIVE_MAX 324
+
+
+//
+//  The top 128 bits of 5^q, for q from POWER_OF_FIVE_MIN to
+//  POWER_OF_FIVE_MAX, normalized so the highest bit is set. They are
+//  exact for q from 0 to 55, rounded up for q from -27 to -1 and
+//  truncated otherwise. Being normalized, they are also the top bits of
+//  10^q, which is how the number formatter uses them.
+//
+static const uint64_t power_of_five_128[][2] = {
+    {0xeef453d6923bd65a, 0x113faa2906a13b3f},
+    {0x9558b4661b6565f8, 0x4ac7ca59a424c507},
+    {0xbaaee17fa23ebf76, 0x5d79bcf00d2df649},
+    {0xe95a99df8ace6f53, 0xf4d82c2c107973dc},
+    {0x91d8a02bb6c10594, 0x79071b9b8a4be869},
+    {0xb64ec836a47146f9, 0x9748e2826cdee284},
+    {0xe3e27a444d8d98b7, 0xfd1b1b2308169b25},
+    {0x8e6d8c6ab0787f72, 0xfe30f0f5e50e20f7},
+    {0xb208ef855c969f4f, 0xbdbd2d335e51a935},
+    {0xde8b2b66b3bc4723, 0xad2c788035e61382},
+    {0x8b16fb203055ac76, 0x4c3bcb5021afcc31},
+    {0xaddcb9e83c6b1793, 0xdf4abe242a1bbf3d},
+    {0xd953e8624b85dd78, 0xd71d6dad34a2af0d},
+    {0x87d4713d6f33aa6b, 0x8672648c40e5ad68},
+    {0xa9c98d8ccb009506, 0x680efdaf511f18c2},
+    {0xd43bf0effdc0ba48, 0x0212bd1b2566def2},
+    {0x84a57695fe98746d, 0x014bb630f7604b57},
+    {0xa5ced43b7e3e9188, 0x419ea3bd35385e2d},
+    {0xcf42894a5dce35ea, 0x52064cac828675b9},
+    {0x818995ce7aa0e1b2, 0x7343efebd1940993},
+    {0xa1ebfb4219491a1f, 0x1014ebe6c5f90bf8},
+    {0xca66fa129f9b60a6, 0xd41a26e077774ef6},
+    {0xfd00b897478238d0, 0x8920b098955522b4},
+    {0x9e20735e8cb16382, 0x55b46e5f5d5535b0},
+    {0xc5a890362fddbc62, 0xeb2189f734aa831d},
+    {0xf712b443bbd52b7b, 0xa5e9ec7501d523e4},
+    {0x9a6bb0aa55653b2d, 0x47b233c92125366e},
+    {0xc1069cd4eabe89f8, 0x999ec0bb696e840a},
+    {0xf148440a256e2c76, 0xc00670ea43ca250d},
+    {0x96cd2a865764dbca, 0x380406926a5e5728},
+    {0xbc807527ed3e12bc, 0xc605083704f5ecf2},
+    {0xeba09271e88d976b, 0xf7864a44c633682e},
+    {0x93445b8731587ea3, 0x7ab3ee6afbe0211d},
+    {0xb8157268fdae9e4c, 0x5960ea05bad82964},
+    {0xe61acf033d1a45df, 0x6fb92487298e33bd},
+    {0x8fd0c16206306bab, 0xa5d3b6d479f8e056},
+    {0xb3c4f1ba87bc8696, 0x8f48a4899877186c},
+    {0xe0b62e2929aba83c, 0x331acdabfe94de87},
+    {0x8c71dcd9ba0b4925, 0x9ff0c08b7f1d0b14},
+    {0xaf8e5410288e1b6f, 0x07ecf0ae5ee44dd9},
+    {0xdb71e91432b1a24a, 0xc9e82cd9f69d6150},
+    {0x892731ac9faf056e, 0xbe311c083a225cd2},
+    {0xab70fe17c79ac6ca, 0x6dbd630a48aaf406},
+    {0xd64d3d9db981787d, 0x092cbbccdad5b108},
+    {0x85f0468293f0eb4e, 0x25bbf56008c58ea5},
+    {0xa76c582338ed2621, 0xaf2af2b80af6f24e},
+    {0xd1476e2c07286faa, 0x1af5af660db4aee1},
+    {0x82cca4db847945ca, 0x50d98d9fc890ed4d},
+    {0xa37fce126597973c, 0xe50ff107bab528a0},
+    {0xcc5fc196fefd7d0c, 0x1e53ed49a96272c8},
+    {0xff77b1fcbebcdc4f, 0x25e8e89c13bb0f7a},
+    {0x9faacf3df73609b1, 0x77b191618c54e9ac},
+    {0xc795830d75038c1d, 0xd59df5b9ef6a2417},
+    {0xf97ae3d0d2446f25, 0x4b0573286b44ad1d},
+    {0x9becce62836ac577, 0x4ee367f9430aec32},
+    {0xc2e801fb244576d5, 0x229c41f793cda73f},
+    {0xf3a20279ed56d48a, 0x6b43527578c1110f},
+    {0x9845418c345644d6, 0x830a13896b78aaa9},
+    {0xbe5691ef416bd60c, 0x23cc986bc656d553},
+    {0xedec366b11c6cb8f, 0x2cbfbe86b7ec8aa8},
+    {0x94b3a202eb1c3f39, 0x7bf7d71432f3d6a9},
+    {0xb9e08a83a5e34f07, 0xdaf5ccd93fb0cc53},
+    {0xe858ad248f5c22c9, 0xd1b3400f8f9cff68},
+    {0x91376c36d99995be, 0x23100809b9c21fa1},
+    {0xb58547448ffffb2d, 0xabd40a0c2832a78a},
+    {0xe2e69915b3fff9f9, 0x16c90c8f323f516c},
+    {0x8dd01fad907ffc3b, 0xae3da7d97f6792e3},
+    {0xb1442798f49ffb4a, 0x99cd11cfdf41779c},
+    {0xdd95317f31c7fa1d, 0x40405643d711d583},
+    {0x8a7d3eef7f1cfc52, 0x482835ea666b2572},
+    {0xad1c8eab5ee43b66, 0xda3243650005eecf},
+    {0xd863b256369d4a40, 0x90bed43e40076a82},
+    {0x873e4f75e2224e68, 0x5a7744a6e804a291},
+    {0xa90de3535aaae202, 0x711515d0a205cb36},
+    {0xd3515c2831559a83, 0x0d5a5b44ca873e03},
+    {0x8412d9991ed58091, 0xe858790afe9486c2},
+    {0xa5178fff668ae0b6, 0x626e974dbe39a872},
+    {0xce5d73ff402d98e3, 0xfb0a3d212dc8128f},
+    {0x80fa687f881c7f8e, 0x7ce66634bc9d0b99},
+    {0xa139029f6a239f72, 0x1c1fffc1ebc44e80},
+    {0xc987434744ac874e, 0xa327ffb266b56220},
+    {0xfbe9141915d7a922, 0x4bf1ff9f0062baa8},
+    {0x9d71ac8fada6c9b5, 0x6f773fc3603db4a9},
+    {0xc4ce17b399107c22, 0xcb550fb4384d21d3},
+    {0xf6019da07f549b2b, 0x7e2a53a146606a48},
+    {0x99c102844f94e0fb, 0x2eda7444cbfc426d},
+    {0xc0314325637a1939, 0xfa911155fefb5308},
+    {0xf03d93eebc589f88, 0x793555ab7eba27ca},
+    {0x96267c7535b763b5, 0x4bc1558b2f3458de},
+    {0xbbb01b9283253ca2, 0x9eb1aaedfb016f16},
+    {0xea9c227723ee8bcb, 0x465e15a979c1cadc},
+    {0x92a1958a7675175f, 0x0bfacd89ec191ec9},
+    {0xb749faed14125d36, 0xcef980ec671f667b},
+    {0xe51c79a85916f484, 0x82b7e12780e7401a},
+    {0x8f31cc0937ae58d2, 0xd1b2ecb8b0908810},
+    {0xb2fe3f0b8599ef07, 0x861fa7e6dcb4aa15},
+    {0xdfbdcece67006ac9, 0x67a791e093e1d49a},
+    {0x8bd6a141006042bd, 0xe0c8bb2c5c6d24e0},
+    {0xaecc49914078536d, 0x58fae9f773886e18},
+    {0xda7f5bf590966848, 0xaf39a475506a899e},
+    {0x888f99797a5e012d, 0x6d8406c952429603},
+    {0xaab37fd7d8f58178, 0xc8e5087ba6d33b83},
+    {0xd5605fcdcf32e1d6, 0xfb1e4a9a90880a64},
+    {0x855c3be0a17fcd26, 0x5cf2eea09a55067f},
+    {0xa6b34ad8c9dfc06f, 0xf42faa48c0ea481e},
+    {0xd0601d8efc57b08b, 0xf13b94daf124da26},
+    {0x823c12795db6ce57, 0x76c53d08d6b70858},
+    {0xa2cb1717b52481ed, 0x54768c4b0c64ca6e},
+    {0xcb7ddcdda26da268, 0xa9942f5dcf7dfd09},
+    {0xfe5d54150b090b02, 0xd3f93b35435d7c4c},
+    {0x9efa548d26e5a6e1, 0xc47bc5014a1a6daf},
+    {0xc6b8e9b0709f109a, 0x359ab6419ca1091b},
+    {0xf867241c8cc6d4c0, 0xc30163d203c94b62},
+    {0x9b407691d7fc44f8, 0x79e0de63425dcf1d},
+    {0xc21094364dfb5636, 0x985915fc12f542e4},
+    {0xf294b943e17a2bc4, 0x3e6f5b7b17b2939d},
+    {0x979cf3ca6cec5b5a, 0xa705992ceecf9c42},
+    {0xbd8430bd08277231, 0x50c6ff782a838353},
+    {0xece53cec4a314ebd, 0xa4f8bf5635246428},
+    {0x940f4613ae5ed136, 0x871b7795e136be99},
+    {0xb913179899f68584, 0x28e2557b59846e3f},
+    {0xe757dd7ec07426e5, 0x331aeada2fe589cf},
+    {0x9096ea6f3848984f, 0x3ff0d2c85def7621},
+    {0xb4bca50b065abe63, 0x0fed077a756b53a9},
+    {0xe1ebce4dc7f16dfb, 0xd3e8495912c62894},
+    {0x8d3360f09cf6e4bd, 0x64712dd7abbbd95c},
+    {0xb080392cc4349dec, 0xbd8d794d96aacfb3},
+    {0xdca04777f541c567, 0xecf0d7a0fc5583a0},
+    {0x89e42caaf9491b60, 0xf41686c49db57244},
+    {0xac5d37d5b79b6239, 0x311c2875c522ced5},
+    {0xd77485cb25823ac7, 0x7d633293366b828b},
+    {0x86a8d39ef77164bc, 0xae5dff9c02033197},
+    {0xa8530886b54dbdeb, 0xd9f57f830283fdfc},
+    {0xd267caa862a12d66, 0xd072df63c324fd7b},
+    {0x8380dea93da4bc60, 0x4247cb9e59f71e6d},
+    {0xa46116538d0deb78, 0x52d9be85f074e608},
+    {0xcd795be870516656, 0x67902e276c921f8b},
+    {0x806bd9714632dff6, 0x00ba1cd8a3db53b6},
+    {0xa086cfcd97bf97f3, 0x80e8a40eccd228a4},
+    {0xc8a883c0fdaf7df0, 0x6122cd128006b2cd},
+    {0xfad2a4b13d1b5d6c, 0x796b805720085f81},
+    {0x9cc3a6eec6311a63, 0xcbe3303674053bb0},
+    {0xc3f490aa77bd60fc, 0xbedbfc4411068a9c},
+    {0xf4f1b4d515acb93b, 0xee92fb5515482d44},
+    {0x991711052d8bf3c5, 0x751bdd152d4d1c4a},
+    {0xbf5cd54678eef0b6, 0xd262d45a78a0635d},
+    {0xef340a98172aace4, 0x86fb897116c87c34},
+    {0x9580869f0e7aac0e, 0xd45d35e6ae3d4da0},
+    {0xbae0a846d2195712, 0x8974836059cca109},
+    {0xe998d258869facd7, 0x2bd1a438703fc94b},
+    {0x91ff83775423cc06, 0x7b6306a34627ddcf},
+    {0xb67f6455292cbf08, 0x1a3bc84c17b1d542},
+    {0xe41f3d6a7377eeca, 0x20caba5f1d9e4a93},
+    {0x8e938662882af53e, 0x547eb47b7282ee9c},
+    {0xb23867fb2a35b28d, 0xe99e619a4f23aa43},
+    {0xdec681f9f4c31f31, 0x6405fa00e2ec94d4},
+    {0x8b3c113c38f9f37e, 0xde83bc408dd3dd04},
+    {0xae0b158b4738705e, 0x9624ab50b148d445},
+    {0xd98ddaee19068c76, 0x3badd624dd9b0957},
+    {0x87f8a8d4cfa417c9, 0xe54ca5d70a80e5d6},
+    {0xa9f6d30a038d1dbc, 0x5e9fcf4ccd211f4c},
+    {0xd47487cc8470652b, 0x7647c3200069671f},
+    {0x84c8d4dfd2c63f3b, 0x29ecd9f40041e073},
+    {0xa5fb0a17c777cf09, 0xf468107100525890},
+    {0xcf79cc9db955c2cc, 0x7182148d4066eeb4},
+    {0x81ac1fe293d599bf, 0xc6f14cd848405530},
+    {0xa21727db38cb002f, 0xb8ada00e5a506a7c},
+    {0xca9cf1d206fdc03b, 0xa6d90811f0e4851c},
+    {0xfd442e4688bd304a, 0x908f4a166d1da663},
+    {0x9e4a9cec15763e2e, 0x9a598e4e043287fe},
+    {0xc5dd44271ad3cdba, 0x40eff1e1853f29fd},
+    {0xf7549530e188c128, 0xd12bee59e68ef47c},
+    {0x9a94dd3e8cf578b9, 0x82bb74f8301958ce},
+    {0xc13a148e3032d6e7, 0xe36a52363c1faf01},
+    {0xf18899b1bc3f8ca1, 0xdc44e6c3cb279ac1},
+    {0x96f5600f15a7b7e5, 0x29ab103a5ef8c0b9},
+    {0xbcb2b812db11a5de, 0x7415d448f6b6f0e7},
+    {0xebdf661791d60f56, 0x111b495b3464ad21},
+    {0x936b9fcebb25c995, 0xcab10dd900beec34},
+    {0xb84687c269ef3bfb, 0x3d5d514f40eea742},
+    {0xe65829b3046b0afa, 0x0cb4a5a3112a5112},
+    {0x8ff71a0fe2c2e6dc, 0x47f0e785eaba72ab},
+    {0xb3f4e093db73a093, 0x59ed216765690f56},
+    {0xe0f218b8d25088b8, 0x306869c13ec3532c},
+    {0x8c974f7383725573, 0x1e414218c73a13fb},
+    {0xafbd2350644eeacf, 0xe5d1929ef90898fa},
+    {0xdbac6c247d62a583, 0xdf45f746b74abf39},
+    {0x894bc396ce5da772, 0x6b8bba8c328eb783},
+    {0xab9eb47c81f5114f, 0x066ea92f3f326564},
+    {0xd686619ba27255a2, 0xc80a537b0efefebd},
+    {0x8613fd0145877585, 0xbd06742ce95f5f36},
+    {0xa798fc4196e952e7, 0x2c48113823b73704},
+    {0xd17f3b51fca3a7a0, 0xf75a15862ca504c5},
+    {0x82ef85133de648c4, 0x9a984d73dbe722fb},
+    {0xa3ab66580d5fdaf5, 0xc13e60d0d2e0ebba},
+    {0xcc963fee10b7d1b3, 0x318df905079926a8},
+    {0xffbbcfe994e5c61f, 0xfdf17746497f7052},
+    {0x9fd561f1fd0f9bd3, 0xfeb6ea8bedefa633},
+    {0xc7caba6e7c5382c8, 0xfe64a52ee96b8fc0},
+    {0xf9bd690a1b68637b, 0x3dfdce7aa3c673b0},
+    {0x9c1661a651213e2d, 0x06bea10ca65c084e},
+    {0xc31bfa0fe5698db8, 0x486e494fcff30a62},
+    {0xf3e2f893dec3f126, 0x5a89dba3c3efccfa},
+    {0x986ddb5c6b3a76b7, 0xf89629465a75e01c},
+    {0xbe89523386091465, 0xf6bbb397f1135823},
+    {0xee2ba6c0678b597f, 0x746aa07ded582e2c},
+    {0x94db483840b717ef, 0xa8c2a44eb4571cdc},
+    {0xba121a4650e4ddeb, 0x92f34d62616ce413},
+    {0xe896a0d7e51e1566, 0x77b020baf9c81d17},
+    {0x915e2486ef32cd60, 0x0ace1474dc1d122e},
+    {0xb5b5ada8aaff80b8, 0x0d819992132456ba},
+    {0xe3231912d5bf60e6, 0x10e1fff697ed6c69},
+    {0x8df5efabc5979c8f, 0xca8d3ffa1ef463c1},
+    {0xb1736b96b6fd83b3, 0xbd308ff8a6b17cb2},
+    {0xddd0467c64bce4a0, 0xac7cb3f6d05ddbde},
+    {0x8aa22c0dbef60ee4, 0x6bcdf07a423aa96b},
+    {0xad4ab7112eb3929d, 0x86c16c98d2c953c6},
+    {0xd89d64d57a607744, 0xe871c7bf077ba8b7},
+    {0x87625f056c7c4a8b, 0x11471cd764ad4972},
+    {0xa93af6c6c79b5d2d, 0xd598e40d3dd89bcf},
+    {0xd389b47879823479, 0x4aff1d108d4ec2c3},
+    {0x843610cb4bf160cb, 0xcedf722a585139ba},
+    {0xa54394fe1eedb8fe, 0xc2974eb4ee658828},
+    {0xce947a3da6a9273e, 0x733d226229feea32},
+    {0x811ccc668829b887, 0x0806357d5a3f525f},
+    {0xa163ff802a3426a8, 0xca07c2dcb0cf26f7},
+    {0xc9bcff6034c13052, 0xfc89b393dd02f0b5},
+    {0xfc2c3f3841f17c67, 0xbbac2078d443ace2},
+    {0x9d9ba7832936edc0, 0xd54b944b84aa4c0d},
+    {0xc5029163f384a931, 0x0a9e795e65d4df11},
+    {0xf64335bcf065d37d, 0x4d4617b5ff4a16d5},
+    {0x99ea0196163fa42e, 0x504bced1bf8e4e45},
+    {0xc06481fb9bcf8d39, 0xe45ec2862f71e1d6},
+    {0xf07da27a82c37088, 0x5d767327bb4e5a4c},
+    {0x964e858c91ba2655, 0x3a6a07f8d510f86f},
+    {0xbbe226efb628afea, 0x890489f70a55368b},
+    {0xeadab0aba3b2dbe5, 0x2b45ac74ccea842e},
+    {0x92c8ae6b464fc96f, 0x3b0b8bc90012929d},
+    {0xb77ada0617e3bbcb, 0x09ce6ebb40173744},
+    {0xe55990879ddcaabd, 0xcc420a6a101d0515},
+    {0x8f57fa54c2a9eab6, 0x9fa946824a12232d},
+    {0xb32df8e9f3546564, 0x47939822dc96abf9},
+    {0xdff9772470297ebd, 0x59787e2b93bc56f7},
+    {0x8bfbea76c619ef36, 0x57eb4edb3c55b65a},
+    {0xaefae51477a06b03, 0xede622920b6b23f1},
+    {0xdab99e59958885c4, 0xe95fab368e45eced},
+    {0x88b402f7fd75539b, 0x11dbcb0218ebb414},
+    {0xaae103b5fcd2a881, 0xd652bdc29f26a119},
+    {0xd59944a37c0752a2, 0x4be76d3346f0495f},
+    {0x857fcae62d8493a5, 0x6f70a4400c562ddb},
+    {0xa6dfbd9fb8e5b88e, 0xcb4ccd500f6bb952},
+    {0xd097ad07a71f26b2, 0x7e2000a41346a7a7},
+    {0x825ecc24c873782f, 0x8ed400668c0c28c8},
+    {0xa2f67f2dfa90563b, 0x728900802f0f32fa},
+    {0xcbb41ef979346bca, 0x4f2b40a03ad2ffb9},
+    {0xfea126b7d78186bc, 0xe2f610c84987bfa8},
+    {0x9f24b832e6b0f436, 0x0dd9ca7d2df4d7c9},
+    {0xc6ede63fa05d3143, 0x91503d1c79720dbb},
+    {0xf8a95fcf88747d94, 0x75a44c6397ce912a},
+    {0x9b69dbe1b548ce7c, 0xc986afbe3ee11aba},
+    {0xc24452da229b021b, 0xfbe85badce996168},
+    {0xf2d56790ab41c2a2, 0xfae27299423fb9c3},
+    {0x97c560ba6b0919a5, 0xdccd879fc967d41a},
+    {0xbdb6b8e905cb600f, 0x5400e987bbc1c920},
+    {0xed246723473e3813, 0x290123e9aab23b68},
+    {0x9436c0760c86e30b, 0xf9a0b6720aaf6521},
+    {0xb94470938fa89bce, 0xf808e40e8d5b3e69},
+    {0xe7958cb87392c2c2, 0xb60b1d1230b20e04},
+    {0x90bd77f3483bb9b9, 0xb1c6f22b5e6f48c2},
+    {0xb4ecd5f01a4aa828, 0x1e38aeb6360b1af3},
+    {0xe2280b6c20dd5232, 0x25c6da63c38de1b0},
+    {0x8d590723948a535f, 0x579c487e5a38ad0e},
+    {0xb0af48ec79ace837, 0x2d835a9df0c6d851},
+    {0xdcdb1b2798182244, 0xf8e431456cf88e65},
+    {0x8a08f0f8bf0f156b, 0x1b8e9ecb641b58ff},
+    {0xac8b2d36eed2dac5, 0xe272467e3d222f3f},
+    {0xd7adf884aa879177, 0x5b0ed81dcc6abb0f},
+    {0x86ccbb52ea94baea, 0x98e947129fc2b4e9},
+    {0xa87fea27a539e9a5, 0x3f2398d747b36224},
+    {0xd29fe4b18e88640e, 0x8eec7f0d19a03aad},
+    {0x83a3eeeef9153e89, 0x1953cf68300424ac},
+    {0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7},
+    {0xcdb02555653131b6, 0x3792f412cb06794d},
+    {0x808e17555f3ebf11, 0xe2bbd88bbee40bd0},
+    {0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4},
+    {0xc8de047564d20a8b, 0xf245825a5a445275},
+    {0xfb158592be068d2e, 0xeed6e2f0f0d56712},
+    {0x9ced737bb6c4183d, 0x55464dd69685606b},
+    {0xc428d05aa4751e4c, 0xaa97e14c3c26b886},
+    {0xf53304714d9265df, 0xd53dd99f4b3066a8},
+    {0x993fe2c6d07b7fab, 0xe546a8038efe4029},
+    {0xbf8fdb78849a5f96, 0xde98520472bdd033},
+    {0xef73d256a5c0f77c, 0x963e66858f6d4440},
+    {0x95a8637627989aad, 0xdde7001379a44aa8},
+    {0xbb127c53b17ec159, 0x5560c018580d5d52},
+    {0xe9d71b689dde71af, 0xaab8f01e6e10b4a6},
+    {0x9226712162ab070d, 0xcab3961304ca70e8},
+    {0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22},
+    {0xe45c10c42a2b3b05, 0x8cb89a7db77c506a},
+    {0x8eb98a7a9a5b04e3, 0x77f3608e92adb242},
+    {0xb267ed1940f1c61c, 0x55f038b237591ed3},
+    {0xdf01e85f912e37a3, 0x6b6c46dec52f6688},
+    {0x8b61313bbabce2c6, 0x2323ac4b3b3da015},
+    {0xae397d8aa96c1b77, 0xabec975e0a0d081a},
+    {0xd9c7dced53c72255, 0x96e7bd358c904a21},
+    {0x881cea14545c7575, 0x7e50d64177da2e54},
+    {0xaa242499697392d2, 0xdde50bd1d5d0b9e9},
+    {0xd4ad2dbfc3d07787, 0x955e4ec64b44e864},
+    {0x84ec3c97da624ab4, 0xbd5af13bef0b113e},
+    {0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e},
+    {0xcfb11ead453994ba, 0x67de18eda5814af2},
+    {0x81ceb32c4b43fcf4, 0x80eacf948770ced7},
+    {0xa2425ff75e14fc31, 0xa1258379a94d028d},
+    {0xcad2f7f5359a3b3e, 0x096ee45813a04330},
+    {0xfd87b5f28300ca0d, 0x8bca9d6e188853fc},
+    {0x9e74d1b791e07e48, 0x775ea264cf55347e},
+    {0xc612062576589dda, 0x95364afe032a819e},
+    {0xf79687aed3eec551, 0x3a83ddbd83f52205},
+    {0x9abe14cd44753b52, 0xc4926a9672793543},
+    {0xc16d9a0095928a27, 0x75b7053c0f178294},
+    {0xf1c90080baf72cb1, 0x5324c68b12dd6339},
+    {0x971da05074da7bee, 0xd3f6fc16ebca5e04},
+    {0xbce5086492111aea, 0x88f4bb1ca6bcf585},
+    {0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6},
+    {0x9392ee8e921d5d07, 0x3aff322e62439fd0},
+    {0xb877aa3236a4b449, 0x09befeb9fad487c3},
+    {0xe69594bec44de15b, 0x4c2ebe687989a9b4},
+    {0x901d7cf73ab0acd9, 0x0f9d37014bf60a11},
+    {0xb424dc35095cd80f, 0x538484c19ef38c95},
+    {0xe12e13424bb40e13, 0x2865a5f206b06fba},
+    {0x8cbccc096f5088cb, 0xf93f87b7442e45d4},
+    {0xafebff0bcb24aafe, 0xf78f69a51539d749},
+    {0xdbe6fecebdedd5be, 0xb573440e5a884d1c},
+    {0x89705f4136b4a597, 0x31680a88f8953031},
+    {0xabcc77118461cefc, 0xfdc20d2b36ba7c3e},
+    {0xd6bf94d5e57a42bc, 0x3d32907604691b4d},
+    {0x8637bd05af6c69b5, 0xa63f9a49c2c1b110},
+    {0xa7c5ac471b478423, 0x0fcf80dc33721d54},
+    {0xd1b71758e219652b, 0xd3c36113404ea4a9},
+    {0x83126e978d4fdf3b, 0x645a1cac083126ea},
+    {0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4},
+    {0xcccccccccccccccc, 0xcccccccccccccccd},
+    {0x8000000000000000, 0x0000000000000000},
+    {0xa000000000000000, 0x0000000000000000},
+    {0xc800000000000000, 0x0000000000000000},
+    {0xfa00000000000000, 0x0000000000000000},
+    {0x9c40000000000000, 0x0000000000000000},
+    {0xc350000000000000, 0x0000000000000000},
+    {0xf424000000000000, 0x0000000000000000},
+    {0x9896800000000000, 0x0000000000000000},
+    {0xbebc200000000000, 0x0000000000000000},
+    {0xee6b280000000000, 0x0000000000000000},
+    {0x9502f90000000000, 0x0000000000000000},
+    {0xba43b74000000000, 0x0000000000000000},
+    {0xe8d4a51000000000, 0x0000000000000000},
+    {0x9184e72a00000000, 0x0000000000000000},
+    {0xb5e620f480000000, 0x0000000000000000},
+    {0xe35fa931a0000000, 0x0000000000000000},
+    {0x8e1bc9bf04000000, 0x0000000000000000},
+    {0xb1a2bc2ec5000000, 0x0000000000000000},
+    {0xde0b6b3a76400000, 0x0000000000000000},
+    {0x8ac7230489e80000, 0x0000000000000000},
+    {0xad78ebc5ac620000, 0x0000000000000000},
+    {0xd8d726b7177a8000, 0x0000000000000000},
+    {0x878678326eac9000, 0x0000000000000000},
+    {0xa968163f0a57b400, 0x0000000000000000},
+    {0xd3c21bcecceda100, 0x0000000000000000},
+    {0x84595161401484a0, 0x0000000000000000},
+    {0xa56fa5b99019a5c8, 0x0000000000000000},
+    {0xcecb8f27f4200f3a, 0x0000000000000000},
+    {0x813f3978f8940984, 0x4000000000000000},
+    {0xa18f07d736b90be5, 0x5000000000000000},
+    {0xc9f2c9cd04674ede, 0xa400000000000000},
+    {0xfc6f7c4045812296, 0x4d00000000000000},
+    {0x9dc5ada82b70b59d, 0xf020000000000000},
+    {0xc5371912364ce305, 0x6c28000000000000},
+    {0xf684df56c3e01bc6, 0xc732000000000000},
+    {0x9a130b963a6c115c, 0x3c7f400000000000},
+    {0xc097ce7bc90715b3, 0x4b9f100000000000},
+    {0xf0bdc21abb48db20, 0x1e86d40000000000},
+    {0x96769950b50d88f4, 0x1314448000000000},
+    {0xbc143fa4e250eb31, 0x17d955a000000000},
+    {0xeb194f8e1ae525fd, 0x5dcfab0800000000},
+    {0x92efd1b8d0cf37be, 0x5aa1cae500000000},
+    {0xb7abc627050305ad, 0xf14a3d9e40000000},
+    {0xe596b7b0c643c719, 0x6d9ccd05d0000000},
+    {0x8f7e32ce7bea5c6f, 0xe4820023a2000000},
+    {0xb35dbf821ae4f38b, 0xdda2802c8a800000},
+    {0xe0352f62a19e306e, 0xd50b2037ad200000},
+    {0x8c213d9da502de45, 0x4526f422cc340000},
+    {0xaf298d050e4395d6, 0x9670b12b7f410000},
+    {0xdaf3f04651d47b4c, 0x3c0cdd765f114000},
+    {0x88d8762bf324cd0f, 0xa5880a69fb6ac800},
+    {0xab0e93b6efee0053, 0x8eea0d047a457a00},
+    {0xd5d238a4abe98068, 0x72a4904598d6d880},
+    {0x85a36366eb71f041, 0x47a6da2b7f864750},
+    {0xa70c3c40a64e6c51, 0x999090b65f67d924},
+    {0xd0cf4b50cfe20765, 0xfff4b4e3f741cf6d},
+    {0x82818f1281ed449f, 0xbff8f10e7a8921a4},
+    {0xa321f2d7226895c7, 0xaff72d52192b6a0d},
+    {0xcbea6f8ceb02bb39, 0x9bf4f8a69f764490},
+    {0xfee50b7025c36a08, 0x02f236d04753d5b4},
+    {0x9f4f2726179a2245, 0x01d762422c946590},
+    {0xc722f0ef9d80aad6, 0x424d3ad2b7b97ef5},
+    {0xf8ebad2b84e0d58b, 0xd2e0898765a7deb2},
+    {0x9b934c3b330c8577, 0x63cc55f49f88eb2f},
+    {0xc2781f49ffcfa6d5, 0x3cbf6b71c76b25fb},
+    {0xf316271c7fc3908a, 0x8bef464e3945ef7a},
+    {0x97edd871cfda3a56, 0x97758bf0e3cbb5ac},
+    {0xbde94e8e43d0c8ec, 0x3d52eeed1cbea317},
+    {0xed63a231d4c4fb27, 0x4ca7aaa863ee4bdd},
+    {0x945e455f24fb1cf8, 0x8fe8caa93e74ef6a},
+    {0xb975d6b6ee39e436, 0xb3e2fd538e122b44},
+    {0xe7d34c64a9c85d44, 0x60dbbca87196b616},
+    {0x90e40fbeea1d3a4a, 0xbc8955e946fe31cd},
+    {0xb51d13aea4a488dd, 0x6babab6398bdbe41},
+    {0xe264589a4dcdab14, 0xc696963c7eed2dd1},
+    {0x8d7eb76070a08aec, 0xfc1e1de5cf543ca2},
+    {0xb0de65388cc8ada8, 0x3b25a55f43294bcb},
+    {0xdd15fe86affad912, 0x49ef0eb713f39ebe},
+    {0x8a2dbf142dfcc7ab, 0x6e3569326c784337},
+    {0xacb92ed9397bf996, 0x49c2c37f07965404},
+    {0xd7e77a8f87daf7fb, 0xdc33745ec97be906},
+    {0x86f0ac99b4e8dafd, 0x69a028bb3ded71a3},
+    {0xa8acd7c0222311bc, 0xc40832ea0d68ce0c},
+    {0xd2d80db02aabd62b, 0xf50a3fa490c30190},
+    {0x83c7088e1aab65db, 0x792667c6da79e0fa},
+    {0xa4b8cab1a1563f52, 0x577001b891185938},
+    {0xcde6fd5e09abcf26, 0xed4c0226b55e6f86},
+    {0x80b05e5ac60b6178, 0x544f8158315b05b4},
+    {0xa0dc75f1778e39d6, 0x696361ae3db1c721},
+    {0xc913936dd571c84c, 0x03bc3a19cd1e38e9},
+    {0xfb5878494ace3a5f, 0x04ab48a04065c723},
+    {0x9d174b2dcec0e47b, 0x62eb0d64283f9c76},
+    {0xc45d1df942711d9a, 0x3ba5d0bd324f8394},
+    {0xf5746577930d6500, 0xca8f44ec7ee36479},
+    {0x9968bf6abbe85f20, 0x7e998b13cf4e1ecb},
+    {0xbfc2ef456ae276e8, 0x9e3fedd8c321a67e},
+    {0xefb3ab16c59b14a2, 0xc5cfe94ef3ea101e},
+    {0x95d04aee3b80ece5, 0xbba1f1d158724a12},
+    {0xbb445da9ca61281f, 0x2a8a6e45ae8edc97},
+    {0xea1575143cf97226, 0xf52d09d71a3293bd},
+    {0x924d692ca61be758, 0x593c2626705f9c56},
+    {0xb6e0c377cfa2e12e, 0x6f8b2fb00c77836c},
+    {0xe498f455c38b997a, 0x0b6dfb9c0f956447},
+    {0x8edf98b59a373fec, 0x4724bd4189bd5eac},
+    {0xb2977ee300c50fe7, 0x58edec91ec2cb657},
+    {0xdf3d5e9bc0f653e1, 0x2f2967b66737e3ed},
+    {0x8b865b215899f46c, 0xbd79e0d20082ee74},
+    {0xae67f1e9aec07187, 0xecd8590680a3aa11},
+    {0xda01ee641a708de9, 0xe80e6f4820cc9495},
+    {0x884134fe908658b2, 0x3109058d147fdcdd},
+    {0xaa51823e34a7eede, 0xbd4b46f0599fd415},
+    {0xd4e5e2cdc1d1ea96, 0x6c9e18ac7007c91a},
+    {0x850fadc09923329e, 0x03e2cf6bc604ddb0},
+    {0xa6539930bf6bff45, 0x84db8346b786151c},
+    {0xcfe87f7cef46ff16, 0xe612641865679a63},
+    {0x81f14fae158c5f6e, 0x4fcb7e8f3f60c07e},
+    {0xa26da3999aef7749, 0xe3be5e330f38f09d},
+    {0xcb090c8001ab551c, 0x5cadf5bfd3072cc5},
+    {0xfdcb4fa002162a63, 0x73d9732fc7c8f7f6},
+    {0x9e9f11c4014dda7e, 0x2867e7fddcdd9afa},
+    {0xc646d63501a1511d, 0xb281e1fd541501b8},
+    {0xf7d88bc24209a565, 0x1f225a7ca91a4226},
+    {0x9ae757596946075f, 0x3375788de9b06958},
+    {0xc1a12d2fc3978937, 0x0052d6b1641c83ae},
+    {0xf209787bb47d6b84, 0xc0678c5dbd23a49a},
+    {0x9745eb4d50ce6332, 0xf840b7ba963646e0},
+    {0xbd176620a501fbff, 0xb650e5a93bc3d898},
+    {0xec5d3fa8ce427aff, 0xa3e51f138ab4cebe},
+    {0x93ba47c980e98cdf, 0xc66f336c36b10137},
+    {0xb8a8d9bbe123f017, 0xb80b0047445d4184},
+    {0xe6d3102ad96cec1d, 0xa60dc059157491e5},
+    {0x9043ea1ac7e41392, 0x87c89837ad68db2f},
+    {0xb454e4a179dd1877, 0x29babe4598c311fb},
+    {0xe16a1dc9d8545e94, 0xf4296dd6fef3d67a},
+    {0x8ce2529e2734bb1d, 0x1899e4a65f58660c},
+    {0xb01ae745b101e9e4, 0x5ec05dcff72e7f8f},
+    {0xdc21a1171d42645d, 0x76707543f4fa1f73},
+    {0x899504ae72497eba, 0x6a06494a791c53a8},
+    {0xabfa45da0edbde69, 0x0487db9d17636892},
+    {0xd6f8d7509292d603, 0x45a9d2845d3c42b6},
+    {0x865b86925b9bc5c2, 0x0b8a2392ba45a9b2},
+    {0xa7f26836f282b732, 0x8e6cac7768d7141e},
+    {0xd1ef0244af2364ff, 0x3207d795430cd926},
+    {0x8335616aed761f1f, 0x7f44e6bd49e807b8},
+    {0xa402b9c5a8d3a6e7, 0x5f16206c9c6209a6},
+    {0xcd036837130890a1, 0x36dba887c37a8c0f},
+    {0x802221226be55a64, 0xc2494954da2c9789},
+    {0xa02aa96b06deb0fd, 0xf2db9baa10b7bd6c},
+    {0xc83553c5c8965d3d, 0x6f92829494e5acc7},
+    {0xfa42a8b73abbf48c, 0xcb772339ba1f17f9},
+    {0x9c69a97284b578d7, 0xff2a760414536efb},
+    {0xc38413cf25e2d70d, 0xfef5138519684aba},
+    {0xf46518c2ef5b8cd1, 0x7eb258665fc25d69},
+    {0x98bf2f79d5993802, 0xef2f773ffbd97a61},
+    {0xbeeefb584aff8603, 0xaafb550ffacfd8fa},
+    {0xeeaaba2e5dbf6784, 0x95ba2a53f983cf38},
+    {0x952ab45cfa97a0b2, 0xdd945a747bf26183},
+    {0xba756174393d88df, 0x94f971119aeef9e4},
+    {0xe912b9d1478ceb17, 0x7a37cd5601aab85d},
+    {0x91abb422ccb812ee, 0xac62e055c10ab33a},
+    {0xb616a12b7fe617aa, 0x577b986b314d6009},
+    {0xe39c49765fdf9d94, 0xed5a7e85fda0b80b},
+    {0x8e41ade9fbebc27d, 0x14588f13be847307},
+    {0xb1d219647ae6b31c, 0x596eb2d8ae258fc8},
+    {0xde469fbd99a05fe3, 0x6fca5f8ed9aef3bb},
+    {0x8aec23d680043bee, 0x25de7bb9480d5854},
+    {0xada72ccc20054ae9, 0xaf561aa79a10ae6a},
+    {0xd910f7ff28069da4, 0x1b2ba1518094da04},
+    {0x87aa9aff79042286, 0x90fb44d2f05d0842},
+    {0xa99541bf57452b28, 0x353a1607ac744a53},
+    {0xd3fa922f2d1675f2, 0x42889b8997915ce8},
+    {0x847c9b5d7c2e09b7, 0x69956135febada11},
+    {0xa59bc234db398c25, 0x43fab9837e699095},
+    {0xcf02b2c21207ef2e, 0x94f967e45e03f4bb},
+    {0x8161afb94b44f57d, 0x1d1be0eebac278f5},
+    {0xa1ba1ba79e1632dc, 0x6462d92a69731732},
+    {0xca28a291859bbf93, 0x7d7b8f7503cfdcfe},
+    {0xfcb2cb35e702af78, 0x5cda735244c3d43e},
+    {0x9defbf01b061adab, 0x3a0888136afa64a7},
+    {0xc56baec21c7a1916, 0x088aaa1845b8fdd0},
+    {0xf6c69a72a3989f5b, 0x8aad549e57273d45},
+    {0x9a3c2087a63f6399, 0x36ac54e2f678864b},
+    {0xc0cb28a98fcf3c7f, 0x84576a1bb416a7dd},
+    {0xf0fdf2d3f3c30b9f, 0x656d44a2a11c51d5},
+    {0x969eb7c47859e743, 0x9f644ae5a4b1b325},
+    {0xbc4665b596706114, 0x873d5d9f0dde1fee},
+    {0xeb57ff22fc0c7959, 0xa90cb506d155a7ea},
+    {0x9316ff75dd87cbd8, 0x09a7f12442d588f2},
+    {0xb7dcbf5354e9bece, 0x0c11ed6d538aeb2f},
+    {0xe5d3ef282a242e81, 0x8f1668c8a86da5fa},
+    {0x8fa475791a569d10, 0xf96e017d694487bc},
+    {0xb38d92d760ec4455, 0x37c981dcc395a9ac},
+    {0xe070f78d3927556a, 0x85bbe253f47b1417},
+    {0x8c469ab843b89562, 0x93956d7478ccec8e},
+    {0xaf58416654a6babb, 0x387ac8d1970027b2},
+    {0xdb2e51bfe9d0696a, 0x06997b05fcc0319e},
+    {0x88fcf317f22241e2, 0x441fece3bdf81f03},
+    {0xab3c2fddeeaad25a, 0xd527e81cad7626c3},
+    {0xd60b3bd56a5586f1, 0x8a71e223d8d3b074},
+    {0x85c7056562757456, 0xf6872d5667844e49},
+    {0xa738c6bebb12d16c, 0xb428f8ac016561db},
+    {0xd106f86e69d785c7, 0xe13336d701beba52},
+    {0x82a45b450226b39c, 0xecc0024661173473},
+    {0xa34d721642b06084, 0x27f002d7f95d0190},
+    {0xcc20ce9bd35c78a5, 0x31ec038df7b441f4},
+    {0xff290242c83396ce, 0x7e67047175a15271},
+    {0x9f79a169bd203e41, 0x0f0062c6e984d386},
+    {0xc75809c42c684dd1, 0x52c07b78a3e60868},
+    {0xf92e0c3537826145, 0xa7709a56ccdf8a82},
+    {0x9bbcc7a142b17ccb, 0x88a66076400bb691},
+    {0xc2abf989935ddbfe, 0x6acff893d00ea435},
+    {0xf356f7ebf83552fe, 0x0583f6b8c4124d43},
+    {0x98165af37b2153de, 0xc3727a337a8b704a},
+    {0xbe1bf1b059e9a8d6, 0x744f18c0592e4c5c},
+    {0xeda2ee1c7064130c, 0x1162def06f79df73},
+    {0x9485d4d1c63e8be7, 0x8addcb5645ac2ba8},
+    {0xb9a74a0637ce2ee1, 0x6d953e2bd7173692},
+    {0xe8111c87c5c1ba99, 0xc8fa8db6ccdd0437},
+    {0x910ab1d4db9914a0, 0x1d9c9892400a22a2},
+    {0xb54d5e4a127f59c8, 0x2503beb6d00cab4b},
+    {0xe2a0b5dc971f303a, 0x2e44ae64840fd61d},
+    {0x8da471a9de737e24, 0x5ceaecfed289e5d2},
+    {0xb10d8e1456105dad, 0x7425a83e872c5f47},
+    {0xdd50f1996b947518, 0xd12f124e28f77719},
+    {0x8a5296ffe33cc92f, 0x82bd6b70d99aaa6f},
+    {0xace73cbfdc0bfb7b, 0x636cc64d1001550b},
+    {0xd8210befd30efa5a, 0x3c47f7e05401aa4e},
+    {0x8714a775e3e95c78, 0x65acfaec34810a71},
+    {0xa8d9d1535ce3b396, 0x7f1839a741a14d0d},
+    {0xd31045a8341ca07c, 0x1ede48111209a050},
+    {0x83ea2b892091e44d, 0x934aed0aab460432},
+    {0xa4e4b66b68b65d60, 0xf81da84d5617853f},
+    {0xce1de40642e3f4b9, 0x36251260ab9d668e},
+    {0x80d2ae83e9ce78f3, 0xc1d72b7c6b426019},
+    {0xa1075a24e4421730, 0xb24cf65b8612f81f},
+    {0xc94930ae1d529cfc, 0xdee033f26797b627},
+    {0xfb9b7cd9a4a7443c, 0x169840ef017da3b1},
+    {0x9d412e0806e88aa5, 0x8e1f289560ee864e},
+    {0xc491798a08a2ad4e, 0xf1a6f2bab92a27e2},
+    {0xf5b5d7ec8acb58a2, 0xae10af696774b1db},
+    {0x9991a6f3d6bf1765, 0xacca6da1e0a8ef29},
+    {0xbff610b0cc6edd3f, 0x17fd090a58d32af3},
+    {0xeff394dcff8a948e, 0xddfc4b4cef07f5b0},
+    {0x95f83d0a1fb69cd9, 0x4abdaf101564f98e},
+    {0xbb764c4ca7a4440f, 0x9d6d1ad41abe37f1},
+    {0xea53df5fd18d5513, 0x84c86189216dc5ed},
+    {0x92746b9be2f8552c, 0x32fd3cf5b4e49bb4},
+    {0xb7118682dbb66a77, 0x3fbc8c33221dc2a1},
+    {0xe4d5e82392a40515, 0x0fabaf3feaa5334a},
+    {0x8f05b1163ba6832d, 0x29cb4d87f2a7400e},
+    {0xb2c71d5bca9023f8, 0x743e20e9ef511012},
+    {0xdf78e4b2bd342cf6, 0x914da9246b255416},
+    {0x8bab8eefb6409c1a, 0x1ad089b6c2f7548e},
+    {0xae9672aba3d0c320, 0xa184ac2473b529b1},
+    {0xda3c0f568cc4f3e8, 0xc9e5d72d90a2741e},
+    {0x8865899617fb1871, 0x7e2fa67c7a658892},
+    {0xaa7eebfb9df9de8d, 0xddbb901b98feeab7},
+    {0xd51ea6fa85785631, 0x552a74227f3ea565},
+    {0x8533285c936b35de, 0xd53a88958f87275f},
+    {0xa67ff273b8460356, 0x8a892abaf368f137},
+    {0xd01fef10a657842c, 0x2d2b7569b0432d85},
+    {0x8213f56a67f6b29b, 0x9c3b29620e29fc73},
+    {0xa298f2c501f45f42, 0x8349f3ba91b47b8f},
+    {0xcb3f2f7642717713, 0x241c70a936219a73},
+    {0xfe0efb53d30dd4d7, 0xed238cd383aa0110},
+    {0x9ec95d1463e8a506, 0xf4363804324a40aa},
+    {0xc67bb4597ce2ce48, 0xb143c6053edcd0d5},
+    {0xf81aa16fdc1b81da, 0xdd94b7868e94050a},
+    {0x9b10a4e5e9913128, 0xca7cf2b4191c8326},
+    {0xc1d4ce1f63f57d72, 0xfd1c2f611f63a3f0},
+    {0xf24a01a73cf2dccf, 0xbc633b39673c8cec},
+    {0x976e41088617ca01, 0xd5be0503e085d813},
+    {0xbd49d14aa79dbc82, 0x4b2d8644d8a74e18},
+    {0xec9c459d51852ba2, 0xddf8e7d60ed1219e},
+    {0x93e1ab8252f33b45, 0xcabb90e5c942b503},
+    {0xb8da1662e7b00a17, 0x3d6a751f3b936243},
+    {0xe7109bfba19c0c9d, 0x0cc512670a783ad4},
+    {0x906a617d450187e2, 0x27fb2b80668b24c5},
+    {0xb484f9dc9641e9da, 0xb1f9f660802dedf6},
+    {0xe1a63853bbd26451, 0x5e7873f8a0396973},
+    {0x8d07e33455637eb2, 0xdb0b487b6423e1e8},
+    {0xb049dc016abc5e5f, 0x91ce1a9a3d2cda62},
+    {0xdc5c5301c56b75f7, 0x7641a140cc7810fb},
+    {0x89b9b3e11b6329ba, 0xa9e904c87fcb0a9d},
+    {0xac2820d9623bf429, 0x546345fa9fbdcd44},
+    {0xd732290fbacaf133, 0xa97c177947ad4095},
+    {0x867f59a9d4bed6c0, 0x49ed8eabcccc485d},
+    {0xa81f301449ee8c70, 0x5c68f256bfff5a74},
+    {0xd226fc195c6a2f8c, 0x73832eec6fff3111},
+    {0x83585d8fd9c25db7, 0xc831fd53c5ff7eab},
+    {0xa42e74f3d032f525, 0xba3e7ca8b77f5e55},
+    {0xcd3a1230c43fb26f, 0x28ce1bd2e55f35eb},
+    {0x80444b5e7aa7cf85, 0x7980d163cf5b81b3},
+    {0xa0555e361951c366, 0xd7e105bcc332621f},
+    {0xc86ab5c39fa63440, 0x8dd9472bf3fefaa7},
+    {0xfa856334878fc150, 0xb14f98f6f0feb951},
+    {0x9c935e00d4b9d8d2, 0x6ed1bf9a569f33d3},
+    {0xc3b8358109e84f07, 0x0a862f80ec4700c8},
+    {0xf4a642e14c6262c8, 0xcd27bb612758c0fa},
+    {0x98e7e9cccfbd7dbd, 0x8038d51cb897789c},
+    {0xbf21e44003acdd2c, 0xe0470a63e6bd56c3},
+    {0xeeea5d5004981478, 0x1858ccfce06cac74},
+    {0x95527a5202df0ccb, 0x0f37801e0c43ebc8},
+    {0xbaa718e68396cffd, 0xd30560258f54e6ba},
+    {0xe950df20247c83fd, 0x47c6b82ef32a2069},
+    {0x91d28b7416cdd27e, 0x4cdc331d57fa5441},
+    {0xb6472e511c81471d, 0xe0133fe4adf8e952},
+    {0xe3d8f9e563a198e5, 0x58180fddd97723a6},
+    {0x8e679c2f5e44ff8f, 0x570f09eaa7ea7648},
+    {0xb201833b35d63f73, 0x2cd2cc6551e513da},
+    {0xde81e40a034bcf4f, 0xf8077f7ea65e58d1},
+    {0x8b112e86420f6191, 0xfb04afaf27faf782},
+    {0xadd57a27d29339f6, 0x79c5db9af1f9b563},
+    {0xd94ad8b1c7380874, 0x18375281ae7822bc},
+    {0x87cec76f1c830548, 0x8f2293910d0b15b5},
+    {0xa9c2794ae3a3c69a, 0xb2eb3875504ddb22},
+    {0xd433179d9c8cb841, 0x5fa60692a46151eb},
+    {0x849feec281d7f328, 0xdbc7c41ba6bcd333},
+    {0xa5c7ea73224deff3, 0x12b9b522906c0800},
+    {0xcf39e50feae16bef, 0xd768226b34870a00},
+    {0x81842f29f2cce375, 0xe6a1158300d46640},
+    {0xa1e53af46f801c53, 0x60495ae3c1097fd0},
+    {0xca5e89b18b602368, 0x385bb19cb14bdfc4},
+    {0xfcf62c1dee382c42, 0x46729e03dd9ed7b5},
+    {0x9e19db92b4e31ba9, 0x6c07a2c26a8346d1}
+};
+
+
+static const double exact_power_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+typedef struct _NUMBER_TEXT {
+
+    int Negative;
+    int IsInteger;
+    uint64_t Mantissa;
+    int64_t Exponent;
+    int Digits;
+    char *Start;
+    char *End;
+
+} NUMBER_TEXT;
+
+
+static inline int isJsonDigit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+
+//
+//  Returns the end of the number, or NULL if the text is not one.
+//
+static char *lexJsonNumber(char *cursor, char *end, NUMBER_TEXT *number)
+{
+    //-----------------------------
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    int64_t exp_value = 0;
+    int exp_negative = 0;
+    int digits = 0;
+    //-----------------------------
+
+    number->Start = cursor;
+    number->Negative = 0;
+    number->IsInteger = 1;
+
+    if (cursor < end && *cursor == '-') {
+        number->Negative = 1;
+        cursor++;
+    }
+
+    if (cursor >= end || !isJsonDigit(*cursor))
+        return NULL;
+
+    //  No leading zeros, so a 0 is the whole integer part.
+    if (*cursor == '0') {
+        cursor++;
+    }
+    else {
+        while (cursor < end && isJsonDigit(*cursor)) {
+            if (digits < 19)
+                mantissa = mantissa * 10 + (*cursor - '0');
+            else
+                exponent++;
+            digits++;
+            cursor++;
+        }
+    }
+
+    if (cursor < end && *cursor == '.') {
+        number->IsInteger = 0;
+        cursor++;
+
+        if (cursor >= end || !isJsonDigit(*cursor))
+            return NULL;
+
+        while (cursor < end && isJsonDigit(*cursor)) {
+            //  Zeros ahead of the first significant digit only scale.
+            if (digits == 0 && *cursor == '0') {
+                exponent--;
+            }
+            else if (digits < 19) {
+                mantissa = mantissa * 10 + (*cursor - '0');
+                exponent--;
+                digits++;
+            }
+            else {
+                digits++;
+            }
+            cursor++;
+        }
+    }
+
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+        number->IsInteger = 0;
+        cursor++;
+
+        if (cursor < end && (*cursor == '+' || *cursor == '-')) {
+            exp_negative = (*cursor == '-');
+            cursor++;
+        }
+
+        if (cursor >= end || !isJsonDigit(*cursor))
+            return NULL;
+
+        while (cursor < end && isJsonDigit(*cursor)) {
+            //  Far beyond the range of a double either way.
+            if (exp_value < 100000)
+                exp_value = exp_value * 10 + (*cursor - '0');
+            cursor++;
+        }
+
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    number->Mantissa = mantissa;
+    number->Exponent = exponent;
+    number->Digits = digits;
+    number->End = cursor;
+
+    return cursor;
+}
+
+
+//
+//  The Eisel-Lemire conversion. Returns 0 when it cannot decide the
+//  correctly rounded result.
+//
+static int eiselLemire(uint64_t w, int64_t q, int negative, double *result)
+{
+    //-----------------------------
+    unsigned __int128 first;
+    unsigned __int128 second;
+    uint64_t upper;
+    uint64_t lower;
+    uint64_t upperbit;
+    uint64_t mantissa;
+    uint64_t bits;
+    int64_t exponent;
+    int lz;
+    const uint64_t *power;
+    //-----------------------------
+
+    if (w == 0) {
+        *result = negative ? -0.0 : 0.0;
+        return 1;
+    }
+
+    if (q < POWER_OF_FIVE_MIN || q > POWER_OF_FIVE_MAX)
+        return 0;
+
+    //  Clinger's fast path, both operands and the result are exact.
+    if (q >= -22 && q <= 22 && w <= (1ULL << 53)) {
+        if (q < 0)
+            *result = (double)w / exact_power_of_ten[-q];
+        else
+            *result = (double)w * exact_power_of_ten[q];
+        if (negative)
+            *result = -*result;
+        return 1;
+    }
+
+    //  The binary exponent is 1024 + 63 + q + floor(log2(5^q)).
+    exponent = (((152170 + 65536) * q) >> 16) + 1024 + 63;
+
+    lz = __builtin_clzll(w);
+    w <<= lz;
+
+    power = power_of_five_128[q - POWER_OF_FIVE_MIN];
+
+    first = (unsigned __int128)w * power[0];
+    upper = (uint64_t)(first >> 64);
+    lower = (uint64_t)first;
+
+    //  Only look at the lower half of 5^q when the upper one leaves the
+    //  rounding in doubt.
+    if ((upper & 0x1FF) == 0x1FF) {
+        second = (unsigned __int128)w * power[1];
+        lower += (uint64_t)(second >> 64);
+        if ((uint64_t)(second >> 64) > lower)
+            upper++;
+    }
+
+    upperbit = upper >> 63;
+    mantissa = upper >> (upperbit + 9);
+    lz += (int)(1 ^ upperbit);
+
+    //  Exactly halfway between two doubles.
+    if (lower == 0 && (upper & 0x1FF) == 0 && (mantissa & 3) == 1)
+        return 0;
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+
+    if (mantissa >= (1ULL << 53)) {
+        mantissa = (1ULL << 52);
+        lz--;
+    }
+
+    mantissa &= ~(1ULL << 52);
+    exponent -= lz;
+
+    //  Subnormal or overflowing results.
+    if (exponent < 1 || exponent > 2046)
+        return 0;
+
+    bits = mantissa | ((uint64_t)exponent << 52) |
+           ((uint64_t)(negative != 0) << 63);
+    memcpy(result, &bits, sizeof(double));
+
+    return 1;
+}
+
+
+//
+//  Hands the digits to strtod() as "digits" "e" exponent, leaving out
+//  the decimal point, the only part of the syntax the locale changes.
+//  Returns -1 if out of memory.
+//
+static int slowJsonNumber(NUMBER_TEXT *number, double *result)
+{
+    //-----------------------------
+    char local[128];
+    char *buffer = local;
+    char *out;
+    char *cursor;
+    int64_t exponent = 0;
+    int64_t exp_value = 0;
+    int exp_negative = 0;
+    size_t size;
+    //-----------------------------
+
+    size = (number->End - number->Start) + 32;
+    if (size > sizeof(local)) {
+        buffer = (char *)malloc(size);
+        if (!buffer)
+            return -1;
+    }
+
+    out = buffer;
+    cursor = number->Start;
+
+    if (*cursor == '-')
+        *out++ = *cursor++;
+
+    for (; cursor < number->End && isJsonDigit(*cursor); cursor++)
+        *out++ = *cursor;
+
+    //  Every digit after the point scales the result down.
+    if (cursor < number->End && *cursor == '.') {
+        for (cursor++; cursor < number->End && isJsonDigit(*cursor); cursor++) {
+            *out++ = *cursor;
+            exponent--;
+        }
+    }
+
+    //  The lexer already checked the syntax, and the cap is the same.
+    if (cursor < number->End) {
+        cursor++;
+        if (*cursor == '+' || *cursor == '-') {
+            exp_negative = (*cursor == '-');
+            cursor++;
+        }
+        for (; cursor < number->End; cursor++) {
+            if (exp_value < 100000)
+                exp_value = exp_value * 10 + (*cursor - '0');
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    sprintf(out, "e%lld", (long long)exponent);
+
+    *result = strtod(buffer, NULL);
+
+    if (buffer != local)
+        free(buffer);
+
+    return 0;
+}
+
+
+//
+//  Stores a lexed number in value. Numbers too large for a double fail,
+//  since no JSON text could hold the infinity they would become.
+//
+static JSON_ERROR convertJsonNumber(NUMBER_TEXT *number, JSON_VALUE *value)
+{
+    //-----------------------------
+    double result;
+    //-----------------------------
+
+    //  -0 stays a double to keep its sign.
+    if (number->IsInteger && number->Digits <= 19 &&
+        (number->Mantissa != 0 || !number->Negative)) {
+
+        if (!number->Negative && number->Mantissa <= (uint64_t)INT64_MAX) {
+            value->Type = TYPE_INTEGER;
+            value->Integer = (int64_t)number->Mantissa;
+            return SUCCESS;
+        }
+        else if (number->Negative &&
+                 number->Mantissa <= (uint64_t)INT64_MAX + 1) {
+            value->Type = TYPE_INTEGER;
+            value->Integer = (int64_t)(0 - number->Mantissa);
+            return SUCCESS;
+        }
+    }
+
+    value->Type = TYPE_NUMBER;
+
+    if (number->Digits <= 19 &&
+        eiselLemire(number->Mantissa, number->Exponent, number->Negative,
+                    &result)) {
+        value->Number = result;
+    }
+    else if (slowJsonNumber(number, &result) == 0) {
+        value->Number = result;
+    }
+    else {
+        return ERROR_ALLOC_FAILED;
+    }
+
+    if (!isfinite(value->Number))
+        return ERROR_INVALID_NUMBER;
+
+    return SUCCESS;
+}
+
+
+static void parseJsonNumber(PARSE_STATE *ps, char *start, JSON_VALUE *value)
+{
+    //-----------------------------
+    NUMBER_TEXT number;
+    JSON_ERROR rc;
+    char *end;
+    //-----------------------------
+
+    end = lexJsonNumber(start, ps->End, &number);
+    if (!end) {
+        parseError(ps, ERROR_INVALID_NUMBER);
+    }
+
+    checkScalarEnd(ps, end, ERROR_INVALID_NUMBER);
+
+    rc = convertJsonNumber(&number, value);
+    if (rc != SUCCESS) {
+        parseError(ps, rc);
+    }
+}
+
+
+// Forward declarations
+static void parseJsonValueInto(PARSE_STATE *ps, JSON_VALUE *value);
+static void parseJsonObject(PARSE_STATE *ps, JSON_MEMBER **link);
+static void parseSelectObject(PARSE_STATE *ps, JSON_MEMBER **link,
+                              struct _SELECT_NODE *select);
+
+
+static JSON_MEMBER *linkJsonMember(PARSE_STATE *ps, JSON_MEMBER **link)
+{
+    //---------------------
+    JSON_MEMBER *member;
+    //---------------------
+
+    member = allocJsonNode(ps->Document);
+    if (!member){
+        parseError(ps, ERROR_ALLOC_FAILED);
+    }
+
+    *link = member;
+
+    return member;
+}
+
+
+//
+//  Called with the [ already consumed. The array is linked in first, and
+//  counts each element before parsing it, so a failed parse can still
+//  free everything built so far. Elements only move when the array grows
+//  between them.
+//
+static void parseJsonArray(PARSE_STATE *ps, JSON_ARRAY **link)
+{
+    //------------------------------------
+    JSON_ARRAY *array;
+    JSON_VALUE *value;
+    JSON_VALUE *values;
+    char *token;
+    //------------------------------------
+
+    array = allocJsonArray(ps->Document);
+    if (!array) {
+        parseError(ps, ERROR_ALLOC_FAILED);
+    }
+
+    *link = array;
+
+    if (nextTokenIs(ps, ']'))
+        return;
+
+    do {
+        if (array->Count == array->Capacity &&
+            growJsonArray(ps->Document, array) != 0) {
+            parseError(ps, ERROR_ALLOC_FAILED);
+        }
+
+        value = &array->Values[array->Count++];
+        memset(value, 0, sizeof(JSON_VALUE));
+        value->Signature = JSON_VALUE_SIGNATURE;
+
+        parseJsonValueInto(ps, value);
+
+        token = nextToken(ps, ERROR_INVALID_ARRAY);
+
+        if (*token == ']') {
+            break;
+        }
+        else if (*token != ',') {
+            parseError(ps, ERROR_INVALID_ARRAY);
+        }
+
+    } while (1);
+
+    //  Heap arrays give back what the doubling left unused.
+    if (!usesArena(ps->Document) && array->Count < array->Capacity) {
+        values = (JSON_VALUE *)realloc(array->Values,
+                                       array->Count * sizeof(JSON_VALUE));
+        if (values) {
+            array->Values = values;
+            array->Capacity = array->Count;
+        }
+    }
+}
+
+
+//
+//  Skips the rest of a container whose opening bracket was just read.
+//  Only the structurals are walked, nothing in the container is looked
+//  at, so bracket kinds are not matched until it is parsed.
+//
+static const signed char nesting[256] = {
+    ['{'] = 1, ['['] = 1, ['}'] = -1, [']'] = -1
+};
+
+
+static void skipJsonContainer(PARSE_STATE *ps, char open)
+{
+    //--------------------------
+    const uint32_t *positions = ps->Index.Positions;
+    const char *start = ps->Start;
+    size_t next = ps->Next;
+    size_t depth = 1;
+    //--------------------------
+
+    while (next < ps->Index.Count) {
+        depth += nesting[(unsigned char)start[positions[next++]]];
+        if (depth == 0)
+            break;
+    }
+
+    if (depth) {
+        parseError(ps, (open == '{') ? ERROR_INVALID_OBJECT :
+                                       ERROR_INVALID_ARRAY);
+    }
+
+    ps->Next = next;
+}
+
+
+//
+//  Lazy parses leave nested containers for later, as a span of the
+//  document's text.
+//
+static void skipLazyContainer(PARSE_STATE *ps, JSON_VALUE *value, char open)
+{
+    //--------------------------
+    LAZY_SPAN *span;
+    //--------------------------
+
+    span = (LAZY_SPAN *)jsonAlloc(ps->Document, sizeof(LAZY_SPAN));
+    if (!span) {
+        parseError(ps, ERROR_ALLOC_FAILED);
+    }
+
+    span->Document = ps->Document;
+    span->Position = ps->Next - 1;
+
+    value->Type = (open == '{') ? TYPE_LAZY_OBJECT : TYPE_LAZY_ARRAY;
+    value->Lazy = span;
+
+    skipJsonContainer(ps, open);
+}
+
+
+static void parseJsonValueInto(PARSE_STATE *ps, JSON_VALUE *value)
+{
+    //--------------------------
+    char *start;
+    //--------------------------
+
+    start = nextToken(ps, ERROR_INVALID_VALUE_TYPE);
+
+    if (*start == '"') {
+        value->Type = TYPE_STRING;
+        value->String = parseJsonString(ps, start);
+    }
+    else if (*start == 't') {
+        value->Type = TYPE_BOOLEAN;
+        value->Boolean = parseJsonBoolean(ps, start);
+    }
+    else if (*start == 'f') {
+        value->Type = TYPE_BOOLEAN;
+        value->Boolean = parseJsonBoolean(ps, start);
+    }
+    else if (isJsonDigit(*start) || *start == '-') {
+        parseJsonNumber(ps, start, value);
+    }
+    else if (ps->Lazy && (*start == '[' || *start == '{')) {
+        skipLazyContainer(ps, value, *start);
+    }
+    else if (*start == '[') {
+        value->Type = TYPE_ARRAY;
+        parseJsonArray(ps, &value->Array);
+    }
+    else if (*start == '{') {
+        value->Type = TYPE_OBJECT;
+        parseJsonObject(ps, &value->Object);
+    }
+    else {
+        parseError(ps, ERROR_INVALID_VALUE_TYPE);
+    }
+}
+
+
+static void parseJsonObjectMember(PARSE_STATE *ps, JSON_MEMBER *member)
+{
+    //---------------------
+    char *token;
+    //---------------------
+
+    // Get the name
+    token = nextToken(ps, ERROR_INVALID_OBJECT);
+    if (ps->Keys)
+        member->Name = parseJsonKey(ps, token);
+    else
+        member->Name = parseJsonString(ps, token);
+
+    // Find the :
+    token = nextToken(ps, ERROR_INVALID_OBJECT);
+    if (*token != ':') {
+        parseError(ps, ERROR_INVALID_OBJECT);
+    }
+
+    // Get the value
+    parseJsonValueInto(ps, member->Value);
+}
+
+
+//
+//  Called with the { already consumed. An empty object is a single
+//  member with no name and no value.
+//
+static void parseJsonObject(PARSE_STATE *ps, JSON_MEMBER **link)
+{
+    //-----------------------------------------
+    JSON_MEMBER *member;
+    char *token;
+    //-----------------------------------------
+
+    if (nextTokenIs(ps, '}')) {
+        *link = allocJsonMember(ps->Document);
+        if (!*link) {
+            parseError(ps, ERROR_ALLOC_FAILED);
+        }
+        return;
+    }
+
+    do {
+        member = linkJsonMember(ps, link);
+        link = &member->Next;
+
+        parseJsonObjectMember(ps, member);
+
+        token = nextToken(ps, ERROR_INVALID_OBJECT);
+
+        if (*token == '}') {
+            break;
+        }
+        else if (*token != ',') {
+            parseError(ps, ERROR_INVALID_OBJECT);
+        }
+
+    } while (1);
+}
+
+
+#ifdef JSON_STATS_COUNTERS
+static uint64_t statsClock(void)
+{
+    //-----------------------
+    struct timespec ts;
+    //-----------------------
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+
+//
+//  Runs both stages over a complete document. On failure the context
+//  holds the error and ps->Root whatever part of the tree was built.
+//
+static int parseText(PARSE_STATE *ps, char *string, size_t length)
+{
+    //-----------------------
+    JSON_ERROR rc;
+    char *token;
+#ifdef JSON_STATS_COUNTERS
+    uint64_t start = statsClock();
+#endif
+    //-----------------------
+
+    ps->Start = string;
+    ps->End = string + length;
+    ps->Next = 0;
+    ps->Root = NULL;
+
+    initStructuralIndex(&ps->Index);
+
+    rc = buildStructuralIndex(string, length, &ps->Index);
+    if (rc != SUCCESS) {
+        freeStructuralIndex(&ps->Index);
+        ps->Context->Errno = rc;
+        return -1;
+    }
+
+    if (setjmp(ps->JmpBuffer) != 0) {
+        freeStructuralIndex(&ps->Index);
+        return -1;
+    }
+
+    token = nextToken(ps, ERROR_INVALID_OBJECT);
+    if (*token != '{') {
+        parseError(ps, ERROR_INVALID_OBJECT);
+    }
+
+    if (ps->Select)
+        parseSelectObject(ps, &ps->Root, ps->Select);
+    else
+        parseJsonObject(ps, &ps->Root);
+
+    // Nothing may follow the object.
+    if (ps->Next != ps->Index.Count) {
+        parseError(ps, ERROR_INVALID_OBJECT);
+    }
+
+    //  Lazy parses hand the index over to their document.
+    if (!ps->Lazy)
+        freeStructuralIndex(&ps->Index);
+
+#ifdef JSON_STATS_COUNTERS
+    if (ps->Document)
+        ps->Document->ParseNanoseconds = statsClock() - start;
+#endif
+
+    return 0;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseCtx(JSON_CONTEXT *ctx, char *string)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    //-----------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!string) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    ps.Document = NULL;
+    ps.Context = ctx;
+    ps.Lazy = 0;
+    ps.Select = NULL;
+    ps.Keys = NULL;
+
+    if (parseText(&ps, string, strlen(string)) != 0) {
+        if (ps.Root)
+            freeJsonObject(NULL, ps.Root);
+        return NULL;
+    }
+
+    return ps.Root;
+}
+
+
+JSON_OBJECT_HANDLE JSON_Parse(char *string)
+{
+    return JSON_ParseCtx(&default_context, string);
+}
+
+
+static JSON_OBJECT_HANDLE parseArenaDocument(JSON_CONTEXT *ctx, char *string,
+                                             size_t length,
+                                             size_t first_chunk_size)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_DOCUMENT *doc;
+    //-----------------------
+
+    doc = allocJsonDocument(first_chunk_size);
+    if (!doc) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    ps.Document = doc;
+    ps.Context = ctx;
+    ps.Lazy = 0;
+    ps.Select = NULL;
+    ps.Keys = NULL;
+
+    if (parseText(&ps, string, length) != 0) {
+        freeArenaChunks(doc);
+        return NULL;
+    }
+
+    doc->Root = ps.Root;
+
+    return doc;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseArenaCtx(JSON_CONTEXT *ctx, char *string)
+{
+    ctx->Errno = SUCCESS;
+
+    if (!string) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    return parseArenaDocument(ctx, string, strlen(string),
+                              ARENA_FIRST_CHUNK_SIZE);
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseArena(char *string)
+{
+    return JSON_ParseArenaCtx(&default_context, string);
+}
+
+
+JSON_KEYTABLE_HANDLE JSON_KeyTableCreate(void)
+{
+    //-----------------------
+    JSON_DOCUMENT *storage;
+    KEY_TABLE *keys;
+    //-----------------------
+
+    default_context.Errno = SUCCESS;
+
+    storage = allocJsonDocument(ARENA_FIRST_CHUNK_SIZE);
+    if (!storage) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    keys = createKeyTable(storage);
+    if (!keys) {
+        freeArenaChunks(storage);
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    return keys;
+}
+
+
+static KEY_TABLE *getKeyTable(JSON_KEYTABLE_HANDLE keys)
+{
+    //-----------------------
+    KEY_TABLE *table = keys;
+    //-----------------------
+
+    if (table && table->Signature == KEY_TABLE_SIGNATURE)
+        return table;
+
+    return NULL;
+}
+
+
+void JSON_KeyTableFree(JSON_KEYTABLE_HANDLE keys)
+{
+    //-----------------------
+    KEY_TABLE *table;
+    //-----------------------
+
+    default_context.Errno = SUCCESS;
+    table = getKeyTable(keys);
+
+    if (!table) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return;
+    }
+
+    freeArenaChunks(table->Storage);
+    freeKeyTable(table);
+}
+
+
+size_t JSON_KeyTableCount(JSON_KEYTABLE_HANDLE keys)
+{
+    //-----------------------
+    KEY_TABLE *table;
+    //-----------------------
+
+    default_context.Errno = SUCCESS;
+    table = getKeyTable(keys);
+
+    if (!table) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return 0;
+    }
+
+    return table->Count;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseInternedCtx(JSON_CONTEXT *ctx, char *string,
+                                         JSON_KEYTABLE_HANDLE keys)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_DOCUMENT *doc;
+    //-----------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!string || (keys && !getKeyTable(keys))) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    doc = allocJsonDocument(ARENA_FIRST_CHUNK_SIZE);
+    if (!doc) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    //  Without a shared table, the document gets one of its own.
+    if (!keys) {
+        doc->Keys = createKeyTable(doc);
+        if (!doc->Keys) {
+            freeArenaChunks(doc);
+            ctx->Errno = ERROR_ALLOC_FAILED;
+            return NULL;
+        }
+    }
+
+    ps.Document = doc;
+    ps.Context = ctx;
+    ps.Lazy = 0;
+    ps.Select = NULL;
+    ps.Keys = keys ? getKeyTable(keys) : doc->Keys;
+
+    if (parseText(&ps, string, strlen(string)) != 0) {
+        freeArenaChunks(doc);
+        return NULL;
+    }
+
+    doc->Root = ps.Root;
+
+    return doc;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseInterned(char *string, JSON_KEYTABLE_HANDLE keys)
+{
+    return JSON_ParseInternedCtx(&default_context, string, keys);
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseInSituCtx(JSON_CONTEXT *ctx, char *string)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_DOCUMENT *doc;
+    size_t length;
+    //-----------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!string) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    length = strlen(string);
+
+    doc = allocInSituDocument(string, length + 1);
+    if (!doc) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    ps.Document = doc;
+    ps.Context = ctx;
+    ps.Lazy = 0;
+    ps.Select = NULL;
+    ps.Keys = NULL;
+
+    if (parseText(&ps, string, length) != 0) {
+        doc->Root = ps.Root;
+        freeJsonDocument(doc);
+        return NULL;
+    }
+
+    doc->Root = ps.Root;
+
+    return doc;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseInSitu(char *string)
+{
+    return JSON_ParseInSituCtx(&default_context, string);
+}
+
+
+//
+//  Files are parsed straight from a private mapping. Without FILE_IN_SITU
+//  it is read only and unmapped once the strings are copied out. With it
+//  the strings are terminated where they are, which only copies the
+//  pages they are on, and the document keeps the mapping until it is
+//  freed.
+//
+JSON_OBJECT_HANDLE JSON_ParseFileCtx(JSON_CONTEXT *ctx, const char *path,
+                                     int flags)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_DOCUMENT *doc;
+    struct stat st;
+    char *mapping;
+    size_t length;
+    int in_situ;
+    int fd;
+    //-----------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!path) {
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    //  An empty file is no object, and cannot be mapped.
+    if (st.st_size == 0) {
+        close(fd);
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    length = (size_t)st.st_size;
+    in_situ = (flags & FILE_IN_SITU) != 0;
+
+    mapping = (char *)mmap(NULL, length,
+                           in_situ ? PROT_READ | PROT_WRITE : PROT_READ,
+                           MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    madvise(mapping, length, MADV_SEQUENTIAL);
+
+    doc = allocJsonDocument(ARENA_FIRST_CHUNK_SIZE);
+    if (!doc) {
+        munmap(mapping, length);
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    if (in_situ) {
+        doc->Buffer = mapping;
+        doc->BufferLength = length;
+        doc->Mapped = 1;
+    }
+
+    ps.Document = doc;
+    ps.Context = ctx;
+    ps.Lazy = 0;
+    ps.Select = NULL;
+    ps.Keys = NULL;
+
+    if (parseText(&ps, mapping, length) != 0) {
+        freeArenaChunks(doc);
+        if (!in_situ)
+            munmap(mapping, length);
+        return NULL;
+    }
+
+    if (!in_situ)
+        munmap(mapping, length);
+
+    doc->Root = ps.Root;
+
+    return doc;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseFile(const char *path, int flags)
+{
+    return JSON_ParseFileCtx(&default_context, path, flags);
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseLazyCtx(JSON_CONTEXT *ctx, char *string)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_DOCUMENT *doc;
+    LAZY_TEXT *lazy;
+    size_t length;
+    //-----------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!string) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    length = strlen(string);
+
+    doc = allocJsonDocument(ARENA_FIRST_CHUNK_SIZE);
+    if (!doc) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    lazy = (LAZY_TEXT *)arenaAlloc(doc, sizeof(LAZY_TEXT));
+    if (lazy)
+        lazy->Start = (char *)arenaAlloc(doc, length + 1);
+    if (!lazy || !lazy->Start) {
+        freeArenaChunks(doc);
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    memcpy(lazy->Start, string, length + 1);
+    lazy->End = lazy->Start + length;
+
+    ps.Document = doc;
+    ps.Context = ctx;
+    ps.Lazy = 1;
+    ps.Select = NULL;
+    ps.Keys = NULL;
+
+    if (parseText(&ps, lazy->Start, length) != 0) {
+        freeArenaChunks(doc);
+        return NULL;
+    }
+
+    //  The index outlives the parse, so it cannot stay inline.
+    if (ps.Index.Positions == ps.Index.Inline) {
+        lazy->Positions = (uint32_t *)malloc(ps.Index.Count * sizeof(uint32_t));
+        if (!lazy->Positions) {
+            freeArenaChunks(doc);
+            ctx->Errno = ERROR_ALLOC_FAILED;
+            return NULL;
+        }
+        memcpy(lazy->Positions, ps.Index.Inline,
+               ps.Index.Count * sizeof(uint32_t));
+        lazy->Capacity = ps.Index.Count;
+    }
+    else {
+        lazy->Positions = ps.Index.Positions;
+        lazy->Capacity = ps.Index.Capacity;
+    }
+
+    lazy->Count = ps.Index.Count;
+    doc->Lazy = lazy;
+    doc->Root = ps.Root;
+
+    return doc;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseLazy(char *string)
+{
+    return JSON_ParseLazyCtx(&default_context, string);
+}
+
+
+//
+//  Parses the next level of a lazy container, whose own nested
+//  containers stay lazy in turn. The value only changes on success, so a
+//  container with an error in it stays lazy and reports it each time it
+//  is read.
+//
+static JSON_ERROR loadLazyValue(JSON_VALUE *value)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_CONTEXT ctx;
+    LAZY_TEXT *lazy;
+    JSON_MEMBER *object;
+    JSON_ARRAY *array;
+#ifdef JSON_STATS_COUNTERS
+    uint64_t start = statsClock();
+#endif
+    //-----------------------
+
+    lazy = value->Lazy->Document->Lazy;
+
+    ps.Start = lazy->Start;
+    ps.End = lazy->End;
+    ps.Index.Positions = lazy->Positions;
+    ps.Index.Count = lazy->Count;
+    ps.Next = value->Lazy->Position + 1;
+    ps.Root = NULL;
+    ps.Document = value->Lazy->Document;
+    ps.Context = &ctx;
+    ps.Lazy = 1;
+    ps.Select = NULL;
+    ps.Keys = NULL;
+
+    if (setjmp(ps.JmpBuffer) != 0)
+        return ctx.Errno;
+
+    if (value->Type == TYPE_LAZY_OBJECT) {
+        parseJsonObject(&ps, &object);
+        value->Type = TYPE_OBJECT;
+        value->Object = object;
+    }
+    else {
+        parseJsonArray(&ps, &array);
+        value->Type = TYPE_ARRAY;
+        value->Array = array;
+    }
+
+#ifdef JSON_STATS_COUNTERS
+    __atomic_fetch_add(&ps.Document->ParseNanoseconds, statsClock() - start,
+                       __ATOMIC_RELAXED);
+#endif
+
+    return SUCCESS;
+}
+
+
+static inline int isLazyValue(JSON_VALUE *value)
+{
+    return value->Type == TYPE_LAZY_OBJECT || value->Type == TYPE_LAZY_ARRAY;
+}
+
+
+#ifdef JSON_THREADS
+
+
+//
+//  Runs worker on thread_count threads, the calling thread being one of
+//  them, and returns once all of them are done.
+//
+static int runWorkers(int thread_count, void *(*worker)(void *), void *arg)
+{
+    //-----------------------------
+    pthread_t *threads;
+    int started;
+    int i;
+    //-----------------------------
+
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * thread_count);
+    if (!threads) {
+        return -1;
+    }
+
+    for (started = 0; started < thread_count - 1; started++) {
+        if (pthread_create(&threads[started], NULL, worker, arg) != 0) {
+            // Fewer threads just means less parallelism.
+            break;
+        }
+    }
+
+    worker(arg);
+
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+
+    return 0;
+}
+
+
+static int getThreadCount(int threads, size_t work_items)
+{
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0)
+            threads = 1;
+    }
+
+    if ((size_t)threads > work_items)
+        threads = (int)work_items;
+
+    return threads;
+}
+
+
+//
+//  Workers claim this many inputs at a time, which keeps the shared
+//  counter cold when the documents are small.
+//
+#define BATCH_GRAIN 16
+
+
+typedef struct _BATCH_JOB {
+
+    char **Inputs;
+    JSON_OBJECT_HANDLE *Out;
+    JSON_ERROR *Errors;
+    size_t Count;
+    size_t Next;
+
+} BATCH_JOB;
+
+
+static void *batchWorker(void *arg)
+{
+    //-----------------------------
+    BATCH_JOB *job = (BATCH_JOB *)arg;
+    JSON_CONTEXT ctx;
+    size_t i;
+    size_t end;
+    //-----------------------------
+
+    JSON_InitContext(&ctx);
+
+    while (1) {
+
+        i = __atomic_fetch_add(&job->Next, BATCH_GRAIN, __ATOMIC_RELAXED);
+        if (i >= job->Count)
+            break;
+
+        end = i + BATCH_GRAIN;
+        if (end > job->Count)
+            end = job->Count;
+
+        for (; i < end; i++) {
+
+            if (job->Inputs[i])
+                job->Out[i] = JSON_ParseCtx(&ctx, job->Inputs[i]);
+            else {
+                job->Out[i] = NULL;
+                ctx.Errno = ERROR_INVALID_OBJECT;
+            }
+
+            job->Errors[i] = ctx.Errno;
+        }
+    }
+
+    return NULL;
+}
+
+
+JSON_ERROR JSON_ParseBatch(char **inputs, size_t n, JSON_OBJECT_HANDLE *out,
+                           JSON_ERROR *errors, int threads)
+{
+    //-----------------------------
+    BATCH_JOB job;
+    JSON_ERROR *item_errors;
+    size_t i;
+    //-----------------------------
+
+    default_context.Errno = SUCCESS;
+
+    if (!inputs || !out) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return default_context.Errno;
+    }
+
+    if (n == 0)
+        return SUCCESS;
+
+    item_errors = errors;
+    if (!item_errors) {
+        item_errors = (JSON_ERROR *)malloc(sizeof(JSON_ERROR) * n);
+        if (!item_errors) {
+            default_context.Errno = ERROR_ALLOC_FAILED;
+            return default_context.Errno;
+        }
+    }
+
+    job.Inputs = inputs;
+    job.Out = out;
+    job.Errors = item_errors;
+    job.Count = n;
+    job.Next = 0;
+
+    if (runWorkers(getThreadCount(threads, (n + BATCH_GRAIN - 1) / BATCH_GRAIN),
+                   batchWorker, &job) != 0) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            if (item_errors[i] != SUCCESS) {
+                default_context.Errno = item_errors[i];
+                break;
+            }
+        }
+    }
+
+    if (!errors)
+        free(item_errors);
+
+    return default_context.Errno;
+}
+
+
+#endif
+
+
+//---------------------------------------------------------------------------
+//
+//  Newline delimited JSON.
+//
+//  The input is read in large chunks that end on a line break. The part
+//  of a line cut off by the end of a read is carried over to the start
+//  of the next chunk, so every chunk holds whole lines only, and lines
+//  are parsed where they are, with each line break replaced by a NUL.
+//
+//---------------------------------------------------------------------------
+#define NDJSON_CHUNK_SIZE (64 * 1024)
+#define JSON_NDJSON_SIGNATURE 0x646E644A
+
+
+typedef struct _NDJSON_CHUNK {
+
+    char *Text;
+    size_t Length;
+    size_t Sequence;
+
+} NDJSON_CHUNK;
+
+
+typedef struct _JSON_NDJSON {
+
+    int Signature;
+    FILE *File;
+    char *Carry;
+    size_t CarryLength;
+    size_t CarryCapacity;
+    size_t Sequence;
+    int Eof;
+    NDJSON_CHUNK Chunk;
+    char *Cursor;
+
+} JSON_NDJSON;
+
+
+static void initNdjsonReader(JSON_NDJSON *r, FILE *file)
+{
+    memset(r, 0, sizeof(JSON_NDJSON));
+    r->Signature = JSON_NDJSON_SIGNATURE;
+    r->File = file;
+}
+
+
+static JSON_NDJSON *getNdjsonReader(JSON_NDJSON_HANDLE reader)
+{
+    //------------------------
+    JSON_NDJSON *r = reader;
+    //------------------------
+
+    if (r && r->Signature == JSON_NDJSON_SIGNATURE)
+        return r;
+
+    return NULL;
+}
+
+
+//
+//  Keeps the text after the last line break for the next chunk.
+//
+static JSON_ERROR carryNdjsonTail(JSON_NDJSON *r, const char *tail,
+                                  size_t length)
+{
+    //------------------------
+    char *carry;
+    //------------------------
+
+    if (length > r->CarryCapacity) {
+        carry = (char *)realloc(r->Carry, length);
+        if (!carry)
+            return ERROR_ALLOC_FAILED;
+        r->Carry = carry;
+        r->CarryCapacity = length;
+    }
+
+    memcpy(r->Carry, tail, length);
+    r->CarryLength = length;
+
+    return SUCCESS;
+}
+
+
+static char *findLastLineBreak(char *text, size_t length)
+{
+    while (length) {
+        if (text[--length] == '\n')
+            return text + length;
+    }
+
+    return NULL;
+}
+
+
+//
+//  Reads the next chunk of whole lines, NUL terminated. A line longer
+//  than a chunk makes the chunk grow until it fits. chunk->Text is NULL
+//  once the input is used up.
+//
+static JSON_ERROR readNdjsonChunk(JSON_NDJSON *r, NDJSON_CHUNK *chunk)
+{
+    //------------------------
+    char *text;
+    char *grown;
+    char *line_end;
+    size_t capacity;
+    size_t length;
+    size_t got;
+    JSON_ERROR rc;
+    //------------------------
+
+    chunk->Text = NULL;
+    chunk->Length = 0;
+
+    if (r->Eof && r->CarryLength == 0)
+        return SUCCESS;
+
+    capacity = NDJSON_CHUNK_SIZE;
+    while (capacity < r->CarryLength * 2)
+        capacity *= 2;
+
+    text = (char *)malloc(capacity + 1);
+    if (!text)
+        return ERROR_ALLOC_FAILED;
+
+    if (r->CarryLength)
+        memcpy(text, r->Carry, r->CarryLength);
+    length = r->CarryLength;
+    line_end = NULL;
+
+    while (!r->Eof) {
+
+        got = fread(text + length, 1, capacity - length, r->File);
+        if (got < capacity - length) {
+            if (ferror(r->File)) {
+                free(text);
+                return ERROR_READ_FAILED;
+            }
+            r->Eof = 1;
+        }
+
+        //  Only the new text can hold the last line break.
+        line_end = findLastLineBreak(text + length, got);
+        length += got;
+
+        if (line_end || r->Eof)
+            break;
+
+        capacity *= 2;
+        grown = (char *)realloc(text, capacity + 1);
+        if (!grown) {
+            free(text);
+            return ERROR_ALLOC_FAILED;
+        }
+        text = grown;
+    }
+
+    //  At the end of the input the last line needs no line break.
+    if (r->Eof) {
+        r->CarryLength = 0;
+    }
+    else {
+        rc = carryNdjsonTail(r, line_end + 1, text + length - line_end - 1);
+        if (rc != SUCCESS) {
+            free(text);
+            return rc;
+        }
+        length = line_end + 1 - text;
+    }
+
+    text[length] = 0;
+
+    chunk->Text = text;
+    chunk->Length = length;
+    chunk->Sequence = r->Sequence++;
+
+    return SUCCESS;
+}
+
+
+//
+//  Returns the next line of a chunk that is not blank, or NULL.
+//
+static char *nextNdjsonLine(char **cursor, char *end, size_t *length)
+{
+    //------------------------
+    char *line;
+    char *line_end;
+    //------------------------
+
+    while (*cursor < end) {
+
+        line = *cursor;
+        line_end = memchr(line, '\n', end - line);
+
+        if (line_end) {
+            *line_end = 0;
+            *cursor = line_end + 1;
+        }
+        else {
+            line_end = end;
+            *cursor = end;
+        }
+
+        if (skipBlanks(line, line_end) != line_end) {
+            *length = line_end - line;
+            return line;
+        }
+    }
+
+    return NULL;
+}
+
+
+//
+//  Records are usually small, and a whole chunk of them can be held at
+//  once, so their arenas start out sized to the line.
+//
+#define NDJSON_ARENA_MIN_SIZE 512
+
+
+static JSON_OBJECT_HANDLE parseNdjsonRecord(JSON_CONTEXT *ctx, char *line,
+                                            size_t length)
+{
+    //------------------------
+    size_t size;
+    //------------------------
+
+    ctx->Errno = SUCCESS;
+
+    size = ARENA_ALIGN(sizeof(JSON_DOCUMENT)) + length * 8;
+    if (size < NDJSON_ARENA_MIN_SIZE)
+        size = NDJSON_ARENA_MIN_SIZE;
+    else if (size > ARENA_FIRST_CHUNK_SIZE)
+        size = ARENA_FIRST_CHUNK_SIZE;
+
+    return parseArenaDocument(ctx, line, length, size);
+}
+
+
+static void releaseNdjsonReader(JSON_NDJSON *r)
+{
+    r->Signature = 0;
+    free(r->Chunk.Text);
+    free(r->Carry);
+}
+
+
+JSON_NDJSON_HANDLE JSON_NdjsonOpen(FILE *file)
+{
+    //------------------------
+    JSON_NDJSON *r;
+    //------------------------
+
+    default_context.Errno = SUCCESS;
+
+    if (!file) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    r = (JSON_NDJSON *)malloc(sizeof(JSON_NDJSON));
+    if (!r) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    initNdjsonReader(r, file);
+
+    return r;
+}
+
+
+JSON_OBJECT_HANDLE JSON_NdjsonNextCtx(JSON_CONTEXT *ctx,
+                                      JSON_NDJSON_HANDLE reader)
+{
+    //------------------------
+    JSON_NDJSON *r;
+    JSON_ERROR rc;
+    char *line;
+    size_t length;
+    //------------------------
+
+    ctx->Errno = SUCCESS;
+
+    r = getNdjsonReader(reader);
+    if (!r) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    while (1) {
+
+        if (r->Chunk.Text) {
+            line = nextNdjsonLine(&r->Cursor, r->Chunk.Text + r->Chunk.Length,
+                                  &length);
+            if (line)
+                return parseNdjsonRecord(ctx, line, length);
+
+            free(r->Chunk.Text);
+            r->Chunk.Text = NULL;
+        }
+
+        rc = readNdjsonChunk(r, &r->Chunk);
+        if (rc != SUCCESS) {
+            ctx->Errno = rc;
+            return NULL;
+        }
+
+        if (!r->Chunk.Text)
+            return NULL;
+
+        r->Cursor = r->Chunk.Text;
+    }
+}
+
+
+JSON_OBJECT_HANDLE JSON_NdjsonNext(JSON_NDJSON_HANDLE reader)
+{
+    return JSON_NdjsonNextCtx(&default_context, reader);
+}
+
+
+void JSON_NdjsonClose(JSON_NDJSON_HANDLE reader)
+{
+    //------------------------
+    JSON_NDJSON *r;
+    //------------------------
+
+    r = getNdjsonReader(reader);
+
+    if (r) {
+        releaseNdjsonReader(r);
+        free(r);
+    }
+}
+
+
+#ifdef JSON_THREADS
+
+
+//
+//  Workers take turns reading the next chunk under the lock, and parse
+//  it on their own. So each holds at most one chunk, and memory does not
+//  grow with the input. Kept in order, a worker holds on to its parsed
+//  chunk until the chunks before it have been delivered.
+//
+typedef struct _NDJSON_JOB {
+
+    JSON_NDJSON Reader;
+    JSON_RECORD_CALLBACK Callback;
+    void *UserData;
+    JSON_RECORD_ORDER Order;
+    size_t Delivered;
+    int Stop;
+    JSON_ERROR Error;
+    pthread_mutex_t Lock;
+    pthread_cond_t Turn;
+
+} NDJSON_JOB;
+
+
+//
+//  Ends the job with the first error, and wakes the workers waiting for
+//  their turn. Called with the lock held.
+//
+static void stopNdjsonJob(NDJSON_JOB *job, JSON_ERROR error)
+{
+    if (!job->Stop) {
+        __atomic_store_n(&job->Stop, 1, __ATOMIC_RELAXED);
+        job->Error = error;
+        pthread_cond_broadcast(&job->Turn);
+    }
+}
+
+
+static void failNdjsonJob(NDJSON_JOB *job, JSON_ERROR error)
+{
+    pthread_mutex_lock(&job->Lock);
+    stopNdjsonJob(job, error);
+    pthread_mutex_unlock(&job->Lock);
+}
+
+
+//
+//  Parses every line of the chunk and hands the records to the callback
+//  as they come or, when records is set, collects them there for their
+//  turn. Returns the number of records collected.
+//
+static long forEachNdjsonLine(NDJSON_JOB *job, NDJSON_CHUNK *chunk,
+                              JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE **records)
+{
+    //------------------------
+    JSON_OBJECT_HANDLE record;
+    JSON_OBJECT_HANDLE *grown;
+    size_t capacity = 0;
+    long count = 0;
+    char *cursor = chunk->Text;
+    char *end = chunk->Text + chunk->Length;
+    char *line;
+    size_t length;
+    //------------------------
+
+    while ((line = nextNdjsonLine(&cursor, end, &length))) {
+
+        if (__atomic_load_n(&job->Stop, __ATOMIC_RELAXED))
+            break;
+
+        record = parseNdjsonRecord(ctx, line, length);
+
+        //  In order, records are kept until it is this chunk's turn, and
+        //  a failed one marks where the delivery has to stop.
+        if (records) {
+            if ((size_t)count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                grown = (JSON_OBJECT_HANDLE *)realloc(*records,
+                                        capacity * sizeof(JSON_OBJECT_HANDLE));
+                if (!grown) {
+                    JSON_FreeObject(record);
+                    failNdjsonJob(job, ERROR_ALLOC_FAILED);
+                    break;
+                }
+                *records = grown;
+            }
+            (*records)[count++] = record;
+            if (!record)
+                break;
+            continue;
+        }
+
+        if (!record) {
+            failNdjsonJob(job, ctx->Errno);
+            break;
+        }
+
+        if (job->Callback(job->UserData, record) != 0) {
+            JSON_FreeObject(record);
+            failNdjsonJob(job, ERROR_STOPPED);
+            break;
+        }
+        JSON_FreeObject(record);
+    }
+
+    return count;
+}
+
+
+static void deliverNdjsonChunk(NDJSON_JOB *job, NDJSON_CHUNK *chunk,
+                               JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE *records,
+                               long count)
+{
+    //------------------------
+    JSON_ERROR rc = SUCCESS;
+    long i;
+    //------------------------
+
+    pthread_mutex_lock(&job->Lock);
+    while (!job->Stop && job->Delivered != chunk->Sequence)
+        pthread_cond_wait(&job->Turn, &job->Lock);
+    pthread_mutex_unlock(&job->Lock);
+
+    for (i = 0; i < count; i++) {
+
+        if (rc != SUCCESS || __atomic_load_n(&job->Stop, __ATOMIC_RELAXED)) {
+            JSON_FreeObject(records[i]);
+            continue;
+        }
+
+        if (!records[i])
+            rc = ctx->Errno;
+        else if (job->Callback(job->UserData, records[i]) != 0)
+            rc = ERROR_STOPPED;
+
+        JSON_FreeObject(records[i]);
+    }
+
+    pthread_mutex_lock(&job->Lock);
+    if (rc != SUCCESS)
+        stopNdjsonJob(job, rc);
+    job->Delivered++;
+    pthread_cond_broadcast(&job->Turn);
+    pthread_mutex_unlock(&job->Lock);
+}
+
+
+static void *ndjsonWorker(void *arg)
+{
+    //-----------------------------
+    NDJSON_JOB *job = (NDJSON_JOB *)arg;
+    NDJSON_CHUNK chunk;
+    JSON_OBJECT_HANDLE *records = NULL;
+    JSON_CONTEXT ctx;
+    JSON_ERROR rc;
+    long count;
+    //-----------------------------
+
+    JSON_InitContext(&ctx);
+
+    while (1) {
+
+        pthread_mutex_lock(&job->Lock);
+        if (job->Stop) {
+            pthread_mutex_unlock(&job->Lock);
+            break;
+        }
+        rc = readNdjsonChunk(&job->Reader, &chunk);
+        if (rc != SUCCESS)
+            stopNdjsonJob(job, rc);
+        pthread_mutex_unlock(&job->Lock);
+
+        if (!chunk.Text)
+            break;
+
+        if (job->Order == ORDER_INPUT) {
+            count = forEachNdjsonLine(job, &chunk, &ctx, &records);
+            deliverNdjsonChunk(job, &chunk, &ctx, records, count);
+        }
+        else {
+            forEachNdjsonLine(job, &chunk, &ctx, NULL);
+        }
+
+        free(chunk.Text);
+    }
+
+    free(records);
+
+    return NULL;
+}
+
+
+JSON_ERROR JSON_NdjsonForEach(FILE *file, JSON_RECORD_CALLBACK callback,
+                              void *user_data, int threads,
+                              JSON_RECORD_ORDER order)
+{
+    //-----------------------------
+    NDJSON_JOB job;
+    //-----------------------------
+
+    default_context.Errno = SUCCESS;
+
+    if (!file || !callback) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return default_context.Errno;
+    }
+
+    initNdjsonReader(&job.Reader, file);
+    job.Callback = callback;
+    job.UserData = user_data;
+    job.Order = order;
+    job.Delivered = 0;
+    job.Stop = 0;
+    job.Error = SUCCESS;
+    pthread_mutex_init(&job.Lock, NULL);
+    pthread_cond_init(&job.Turn, NULL);
+
+    if (runWorkers(getThreadCount(threads, SIZE_MAX), ndjsonWorker, &job) != 0)
+        job.Error = ERROR_ALLOC_FAILED;
+
+    pthread_cond_destroy(&job.Turn);
+    pthread_mutex_destroy(&job.Lock);
+    releaseNdjsonReader(&job.Reader);
+
+    default_context.Errno = job.Error;
+
+    return job.Error;
+}
+
+
+#endif
+
+
+//---------------------------------------------------------------------------
+//
+//  Number formatting.
+//
+//  Doubles are written with the fewest digits that still read back as
+//  the same double, found with the Schubfach algorithm: the interval of
+//  decimals that round to the double is scaled by a 128 bit power of
+//  ten from the parser's table, and the shortest decimal inside it is
+//  picked. Whole doubles keep a ".0" so they read back as doubles and
+//  not as integers. NaN and infinity have no JSON form, so stringifying
+//  them fails with ERROR_INVALID_NUMBER.
+//
+//---------------------------------------------------------------------------
+#define NUMBER_TEXT_SIZE 32
+
+
+static const char digit_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+static char *formatUint64(uint64_t value, char *out)
+{
+    //-----------------------------
+    char buffer[20];
+    char *cursor = buffer + sizeof(buffer);
+    size_t length;
+    //-----------------------------
+
+    while (value >= 100) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + (value % 100) * 2, 2);
+        value /= 100;
+    }
+
+    if (value >= 10) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + value * 2, 2);
+    }
+    else {
+        *--cursor = (char)('0' + value);
+    }
+
+    length = buffer + sizeof(buffer) - cursor;
+    memcpy(out, cursor, length);
+
+    return out + length;
+}
+
+
+static char *formatInt64(int64_t value, char *out)
+{
+    if (value < 0) {
+        *out++ = '-';
+        return formatUint64(0 - (uint64_t)value, out);
+    }
+
+    return formatUint64((uint64_t)value, out);
+}
+
+
+static inline uint64_t roundToOdd(uint64_t hi, uint64_t lo, uint64_t cp)
+{
+    //-----------------------------
+    unsigned __int128 x;
+    unsigned __int128 y;
+    //-----------------------------
+
+    x = (unsigned __int128)cp * lo;
+    y = (unsigned __int128)cp * hi + (uint64_t)(x >> 64);
+
+    return (uint64_t)(y >> 64) | ((uint64_t)y > 1);
+}
+
+
+//
+//  Finds the shortest decimal, digits * 10^exponent, that reads back as
+//  the finite, non-zero double with the given bits.
+//
+static void shortestDecimal(uint64_t bits, uint64_t *digits, int *exponent)
+{
+    //-----------------------------
+    uint64_t sig_raw = bits & ((1ULL << 52) - 1);
+    int exp_raw = (int)((bits >> 52) & 0x7FF);
+    uint64_t sig;
+    int exp_bin;
+    int regular;
+    int even;
+    int k;
+    int h;
+    uint64_t hi;
+    uint64_t lo;
+    uint64_t cb;
+    uint64_t vb;
+    uint64_t vbl;
+    uint64_t vbr;
+    uint64_t lower;
+    uint64_t upper;
+    uint64_t s;
+    uint64_t sp;
+    uint64_t mid;
+    int u_inside;
+    int w_inside;
+    //-----------------------------
+
+    if (exp_raw == 0) {
+        sig = sig_raw;
+        exp_bin = 1 - 1075;
+    }
+    else {
+        sig = sig_raw | (1ULL << 52);
+        exp_bin = exp_raw - 1075;
+    }
+
+    even = !(sig & 1);
+
+    //  Powers of two have a closer neighbour below than above.
+    regular = (sig_raw != 0 || exp_raw <= 1);
+
+    cb = 4 * sig;
+
+    //  k = floor(log10(2^exp_bin)), or floor(log10(3/4 * 2^exp_bin)).
+    k = (exp_bin * 315653 - (regular ? 0 : 131237)) >> 20;
+    h = exp_bin + (((-k) * 217707) >> 16) + 1;
+
+    hi = power_of_five_128[-k - POWER_OF_FIVE_MIN][0];
+    lo = power_of_five_128[-k - POWER_OF_FIVE_MIN][1];
+
+    //  The algorithm needs 10^-k rounded up.
+    if (-k < -27 || -k > 55) {
+        lo++;
+        if (lo == 0)
+            hi++;
+    }
+
+    vbl = roundToOdd(hi, lo, (cb - 2 + !regular) << h);
+    vb = roundToOdd(hi, lo, cb << h);
+    vbr = roundToOdd(hi, lo, (cb + 2) << h);
+
+    lower = vbl + !even;
+    upper = vbr - !even;
+
+    s = vb / 4;
+
+    if (s >= 10) {
+        sp = s / 10;
+        u_inside = (lower <= 40 * sp);
+        w_inside = (upper >= 40 * sp + 40);
+        if (u_inside != w_inside) {
+            *digits = sp + w_inside;
+            *exponent = k + 1;
+            return;
+        }
+    }
+
+    u_inside = (lower <= 4 * s);
+    w_inside = (upper >= 4 * s + 4);
+
+    if (u_inside != w_inside) {
+        *digits = s + w_inside;
+    }
+    else {
+        mid = 4 * s + 2;
+        *digits = s + ((vb > mid) || (vb == mid && (s & 1)));
+    }
+
+    *exponent = k;
+}
+
+
+//
+//  Writes value to out, which must hold NUMBER_TEXT_SIZE bytes, and
+//  returns the end of the text. The text is not terminated. JSON has no
+//  text for infinities and NaN, so value must be finite.
+//
+static char *formatDouble(double value, char *out)
+{
+    //-----------------------------
+    uint64_t bits;
+    uint64_t digits;
+    int exponent;
+    char text[20];
+    int length;
+    int point;
+    int i;
+    //-----------------------------
+
+    memcpy(&bits, &value, sizeof(double));
+
+    if (bits >> 63)
+        *out++ = '-';
+
+    if ((bits << 1) == 0) {
+        memcpy(out, "0.0", 3);
+        return out + 3;
+    }
+
+    shortestDecimal(bits, &digits, &exponent);
+
+    while (digits % 10 == 0) {
+        digits /= 10;
+        exponent++;
+    }
+
+    length = (int)(formatUint64(digits, text) - text);
+
+    //  Where the decimal point goes, counted from the first digit.
+    point = length + exponent;
+
+    if (point > 0 && point <= 21) {
+        if (exponent >= 0) {
+            memcpy(out, text, length);
+            out += length;
+            for (i = 0; i < exponent; i++)
+                *out++ = '0';
+            *out++ = '.';
+            *out++ = '0';
+        }
+        else {
+            memcpy(out, text, point);
+            out += point;
+            *out++ = '.';
+            memcpy(out, text + point, length - point);
+            out += length - point;
+        }
+    }
+    else if (point > -6 && point <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (i = point; i < 0; i++)
+            *out++ = '0';
+        memcpy(out, text, length);
+        out += length;
+    }
+    else {
+        *out++ = text[0];
+        if (length > 1) {
+            *out++ = '.';
+            memcpy(out, text + 1, length - 1);
+            out += length - 1;
+        }
+        *out++ = 'e';
+        out = formatInt64(point - 1, out);
+    }
+
+    return out;
+}
+
+
+//
+//  Returns the escape sequence that stands for c inside a JSON string,
+//  or NULL if c can be written as is. Strings are kept unescaped in
+//  memory, so every writer has to put the escapes back.
+//
+static const char *escapeSequence(unsigned char c, char *scratch)
+{
+    switch (c) {
+        case '"':  return "\\\"";
+        case '\\': return "\\\\";
+        case '\b': return "\\b";
+        case '\f': return "\\f";
+        case '\n': return "\\n";
+        case '\r': return "\\r";
+        case '\t': return "\\t";
+        default:
+            break;
+    }
+
+    if (c < 0x20) {
+        sprintf(scratch, "\\u%04x", c);
+        return scratch;
+    }
+
+    return NULL;
+}
+
+
+#define SPACES_PER_INDENTATION 4
+
+
+#ifdef JSON_DBG_PRINT
+
+
+static void printIndent(int indent_level)
+{
+    printf("%*s", indent_level * SPACES_PER_INDENTATION, "");
+}
+
+
+static void dbgPrintType(JSON_TYPE type)
+{
+    printf("Value Type: ");
+    switch(type) {
+        case TYPE_UNKNOWN: printf("TYPE_UNKNOWN\n"); break;
+        case TYPE_OBJECT: printf("TYPE_OBJECT\n"); break;
+        case TYPE_STRING: printf("TYPE_STRING\n"); break;
+        case TYPE_BOOLEAN: printf("TYPE_BOOLEAN\n"); break;
+        case TYPE_ARRAY: printf("TYPE_ARRAY\n"); break;
+        case TYPE_NUMBER: printf("TYPE_NUMBER\n"); break;
+        case TYPE_INTEGER: printf("TYPE_INTEGER\n"); break;
+        default:
+            if (type == TYPE_LAZY_OBJECT)
+                printf("TYPE_OBJECT, not parsed yet\n");
+            else if (type == TYPE_LAZY_ARRAY)
+                printf("TYPE_ARRAY, not parsed yet\n");
+            else
+                printf("Invalid!!!\n");
+            break;
+    }
+}
+#endif
+
+
+#define SMART_BUFFER_SIGNATURE 0x53627566
+
+
+//
+//  All output is built up here. Every write checks for room first.
+//  Without a sink, the buffer at least doubles whenever it grows, so
+//  the total cost of the copies stays linear in the output size. With
+//  a sink, the buffer has a fixed size and is flushed to the sink
+//  whenever it runs out of room.
+//
+#define SMART_BUFFER_INITIAL_SIZE 1024
+#define SINK_BUFFER_SIZE (64 * 1024)
+
+
+typedef struct _SMART_BUFFER {
+
+    int Signature;
+    char *buffer;
+    size_t buffer_length;
+    size_t length_used;
+    JSON_SINK *Sink;
+    JSON_WRITE_MODE Mode;
+    int IndentLevel;
+    JSON_CONTEXT *Context;
+    jmp_buf JmpBuffer;
+
+}SMART_BUFFER;
+
+
+static void writeError(SMART_BUFFER *sb, JSON_ERROR error)
+{
+    sb->Context->Errno = error;
+    longjmp(sb->JmpBuffer, 1);
+}
+
+
+static int writeSink(JSON_SINK *sink, const char *data, size_t length)
+{
+    //----------------------
+    ssize_t written;
+    //----------------------
+
+    switch (sink->Type) {
+
+        case SINK_CALLBACK:
+            return sink->Write(sink->UserData, data, length);
+
+        case SINK_FILE:
+            if (fwrite(data, 1, length, sink->File) != length)
+                return -1;
+            return 0;
+
+        case SINK_FD:
+            while (length > 0) {
+                written = write(sink->Fd, data, length);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    return -1;
+                }
+                data += written;
+                length -= written;
+            }
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+
+static void flushBuffer(SMART_BUFFER *sb)
+{
+    if (sb->length_used == 0)
+        return;
+
+    if (writeSink(sb->Sink, sb->buffer, sb->length_used) != 0)
+        writeError(sb, ERROR_WRITE_FAILED);
+
+    sb->length_used = 0;
+}
+
+
+static void growBuffer(SMART_BUFFER *sb, size_t size)
+{
+    //----------------------
+    char *new_buffer;
+    size_t new_length;
+    //----------------------
+
+    //  Longer runs are written in pieces, so no reservation should come
+    //  near the size of a sink's buffer.
+    if (sb->Sink) {
+        flushBuffer(sb);
+        if (sb->buffer_length <= size)
+            writeError(sb, ERROR_WRITE_FAILED);
+        return;
+    }
+
+    new_length = sb->buffer_length ? sb->buffer_length * 2
+                                   : SMART_BUFFER_INITIAL_SIZE;
+
+    //  One more byte for the terminating zero.
+    while (new_length - sb->length_used <= size) {
+        if (new_length > SIZE_MAX / 2)
+            writeError(sb, ERROR_ALLOC_FAILED);
+        new_length *= 2;
+    }
+
+    new_buffer = (char*) realloc(sb->buffer, new_length);
+    if (!new_buffer)
+        writeError(sb, ERROR_ALLOC_FAILED);
+
+    sb->buffer_length = new_length;
+    sb->buffer = new_buffer;
+}
+
+
+//
+//  Makes sure size more bytes and a terminating zero fit.
+//
+static inline void reserveBuffer(SMART_BUFFER *sb, size_t size)
+{
+    if (sb->buffer_length - sb->length_used <= size)
+        growBuffer(sb, size);
+}
+
+
+static inline void writeBuffer(SMART_BUFFER *sb, const char *data,
+                               size_t length)
+{
+    reserveBuffer(sb, length);
+    memcpy(sb->buffer + sb->length_used, data, length);
+    sb->length_used += length;
+}
+
+
+static inline void writeChar(SMART_BUFFER *sb, char c)
+{
+    reserveBuffer(sb, 1);
+    sb->buffer[sb->length_used++] = c;
+}
+
+
+//
+//  Starts a new line at the current indentation, in pretty mode only.
+//  Deep documents indent further than a sink's buffer holds, so the
+//  spaces go in as many pieces as the free space takes.
+//
+static void writeIndentedLine(SMART_BUFFER *sb)
+{
+    //--------------------------
+    size_t spaces;
+    size_t piece;
+    //--------------------------
+
+    spaces = (size_t)sb->IndentLevel * SPACES_PER_INDENTATION;
+
+    writeChar(sb, '\n');
+
+    while (spaces) {
+        reserveBuffer(sb, 1);
+        piece = sb->buffer_length - sb->length_used - 1;
+        if (piece > spaces)
+            piece = spaces;
+        memset(sb->buffer + sb->length_used, ' ', piece);
+        sb->length_used += piece;
+        spaces -= piece;
+    }
+}
+
+
+static inline void writeNewLine(SMART_BUFFER *sb)
+{
+    if (sb->Mode == WRITE_PRETTY)
+        writeIndentedLine(sb);
+}
+
+
+static inline int needsEscape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+
+//
+//  Strings go out in chunks, each with room for all of it escaped, so
+//  even a fixed size sink buffer takes strings of any length.
+//
+#define STRING_CHUNK_SIZE 1024
+
+
+static void stringifyJsonString(const char *string, SMART_BUFFER *sb)
+{
+    //--------------------------
+    const char *escape;
+    char scratch[8];
+    char *out;
+    size_t length;
+    int i;
+    //--------------------------
+
+    writeChar(sb, '"');
+
+    while (*string) {
+
+        reserveBuffer(sb, STRING_CHUNK_SIZE * 6 + 1);
+        out = sb->buffer + sb->length_used;
+
+        for (i = 0; i < STRING_CHUNK_SIZE && *string; i++, string++) {
+
+            if (!needsEscape((unsigned char)*string)) {
+                *out++ = *string;
+                continue;
+            }
+
+            escape = escapeSequence((unsigned char)*string, scratch);
+            length = strlen(escape);
+            memcpy(out, escape, length);
+            out += length;
+        }
+
+        sb->length_used = out - sb->buffer;
+    }
+
+    writeChar(sb, '"');
+}
+
+
+// Forward dec'l
+static void stringifyJsonObject(JSON_MEMBER *member, SMART_BUFFER *sb);
+static void stringifyJsonValue(JSON_VALUE *value, SMART_BUFFER *sb);
+
+
+static void stringifyJsonArray(JSON_ARRAY *array, SMART_BUFFER *sb)
+{
+    //--------------------------
+    size_t i;
+    //--------------------------
+
+    ASSERT_SIGNATURE(array, JSON_ARRAY_SIGNATURE);
+
+    if (array->Count == 0) {
+        writeBuffer(sb, "[]", 2);
+        return;
+    }
+
+    writeChar(sb, '[');
+    sb->IndentLevel++;
+
+    for (i = 0; i < array->Count; i++) {
+        if (i)
+            writeChar(sb, ',');
+        writeNewLine(sb);
+        stringifyJsonValue(&array->Values[i], sb);
+    }
+
+    sb->IndentLevel--;
+    writeNewLine(sb);
+    writeChar(sb, ']');
+}
+
+
+static void stringifyJsonValue(JSON_VALUE *value, SMART_BUFFER *sb)
+{
+    //--------------------------
+    char *end;
+    JSON_ERROR rc;
+    //--------------------------
+
+    ASSERT_SIGNATURE(value, JSON_VALUE_SIGNATURE);
+    ASSERT_SIGNATURE(sb, SMART_BUFFER_SIGNATURE);
+
+    //  Lazy containers are parsed to be written.
+    if (isLazyValue(value)) {
+        rc = loadLazyValue(value);
+        if (rc != SUCCESS)
+            writeError(sb, rc);
+    }
+
+    switch (value->Type) {
+
+        case TYPE_OBJECT:
+            stringifyJsonObject(value->Object, sb);
+            break;
+
+        case TYPE_ARRAY:
+            stringifyJsonArray(value->Array, sb);
+            break;
+
+        case TYPE_STRING:
+            stringifyJsonString(value->String, sb);
+            break;
+
+        case TYPE_BOOLEAN:
+            if (value->Boolean)
+                writeBuffer(sb, "true", 4);
+            else
+                writeBuffer(sb, "false", 5);
+            break;
+
+        case TYPE_NUMBER:
+            //  Such numbers can only have been added by the caller.
+            if (!isfinite(value->Number))
+                writeError(sb, ERROR_INVALID_NUMBER);
+            reserveBuffer(sb, NUMBER_TEXT_SIZE);
+            end = formatDouble(value->Number, sb->buffer + sb->length_used);
+            sb->length_used = end - sb->buffer;
+            break;
+
+        case TYPE_INTEGER:
+            reserveBuffer(sb, NUMBER_TEXT_SIZE);
+            end = formatInt64(value->Integer, sb->buffer + sb->length_used);
+            sb->length_used = end - sb->buffer;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void stringifyJsonMember(JSON_MEMBER *member, SMART_BUFFER *sb)
+{
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+    ASSERT_SIGNATURE(sb, SMART_BUFFER_SIGNATURE);
+
+    stringifyJsonString(member->Name, sb);
+    writeChar(sb, ':');
+    stringifyJsonValue(member->Value, sb);
+}
+
+
+static void stringifyJsonObject(JSON_MEMBER *member, SMART_BUFFER *sb)
+{
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    //  An empty object is a single member without a name.
+    if (!member->Name && !member->Next) {
+        writeBuffer(sb, "{}", 2);
+        return;
+    }
+
+    writeChar(sb, '{');
+    sb->IndentLevel++;
+
+    while (member) {
+        writeNewLine(sb);
+        stringifyJsonMember(member, sb);
+        member = member->Next;
+        if (member)
+            writeChar(sb, ',');
+    }
+
+    sb->IndentLevel--;
+    writeNewLine(sb);
+    writeChar(sb, '}');
+}
+
+
+//
+//  Kept apart from the public functions so nothing they use after the
+//  setjmp() can be clobbered by the longjmp(). Returns 0 on success.
+//
+static int stringifyRoot(JSON_MEMBER *member, SMART_BUFFER *sb)
+{
+    if (setjmp(sb->JmpBuffer) != 0) {
+        return -1;
+    }
+
+    stringifyJsonObject(member, sb);
+
+    if (sb->Sink) {
+        flushBuffer(sb);
+    }
+    else {
+        //  Every write leaves room for this.
+        sb->buffer[sb->length_used] = 0;
+    }
+
+    return 0;
+}
+
+
+char* JSON_StringifyCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object)
+{
+    //-------------------------------
+    SMART_BUFFER sb = {0};
+    JSON_MEMBER *member;
+    //-------------------------------
+
+    ctx->Errno = SUCCESS;
+    member = getJsonMember(object, NULL);
+
+    sb.Signature = SMART_BUFFER_SIGNATURE;
+    sb.Mode = WRITE_COMPACT;
+    sb.Context = ctx;
+
+    if (!member) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    if (stringifyRoot(member, &sb) != 0) {
+        free(sb.buffer);
+        return NULL;
+    }
+
+    return sb.buffer;
+}
+
+
+char* JSON_Stringify(JSON_OBJECT_HANDLE object)
+{
+    return JSON_StringifyCtx(&default_context, object);
+}
+
+
+void JSON_InitCallbackSink(JSON_SINK *sink, JSON_WRITE_CALLBACK write,
+                           void *user_data)
+{
+    memset(sink, 0, sizeof(JSON_SINK));
+    sink->Type = SINK_CALLBACK;
+    sink->Write = write;
+    sink->UserData = user_data;
+}
+
+
+void JSON_InitFileSink(JSON_SINK *sink, FILE *file)
+{
+    memset(sink, 0, sizeof(JSON_SINK));
+    sink->Type = SINK_FILE;
+    sink->File = file;
+}
+
+
+void JSON_InitFdSink(JSON_SINK *sink, int fd)
+{
+    memset(sink, 0, sizeof(JSON_SINK));
+    sink->Type = SINK_FD;
+    sink->Fd = fd;
+}
+
+
+JSON_ERROR JSON_WriteToCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                           JSON_SINK *sink, JSON_WRITE_MODE mode)
+{
+    //-------------------------------
+    SMART_BUFFER sb = {0};
+    JSON_MEMBER *member;
+    //-------------------------------
+
+    ctx->Errno = SUCCESS;
+    member = getJsonMember(object, NULL);
+
+    if (!member || !sink) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return ctx->Errno;
+    }
+
+    sb.Signature = SMART_BUFFER_SIGNATURE;
+    sb.Sink = sink;
+    sb.Mode = mode;
+    sb.Context = ctx;
+
+    sb.buffer = (char *)malloc(SINK_BUFFER_SIZE);
+    if (!sb.buffer) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return ctx->Errno;
+    }
+    sb.buffer_length = SINK_BUFFER_SIZE;
+
+    stringifyRoot(member, &sb);
+
+    free(sb.buffer);
+
+    return ctx->Errno;
+}
+
+
+JSON_ERROR JSON_WriteTo(JSON_OBJECT_HANDLE object, JSON_SINK *sink,
+                        JSON_WRITE_MODE mode)
+{
+    return JSON_WriteToCtx(&default_context, object, sink, mode);
+}
+
+
+#ifdef JSON_PRINT
+
+
+void JSON_Print(JSON_OBJECT_HANDLE object)
+{
+    //--------------------------
+    JSON_SINK sink;
+    //--------------------------
+
+    JSON_InitFileSink(&sink, stdout);
+
+    if (JSON_WriteTo(object, &sink, WRITE_PRETTY) == SUCCESS)
+        fputs("\n", stdout);
+}
+#endif
+
+
+// Forward declarations
+static void freeJsonValueContent(JSON_DOCUMENT *doc, JSON_VALUE *value);
+static void freeJsonMember(JSON_DOCUMENT *doc, JSON_MEMBER *member);
+
+
+//
+//  The document, if any, tells which strings are borrowed from the
+//  caller's buffer and must be left alone.
+//
+static void freeJsonString(JSON_DOCUMENT *doc, char *string)
+{
+    if (!isBorrowed(doc, string))
+        free(string);
+}
+
+
+static void freeJsonArray(JSON_DOCUMENT *doc, JSON_ARRAY *array)
+{
+    //-----------------------------
+    size_t i;
+    //-----------------------------
+
+    ASSERT(array != NULL);
+    ASSERT_SIGNATURE(array, JSON_ARRAY_SIGNATURE);
+
+    for (i = 0; i < array->Count; i++)
+        freeJsonValueContent(doc, &array->Values[i]);
+
+    array->Signature = 0;
+    free(array->Values);
+    free(array);
+}
+
+
+//
+//  Frees what a value points to, but not the value, which may be one of
+//  the elements of an array.
+//
+static void freeJsonValueContent(JSON_DOCUMENT *doc, JSON_VALUE *value)
+{
+    ASSERT(value != NULL);
+    ASSERT_SIGNATURE(value, JSON_VALUE_SIGNATURE);
+
+    switch (value->Type) {
+
+        //  A parse that failed half way can leave these empty.
+        case TYPE_OBJECT:
+            if (value->Object)
+                freeJsonObject(doc, value->Object);
+            break;
+
+        case TYPE_ARRAY:
+            if (value->Array)
+                freeJsonArray(doc, value->Array);
+            break;
+
+        case TYPE_STRING:
+            freeJsonString(doc, value->String);
+            break;
+
+        case TYPE_BOOLEAN:
+            break;
+
+        case TYPE_NUMBER:
+            break;
+
+        //  Including lazy containers, which only arena documents have.
+        default:
+            break;
+    }
+}
+
+
+static void freeJsonValue(JSON_DOCUMENT *doc, JSON_VALUE *value)
+{
+    freeJsonValueContent(doc, value);
+    free(value);
+}
+
+
+//
+//  The value in a node goes with the node.
+//
+static void freeMemberValue(JSON_DOCUMENT *doc, JSON_MEMBER *member)
+{
+    if (member->InNode && member->Value == &((JSON_NODE *)member)->Value)
+        freeJsonValueContent(doc, member->Value);
+    else
+        freeJsonValue(doc, member->Value);
+}
+
+
+static void freeJsonMember(JSON_DOCUMENT *doc, JSON_MEMBER *member)
+{
+    ASSERT(member != NULL);
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    if (member->Name) {
+        freeJsonString(doc, member->Name);
+        member->Name = NULL;
+    }
+
+    if (member->Value)
+        freeMemberValue(doc, member);
+
+    free(member);
+}
+
+
+static void freeJsonObject(JSON_DOCUMENT *doc, JSON_MEMBER *member)
+{
+    //------------------------
+    JSON_MEMBER *next_member;
+    //------------------------
+
+    ASSERT(member != NULL);
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    freeMemberIndexes(getMemberIndex(member));
+
+    while (member) {
+        next_member = member->Next;
+        freeJsonMember(doc, member);
+        member = next_member;
+    }
+}
+
+
+void JSON_FreeObject(JSON_OBJECT_HANDLE object)
+{
+    //-------------------------------
+    JSON_MEMBER *member;
+    JSON_DOCUMENT *doc;
+    //-------------------------------
+
+    default_context.Errno = SUCCESS;
+    member = getJsonMember(object, &doc);
+
+    if (!member) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return;
+    }
+
+    //  Documents know how their nodes and strings were allocated.
+    if (doc) {
+        freeJsonDocument(doc);
+        return;
+    }
+
+    freeJsonObject(NULL, member);
+}
+
+
+//---------------------------------------------------------------------------
+//
+//  Statistics of JSON_GetStats().
+//
+//  The tree is walked once, counting values and adding up the memory of
+//  every node, string and member index. Nodes of a whole arena document
+//  are not added up, since its chunks are counted as they are.
+//
+//---------------------------------------------------------------------------
+typedef struct _STATS_WALK {
+
+    JSON_STATS *Stats;
+    JSON_DOCUMENT *Document;
+    int CountNodes;
+
+} STATS_WALK;
+
+
+static void statsBlock(STATS_WALK *w, size_t size)
+{
+    if (!w->CountNodes)
+        return;
+
+    if (usesArena(w->Document)) {
+        w->Stats->BytesHeld += ARENA_ALIGN(size);
+    }
+    else {
+        w->Stats->BytesHeld += size;
+        w->Stats->Allocations++;
+    }
+}
+
+
+static size_t statsString(STATS_WALK *w, const char *string)
+{
+    //-----------------------------
+    size_t length;
+    //-----------------------------
+
+    length = strlen(string);
+
+    if (!isBorrowed(w->Document, string))
+        statsBlock(w, length + 1);
+
+    return length;
+}
+
+
+static void statsDepth(STATS_WALK *w, size_t depth)
+{
+    if (depth > w->Stats->MaxDepth)
+        w->Stats->MaxDepth = depth;
+}
+
+
+// Forward declarations
+static void statsJsonObject(STATS_WALK *w, JSON_MEMBER *member, size_t depth);
+static void statsJsonArray(STATS_WALK *w, JSON_ARRAY *array, size_t depth);
+
+
+//
+//  Depth is that of the object or array holding the value.
+//
+static void statsJsonValue(STATS_WALK *w, JSON_VALUE *value, size_t depth)
+{
+    if (isLazyValue(value)) {
+        if (value->Type == TYPE_LAZY_OBJECT)
+            w->Stats->Objects++;
+        else
+            w->Stats->Arrays++;
+        statsDepth(w, depth + 1);
+        statsBlock(w, sizeof(LAZY_SPAN));
+        return;
+    }
+
+    switch (value->Type) {
+
+        case TYPE_OBJECT:
+            statsJsonObject(w, value->Object, depth + 1);
+            break;
+
+        case TYPE_ARRAY:
+            statsJsonArray(w, value->Array, depth + 1);
+            break;
+
+        case TYPE_STRING:
+            w->Stats->Strings++;
+            w->Stats->StringBytes += statsString(w, value->String);
+            break;
+
+        case TYPE_NUMBER:
+            w->Stats->Numbers++;
+            break;
+
+        case TYPE_INTEGER:
+            w->Stats->Integers++;
+            break;
+
+        case TYPE_BOOLEAN:
+            w->Stats->Booleans++;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void statsJsonArray(STATS_WALK *w, JSON_ARRAY *array, size_t depth)
+{
+    //-----------------------------
+    size_t i;
+    //-----------------------------
+
+    w->Stats->Arrays++;
+    statsDepth(w, depth);
+
+    statsBlock(w, sizeof(JSON_ARRAY));
+    if (array->Capacity)
+        statsBlock(w, array->Capacity * sizeof(JSON_VALUE));
+
+    for (i = 0; i < array->Count; i++)
+        statsJsonValue(w, &array->Values[i], depth);
+}
+
+
+static void statsJsonObject(STATS_WALK *w, JSON_MEMBER *member, size_t depth)
+{
+    //-----------------------------
+    MEMBER_INDEX *index;
+    //-----------------------------
+
+    w->Stats->Objects++;
+    statsDepth(w, depth);
+
+    //  Indexes are always on the heap, even in arena documents.
+    index = getMemberIndex(member);
+    if (index) {
+        w->Stats->BytesHeld += sizeof(MEMBER_INDEX) +
+                               (index->Mask + 1) * sizeof(INDEX_SLOT);
+        w->Stats->Allocations += 2;
+    }
+
+    for (; member; member = member->Next) {
+
+        if (member->InNode) {
+            statsBlock(w, sizeof(JSON_NODE));
+            if (member->Value && member->Value != &((JSON_NODE *)member)->Value)
+                statsBlock(w, sizeof(JSON_VALUE));
+        }
+        else {
+            statsBlock(w, sizeof(JSON_MEMBER));
+            if (member->Value)
+                statsBlock(w, sizeof(JSON_VALUE));
+        }
+
+        if (member->Name) {
+            w->Stats->Members++;
+            w->Stats->NameBytes += statsString(w, member->Name);
+        }
+
+        if (member->Value)
+            statsJsonValue(w, member->Value, depth);
+    }
+}
+
+
+//
+//  Objects inside a document only know it if it has an arena, through
+//  their first member.
+//
+static JSON_DOCUMENT *getOwnerDocument(JSON_MEMBER *head)
+{
+    //-----------------------------
+    JSON_DOCUMENT *doc;
+    MEMBER_INDEX *index;
+    //-----------------------------
+
+    index = getMemberIndex(head);
+    if (index)
+        return index->Owner;
+
+    doc = __atomic_load_n((JSON_DOCUMENT **)&head->Index, __ATOMIC_ACQUIRE);
+    if (doc && doc->Signature == JSON_DOCUMENT_SIGNATURE)
+        return doc;
+
+    return NULL;
+}
+
+
+//
+//  What the document holds besides its nodes.
+//
+static void statsJsonDocument(JSON_DOCUMENT *doc, JSON_STATS *stats)
+{
+    //-----------------------------
+    JSON_ARENA *chunk;
+    //-----------------------------
+
+    if (doc->Arena) {
+        //  The header is in the first chunk.
+        for (chunk = doc->Arena; chunk; chunk = chunk->Next) {
+            stats->BytesHeld += ARENA_ALIGN(sizeof(JSON_ARENA)) + chunk->Size;
+            stats->Allocations++;
+        }
+    }
+    else {
+        stats->BytesHeld += sizeof(JSON_DOCUMENT);
+        stats->Allocations++;
+    }
+
+    if (doc->Lazy) {
+        stats->BytesHeld += doc->Lazy->Capacity * sizeof(uint32_t);
+        stats->Allocations++;
+    }
+
+    if (doc->Keys) {
+        stats->BytesHeld += sizeof(KEY_TABLE) +
+                            (doc->Keys->Mask + 1) * sizeof(KEY_SLOT);
+        stats->Allocations += 2;
+    }
+
+    if (doc->Mapped)
+        stats->BytesHeld += doc->BufferLength;
+
+#ifdef JSON_STATS_COUNTERS
+    stats->ParseNanoseconds = __atomic_load_n(&doc->ParseNanoseconds,
+                                              __ATOMIC_RELAXED);
+    stats->Lookups = __atomic_load_n(&doc->Lookups, __ATOMIC_RELAXED);
+#endif
+}
+
+
+JSON_ERROR JSON_GetStatsCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                            JSON_STATS *stats)
+{
+    //-------------------------------
+    STATS_WALK w;
+    JSON_MEMBER *member;
+    JSON_DOCUMENT *doc;
+    //-------------------------------
+
+    ctx->Errno = SUCCESS;
+    member = getJsonMember(object, &doc);
+
+    if (!member || !stats) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return ctx->Errno;
+    }
+
+    memset(stats, 0, sizeof(JSON_STATS));
+
+    w.Stats = stats;
+    w.Document = doc ? doc : getOwnerDocument(member);
+    w.CountNodes = !(doc && doc->Arena);
+
+    statsJsonObject(&w, member, 1);
+
+    if (doc)
+        statsJsonDocument(doc, stats);
+
+    return SUCCESS;
+}
+
+
+JSON_ERROR JSON_GetStats(JSON_OBJECT_HANDLE object, JSON_STATS *stats)
+{
+    return JSON_GetStatsCtx(&default_context, object, stats);
+}
+
+
+static uint32_t hashName(const char *name, uint32_t *length)
+{
+    *length = (uint32_t)strlen(name);
+
+    return hashBytes(name, *length);
+}
+
+
+static MEMBER_INDEX *getMemberIndex(JSON_MEMBER *head)
+{
+    //-----------------------------
+    MEMBER_INDEX *index;
+    //-----------------------------
+
+    index = __atomic_load_n((MEMBER_INDEX **)&head->Index, __ATOMIC_ACQUIRE);
+
+    if (index && index->Signature == MEMBER_INDEX_SIGNATURE)
+        return index;
+
+    return NULL;
+}
+
+
+//
+//  Returns the slot holding name, or the empty slot where it would go.
+//
+static INDEX_SLOT *findIndexSlot(MEMBER_INDEX *index, const char *name,
+                                 uint32_t hash, uint32_t length)
+{
+    //-----------------------------
+    INDEX_SLOT *slot;
+    size_t i;
+    //-----------------------------
+
+    for (i = hash & index->Mask; ; i = (i + 1) & index->Mask) {
+        slot = &index->Slots[i];
+        if (!slot->Member)
+            return slot;
+        if (slot->Hash == hash && slot->Length == length &&
+            (slot->Member->Name == name ||
+             memcmp(slot->Member->Name, name, length) == 0))
+            return slot;
+    }
+}
+
+
+//
+//  Only the first member of a name goes in, like a scan would find it.
+//
+static void insertIndexSlot(MEMBER_INDEX *index, JSON_MEMBER *member)
+{
+    //-----------------------------
+    INDEX_SLOT *slot;
+    uint32_t hash;
+    uint32_t length;
+    //-----------------------------
+
+    hash = hashName(member->Name, &length);
+    slot = findIndexSlot(index, member->Name, hash, length);
+
+    if (!slot->Member) {
+        slot->Member = member;
+        slot->Hash = hash;
+        slot->Length = length;
+        index->Count++;
+    }
+}
+
+
+//
+//  Keeps the table at most half full. Returns -1 if it could not grow.
+//
+static int growMemberIndex(MEMBER_INDEX *index, size_t count)
+{
+    //-----------------------------
+    INDEX_SLOT *old_slots;
+    INDEX_SLOT *new_slots;
+    size_t old_size;
+    size_t new_size;
+    size_t i;
+    //-----------------------------
+
+    old_slots = index->Slots;
+    old_size = old_slots ? index->Mask + 1 : 0;
+
+    if (count * 2 <= old_size)
+        return 0;
+
+    new_size = 64;
+    while (new_size < count * 2)
+        new_size *= 2;
+
+    new_slots = (INDEX_SLOT *)calloc(new_size, sizeof(INDEX_SLOT));
+    if (!new_slots)
+        return -1;
+
+    index->Slots = new_slots;
+    index->Mask = new_size - 1;
+    index->Count = 0;
+
+    for (i = 0; i < old_size; i++) {
+        if (old_slots[i].Member)
+            insertIndexSlot(index, old_slots[i].Member);
+    }
+
+    free(old_slots);
+
+    return 0;
+}
+
+
+static void freeMemberIndexes(MEMBER_INDEX *index)
+{
+    //-----------------------------
+    MEMBER_INDEX *next;
+    //-----------------------------
+
+    while (index) {
+        next = index->Next;
+        index->Signature = 0;
+        free(index->Slots);
+        free(index);
+        index = next;
+    }
+}
+
+
+#ifdef JSON_INDEX_MIN_MEMBERS
+//
+//  Builds the index of an object and publishes it on its first member.
+//  Lookups may run in parallel on a shared object, so if another thread
+//  got there first its index is used and this one dropped.
+//
+static MEMBER_INDEX *buildMemberIndex(JSON_MEMBER *head)
+{
+    //-----------------------------
+    MEMBER_INDEX *index;
+    void *owner;
+    JSON_DOCUMENT *doc = NULL;
+    JSON_MEMBER *member;
+    size_t count = 0;
+    //-----------------------------
+
+    for (member = head; member; member = member->Next)
+        count++;
+
+    index = (MEMBER_INDEX *)calloc(1, sizeof(MEMBER_INDEX));
+    if (!index)
+        return NULL;
+
+    index->Signature = MEMBER_INDEX_SIGNATURE;
+
+    if (growMemberIndex(index, count) != 0) {
+        free(index);
+        return NULL;
+    }
+
+    for (member = head; member; member = member->Next) {
+        if (member->Name)
+            insertIndexSlot(index, member);
+        index->Last = member;
+    }
+
+    owner = __atomic_load_n(&head->Index, __ATOMIC_ACQUIRE);
+
+    if (owner && ((JSON_DOCUMENT *)owner)->Signature == JSON_DOCUMENT_SIGNATURE)
+        doc = owner;
+    else if (owner)
+        owner = NULL;
+
+    index->Owner = doc;
+
+    if (!__atomic_compare_exchange_n(&head->Index, &owner, index, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        index->Next = NULL;
+        freeMemberIndexes(index);
+        return getMemberIndex(head);
+    }
+
+    if (doc) {
+        index->Next = __atomic_load_n(&doc->Indexes, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&doc->Indexes, &index->Next, index,
+                                            1, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+
+    return index;
+}
+#endif
+
+
+//
+//  Finds a member by its name, whose hash and length are already known.
+//
+static JSON_MEMBER *findJsonMemberHashed(JSON_MEMBER *member, const char *name,
+                                         uint32_t hash, uint32_t length)
+{
+    //-----------------------------
+    JSON_MEMBER *head = member;
+    MEMBER_INDEX *index;
+#ifdef JSON_INDEX_MIN_MEMBERS
+    size_t scanned = 0;
+#endif
+    //-----------------------------
+
+    ASSERT(member != NULL);
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    index = getMemberIndex(head);
+
+    while (!index && member) {
+        //  Names interned in the same table are the same string.
+        if (member->Name == name ||
+            (member->Name && strcmp(member->Name, name) == 0)){
+            return member;
+        }
+        member = member->Next;
+
+#ifdef JSON_INDEX_MIN_MEMBERS
+        if (++scanned == JSON_INDEX_MIN_MEMBERS && member)
+            index = buildMemberIndex(head);
+#endif
+    }
+
+    if (!index)
+        return NULL;
+
+    return findIndexSlot(index, name, hash, length)->Member;
+}
+
+
+static JSON_MEMBER *findJsonMemberInObject(JSON_MEMBER *member, char *name)
+{
+    //-----------------------------
+    uint32_t hash;
+    uint32_t length;
+    //-----------------------------
+
+    hash = hashName(name, &length);
+
+    return findJsonMemberHashed(member, name, hash, length);
+}
+
+
+static void addJsonMemberToObject(JSON_MEMBER *member, JSON_MEMBER *new_member)
+{
+    //-----------------------------
+    MEMBER_INDEX *index;
+    //-----------------------------
+
+    ASSERT(member != NULL);
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+    ASSERT(new_member != NULL);
+    ASSERT_SIGNATURE(new_member, JSON_MEMBER_SIGNATURE);
+
+    index = getMemberIndex(member);
+
+    if (index) {
+        index->Last->Next = new_member;
+        index->Last = new_member;
+
+        //  An index that cannot grow no longer covers every name, so the
+        //  object goes back to being scanned. Arena documents still list
+        //  it, and free it with the rest.
+        if (growMemberIndex(index, index->Count + 1) == 0) {
+            insertIndexSlot(index, new_member);
+        }
+        else {
+            member->Index = index->Owner;
+            index->Signature = 0;
+            if (!index->Owner)
+                freeMemberIndexes(index);
+        }
+        return;
+    }
+
+    while (1) {
+        if (!member->Next) {
+            member->Next = new_member;
+            return;
+        }
+        member = member->Next;
+    }
+}
+
+
+enum DOB_BRACKET_ORDER {
+    DOB_LAST_ELEMENT,
+    DOB_NEXT_IS_OBJECT,
+    DOB_NEXT_IS_NAMED_ARRAY,
+    DOB_NEXT_IS_NESTED_ARRAY,
+};
+
+
+typedef struct DotOrBracket_ {
+    char *Dot;
+    char *Bracket;
+    enum DOB_BRACKET_ORDER Order;
+    char *Path;
+    int ArrayIndex;
+}DotOrBracket;
+
+
+static int parseArrayIndex(DotOrBracket *dob)
+{
+    //-----------------
+    char *endptr;
+    long index;
+    //-----------------
+
+    errno = 0;
+
+    index = strtol(dob->Path, &endptr, 0);
+
+    if (*endptr != ']') {
+        return -1;
+    }
+    else {
+        endptr++;
+        dob->Path = endptr;
+    }
+
+    if (errno) {
+        return -1;
+    }
+
+    return (int)index;
+}
+
+
+static char *getNextDotOrBracket(DotOrBracket *dob)
+{
+    //------------------
+    char *name;
+    //------------------
+
+    dob->Bracket = strchr(dob->Path, '[');
+    dob->Dot = strchr(dob->Path, '.');
+
+    if (!dob->Dot && !dob->Bracket) {
+        dob->Order = DOB_LAST_ELEMENT;
+        name = dob->Path;
+    }
+    else if (!dob->Bracket) {
+        dob->Order = DOB_NEXT_IS_OBJECT;
+        name = dob->Path;
+        *(dob->Dot) = 0;
+        dob->Path = dob->Dot + 1;
+    }
+    else if (!dob->Dot) {
+        if (dob->Bracket == dob->Path) {
+            dob->Order = DOB_NEXT_IS_NESTED_ARRAY;
+            name = NULL;
+            *(dob->Bracket) = 0;
+            dob->Path = dob->Bracket + 1;
+            dob->ArrayIndex = parseArrayIndex(dob);
+        }
+        else {
+            dob->Order = DOB_NEXT_IS_NAMED_ARRAY;
+            name = dob->Path;
+            *(dob->Bracket) = 0;
+            dob->Path = dob->Bracket + 1;
+            dob->ArrayIndex = parseArrayIndex(dob);
+        }
+    }
+    else if (dob->Bracket > dob->Dot) {
+        dob->Order = DOB_NEXT_IS_OBJECT;
+        name = dob->Path;
+        *(dob->Dot) = 0;
+        dob->Path = dob->Dot + 1;
+    }
+    else {
+        if (dob->Bracket == dob->Path) {
+            dob->Order = DOB_NEXT_IS_NESTED_ARRAY;
+            name = NULL;
+            *(dob->Bracket) = 0;
+            dob->Path = dob->Bracket + 1;
+            dob->ArrayIndex = parseArrayIndex(dob);
+        }
+        else {
+            dob->Order = DOB_NEXT_IS_NAMED_ARRAY;
+            name = dob->Path;
+            *(dob->Bracket) = 0;
+            dob->Path = dob->Bracket + 1;
+            dob->ArrayIndex = parseArrayIndex(dob);
+        }
+    }
+
+    return name;
+}
+
+
+static JSON_VALUE *findJsonValueInArray(JSON_ARRAY *array, int index)
+{
+    ASSERT_SIGNATURE(array, JSON_ARRAY_SIGNATURE);
+
+    if (index < 0 || (size_t)index >= array->Count)
+        return NULL;
+
+    return &array->Values[index];
+}
+
+
+//
+//  Path strings are compiled once into the steps below, so lookups never
+//  copy or tokenize them again. Names point into the copy of the path
+//  that follows the steps in the same allocation, and keep their hash for
+//  indexed objects. A compiled path is never changed, so any number of
+//  threads can use it at once.
+//
+#define JSON_PATH_SIGNATURE 0x6874614A
+
+
+typedef struct _PATH_STEP {
+
+    enum DOB_BRACKET_ORDER Order;
+    char *Name;
+    uint32_t Hash;
+    uint32_t Length;
+    int ArrayIndex;
+
+} PATH_STEP;
+
+
+typedef struct _JSON_PATH {
+
+    int Signature;
+    int Count;
+    PATH_STEP Steps[];
+
+} JSON_PATH;
+
+
+static JSON_PATH *compilePath(char *path, JSON_ERROR *rc)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    PATH_STEP *step;
+    DotOrBracket dob;
+    size_t length;
+    size_t max_steps = 1;
+    char *c;
+    //------------------------
+
+    *rc = ERROR_INVALID_JSON_PATH;
+
+    if (!path)
+        return NULL;
+
+    //  Every step but the last uses up a dot or a bracket.
+    for (c = path; *c; c++) {
+        if (*c == '.' || *c == '[')
+            max_steps++;
+    }
+    length = c - path;
+
+    compiled = (JSON_PATH *)malloc(sizeof(JSON_PATH) +
+                                   max_steps * sizeof(PATH_STEP) + length + 1);
+    if (!compiled) {
+        *rc = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    compiled->Signature = JSON_PATH_SIGNATURE;
+    compiled->Count = 0;
+
+    dob.Path = (char *)&compiled->Steps[max_steps];
+    memcpy(dob.Path, path, length + 1);
+
+    while (1) {
+
+        step = &compiled->Steps[compiled->Count++];
+        step->Name = getNextDotOrBracket(&dob);
+        step->Order = dob.Order;
+        step->ArrayIndex = 0;
+
+        if (step->Name)
+            step->Hash = hashName(step->Name, &step->Length);
+
+        if (dob.Order == DOB_LAST_ELEMENT)
+            break;
+
+        if (dob.Order == DOB_NEXT_IS_NAMED_ARRAY ||
+            dob.Order == DOB_NEXT_IS_NESTED_ARRAY) {
+
+            if (dob.ArrayIndex < 0) {
+                free(compiled);
+                return NULL;
+            }
+            step->ArrayIndex = dob.ArrayIndex;
+
+            //  An index ends the path, or is followed by another index or
+            //  by a dot and a member of the element.
+            if (*dob.Path == '.')
+                dob.Path++;
+            if (*dob.Path == 0)
+                break;
+        }
+    }
+
+    *rc = SUCCESS;
+
+    return compiled;
+}
+
+
+static JSON_PATH *getJsonPath(JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_PATH *compiled = path;
+    //------------------------
+
+    if (compiled && compiled->Signature == JSON_PATH_SIGNATURE)
+        return compiled;
+
+    return NULL;
+}
+
+
+//
+//  Lazy containers are parsed on the way down. Errors found in them go
+//  to ctx.
+//
+static int loadPathValue(JSON_CONTEXT *ctx, JSON_VALUE *value)
+{
+    //------------------------
+    JSON_ERROR rc;
+    //------------------------
+
+    if (isLazyValue(value)) {
+        rc = loadLazyValue(value);
+        if (rc != SUCCESS) {
+            ctx->Errno = rc;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+//
+//  Member names are looked up in the current object and indices in the
+//  current array. Only one of the two is set at a time.
+//
+static JSON_VALUE *findJsonValue(JSON_CONTEXT *ctx, JSON_PATH *path,
+                                 JSON_MEMBER *member)
+{
+    //------------------------
+    JSON_VALUE *value = NULL;
+    JSON_ARRAY *array = NULL;
+    PATH_STEP *step;
+    int i;
+    //------------------------
+
+    for (i = 0; i < path->Count; i++) {
+
+        step = &path->Steps[i];
+
+        if (!member && step->Order != DOB_NEXT_IS_NESTED_ARRAY)
+            return NULL;
+
+        switch(step->Order) {
+
+            case DOB_LAST_ELEMENT:
+
+                member = findJsonMemberHashed(member, step->Name, step->Hash,
+                                              step->Length);
+                if (!member || !member->Value ||
+                    member->Value->Type == TYPE_OBJECT ||
+                    member->Value->Type == TYPE_LAZY_OBJECT) {
+                    return NULL;
+                }
+                return member->Value;
+
+            case DOB_NEXT_IS_OBJECT:
+
+                member = findJsonMemberHashed(member, step->Name, step->Hash,
+                                              step->Length);
+                if (!member || !member->Value ||
+                    loadPathValue(ctx, member->Value) != 0 ||
+                    member->Value->Type != TYPE_OBJECT) {
+                    return NULL;
+                }
+                member = member->Value->Object;
+                break;
+
+            case DOB_NEXT_IS_NAMED_ARRAY:
+
+                member = findJsonMemberHashed(member, step->Name, step->Hash,
+                                              step->Length);
+                if (!member || !member->Value ||
+                    loadPathValue(ctx, member->Value) != 0 ||
+                    member->Value->Type != TYPE_ARRAY) {
+                    return NULL;
+                }
+                array = member->Value->Array;
+
+                // Fall through - the element is found like a nested one.
+
+            case DOB_NEXT_IS_NESTED_ARRAY:
+
+                if (!array)
+                    return NULL;
+
+                value = findJsonValueInArray(array, step->ArrayIndex);
+                if (!value || loadPathValue(ctx, value) != 0)
+                    return NULL;
+
+                member = NULL;
+                array = NULL;
+
+                if (value->Type == TYPE_OBJECT)
+                    member = value->Object;
+                else if (value->Type == TYPE_ARRAY)
+                    array = value->Array;
+                else
+                    return value;   //  We have the value. We can leave.
+                break;
+        }
+    }
+
+    return value;
+}
+
+
+JSON_PATH_HANDLE JSON_CompilePathCtx(JSON_CONTEXT *ctx, char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    ctx->Errno = rc;
+
+    return compiled;
+}
+
+
+JSON_PATH_HANDLE JSON_CompilePath(char *path)
+{
+    return JSON_CompilePathCtx(&default_context, path);
+}
+
+
+//
+//  The names of the steps are swapped for their copies in the table, so
+//  members of interned documents are matched by pointer.
+//
+JSON_PATH_HANDLE JSON_CompilePathInternedCtx(JSON_CONTEXT *ctx, char *path,
+                                             JSON_KEYTABLE_HANDLE keys)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    KEY_TABLE *table;
+    PATH_STEP *step;
+    const char *name;
+    JSON_ERROR rc;
+    int i;
+    //------------------------
+
+    table = getKeyTable(keys);
+    if (!table) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    compiled = compilePath(path, &rc);
+    ctx->Errno = rc;
+
+    if (!compiled)
+        return NULL;
+
+    for (i = 0; i < compiled->Count; i++) {
+
+        step = &compiled->Steps[i];
+        if (!step->Name)
+            continue;
+
+        name = internKey(table, step->Name, step->Length);
+        if (!name) {
+            free(compiled);
+            ctx->Errno = ERROR_ALLOC_FAILED;
+            return NULL;
+        }
+        step->Name = (char *)name;
+    }
+
+    return compiled;
+}
+
+
+JSON_PATH_HANDLE JSON_CompilePathInterned(char *path, JSON_KEYTABLE_HANDLE keys)
+{
+    return JSON_CompilePathInternedCtx(&default_context, path, keys);
+}
+
+
+void JSON_FreePath(JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    //------------------------
+
+    compiled = getJsonPath(path);
+
+    if (compiled) {
+        compiled->Signature = 0;
+        free(compiled);
+    }
+}
+
+
+//---------------------------------------------------------------------------
+//
+//  Selective parsing for JSON_ParseSelect().
+//
+//  The paths are merged into a tree of member names. Stage 2 only builds
+//  the members on that tree. Every other value is skipped through the
+//  structural index, so nothing in it is allocated or decoded.
+//
+//---------------------------------------------------------------------------
+//
+//  Whole is set where a path ends, or goes on into an array, and the
+//  value of the member is then kept as it is. Names point into the
+//  compiled paths, which stay around for the parse.
+//
+typedef struct _SELECT_NODE {
+
+    const char *Name;
+    uint32_t Length;
+    int Whole;
+    struct _SELECT_NODE *Child;
+    struct _SELECT_NODE *Sibling;
+
+} SELECT_NODE;
+
+
+static SELECT_NODE *findSelectNode(SELECT_NODE *select, const char *name,
+                                   size_t length)
+{
+    //------------------------
+    SELECT_NODE *node;
+    //------------------------
+
+    for (node = select->Child; node; node = node->Sibling) {
+        if (node->Length == length && memcmp(node->Name, name, length) == 0)
+            return node;
+    }
+
+    return NULL;
+}
+
+
+//
+//  Adds the steps of a path below root, taking new nodes from *unused.
+//  Returns -1 if the path does not start with a member name.
+//
+static int addSelectPath(SELECT_NODE *root, JSON_PATH *path,
+                         SELECT_NODE **unused)
+{
+    //------------------------
+    SELECT_NODE *node = root;
+    SELECT_NODE *child;
+    PATH_STEP *step;
+    int i;
+    //------------------------
+
+    for (i = 0; i < path->Count; i++) {
+
+        step = &path->Steps[i];
+
+        if (!step->Name)
+            return -1;
+
+        //  A shorter path already keeps all of this.
+        if (node->Whole)
+            return 0;
+
+        child = findSelectNode(node, step->Name, step->Length);
+        if (!child) {
+            child = (*unused)++;
+            memset(child, 0, sizeof(SELECT_NODE));
+            child->Name = step->Name;
+            child->Length = step->Length;
+            child->Sibling = node->Child;
+            node->Child = child;
+        }
+
+        node = child;
+
+        if (step->Order != DOB_NEXT_IS_OBJECT) {
+            node->Whole = 1;
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+
+//
+//  Skips one value. Containers are walked over their structurals and
+//  strings over their two quotes, which stage 1 has already paired up.
+//
+static void skipJsonValue(PARSE_STATE *ps)
+{
+    //------------------------
+    char *token;
+    //------------------------
+
+    token = nextToken(ps, ERROR_INVALID_VALUE_TYPE);
+
+    switch (*token) {
+
+        case '{':
+        case '[':
+            skipJsonContainer(ps, *token);
+            break;
+
+        case '"':
+            nextToken(ps, ERROR_INVALID_STRING);
+            break;
+
+        case ',':
+        case ':':
+        case '}':
+        case ']':
+            parseError(ps, ERROR_INVALID_VALUE_TYPE);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+//
+//  Called with the { already consumed. Only selected members are linked,
+//  so *link stays NULL if there are none. Names are compared as they are
+//  in the text, unless they have escapes in them.
+//
+static void parseSelectObject(PARSE_STATE *ps, JSON_MEMBER **link,
+                              SELECT_NODE *select)
+{
+    //-----------------------------------------
+    JSON_MEMBER *member;
+    JSON_MEMBER *object;
+    SELECT_NODE *node;
+    char *token;
+    char *end;
+    char *name;
+    //-----------------------------------------
+
+    //  Nothing to select in an empty object.
+    if (nextTokenIs(ps, '}'))
+        return;
+
+    do {
+        token = nextToken(ps, ERROR_INVALID_OBJECT);
+        if (*token != '"') {
+            parseError(ps, ERROR_INVALID_OBJECT);
+        }
+
+        // Stage 1 guarantees the next position is the closing quote.
+        end = ps->Start + ps->Index.Positions[ps->Next];
+        name = NULL;
+
+        if (memchr(token + 1, '\\', end - token - 1)) {
+            name = parseJsonString(ps, token);
+            node = findSelectNode(select, name, strlen(name));
+        }
+        else {
+            node = findSelectNode(select, token + 1, end - token - 1);
+        }
+
+        if (node && !name)
+            name = parseJsonString(ps, token);
+        else if (!name)
+            ps->Next++;
+
+        token = nextToken(ps, ERROR_INVALID_OBJECT);
+        if (*token != ':') {
+            parseError(ps, ERROR_INVALID_OBJECT);
+        }
+
+        if (!node) {
+            skipJsonValue(ps);
+        }
+        else if (node->Whole) {
+            member = linkJsonMember(ps, link);
+            link = &member->Next;
+            member->Name = name;
+            parseJsonValueInto(ps, member->Value);
+        }
+        else if (ps->Next < ps->Index.Count &&
+                 ps->Start[ps->Index.Positions[ps->Next]] == '{') {
+            ps->Next++;
+            object = NULL;
+            parseSelectObject(ps, &object, node);
+
+            //  Objects with nothing selected in them are left out.
+            if (object) {
+                member = linkJsonMember(ps, link);
+                link = &member->Next;
+                member->Name = name;
+                member->Value->Type = TYPE_OBJECT;
+                member->Value->Object = object;
+            }
+        }
+        else {
+            //  Not an object, so the rest of the path cannot match.
+            skipJsonValue(ps);
+        }
+
+        token = nextToken(ps, ERROR_INVALID_OBJECT);
+
+        if (*token == '}') {
+            break;
+        }
+        else if (*token != ',') {
+            parseError(ps, ERROR_INVALID_OBJECT);
+        }
+
+    } while (1);
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseSelectCtx(JSON_CONTEXT *ctx, char *string,
+                                       char **paths, size_t n)
+{
+    //-----------------------
+    PARSE_STATE ps;
+    JSON_DOCUMENT *doc = NULL;
+    JSON_PATH **compiled;
+    SELECT_NODE *nodes = NULL;
+    SELECT_NODE *unused;
+    JSON_ERROR rc = SUCCESS;
+    size_t step_count = 0;
+    size_t i;
+    //-----------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!string) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    if (!paths && n) {
+        ctx->Errno = ERROR_INVALID_JSON_PATH;
+        return NULL;
+    }
+
+    compiled = (JSON_PATH **)calloc(n ? n : 1, sizeof(JSON_PATH *));
+    if (!compiled) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    for (i = 0; i < n && rc == SUCCESS; i++) {
+        compiled[i] = compilePath(paths[i], &rc);
+        if (compiled[i])
+            step_count += compiled[i]->Count;
+    }
+
+    //  One node per step at most, plus the root.
+    if (rc == SUCCESS) {
+        nodes = (SELECT_NODE *)malloc((step_count + 1) * sizeof(SELECT_NODE));
+        if (!nodes)
+            rc = ERROR_ALLOC_FAILED;
+    }
+
+    if (rc == SUCCESS) {
+        memset(nodes, 0, sizeof(SELECT_NODE));
+        unused = nodes + 1;
+        for (i = 0; i < n && rc == SUCCESS; i++) {
+            if (addSelectPath(nodes, compiled[i], &unused) != 0)
+                rc = ERROR_INVALID_JSON_PATH;
+        }
+    }
+
+    if (rc == SUCCESS) {
+        doc = allocJsonDocument(ARENA_FIRST_CHUNK_SIZE);
+        if (!doc)
+            rc = ERROR_ALLOC_FAILED;
+    }
+
+    if (rc == SUCCESS) {
+        ps.Document = doc;
+        ps.Context = ctx;
+        ps.Lazy = 0;
+        ps.Select = nodes;
+        ps.Keys = NULL;
+
+        if (parseText(&ps, string, strlen(string)) != 0) {
+            rc = ctx->Errno;
+        }
+        else if (!ps.Root) {
+            //  Nothing matched, which leaves an empty object.
+            ps.Root = allocJsonMember(doc);
+            if (!ps.Root)
+                rc = ERROR_ALLOC_FAILED;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        free(compiled[i]);
+    free(compiled);
+    free(nodes);
+
+    if (rc != SUCCESS) {
+        if (doc)
+            freeArenaChunks(doc);
+        ctx->Errno = rc;
+        return NULL;
+    }
+
+    doc->Root = ps.Root;
+
+    return doc;
+}
+
+
+JSON_OBJECT_HANDLE JSON_ParseSelect(char *string, char **paths, size_t n)
+{
+    return JSON_ParseSelectCtx(&default_context, string, paths, n);
+}
+
+
+//---------------------------------------------------------------------------
+//
+//  Binary images for JSON_Serialize() and JSON_Open().
+//
+//  An image holds a document as records that refer to each other by
+//  offsets from themselves, never by pointers, so it reads the same
+//  wherever it is mapped. Records are 8 byte aligned, strings are packed
+//  between them. Objects keep their members in order, with a hash table
+//  of the member names after them when they are large, and strings are
+//  NUL terminated, so lookups read the image as it is. Each distinct
+//  member name is written once, and shared by every member with it.
+//
+//  Images are in the byte order of the machine that wrote them, at most
+//  IMAGE_MAX_LENGTH long, and trusted: only the header is checked when
+//  one is opened.
+//
+//---------------------------------------------------------------------------
+#define IMAGE_MAGIC             0x424E534A
+#define IMAGE_VERSION           1
+#define IMAGE_OBJECT_SIGNATURE  0x626F694A
+#define IMAGE_TABLE_MIN_MEMBERS 8
+#define IMAGE_MAX_LENGTH        ((size_t)INT32_MAX)
+#define JSON_IMAGE_SIGNATURE    0x676D694A
+
+
+typedef struct _IMAGE_VALUE {
+
+    uint32_t Type;
+    uint32_t Length;
+    union {
+        double Number;
+        int64_t Integer;
+        int64_t Boolean;
+        int64_t Offset;
+    };
+
+} IMAGE_VALUE;
+
+
+typedef struct _IMAGE_MEMBER {
+
+    int32_t Name;
+    uint32_t Hash;
+    IMAGE_VALUE Value;
+
+} IMAGE_MEMBER;
+
+
+//
+//  Object records start with a signature, so a pointer to one is a
+//  handle the getters accept, like a plain object's first member.
+//  Table has Slots entries, each the index of a member plus one, or 0.
+//
+typedef struct _IMAGE_OBJECT {
+
+    uint32_t Signature;
+    uint32_t Count;
+    uint32_t Slots;
+    uint32_t Reserved;
+    IMAGE_MEMBER Members[];
+
+} IMAGE_OBJECT;
+
+
+typedef struct _IMAGE_HEADER {
+
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Length;
+    int64_t Root;
+
+} IMAGE_HEADER;
+
+
+//
+//  What JSON_Open() returns. Mapped is set when the image is a mapping
+//  to be removed by JSON_Close().
+//
+typedef struct _JSON_IMAGE {
+
+    int Signature;
+    const IMAGE_HEADER *Header;
+    size_t Length;
+    int Mapped;
+
+} JSON_IMAGE;
+
+
+#define IMAGE_AT(_record, _offset) ((const char *)(_record) + (_offset))
+
+
+//
+//  The image is built in one growing buffer. Records are placed by
+//  offset, since the buffer moves as it grows. Names is an open
+//  addressed table of the names written so far, NameSlots long.
+//
+typedef struct _IMAGE_NAME {
+
+    uint32_t Offset;
+    uint32_t Hash;
+
+} IMAGE_NAME;
+
+
+typedef struct _IMAGE_WRITER {
+
+    char *Buffer;
+    size_t Length;
+    size_t Capacity;
+    IMAGE_NAME *Names;
+    uint32_t NameSlots;
+    uint32_t NameCount;
+
+} IMAGE_WRITER;
+
+
+//
+//  Returns the offset of zeroed space, 8 byte aligned for records, or 0
+//  if out of memory. The header is at offset 0, so nothing else ever is.
+//
+static size_t allocImage(IMAGE_WRITER *w, size_t size, int record)
+{
+    //------------------------
+    char *buffer;
+    size_t capacity;
+    size_t offset;
+    //------------------------
+
+    offset = record ? ARENA_ALIGN(w->Length) : w->Length;
+
+    if (offset > IMAGE_MAX_LENGTH || size > IMAGE_MAX_LENGTH - offset)
+        return 0;
+
+    if (offset + size > w->Capacity) {
+        capacity = w->Capacity ? w->Capacity : 4096;
+        while (offset + size > capacity)
+            capacity *= 2;
+        buffer = (char *)realloc(w->Buffer, capacity);
+        if (!buffer)
+            return 0;
+        w->Buffer = buffer;
+        w->Capacity = capacity;
+    }
+
+    memset(w->Buffer + w->Length, 0, offset + size - w->Length);
+    w->Length = offset + size;
+
+    return offset;
+}
+
+
+static size_t writeImageString(IMAGE_WRITER *w, const char *string,
+                               uint32_t length)
+{
+    //------------------------
+    size_t offset;
+    //------------------------
+
+    offset = allocImage(w, (size_t)length + 1, 0);
+    if (offset)
+        memcpy(w->Buffer + offset, string, length);
+
+    return offset;
+}
+
+
+static int growImageNames(IMAGE_WRITER *w)
+{
+    //------------------------
+    IMAGE_NAME *names;
+    uint32_t slots;
+    uint32_t i;
+    uint32_t s;
+    //------------------------
+
+    slots = w->NameSlots ? w->NameSlots * 2 : 256;
+    names = (IMAGE_NAME *)calloc(slots, sizeof(IMAGE_NAME));
+    if (!names)
+        return -1;
+
+    for (i = 0; i < w->NameSlots; i++) {
+        if (!w->Names[i].Offset)
+            continue;
+        for (s = w->Names[i].Hash & (slots - 1); names[s].Offset;
+             s = (s + 1) & (slots - 1))
+            ;
+        names[s] = w->Names[i];
+    }
+
+    free(w->Names);
+    w->Names = names;
+    w->NameSlots = slots;
+
+    return 0;
+}
+
+
+//
+//  Returns the offset of the one copy of a member name, writing it the
+//  first time it is seen, or 0 if out of memory.
+//
+static size_t writeImageName(IMAGE_WRITER *w, const char *name,
+                             uint32_t length, uint32_t hash)
+{
+    //------------------------
+    size_t offset;
+    uint32_t s;
+    //------------------------
+
+    if (w->NameCount * 2 >= w->NameSlots && growImageNames(w) != 0)
+        return 0;
+
+    for (s = hash & (w->NameSlots - 1); w->Names[s].Offset;
+         s = (s + 1) & (w->NameSlots - 1)) {
+        if (w->Names[s].Hash == hash &&
+            strcmp(w->Buffer + w->Names[s].Offset, name) == 0)
+            return w->Names[s].Offset;
+    }
+
+    offset = writeImageString(w, name, length);
+    if (offset) {
+        w->Names[s].Offset = (uint32_t)offset;
+        w->Names[s].Hash = hash;
+        w->NameCount++;
+    }
+
+    return offset;
+}
+
+
+static JSON_ERROR writeImageObject(IMAGE_WRITER *w, JSON_MEMBER *member,
+                                   size_t *object_offset);
+
+
+//
+//  Fills in the value record at offset at, adding whatever it refers to.
+//
+static JSON_ERROR writeImageValue(IMAGE_WRITER *w, size_t at, JSON_VALUE *value)
+{
+    //------------------------
+    IMAGE_VALUE *record;
+    JSON_ERROR rc;
+    size_t offset = 0;
+    size_t length;
+    size_t i;
+    //------------------------
+
+    ASSERT_SIGNATURE(value, JSON_VALUE_SIGNATURE);
+
+    if (isLazyValue(value)) {
+        rc = loadLazyValue(value);
+        if (rc != SUCCESS)
+            return rc;
+    }
+
+    switch (value->Type) {
+
+        case TYPE_STRING:
+            length = strlen(value->String);
+            if (length > UINT32_MAX)
+                return ERROR_INVALID_STRING;
+            offset = writeImageString(w, value->String, (uint32_t)length);
+            if (!offset)
+                return ERROR_ALLOC_FAILED;
+            record = (IMAGE_VALUE *)(w->Buffer + at);
+            record->Length = (uint32_t)length;
+            break;
+
+        case TYPE_OBJECT:
+            rc = writeImageObject(w, value->Object, &offset);
+            if (rc != SUCCESS)
+                return rc;
+            break;
+
+        case TYPE_ARRAY:
+            if (value->Array->Count > UINT32_MAX)
+                return ERROR_INVALID_ARRAY;
+            if (value->Array->Count) {
+                offset = allocImage(w, value->Array->Count *
+                                       sizeof(IMAGE_VALUE), 1);
+                if (!offset)
+                    return ERROR_ALLOC_FAILED;
+            }
+            for (i = 0; i < value->Array->Count; i++) {
+                rc = writeImageValue(w, offset + i * sizeof(IMAGE_VALUE),
+                                     &value->Array->Values[i]);
+                if (rc != SUCCESS)
+                    return rc;
+            }
+            record = (IMAGE_VALUE *)(w->Buffer + at);
+            record->Length = (uint32_t)value->Array->Count;
+            break;
+
+        default:
+            break;
+    }
+
+    record = (IMAGE_VALUE *)(w->Buffer + at);
+    record->Type = value->Type;
+
+    if (value->Type == TYPE_NUMBER)
+        record->Number = value->Number;
+    else if (value->Type == TYPE_INTEGER)
+        record->Integer = value->Integer;
+    else if (value->Type == TYPE_BOOLEAN)
+        record->Boolean = value->Boolean;
+    else if (offset)
+        record->Offset = (int64_t)offset - (int64_t)at;
+
+    return SUCCESS;
+}
+
+
+static JSON_ERROR writeImageObject(IMAGE_WRITER *w, JSON_MEMBER *member,
+                                   size_t *object_offset)
+{
+    //------------------------
+    IMAGE_OBJECT *object;
+    IMAGE_MEMBER *record;
+    JSON_MEMBER *head = member;
+    JSON_ERROR rc;
+    uint32_t *table;
+    uint32_t count = 0;
+    uint32_t slots = 0;
+    uint32_t length;
+    uint32_t hash;
+    uint32_t i;
+    uint32_t s;
+    size_t offset;
+    size_t at;
+    size_t name;
+    //------------------------
+
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    //  An empty object is a single member without a name.
+    for (; member; member = member->Next) {
+        if (member->Name)
+            count++;
+    }
+
+    if (count >= IMAGE_TABLE_MIN_MEMBERS) {
+        for (slots = 16; slots < count * 2; slots *= 2)
+            ;
+    }
+
+    offset = allocImage(w, sizeof(IMAGE_OBJECT) +
+                           count * sizeof(IMAGE_MEMBER) +
+                           slots * sizeof(uint32_t), 1);
+    if (!offset)
+        return ERROR_ALLOC_FAILED;
+
+    object = (IMAGE_OBJECT *)(w->Buffer + offset);
+    object->Signature = IMAGE_OBJECT_SIGNATURE;
+    object->Count = count;
+    object->Slots = slots;
+
+    for (i = 0, member = head; member; member = member->Next) {
+
+        if (!member->Name)
+            continue;
+
+        hash = hashName(member->Name, &length);
+        name = writeImageName(w, member->Name, length, hash);
+        if (!name)
+            return ERROR_ALLOC_FAILED;
+
+        at = offset + sizeof(IMAGE_OBJECT) + i * sizeof(IMAGE_MEMBER);
+        record = (IMAGE_MEMBER *)(w->Buffer + at);
+        record->Name = (int32_t)((int64_t)name - (int64_t)at);
+        record->Hash = hash;
+
+        rc = writeImageValue(w, at + offsetof(IMAGE_MEMBER, Value),
+                             member->Value);
+        if (rc != SUCCESS)
+            return rc;
+
+        i++;
+    }
+
+    //  Only the first of several members with the same name goes in the
+    //  table, as lookups in the tree find that one.
+    object = (IMAGE_OBJECT *)(w->Buffer + offset);
+    table = (uint32_t *)&object->Members[count];
+
+    for (i = 0; i < slots && i < count; i++) {
+
+        record = &object->Members[i];
+
+        for (s = record->Hash & (slots - 1); table[s];
+             s = (s + 1) & (slots - 1)) {
+            if (object->Members[table[s] - 1].Hash == record->Hash &&
+                strcmp(IMAGE_AT(&object->Members[table[s] - 1],
+                                object->Members[table[s] - 1].Name),
+                       IMAGE_AT(record, record->Name)) == 0)
+                break;
+        }
+
+        if (!table[s])
+            table[s] = i + 1;
+    }
+
+    *object_offset = offset;
+
+    return SUCCESS;
+}
+
+
+JSON_ERROR JSON_SerializeCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                             JSON_SINK *sink)
+{
+    //-------------------------------
+    IMAGE_WRITER w = { NULL, 0, 0, NULL, 0, 0 };
+    IMAGE_HEADER *header;
+    JSON_MEMBER *member;
+    size_t root = 0;
+    //-------------------------------
+
+    ctx->Errno = SUCCESS;
+    member = getJsonMember(object, NULL);
+
+    if (!member || !sink) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return ctx->Errno;
+    }
+
+    //  The header takes offset 0, and is filled in last.
+    if (allocImage(&w, sizeof(IMAGE_HEADER), 1) != 0 || !w.Buffer) {
+        free(w.Buffer);
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return ctx->Errno;
+    }
+
+    ctx->Errno = writeImageObject(&w, member, &root);
+
+    if (ctx->Errno == SUCCESS) {
+        header = (IMAGE_HEADER *)w.Buffer;
+        header->Magic = IMAGE_MAGIC;
+        header->Version = IMAGE_VERSION;
+        header->Length = w.Length;
+        header->Root = (int64_t)root;
+
+        if (writeSink(sink, w.Buffer, w.Length) != 0)
+            ctx->Errno = ERROR_WRITE_FAILED;
+    }
+
+    free(w.Names);
+    free(w.Buffer);
+
+    return ctx->Errno;
+}
+
+
+JSON_ERROR JSON_Serialize(JSON_OBJECT_HANDLE object, JSON_SINK *sink)
+{
+    return JSON_SerializeCtx(&default_context, object, sink);
+}
+
+
+static JSON_OBJECT_HANDLE openJsonImage(JSON_CONTEXT *ctx, const void *image,
+                                        size_t length, int mapped)
+{
+    //------------------------
+    const IMAGE_HEADER *header = image;
+    JSON_IMAGE *handle;
+    //------------------------
+
+    if (!image || ((uintptr_t)image & 7) || length < sizeof(IMAGE_HEADER) ||
+        header->Magic != IMAGE_MAGIC || header->Version != IMAGE_VERSION ||
+        header->Length != length) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    handle = (JSON_IMAGE *)malloc(sizeof(JSON_IMAGE));
+    if (!handle) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    handle->Signature = JSON_IMAGE_SIGNATURE;
+    handle->Header = header;
+    handle->Length = length;
+    handle->Mapped = mapped;
+
+    return handle;
+}
+
+
+JSON_OBJECT_HANDLE JSON_OpenImageCtx(JSON_CONTEXT *ctx, const void *image,
+                                     size_t length)
+{
+    ctx->Errno = SUCCESS;
+
+    return openJsonImage(ctx, image, length, 0);
+}
+
+
+JSON_OBJECT_HANDLE JSON_OpenImage(const void *image, size_t length)
+{
+    return JSON_OpenImageCtx(&default_context, image, length);
+}
+
+
+//
+//  The mapping is shared and read only, so every process opening the
+//  same file uses the same pages.
+//
+JSON_OBJECT_HANDLE JSON_OpenCtx(JSON_CONTEXT *ctx, const char *path)
+{
+    //------------------------
+    JSON_OBJECT_HANDLE handle;
+    struct stat st;
+    void *mapping;
+    int fd;
+    //------------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!path) {
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    if ((size_t)st.st_size < sizeof(IMAGE_HEADER)) {
+        close(fd);
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        ctx->Errno = ERROR_READ_FAILED;
+        return NULL;
+    }
+
+    handle = openJsonImage(ctx, mapping, (size_t)st.st_size, 1);
+    if (!handle)
+        munmap(mapping, (size_t)st.st_size);
+
+    return handle;
+}
+
+
+JSON_OBJECT_HANDLE JSON_Open(const char *path)
+{
+    return JSON_OpenCtx(&default_context, path);
+}
+
+
+static JSON_IMAGE *getJsonImage(JSON_OBJECT_HANDLE object)
+{
+    //------------------------
+    JSON_IMAGE *image = object;
+    //------------------------
+
+    if (image && image->Signature == JSON_IMAGE_SIGNATURE)
+        return image;
+
+    return NULL;
+}
+
+
+void JSON_Close(JSON_OBJECT_HANDLE object)
+{
+    //------------------------
+    JSON_IMAGE *image;
+    //------------------------
+
+    default_context.Errno = SUCCESS;
+    image = getJsonImage(object);
+
+    if (!image) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return;
+    }
+
+    if (image->Mapped)
+        munmap((void *)image->Header, image->Length);
+
+    image->Signature = 0;
+    free(image);
+}
+
+
+//---------------------------------------------------------------------------
+//
+//  MessagePack and CBOR.
+//
+//  Both are written straight from the tree, through the same buffer as
+//  JSON text, and read straight into an arena document. Every count and
+//  length is big endian, in the fewest bytes the format allows.
+//  Decoding checks every length against what is left of the input, so
+//  any input is safe to decode.
+//
+//---------------------------------------------------------------------------
+#define BINARY_MAX_DEPTH 1024
+
+
+static void writeBigEndian(SMART_BUFFER *sb, unsigned char lead,
+                           uint64_t value, int size)
+{
+    //--------------------------
+    unsigned char *out;
+    int i;
+    //--------------------------
+
+    reserveBuffer(sb, size + 1);
+    out = (unsigned char *)sb->buffer + sb->length_used;
+
+    out[0] = lead;
+    for (i = size; i > 0; i--) {
+        out[i] = (unsigned char)value;
+        value >>= 8;
+    }
+
+    sb->length_used += size + 1;
+}
+
+
+//
+//  Numbers go out as 32 bit floats whenever that loses nothing.
+//
+static inline int isExactFloat(double number)
+{
+    return fabs(number) <= FLT_MAX && (double)(float)number == number;
+}
+
+
+static void writeBinaryFloat(SMART_BUFFER *sb, unsigned char lead32,
+                             unsigned char lead64, double number)
+{
+    //--------------------------
+    uint64_t bits;
+    uint32_t bits32;
+    float number32;
+    //--------------------------
+
+    //  The decoders would not take them back, as JSON has no text for them.
+    if (!isfinite(number))
+        writeError(sb, ERROR_INVALID_NUMBER);
+
+    if (isExactFloat(number)) {
+        number32 = (float)number;
+        memcpy(&bits32, &number32, sizeof(bits32));
+        writeBigEndian(sb, lead32, bits32, 4);
+    }
+    else {
+        memcpy(&bits, &number, sizeof(bits));
+        writeBigEndian(sb, lead64, bits, 8);
+    }
+}
+
+
+//
+//  Members of an object, not counting the one without a name that an
+//  empty object is made of.
+//
+static uint64_t countJsonMembers(JSON_MEMBER *member)
+{
+    //--------------------------
+    uint64_t count = 0;
+    //--------------------------
+
+    for (; member; member = member->Next) {
+        if (member->Name)
+            count++;
+    }
+
+    return count;
+}
+
+
+//
+//  Loads a lazy value before it is encoded.
+//
+static void loadBinaryValue(SMART_BUFFER *sb, JSON_VALUE *value)
+{
+    //--------------------------
+    JSON_ERROR rc;
+    //--------------------------
+
+    ASSERT_SIGNATURE(value, JSON_VALUE_SIGNATURE);
+
+    if (isLazyValue(value)) {
+        rc = loadLazyValue(value);
+        if (rc != SUCCESS)
+            writeError(sb, rc);
+    }
+}
+
+
+//
+//  MessagePack has a fixed form for small counts, and 16 or 32 bit
+//  lengths after lead16 and lead16 + 1 for the rest.
+//
+static void writeMsgPackLength(SMART_BUFFER *sb, unsigned char fix,
+                               uint64_t fix_limit, unsigned char lead16,
+                               uint64_t length, JSON_ERROR error)
+{
+    if (length < fix_limit)
+        writeChar(sb, (char)(fix | length));
+    else if (length <= UINT16_MAX)
+        writeBigEndian(sb, lead16, length, 2);
+    else if (length <= UINT32_MAX)
+        writeBigEndian(sb, lead16 + 1, length, 4);
+    else
+        writeError(sb, error);
+}
+
+
+static void writeMsgPackString(SMART_BUFFER *sb, const char *string)
+{
+    //--------------------------
+    size_t length;
+    //--------------------------
+
+    length = strlen(string);
+
+    if (length >= 32 && length <= UINT8_MAX)
+        writeBigEndian(sb, 0xd9, length, 1);
+    else
+        writeMsgPackLength(sb, 0xa0, 32, 0xda, length, ERROR_INVALID_STRING);
+
+    writeBuffer(sb, string, length);
+}
+
+
+static void writeMsgPackInteger(SMART_BUFFER *sb, int64_t integer)
+{
+    if (integer >= 0) {
+        if (integer <= 0x7f)
+            writeChar(sb, (char)integer);
+        else if (integer <= UINT8_MAX)
+            writeBigEndian(sb, 0xcc, integer, 1);
+        else if (integer <= UINT16_MAX)
+            writeBigEndian(sb, 0xcd, integer, 2);
+        else if (integer <= UINT32_MAX)
+            writeBigEndian(sb, 0xce, integer, 4);
+        else
+            writeBigEndian(sb, 0xcf, integer, 8);
+    }
+    else {
+        if (integer >= -32)
+            writeChar(sb, (char)integer);
+        else if (integer >= INT8_MIN)
+            writeBigEndian(sb, 0xd0, (uint64_t)integer, 1);
+        else if (integer >= INT16_MIN)
+            writeBigEndian(sb, 0xd1, (uint64_t)integer, 2);
+        else if (integer >= INT32_MIN)
+            writeBigEndian(sb, 0xd2, (uint64_t)integer, 4);
+        else
+            writeBigEndian(sb, 0xd3, (uint64_t)integer, 8);
+    }
+}
+
+
+static void writeMsgPackObject(SMART_BUFFER *sb, JSON_MEMBER *member);
+
+
+static void writeMsgPackValue(SMART_BUFFER *sb, JSON_VALUE *value)
+{
+    //--------------------------
+    size_t i;
+    //--------------------------
+
+    loadBinaryValue(sb, value);
+
+    switch (value->Type) {
+
+        case TYPE_OBJECT:
+            writeMsgPackObject(sb, value->Object);
+            break;
+
+        case TYPE_ARRAY:
+            writeMsgPackLength(sb, 0x90, 16, 0xdc, value->Array->Count,
+                               ERROR_INVALID_ARRAY);
+            for (i = 0; i < value->Array->Count; i++)
+                writeMsgPackValue(sb, &value->Array->Values[i]);
+            break;
+
+        case TYPE_STRING:
+            writeMsgPackString(sb, value->String);
+            break;
+
+        case TYPE_BOOLEAN:
+            writeChar(sb, value->Boolean ? (char)0xc3 : (char)0xc2);
+            break;
+
+        case TYPE_NUMBER:
+            writeBinaryFloat(sb, 0xca, 0xcb, value->Number);
+            break;
+
+        case TYPE_INTEGER:
+            writeMsgPackInteger(sb, value->Integer);
+            break;
+
+        default:
+            writeError(sb, ERROR_INVALID_VALUE_TYPE);
+    }
+}
+
+
+static void writeMsgPackObject(SMART_BUFFER *sb, JSON_MEMBER *member)
+{
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    writeMsgPackLength(sb, 0x80, 16, 0xde, countJsonMembers(member),
+                       ERROR_INVALID_OBJECT);
+
+    for (; member; member = member->Next) {
+        if (!member->Name)
+            continue;
+        writeMsgPackString(sb, member->Name);
+        writeMsgPackValue(sb, member->Value);
+    }
+}
+
+
+//
+//  Every CBOR item starts with its major type in the top 3 bits and a
+//  count, length or value after it.
+//
+#define CBOR_UNSIGNED  0
+#define CBOR_NEGATIVE  1
+#define CBOR_BYTES     2
+#define CBOR_TEXT      3
+#define CBOR_ARRAY     4
+#define CBOR_MAP       5
+#define CBOR_TAG       6
+#define CBOR_SIMPLE    7
+
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK      0xff
+
+
+static void writeCborHead(SMART_BUFFER *sb, int major, uint64_t value)
+{
+    //--------------------------
+    unsigned char lead = (unsigned char)(major << 5);
+    //--------------------------
+
+    if (value < 24)
+        writeChar(sb, (char)(lead | value));
+    else if (value <= UINT8_MAX)
+        writeBigEndian(sb, lead | 24, value, 1);
+    else if (value <= UINT16_MAX)
+        writeBigEndian(sb, lead | 25, value, 2);
+    else if (value <= UINT32_MAX)
+        writeBigEndian(sb, lead | 26, value, 4);
+    else
+        writeBigEndian(sb, lead | 27, value, 8);
+}
+
+
+static void writeCborString(SMART_BUFFER *sb, const char *string)
+{
+    //--------------------------
+    size_t length;
+    //--------------------------
+
+    length = strlen(string);
+
+    writeCborHead(sb, CBOR_TEXT, length);
+    writeBuffer(sb, string, length);
+}
+
+
+static void writeCborObject(SMART_BUFFER *sb, JSON_MEMBER *member);
+
+
+static void writeCborValue(SMART_BUFFER *sb, JSON_VALUE *value)
+{
+    //--------------------------
+    size_t i;
+    //--------------------------
+
+    loadBinaryValue(sb, value);
+
+    switch (value->Type) {
+
+        case TYPE_OBJECT:
+            writeCborObject(sb, value->Object);
+            break;
+
+        case TYPE_ARRAY:
+            writeCborHead(sb, CBOR_ARRAY, value->Array->Count);
+            for (i = 0; i < value->Array->Count; i++)
+                writeCborValue(sb, &value->Array->Values[i]);
+            break;
+
+        case TYPE_STRING:
+            writeCborString(sb, value->String);
+            break;
+
+        case TYPE_BOOLEAN:
+            writeChar(sb, value->Boolean ? (char)0xf5 : (char)0xf4);
+            break;
+
+        case TYPE_NUMBER:
+            writeBinaryFloat(sb, 0xfa, 0xfb, value->Number);
+            break;
+
+        case TYPE_INTEGER:
+            //  Negative integers are stored as -1 - n.
+            if (value->Integer >= 0)
+                writeCborHead(sb, CBOR_UNSIGNED, (uint64_t)value->Integer);
+            else
+                writeCborHead(sb, CBOR_NEGATIVE, ~(uint64_t)value->Integer);
+            break;
+
+        default:
+            writeError(sb, ERROR_INVALID_VALUE_TYPE);
+    }
+}
+
+
+static void writeCborObject(SMART_BUFFER *sb, JSON_MEMBER *member)
+{
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
+
+    writeCborHead(sb, CBOR_MAP, countJsonMembers(member));
+
+    for (; member; member = member->Next) {
+        if (!member->Name)
+            continue;
+        writeCborString(sb, member->Name);
+        writeCborValue(sb, member->Value);
+    }
+}
+
+
+typedef void (*BINARY_WRITER)(SMART_BUFFER *, JSON_MEMBER *);
+
+
+//
+//  Kept apart from the public functions, like stringifyRoot().
+//
+static int writeBinaryRoot(JSON_MEMBER *member, SMART_BUFFER *sb,
+                           BINARY_WRITER write)
+{
+    if (setjmp(sb->JmpBuffer) != 0) {
+        return -1;
+    }
+
+    write(sb, member);
+
+    return 0;
+}
+
+
+static char *encodeBinary(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                          size_t *length, BINARY_WRITER write)
+{
+    //-------------------------------
+    SMART_BUFFER sb = {0};
+    JSON_MEMBER *member;
+    //-------------------------------
+
+    ctx->Errno = SUCCESS;
+    member = getJsonMember(object, NULL);
+
+    sb.Signature = SMART_BUFFER_SIGNATURE;
+    sb.Mode = WRITE_COMPACT;
+    sb.Context = ctx;
+
+    if (!member || !length) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    if (writeBinaryRoot(member, &sb, write) != 0) {
+        free(sb.buffer);
+        return NULL;
+    }
+
+    *length = sb.length_used;
+
+    return sb.buffer;
+}
+
+
+char *JSON_ToMsgPackCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                        size_t *length)
+{
+    return encodeBinary(ctx, object, length, writeMsgPackObject);
+}
+
+
+char *JSON_ToMsgPack(JSON_OBJECT_HANDLE object, size_t *length)
+{
+    return JSON_ToMsgPackCtx(&default_context, object, length);
+}
+
+
+char *JSON_ToCborCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                     size_t *length)
+{
+    return encodeBinary(ctx, object, length, writeCborObject);
+}
+
+
+char *JSON_ToCbor(JSON_OBJECT_HANDLE object, size_t *length)
+{
+    return JSON_ToCborCtx(&default_context, object, length);
+}
+
+
+typedef struct _DECODE_STATE {
+
+    const unsigned char *Cursor;
+    const unsigned char *End;
+    JSON_DOCUMENT *Document;
+    JSON_CONTEXT *Context;
+    int Depth;
+    jmp_buf JmpBuffer;
+
+} DECODE_STATE;
+
+
+static void decodeError(DECODE_STATE *ds, JSON_ERROR error)
+{
+    ds->Context->Errno = error;
+    longjmp(ds->JmpBuffer, 1);
+}
+
+
+static const unsigned char *takeBytes(DECODE_STATE *ds, uint64_t length,
+                                      JSON_ERROR error)
+{
+    //--------------------------
+    const unsigned char *bytes = ds->Cursor;
+    //--------------------------
+
+    if (length > (uint64_t)(ds->End - ds->Cursor))
+        decodeError(ds, error);
+
+    ds->Cursor += length;
+
+    return bytes;
+}
+
+
+static uint64_t readBigEndian(DECODE_STATE *ds, int size, JSON_ERROR error)
+{
+    //--------------------------
+    const unsigned char *bytes;
+    uint64_t value = 0;
+    int i;
+    //--------------------------
+
+    bytes = takeBytes(ds, size, error);
+
+    for (i = 0; i < size; i++)
+        value = (value << 8) | bytes[i];
+
+    return value;
+}
+
+
+static char *decodeString(DECODE_STATE *ds, uint64_t length)
+{
+    //--------------------------
+    const unsigned char *bytes;
+    char *string;
+    //--------------------------
+
+    bytes = takeBytes(ds, length, ERROR_INVALID_STRING);
+
+    //  Strings in the tree end at their first NUL.
+    if (memchr(bytes, 0, length))
+        decodeError(ds, ERROR_INVALID_STRING);
+
+    string = jsonStrndup(ds->Document, (const char *)bytes, length);
+    if (!string)
+        decodeError(ds, ERROR_ALLOC_FAILED);
+
+    return string;
+}
+
+
+static void decodeNumber(DECODE_STATE *ds, JSON_VALUE *value, double number)
+{
+    if (!isfinite(number))
+        decodeError(ds, ERROR_INVALID_NUMBER);
+
+    value->Type = TYPE_NUMBER;
+    value->Number = number;
+}
+
+
+static void decodeUnsigned(JSON_VALUE *value, uint64_t integer)
+{
+    if (integer <= (uint64_t)INT64_MAX) {
+        value->Type = TYPE_INTEGER;
+        value->Integer = (int64_t)integer;
+    }
+    else {
+        value->Type = TYPE_NUMBER;
+        value->Number = (double)integer;
+    }
+}
+
+
+static float bitsToFloat(uint32_t bits)
+{
+    //--------------------------
+    float number;
+    //--------------------------
+
+    memcpy(&number, &bits, sizeof(number));
+
+    return number;
+}
+
+
+static double bitsToDouble(uint64_t bits)
+{
+    //--------------------------
+    double number;
+    //--------------------------
+
+    memcpy(&number, &bits, sizeof(number));
+
+    return number;
+}
+
+
+static void enterContainer(DECODE_STATE *ds, JSON_ERROR error)
+{
+    if (++ds->Depth > BINARY_MAX_DEPTH)
+        decodeError(ds, error);
+}
+
+
+//
+//  Arrays of known size get all of their elements at once. Each element
+//  takes at least a byte, which bounds count by what is left.
+//
+static JSON_ARRAY *decodeArray(DECODE_STATE *ds, uint64_t count)
+{
+    //--------------------------
+    JSON_ARRAY *array;
+    //--------------------------
+
+    if (count > (uint64_t)(ds->End - ds->Cursor))
+        decodeError(ds, ERROR_INVALID_ARRAY);
+
+    array = allocJsonArray(ds->Document);
+    if (!array)
+        decodeError(ds, ERROR_ALLOC_FAILED);
+
+    if (count) {
+        array->Values = (JSON_VALUE *)jsonAlloc(ds->Document,
+                                                count * sizeof(JSON_VALUE));
+        if (!array->Values)
+            decodeError(ds, ERROR_ALLOC_FAILED);
+        memset(array->Values, 0, count * sizeof(JSON_VALUE));
+        array->Capacity = count;
+    }
+
+    return array;
+}
+
+
+static JSON_VALUE *nextArrayValue(DECODE_STATE *ds, JSON_ARRAY *array)
+{
+    //--------------------------
+    JSON_VALUE *value;
+    //--------------------------
+
+    if (array->Count == array->Capacity &&
+        growJsonArray(ds->Document, array) != 0) {
+        decodeError(ds, ERROR_ALLOC_FAILED);
+    }
+
+    value = &array->Values[array->Count++];
+    memset(value, 0, sizeof(JSON_VALUE));
+    value->Signature = JSON_VALUE_SIGNATURE;
+
+    return value;
+}
+
+
+static JSON_MEMBER *decodeMember(DECODE_STATE *ds, JSON_MEMBER **link)
+{
+    //--------------------------
+    JSON_MEMBER *member;
+    //--------------------------
+
+    member = allocJsonNode(ds->Document);
+    if (!member)
+        decodeError(ds, ERROR_ALLOC_FAILED);
+
+    *link = member;
+
+    return member;
+}
+
+
+//
+//  An empty map becomes an object of a single member without a name or
+//  a value.
+//
+static void decodeEmptyObject(DECODE_STATE *ds, JSON_MEMBER **link)
+{
+    *link = allocJsonMember(ds->Document);
+    if (!*link)
+        decodeError(ds, ERROR_ALLOC_FAILED);
+}
+
+
+static void decodeMsgPackObject(DECODE_STATE *ds, JSON_MEMBER **link,
+                                uint64_t count);
+
+
+static uint64_t readMsgPackLength(DECODE_STATE *ds, unsigned char lead,
+                                  unsigned char fix, unsigned char fix_mask,
+                                  unsigned char lead8, JSON_ERROR error)
+{
+    if ((lead & ~fix_mask) == fix)
+        return lead & fix_mask;
+    else if (lead == lead8)
+        return readBigEndian(ds, 1, error);
+    else if (lead == lead8 + 1)
+        return readBigEndian(ds, 2, error);
+    else
+        return readBigEndian(ds, 4, error);
+}
+
+
+static void decodeMsgPackValue(DECODE_STATE *ds, JSON_VALUE *value)
+{
+    //--------------------------
+    unsigned char lead;
+    uint64_t count;
+    JSON_ARRAY *array;
+    //--------------------------
+
+    lead = *takeBytes(ds, 1, ERROR_INVALID_VALUE_TYPE);
+
+    if (lead <= 0x7f || lead >= 0xe0) {
+        value->Type = TYPE_INTEGER;
+        value->Integer = (int8_t)lead;
+    }
+    else if (lead <= 0x8f || lead == 0xde || lead == 0xdf) {
+        count = (lead <= 0x8f) ? (uint64_t)(lead & 0x0f) :
+                readBigEndian(ds, lead == 0xde ? 2 : 4, ERROR_INVALID_OBJECT);
+        value->Type = TYPE_OBJECT;
+        decodeMsgPackObject(ds, &value->Object, count);
+    }
+    else if (lead <= 0x9f || lead == 0xdc || lead == 0xdd) {
+        count = (lead <= 0x9f) ? (uint64_t)(lead & 0x0f) :
+                readBigEndian(ds, lead == 0xdc ? 2 : 4, ERROR_INVALID_ARRAY);
+        enterContainer(ds, ERROR_INVALID_ARRAY);
+        array = decodeArray(ds, count);
+        value->Type = TYPE_ARRAY;
+        value->Array = array;
+        while (count--)
+            decodeMsgPackValue(ds, nextArrayValue(ds, array));
+        ds->Depth--;
+    }
+    else if (lead <= 0xbf || (lead >= 0xd9 && lead <= 0xdb)) {
+        count = readMsgPackLength(ds, lead, 0xa0, 0x1f, 0xd9,
+                                  ERROR_INVALID_STRING);
+        value->Type = TYPE_STRING;
+        value->String = decodeString(ds, count);
+    }
+    else if (lead == 0xc2 || lead == 0xc3) {
+        value->Type = TYPE_BOOLEAN;
+        value->Boolean = (lead == 0xc3);
+    }
+    else if (lead == 0xca) {
+        decodeNumber(ds, value, bitsToFloat(
+            (uint32_t)readBigEndian(ds, 4, ERROR_INVALID_NUMBER)));
+    }
+    else if (lead == 0xcb) {
+        decodeNumber(ds, value, bitsToDouble(
+            readBigEndian(ds, 8, ERROR_INVALID_NUMBER)));
+    }
+    else if (lead >= 0xcc && lead <= 0xcf) {
+        decodeUnsigned(value, readBigEndian(ds, 1 << (lead - 0xcc),
+                                            ERROR_INVALID_NUMBER));
+    }
+    else if (lead >= 0xd0 && lead <= 0xd3) {
+        count = readBigEndian(ds, 1 << (lead - 0xd0), ERROR_INVALID_NUMBER);
+        value->Type = TYPE_INTEGER;
+        if (lead == 0xd0)
+            value->Integer = (int8_t)count;
+        else if (lead == 0xd1)
+            value->Integer = (int16_t)count;
+        else if (lead == 0xd2)
+            value->Integer = (int32_t)count;
+        else
+            value->Integer = (int64_t)count;
+    }
+    else {
+        //  nil, binary data and extension types have no JSON value.
+        decodeError(ds, ERROR_INVALID_VALUE_TYPE);
+    }
+}
+
+
+//
+//  Each member takes at least two bytes, which bounds count.
+//
+static void decodeMsgPackObject(DECODE_STATE *ds, JSON_MEMBER **link,
+                                uint64_t count)
+{
+    //--------------------------
+    JSON_MEMBER *member;
+    unsigned char lead;
+    uint64_t length;
+    //--------------------------
+
+    if (count > (uint64_t)(ds->End - ds->Cursor) / 2)
+        decodeError(ds, ERROR_INVALID_OBJECT);
+
+    enterContainer(ds, ERROR_INVALID_OBJECT);
+
+    if (count == 0)
+        decodeEmptyObject(ds, link);
+
+    while (count--) {
+        member = decodeMember(ds, link);
+        link = &member->Next;
+
+        lead = *takeBytes(ds, 1, ERROR_INVALID_OBJECT);
+        if ((lead & 0xe0) != 0xa0 && (lead < 0xd9 || lead > 0xdb))
+            decodeError(ds, ERROR_INVALID_OBJECT);
+
+        length = readMsgPackLength(ds, lead, 0xa0, 0x1f, 0xd9,
+                                   ERROR_INVALID_OBJECT);
+        member->Name = decodeString(ds, length);
+
+        decodeMsgPackValue(ds, member->Value);
+    }
+
+    ds->Depth--;
+}
+
+
+//
+//  Reads the head of a CBOR item, returning its major type. *info is
+//  what the low 5 bits hold, so CBOR_INDEFINITE, or a simple value.
+//
+static int readCborHead(DECODE_STATE *ds, uint64_t *value, int *info,
+                        JSON_ERROR error)
+{
+    //--------------------------
+    unsigned char lead;
+    //--------------------------
+
+    lead = *takeBytes(ds, 1, error);
+    *info = lead & 0x1f;
+
+    if (*info < 24)
+        *value = *info;
+    else if (*info <= 27)
+        *value = readBigEndian(ds, 1 << (*info - 24), error);
+    else if (*info == CBOR_INDEFINITE)
+        *value = 0;
+    else
+        decodeError(ds, error);
+
+    return lead >> 5;
+}
+
+
+static inline int isCborBreak(DECODE_STATE *ds)
+{
+    if (ds->Cursor == ds->End)
+        decodeError(ds, ERROR_INVALID_VALUE_TYPE);
+
+    if (*ds->Cursor != CBOR_BREAK)
+        return 0;
+
+    ds->Cursor++;
+    return 1;
+}
+
+
+static double halfToDouble(uint64_t half)
+{
+    //--------------------------
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double number;
+    //--------------------------
+
+    if (exponent == 0)
+        number = ldexp(mantissa, -24);
+    else if (exponent != 31)
+        number = ldexp(mantissa + 1024, exponent - 25);
+    else
+        number = mantissa ? NAN : INFINITY;
+
+    return (half & 0x8000) ? -number : number;
+}
+
+
+static void decodeCborObject(DECODE_STATE *ds, JSON_MEMBER **link,
+                             uint64_t count, int indefinite);
+
+
+static void decodeCborValue(DECODE_STATE *ds, JSON_VALUE *value)
+{
+    //--------------------------
+    JSON_ARRAY *array;
+    uint64_t head;
+    int major;
+    int info;
+    //--------------------------
+
+    major = readCborHead(ds, &head, &info, ERROR_INVALID_VALUE_TYPE);
+
+    //  Tags only qualify the item after them, which is taken as it is.
+    while (major == CBOR_TAG) {
+        if (info == CBOR_INDEFINITE)
+            decodeError(ds, ERROR_INVALID_VALUE_TYPE);
+        major = readCborHead(ds, &head, &info, ERROR_INVALID_VALUE_TYPE);
+    }
+
+    if (info == CBOR_INDEFINITE && major != CBOR_ARRAY && major != CBOR_MAP) {
+        decodeError(ds, (major == CBOR_TEXT) ? ERROR_INVALID_STRING :
+                                               ERROR_INVALID_VALUE_TYPE);
+    }
+
+    switch (major) {
+
+        case CBOR_UNSIGNED:
+            decodeUnsigned(value, head);
+            break;
+
+        case CBOR_NEGATIVE:
+            if (head <= (uint64_t)INT64_MAX) {
+                value->Type = TYPE_INTEGER;
+                value->Integer = -1 - (int64_t)head;
+            }
+            else {
+                value->Type = TYPE_NUMBER;
+                value->Number = -1.0 - (double)head;
+            }
+            break;
+
+        case CBOR_TEXT:
+            value->Type = TYPE_STRING;
+            value->String = decodeString(ds, head);
+            break;
+
+        case CBOR_ARRAY:
+            enterContainer(ds, ERROR_INVALID_ARRAY);
+            array = decodeArray(ds, head);
+            value->Type = TYPE_ARRAY;
+            value->Array = array;
+            if (info == CBOR_INDEFINITE) {
+                while (!isCborBreak(ds))
+                    decodeCborValue(ds, nextArrayValue(ds, array));
+            }
+            else {
+                while (head--)
+                    decodeCborValue(ds, nextArrayValue(ds, array));
+            }
+            ds->Depth--;
+            break;
+
+        case CBOR_MAP:
+            value->Type = TYPE_OBJECT;
+            decodeCborObject(ds, &value->Object, head,
+                             info == CBOR_INDEFINITE);
+            break;
+
+        case CBOR_SIMPLE:
+            if (info == 20 || info == 21) {
+                value->Type = TYPE_BOOLEAN;
+                value->Boolean = (info == 21);
+            }
+            else if (info == 25) {
+                decodeNumber(ds, value, halfToDouble(head));
+            }
+            else if (info == 26) {
+                decodeNumber(ds, value, bitsToFloat((uint32_t)head));
+            }
+            else if (info == 27) {
+                decodeNumber(ds, value, bitsToDouble(head));
+            }
+            else {
+                //  null, undefined and the other simple values.
+                decodeError(ds, ERROR_INVALID_VALUE_TYPE);
+            }
+            break;
+
+        default:
+            //  Byte strings have no JSON value.
+            decodeError(ds, ERROR_INVALID_VALUE_TYPE);
+    }
+}
+
+
+static void decodeCborObject(DECODE_STATE *ds, JSON_MEMBER **link,
+                             uint64_t count, int indefinite)
+{
+    //--------------------------
+    JSON_MEMBER *member;
+    uint64_t length;
+    int info;
+    //--------------------------
+
+    if (count > (uint64_t)(ds->End - ds->Cursor) / 2)
+        decodeError(ds, ERROR_INVALID_OBJECT);
+
+    enterContainer(ds, ERROR_INVALID_OBJECT);
+
+    if (indefinite ? isCborBreak(ds) : count == 0) {
+        decodeEmptyObject(ds, link);
+        ds->Depth--;
+        return;
+    }
+
+    do {
+        member = decodeMember(ds, link);
+        link = &member->Next;
+
+        if (readCborHead(ds, &length, &info, ERROR_INVALID_OBJECT) !=
+                CBOR_TEXT || info == CBOR_INDEFINITE) {
+            decodeError(ds, ERROR_INVALID_OBJECT);
+        }
+        member->Name = decodeString(ds, length);
+
+        decodeCborValue(ds, member->Value);
+
+    } while (indefinite ? !isCborBreak(ds) : --count > 0);
+
+    ds->Depth--;
+}
+
+
+typedef void (*BINARY_READER)(DECODE_STATE *, JSON_MEMBER **);
+
+
+static void readMsgPackRoot(DECODE_STATE *ds, JSON_MEMBER **root)
+{
+    //--------------------------
+    JSON_VALUE value;
+    //--------------------------
+
+    memset(&value, 0, sizeof(JSON_VALUE));
+    value.Signature = JSON_VALUE_SIGNATURE;
+
+    decodeMsgPackValue(ds, &value);
+    if (value.Type != TYPE_OBJECT)
+        decodeError(ds, ERROR_INVALID_OBJECT);
+
+    *root = value.Object;
+}
+
+
+static void readCborRoot(DECODE_STATE *ds, JSON_MEMBER **root)
+{
+    //--------------------------
+    JSON_VALUE value;
+    //--------------------------
+
+    memset(&value, 0, sizeof(JSON_VALUE));
+    value.Signature = JSON_VALUE_SIGNATURE;
+
+    decodeCborValue(ds, &value);
+    if (value.Type != TYPE_OBJECT)
+        decodeError(ds, ERROR_INVALID_OBJECT);
+
+    *root = value.Object;
+}
+
+
+//
+//  Kept apart from the public functions, like stringifyRoot(). Nothing
+//  may follow the top level map.
+//
+static int readBinaryRoot(DECODE_STATE *ds, BINARY_READER read)
+{
+    if (setjmp(ds->JmpBuffer) != 0) {
+        return -1;
+    }
+
+    read(ds, &ds->Document->Root);
+
+    if (ds->Cursor != ds->End)
+        decodeError(ds, ERROR_INVALID_OBJECT);
+
+    return 0;
+}
+
+
+static JSON_OBJECT_HANDLE decodeBinary(JSON_CONTEXT *ctx, const void *data,
+                                       size_t length, BINARY_READER read)
+{
+    //-------------------------------
+    DECODE_STATE ds;
+    size_t size;
+    //-------------------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (!data || length == 0) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    //  Trees take a few times the room of their encoding.
+    size = (length < ARENA_MAX_CHUNK_SIZE / 4) ? length * 4 :
+                                                 ARENA_MAX_CHUNK_SIZE;
+    if (size < ARENA_FIRST_CHUNK_SIZE)
+        size = ARENA_FIRST_CHUNK_SIZE;
+
+    ds.Cursor = (const unsigned char *)data;
+    ds.End = ds.Cursor + length;
+    ds.Context = ctx;
+    ds.Depth = 0;
+    ds.Document = allocJsonDocument(size);
+
+    if (!ds.Document) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    if (readBinaryRoot(&ds, read) != 0) {
+        freeArenaChunks(ds.Document);
+        return NULL;
+    }
+
+    return ds.Document;
+}
+
+
+JSON_OBJECT_HANDLE JSON_FromMsgPackCtx(JSON_CONTEXT *ctx, const void *data,
+                                       size_t length)
+{
+    return decodeBinary(ctx, data, length, readMsgPackRoot);
+}
+
+
+JSON_OBJECT_HANDLE JSON_FromMsgPack(const void *data, size_t length)
+{
+    return JSON_FromMsgPackCtx(&default_context, data, length);
+}
+
+
+JSON_OBJECT_HANDLE JSON_FromCborCtx(JSON_CONTEXT *ctx, const void *data,
+                                    size_t length)
+{
+    return decodeBinary(ctx, data, length, readCborRoot);
+}
+
+
+JSON_OBJECT_HANDLE JSON_FromCbor(const void *data, size_t length)
+{
+    return JSON_FromCborCtx(&default_context, data, length);
+}
+
+
+//
+//  Resolves a handle to an image, or to an object in one, to the object.
+//
+static const IMAGE_OBJECT *getImageObject(JSON_OBJECT_HANDLE object)
+{
+    //------------------------
+    const IMAGE_OBJECT *found = object;
+    JSON_IMAGE *image;
+    //------------------------
+
+    if (!object)
+        return NULL;
+
+    image = getJsonImage(object);
+    if (image)
+        return (const IMAGE_OBJECT *)IMAGE_AT(image->Header,
+                                              image->Header->Root);
+
+    if (found->Signature == IMAGE_OBJECT_SIGNATURE)
+        return found;
+
+    return NULL;
+}
+
+
+static inline int isImageName(const IMAGE_MEMBER *member, PATH_STEP *step)
+{
+    //------------------------
+    const char *name = IMAGE_AT(member, member->Name);
+    //------------------------
+
+    return strncmp(name, step->Name, step->Length) == 0 &&
+           name[step->Length] == 0;
+}
+
+
+static const IMAGE_MEMBER *findImageMember(const IMAGE_OBJECT *object,
+                                           PATH_STEP *step)
+{
+    //------------------------
+    const IMAGE_MEMBER *member;
+    const uint32_t *table;
+    uint32_t mask;
+    uint32_t i;
+    //------------------------
+
+    if (object->Slots) {
+        table = (const uint32_t *)&object->Members[object->Count];
+        mask = object->Slots - 1;
+
+        for (i = step->Hash & mask; table[i]; i = (i + 1) & mask) {
+            member = &object->Members[table[i] - 1];
+            if (member->Hash == step->Hash && isImageName(member, step))
+                return member;
+        }
+
+        return NULL;
+    }
+
+    for (i = 0; i < object->Count; i++) {
+        member = &object->Members[i];
+        if (member->Hash == step->Hash && isImageName(member, step))
+            return member;
+    }
+
+    return NULL;
+}
+
+
+//
+//  The getters read image values through this, one per thread, so it
+//  only lives until the next lookup. Objects are handed out as their
+//  records, which are handles themselves.
+//
+static _Thread_local JSON_VALUE image_value;
+
+
+static JSON_VALUE *loadImageValue(const IMAGE_VALUE *record)
+{
+    memset(&image_value, 0, sizeof(JSON_VALUE));
+    image_value.Signature = JSON_VALUE_SIGNATURE;
+    image_value.Type = (JSON_TYPE)record->Type;
+
+    switch (record->Type) {
+
+        case TYPE_STRING:
+            image_value.String = (char *)IMAGE_AT(record, record->Offset);
+            break;
+
+        case TYPE_OBJECT:
+            image_value.Object = (JSON_MEMBER *)IMAGE_AT(record, record->Offset);
+            break;
+
+        case TYPE_NUMBER:
+            image_value.Number = record->Number;
+            break;
+
+        case TYPE_INTEGER:
+            image_value.Integer = record->Integer;
+            break;
+
+        case TYPE_BOOLEAN:
+            image_value.Boolean = (int)record->Boolean;
+            break;
+
+        default:
+            break;
+    }
+
+    return &image_value;
+}
+
+
+//
+//  Walks a path the same way findJsonValue() does in a tree.
+//
+static JSON_VALUE *findImageValue(JSON_PATH *path, const IMAGE_OBJECT *object)
+{
+    //------------------------
+    const IMAGE_MEMBER *member;
+    const IMAGE_VALUE *array = NULL;
+    const IMAGE_VALUE *value = NULL;
+    PATH_STEP *step;
+    int i;
+    //------------------------
+
+    for (i = 0; i < path->Count; i++) {
+
+        step = &path->Steps[i];
+
+        if (!object && step->Order != DOB_NEXT_IS_NESTED_ARRAY)
+            return NULL;
+
+        switch(step->Order) {
+
+            case DOB_LAST_ELEMENT:
+
+                member = findImageMember(object, step);
+                if (!member || member->Value.Type == TYPE_OBJECT)
+                    return NULL;
+                return loadImageValue(&member->Value);
+
+            case DOB_NEXT_IS_OBJECT:
+
+                member = findImageMember(object, step);
+                if (!member || member->Value.Type != TYPE_OBJECT)
+                    return NULL;
+                object = (const IMAGE_OBJECT *)IMAGE_AT(&member->Value,
+                                                        member->Value.Offset);
+                break;
+
+            case DOB_NEXT_IS_NAMED_ARRAY:
+
+                member = findImageMember(object, step);
+                if (!member || member->Value.Type != TYPE_ARRAY)
+                    return NULL;
+                array = &member->Value;
+
+                // Fall through - the element is found like a nested one.
+
+            case DOB_NEXT_IS_NESTED_ARRAY:
+
+                if (!array || step->ArrayIndex < 0 ||
+                    (uint32_t)step->ArrayIndex >= array->Length)
+                    return NULL;
+
+                value = (const IMAGE_VALUE *)IMAGE_AT(array, array->Offset) +
+                        step->ArrayIndex;
+
+                object = NULL;
+                array = NULL;
+
+                if (value->Type == TYPE_OBJECT)
+                    object = (const IMAGE_OBJECT *)IMAGE_AT(value,
+                                                            value->Offset);
+                else if (value->Type == TYPE_ARRAY)
+                    array = value;
+                else
+                    return loadImageValue(value);
+                break;
+        }
+    }
+
+    return value ? loadImageValue(value) : NULL;
+}
+
+
+//
+//  The getters below all look up the value the same way, in a tree or in
+//  an image. The ones taking a path string compile it for the one call.
+//
+static JSON_VALUE *getJsonValue(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                                JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_MEMBER *member = NULL;
+    JSON_DOCUMENT *doc = NULL;
+    const IMAGE_OBJECT *image;
+    JSON_PATH *compiled;
+    //------------------------
+
+    ctx->Errno = SUCCESS;
+    image = getImageObject(object);
+    if (!image)
+        member = getJsonMember(object, &doc);
+
+    if (!member && !image) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    compiled = getJsonPath(path);
+
+    if (!compiled) {
+        ctx->Errno = ERROR_INVALID_JSON_PATH;
+        return NULL;
+    }
+
+    if (image)
+        return findImageValue(compiled, image);
+
+#ifdef JSON_STATS_COUNTERS
+    if (doc)
+        __atomic_fetch_add(&doc->Lookups, 1, __ATOMIC_RELAXED);
+#endif
+
+    return findJsonValue(ctx, compiled, member);
+}
+
+
+JSON_TYPE JSON_GetTypePCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                           JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_VALUE *value;
+    //------------------------
+
+    value = getJsonValue(ctx, object, path);
+
+    if (value == NULL)
+        return TYPE_UNKNOWN;
+    else if (value->Type == TYPE_LAZY_OBJECT)
+        return TYPE_OBJECT;
+    else if (value->Type == TYPE_LAZY_ARRAY)
+        return TYPE_ARRAY;
+    else
+        return value->Type;
+}
+
+
+JSON_TYPE JSON_GetTypeP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path)
+{
+    return JSON_GetTypePCtx(&default_context, object, path);
+}
+
+
+JSON_TYPE JSON_GetTypeCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    JSON_TYPE type;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    type = JSON_GetTypePCtx(ctx, object, compiled);
+    free(compiled);
+
+    return type;
+}
+
+
+JSON_TYPE JSON_GetType(JSON_OBJECT_HANDLE object, char *path)
+{
+    return JSON_GetTypeCtx(&default_context, object, path);
+}
+
+
+int JSON_GetBooleanPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                        JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_VALUE *value;
+    //------------------------
+
+    value = getJsonValue(ctx, object, path);
+
+    if ((value != NULL) && (value->Type == TYPE_BOOLEAN)) {
+        return value->Boolean;
+    }
+    else if (ctx->Errno == ERROR_INVALID_OBJECT) {
+        return 0;
+    }
+    else {
+        if (ctx->Errno == SUCCESS)
+            ctx->Errno = ERROR_INVALID_BOOLEAN;
+        return -ctx->Errno;
+    }
+}
+
+
+int JSON_GetBooleanP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path)
+{
+    return JSON_GetBooleanPCtx(&default_context, object, path);
+}
+
+
+int JSON_GetBooleanCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    int boolean;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    boolean = JSON_GetBooleanPCtx(ctx, object, compiled);
+    free(compiled);
+
+    return boolean;
+}
+
+
+int JSON_GetBoolean(JSON_OBJECT_HANDLE object, char *path)
+{
+    return JSON_GetBooleanCtx(&default_context, object, path);
+}
+
+
+double JSON_GetNumberPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                          JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_VALUE *value;
+    //------------------------
+
+    value = getJsonValue(ctx, object, path);
+
+    if ((value != NULL) && (value->Type == TYPE_NUMBER)) {
+        return value->Number;
+    }
+    else if ((value != NULL) && (value->Type == TYPE_INTEGER)) {
+        return (double)value->Integer;
+    }
+    else if (ctx->Errno == ERROR_INVALID_OBJECT) {
+        return -1;
+    }
+    else {
+        if (ctx->Errno == SUCCESS)
+            ctx->Errno = ERROR_INVALID_NUMBER;
+        return 0;
+    }
+}
+
+
+double JSON_GetNumberP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path)
+{
+    return JSON_GetNumberPCtx(&default_context, object, path);
+}
+
+
+double JSON_GetNumberCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    double number;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    number = JSON_GetNumberPCtx(ctx, object, compiled);
+    free(compiled);
+
+    return number;
+}
+
+
+double JSON_GetNumber(JSON_OBJECT_HANDLE object, char *path)
+{
+    return JSON_GetNumberCtx(&default_context, object, path);
+}
+
+
+int64_t JSON_GetInt64PCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                          JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_VALUE *value;
+    //------------------------
+
+    value = getJsonValue(ctx, object, path);
+
+    if ((value != NULL) && (value->Type == TYPE_INTEGER)) {
+        return value->Integer;
+    }
+    //  Whole doubles in range convert without loss.
+    else if ((value != NULL) && (value->Type == TYPE_NUMBER) &&
+             value->Number >= -9223372036854775808.0 &&
+             value->Number < 9223372036854775808.0 &&
+             (double)(int64_t)value->Number == value->Number) {
+        return (int64_t)value->Number;
+    }
+    else if (ctx->Errno == ERROR_INVALID_OBJECT) {
+        return -1;
+    }
+    else {
+        if (ctx->Errno == SUCCESS)
+            ctx->Errno = ERROR_INVALID_NUMBER;
+        return 0;
+    }
+}
+
+
+int64_t JSON_GetInt64P(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path)
+{
+    return JSON_GetInt64PCtx(&default_context, object, path);
+}
+
+
+int64_t JSON_GetInt64Ctx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    int64_t integer;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    integer = JSON_GetInt64PCtx(ctx, object, compiled);
+    free(compiled);
+
+    return integer;
+}
+
+
+int64_t JSON_GetInt64(JSON_OBJECT_HANDLE object, char *path)
+{
+    return JSON_GetInt64Ctx(&default_context, object, path);
+}
+
+
+char *JSON_GetStringPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                         JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_VALUE *value;
+    //------------------------
+
+    value = getJsonValue(ctx, object, path);
+
+    if ((value != NULL) && (value->Type == TYPE_STRING)) {
+        return value->String;
+    }
+    else {
+        if (ctx->Errno == SUCCESS)
+            ctx->Errno = ERROR_INVALID_STRING;
+        return NULL;
+    }
+}
+
+
+char *JSON_GetStringP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path)
+{
+    return JSON_GetStringPCtx(&default_context, object, path);
+}
+
+
+char *JSON_GetStringCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    char *string;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    string = JSON_GetStringPCtx(ctx, object, compiled);
+    free(compiled);
+
+    return string;
+}
+
+
+char *JSON_GetString(JSON_OBJECT_HANDLE object, char *path)
+{
+    return JSON_GetStringCtx(&default_context, object, path);
+}
+
+
+JSON_OBJECT_HANDLE JSON_GetObjectPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                                      JSON_PATH_HANDLE path)
+{
+    //------------------------
+    JSON_VALUE *value;
+    //------------------------
+
+    value = getJsonValue(ctx, object, path);
+
+    if ((value != NULL) && (loadPathValue(ctx, value) != 0))
+        return NULL;
+
+    if ((value != NULL) && (value->Type == TYPE_OBJECT)){
+        return value->Object;
+    }
+    else {
+        if (ctx->Errno == SUCCESS)
+            ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+}
+
+
+JSON_OBJECT_HANDLE JSON_GetObjectP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path)
+{
+    return JSON_GetObjectPCtx(&default_context, object, path);
+}
+
+
+JSON_OBJECT_HANDLE JSON_GetObjectCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                                     char *path)
+{
+    //------------------------
+    JSON_PATH *compiled;
+    JSON_OBJECT_HANDLE found;
+    JSON_ERROR rc;
+    //------------------------
+
+    compiled = compilePath(path, &rc);
+    found = JSON_GetObjectPCtx(ctx, object, compiled);
+    free(compiled);
+
+    return found;
+}
+
+
+JSON_OBJECT_HANDLE JSON_GetObject(JSON_OBJECT_HANDLE object, char *path)
+{
+    return JSON_GetObjectCtx(&default_context, object, path);
+}
+
+
+JSON_OBJECT_HANDLE JSON_AllocObject(void)
+{
+    //---------------------------
+    JSON_MEMBER *member;
+    //---------------------------
+
+    default_context.Errno = SUCCESS;
+
+    member = allocJsonMember(NULL);
+
+    return member;
+}
+
+
+//
+//  Integers and doubles are both numbers, so either replaces the other.
+//
+static int isSameValueType(JSON_TYPE existing, JSON_TYPE added)
+{
+    if (existing == TYPE_INTEGER)
+        existing = TYPE_NUMBER;
+    if (added == TYPE_INTEGER)
+        added = TYPE_NUMBER;
+
+    return existing == added;
+}
+
+
+//
+//  Paths through objects that are not there yet get new, empty ones.
+//
+static JSON_VALUE *allocEmptyObjectValue(JSON_DOCUMENT *doc)
+{
+    //-----------------------------
+    JSON_VALUE *value;
+    //-----------------------------
+
+    value = allocJsonValue(doc);
+    if (!value)
+        return NULL;
+
+    value->Type = TYPE_OBJECT;
+    value->Object = allocJsonMember(doc);
+
+    if (!value->Object) {
+        if (!usesArena(doc))
+            freeJsonValue(doc, value);
+        return NULL;
+    }
+
+    return value;
+}
+
+
+static JSON_ERROR jsonAddValue(JSON_DOCUMENT *doc, JSON_MEMBER *root_member,
+                               char *path, JSON_VALUE *value)
+{
+    //-----------------------------
+    char *name1;
+    char *name2;
+    char *path_copy;
+    char *save_ptr;
+    int member_should_be_object;
+    JSON_ERROR rc = SUCCESS;
+    JSON_MEMBER *found_member;
+    JSON_MEMBER *new_member;
+    JSON_VALUE *object_value;
+    //-----------------------------
+
+    ASSERT_SIGNATURE(root_member, JSON_MEMBER_SIGNATURE);
+
+    path_copy = strdup(path);
+
+    name1 = strtok_r(path_copy, ".", &save_ptr);
+
+    do {
+        name2 = strtok_r(NULL, ".", &save_ptr);
+        if (name2)
+            member_should_be_object = 1;
+        else
+            member_should_be_object = 0;
+
+        //  We need to special case the first one, since we'll have an
+        //  empty Member at first.
+        if (!root_member->Name && !root_member->Value) {
+
+            if (member_should_be_object) {
+                object_value = allocEmptyObjectValue(doc);
+                if (!object_value) {
+                    rc = ERROR_ALLOC_FAILED;
+                    break;
+                }
+                root_member->Name = jsonStrdup(doc, name1);
+                root_member->Value = object_value;
+                name1 = name2;
+                root_member = object_value->Object;
+                continue;
+            }
+            else {
+                root_member->Name = jsonStrdup(doc, name1);
+                root_member->Value = value;
+                break;
+            }
+        }
+
+        found_member = findJsonMemberInObject(root_member, name1);
+
+        //  Lazy containers are parsed before they are added to.
+        if (found_member && found_member->Value &&
+            isLazyValue(found_member->Value)) {
+            rc = loadLazyValue(found_member->Value);
+            if (rc != SUCCESS)
+                break;
+        }
+
+        if (!found_member) {
+
+            //  Everything the member needs is allocated before it is
+            //  linked, so a failure leaves the object as it was.
+            object_value = NULL;
+            if (member_should_be_object) {
+                object_value = allocEmptyObjectValue(doc);
+                if (!object_value) {
+                    rc = ERROR_ALLOC_FAILED;
+                    break;
+                }
+            }
+
+            new_member = allocJsonMember(doc);
+            if (!new_member) {
+                if (object_value && !usesArena(doc))
+                    freeJsonValue(doc, object_value);
+                rc = ERROR_ALLOC_FAILED;
+                break;
+            }
+            new_member->Name = jsonStrdup(doc, name1);
+
+            if (member_should_be_object) {
+                new_member->Value = object_value;
+                addJsonMemberToObject(root_member, new_member);
+                name1 = name2;
+                root_member = object_value->Object;
+            }
+            else {
+                new_member->Value = value;
+                addJsonMemberToObject(root_member, new_member);
+                break;
+            }
+        }
+        // This is a value and there isn't any value in it.
+        else if (!member_should_be_object && !found_member->Value) {
+            found_member->Value = value;
+            break;
+        }
+        else if (!member_should_be_object &&
+                  isSameValueType(found_member->Value->Type, value->Type)) {
+            if (!usesArena(doc))
+                freeMemberValue(doc, found_member);
+            found_member->Value = value;
+            break;
+        }
+        else if (member_should_be_object && found_member->Value &&
+                 (found_member->Value->Type == TYPE_OBJECT)) {
+            name1 = name2;
+            root_member = found_member->Value->Object;
+        }
+        else {
+            rc = ERROR_TYPE_MISMATCH;
+            break;
+        }
+
+    } while (1);
+
+    free(path_copy);
+
+    //  The value was never linked, so nothing else will free it.
+    if ((rc != SUCCESS) && !usesArena(doc))
+        freeJsonValue(doc, value);
+
+    return rc;
+}
+
+
+JSON_ERROR JSON_AddBoolean(JSON_OBJECT_HANDLE object, char *path, int value)
+{
+    //-----------------------------
+    JSON_VALUE *json_value;
+    JSON_ERROR rc = SUCCESS;
+    JSON_MEMBER *member;
+    JSON_DOCUMENT *doc;
+    //-----------------------------
+
+    default_context.Errno = SUCCESS;
+    member = getJsonMember(object, &doc);
+
+    if (!path) {
+        default_context.Errno = ERROR_INVALID_JSON_PATH;
+        return ERROR_INVALID_JSON_PATH;
+    }
+
+    if (!member) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return default_context.Errno;
+    }
+
+    json_value = allocJsonValue(doc);
+    if (!json_value) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return default_context.Errno;
+    }
+
+    json_value->Type = TYPE_BOOLEAN;
+    json_value->Boolean = value ? 1 : 0;
+
+    rc = jsonAddValue(doc, member, path, json_value);
+
+    return rc;
+}
+
+
+JSON_ERROR JSON_AddString(JSON_OBJECT_HANDLE object, char *path, char *value)
+{
+    //-----------------------------
+    JSON_VALUE *json_value;
+    JSON_ERROR rc = SUCCESS;
+    JSON_MEMBER *member;
+    JSON_DOCUMENT *doc;
+    //-----------------------------
+
+    default_context.Errno = SUCCESS;
+    member = getJsonMember(object, &doc);
+
+    if (!path) {
+        default_context.Errno = ERROR_INVALID_JSON_PATH;
+        return ERROR_INVALID_JSON_PATH;
+    }
+
+    if (!member) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return default_context.Errno;
+    }
+
+    json_value = allocJsonValue(doc);
+    if (!json_value) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return default_context.Errno;
+    }
+
+    json_value->Type = TYPE_STRING;
+    json_value->String = jsonStrdup(doc, value);
+
+    rc = jsonAddValue(doc, member, path, json_value);
+
+    return rc;
+}
+
+
+JSON_ERROR JSON_AddNumber(JSON_OBJECT_HANDLE object, char *path, double value)
+{
+    //-----------------------------
+    JSON_VALUE *json_value;
+    JSON_ERROR rc = SUCCESS;
+    JSON_MEMBER *member;
+    JSON_DOCUMENT *doc;
+    //-----------------------------
+
+    default_context.Errno = SUCCESS;
+    member = getJsonMember(object, &doc);
+
+    if (!path) {
+        default_context.Errno = ERROR_INVALID_JSON_PATH;
+        return ERROR_INVALID_JSON_PATH;
+    }
+
+    if (!member) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return default_context.Errno;
+    }
+
+    json_value = allocJsonValue(doc);
+    if (!json_value) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return default_context.Errno;
+    }
+
+    json_value->Type = TYPE_NUMBER;
+    json_value->Number = value;
+
+    rc = jsonAddValue(doc, member, path, json_value);
+
+    return rc;
+}
+
+
+JSON_ERROR JSON_AddInt64(JSON_OBJECT_HANDLE object, char *path, int64_t value)
+{
+    //-----------------------------
+    JSON_VALUE *json_value;
+    JSON_ERROR rc = SUCCESS;
+    JSON_MEMBER *member;
+    JSON_DOCUMENT *doc;
+    //-----------------------------
+
+    default_context.Errno = SUCCESS;
+    member = getJsonMember(object, &doc);
+
+    if (!path) {
+        default_context.Errno = ERROR_INVALID_JSON_PATH;
+        return ERROR_INVALID_JSON_PATH;
+    }
+
+    if (!member) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return default_context.Errno;
+    }
+
+    json_value = allocJsonValue(doc);
+    if (!json_value) {
+        default_context.Errno = ERROR_ALLOC_FAILED;
+        return default_context.Errno;
+    }
+
+    json_value->Type = TYPE_INTEGER;
+    json_value->Integer = value;
+
+    rc = jsonAddValue(doc, member, path, json_value);
+
+    return rc;
+}
+
+
+//
+//  The builder appends straight to the open objects and arrays of a new
+//  arena document, without any path to parse or member to look up. Each
+//  open container has a frame: objects keep where their next member is
+//  linked, arrays the array itself. The first error sticks, and every
+//  call after it fails with the same error.
+//
+#define JSON_BUILDER_SIGNATURE 0x6C64624A
+
+
+typedef struct _BUILDER_FRAME {
+
+    JSON_TYPE Type;
+    JSON_MEMBER **First;
+    JSON_MEMBER **Link;
+    JSON_ARRAY *Array;
+
+} BUILDER_FRAME;
+
+
+typedef struct _JSON_BUILDER {
+
+    int Signature;
+    JSON_DOCUMENT *Document;
+    JSON_CONTEXT *Context;
+    JSON_ERROR Error;
+    BUILDER_FRAME *Frames;
+    size_t Depth;
+    size_t MaxDepth;
+
+} JSON_BUILDER;
+
+
+static JSON_BUILDER *getJsonBuilder(JSON_BUILDER_HANDLE builder)
+{
+    //--------------------------
+    JSON_BUILDER *b = builder;
+    //--------------------------
+
+    if (b && b->Signature == JSON_BUILDER_SIGNATURE)
+        return b;
+
+    return NULL;
+}
+
+
+static JSON_ERROR builderError(JSON_BUILDER *b, JSON_ERROR rc)
+{
+    if (b->Error == SUCCESS)
+        b->Error = rc;
+
+    b->Context->Errno = b->Error;
+
+    return b->Error;
+}
+
+
+static JSON_ERROR pushBuilderFrame(JSON_BUILDER *b, JSON_TYPE type,
+                                   JSON_MEMBER **first, JSON_ARRAY *array)
+{
+    //--------------------------
+    BUILDER_FRAME *frames;
+    BUILDER_FRAME *frame;
+    size_t max_depth;
+    //--------------------------
+
+    if (b->Depth == b->MaxDepth) {
+        max_depth = b->MaxDepth ? b->MaxDepth * 2 : 16;
+        frames = (BUILDER_FRAME *)realloc(b->Frames,
+                                          max_depth * sizeof(BUILDER_FRAME));
+        if (!frames)
+            return builderError(b, ERROR_ALLOC_FAILED);
+        b->Frames = frames;
+        b->MaxDepth = max_depth;
+    }
+
+    frame = &b->Frames[b->Depth++];
+    frame->Type = type;
+    frame->First = first;
+    frame->Link = first;
+    frame->Array = array;
+
+    return SUCCESS;
+}
+
+
+//
+//  Returns the new, empty value for the next member of the open object,
+//  which needs a name, or the next element of the open array, which must
+//  not have one.
+//
+static JSON_VALUE *builderAddValue(JSON_BUILDER *b, char *name)
+{
+    //--------------------------
+    JSON_DOCUMENT *doc = b->Document;
+    BUILDER_FRAME *frame;
+    JSON_MEMBER *member;
+    JSON_VALUE *value;
+    //--------------------------
+
+    if (b->Error != SUCCESS) {
+        builderError(b, b->Error);
+        return NULL;
+    }
+
+    frame = &b->Frames[b->Depth - 1];
+
+    if (frame->Type == TYPE_ARRAY) {
+
+        if (name) {
+            builderError(b, ERROR_INVALID_ARRAY);
+            return NULL;
+        }
+
+        if (frame->Array->Count == frame->Array->Capacity &&
+            growJsonArray(doc, frame->Array) != 0) {
+            builderError(b, ERROR_ALLOC_FAILED);
+            return NULL;
+        }
+
+        value = &frame->Array->Values[frame->Array->Count++];
+        memset(value, 0, sizeof(JSON_VALUE));
+        value->Signature = JSON_VALUE_SIGNATURE;
+    }
+    else {
+
+        if (!name) {
+            builderError(b, ERROR_INVALID_OBJECT);
+            return NULL;
+        }
+
+        member = allocJsonNode(doc);
+        if (!member) {
+            builderError(b, ERROR_ALLOC_FAILED);
+            return NULL;
+        }
+        value = member->Value;
+
+        member->Name = jsonStrdup(doc, name);
+        if (!member->Name) {
+            builderError(b, ERROR_ALLOC_FAILED);
+            return NULL;
+        }
+
+        *frame->Link = member;
+        frame->Link = &member->Next;
+    }
+
+    b->Context->Errno = SUCCESS;
+
+    return value;
+}
+
+
+//
+//  An object closed without members gets the empty member that
+//  JSON_AllocObject() also starts with.
+//
+static JSON_ERROR closeBuilderFrame(JSON_BUILDER *b)
+{
+    //--------------------------
+    BUILDER_FRAME *frame;
+    //--------------------------
+
+    frame = &b->Frames[b->Depth - 1];
+
+    if (frame->Type == TYPE_OBJECT && !*frame->First) {
+        *frame->First = allocJsonMember(b->Document);
+        if (!*frame->First)
+            return builderError(b, ERROR_ALLOC_FAILED);
+    }
+
+    b->Depth--;
+
+    return SUCCESS;
+}
+
+
+JSON_BUILDER_HANDLE JSON_BuilderBeginCtx(JSON_CONTEXT *ctx, size_t size_hint)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    //--------------------------
+
+    ctx->Errno = SUCCESS;
+
+    if (size_hint < ARENA_FIRST_CHUNK_SIZE)
+        size_hint = ARENA_FIRST_CHUNK_SIZE;
+
+    b = (JSON_BUILDER *)calloc(1, sizeof(JSON_BUILDER));
+    if (!b) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    b->Signature = JSON_BUILDER_SIGNATURE;
+    b->Context = ctx;
+    b->Document = allocJsonDocument(size_hint);
+
+    if (!b->Document ||
+        pushBuilderFrame(b, TYPE_OBJECT, &b->Document->Root, NULL) != SUCCESS) {
+        if (b->Document)
+            freeArenaChunks(b->Document);
+        free(b->Frames);
+        free(b);
+        ctx->Errno = ERROR_ALLOC_FAILED;
+        return NULL;
+    }
+
+    return b;
+}
+
+
+JSON_BUILDER_HANDLE JSON_BuilderBegin(size_t size_hint)
+{
+    return JSON_BuilderBeginCtx(&default_context, size_hint);
+}
+
+
+JSON_ERROR JSON_BuilderBeginObject(JSON_BUILDER_HANDLE builder, char *name)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_VALUE *value;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    value = builderAddValue(b, name);
+    if (!value)
+        return b->Error;
+
+    value->Type = TYPE_OBJECT;
+
+    return pushBuilderFrame(b, TYPE_OBJECT, &value->Object, NULL);
+}
+
+
+JSON_ERROR JSON_BuilderBeginArray(JSON_BUILDER_HANDLE builder, char *name,
+                                  size_t capacity_hint)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_VALUE *value;
+    JSON_ARRAY *array;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    value = builderAddValue(b, name);
+    if (!value)
+        return b->Error;
+
+    array = allocJsonArray(b->Document);
+    if (!array)
+        return builderError(b, ERROR_ALLOC_FAILED);
+
+    if (capacity_hint && capacity_hint <= SIZE_MAX / sizeof(JSON_VALUE)) {
+        array->Values = (JSON_VALUE *)jsonAlloc(b->Document,
+                                                capacity_hint * sizeof(JSON_VALUE));
+        if (!array->Values)
+            return builderError(b, ERROR_ALLOC_FAILED);
+        array->Capacity = capacity_hint;
+    }
+
+    value->Type = TYPE_ARRAY;
+    value->Array = array;
+
+    return pushBuilderFrame(b, TYPE_ARRAY, NULL, array);
+}
+
+
+JSON_ERROR JSON_BuilderEnd(JSON_BUILDER_HANDLE builder)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    if (b->Error != SUCCESS)
+        return builderError(b, b->Error);
+
+    //  The root object is closed by JSON_BuilderFinish().
+    if (b->Depth == 1)
+        return builderError(b, ERROR_INVALID_OBJECT);
+
+    b->Context->Errno = SUCCESS;
+
+    return closeBuilderFrame(b);
+}
+
+
+JSON_ERROR JSON_BuilderAddString(JSON_BUILDER_HANDLE builder, char *name,
+                                 char *value)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_VALUE *json_value;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    if (!value)
+        return builderError(b, ERROR_INVALID_STRING);
+
+    json_value = builderAddValue(b, name);
+    if (!json_value)
+        return b->Error;
+
+    json_value->Type = TYPE_STRING;
+    json_value->String = jsonStrdup(b->Document, value);
+    if (!json_value->String)
+        return builderError(b, ERROR_ALLOC_FAILED);
+
+    return SUCCESS;
+}
+
+
+JSON_ERROR JSON_BuilderAddNumber(JSON_BUILDER_HANDLE builder, char *name,
+                                 double value)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_VALUE *json_value;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    json_value = builderAddValue(b, name);
+    if (!json_value)
+        return b->Error;
+
+    json_value->Type = TYPE_NUMBER;
+    json_value->Number = value;
+
+    return SUCCESS;
+}
+
+
+JSON_ERROR JSON_BuilderAddInt64(JSON_BUILDER_HANDLE builder, char *name,
+                                int64_t value)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_VALUE *json_value;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    json_value = builderAddValue(b, name);
+    if (!json_value)
+        return b->Error;
+
+    json_value->Type = TYPE_INTEGER;
+    json_value->Integer = value;
+
+    return SUCCESS;
+}
+
+
+JSON_ERROR JSON_BuilderAddBoolean(JSON_BUILDER_HANDLE builder, char *name,
+                                  int value)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_VALUE *json_value;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    json_value = builderAddValue(b, name);
+    if (!json_value)
+        return b->Error;
+
+    json_value->Type = TYPE_BOOLEAN;
+    json_value->Boolean = value ? 1 : 0;
+
+    return SUCCESS;
+}
+
+
+JSON_OBJECT_HANDLE JSON_BuilderFinish(JSON_BUILDER_HANDLE builder)
+{
+    //--------------------------
+    JSON_BUILDER *b;
+    JSON_DOCUMENT *doc;
+    JSON_CONTEXT *ctx;
+    //--------------------------
+
+    b = getJsonBuilder(builder);
+    if (!b) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
+
+    ctx = b->Context;
+    doc = b->Document;
+
+    //  Every object and array must have been ended.
+    if (b->Error == SUCCESS && b->Depth != 1)
+        builderError(b, ERROR_INVALID_OBJECT);
+
+    if (b->Error == SUCCESS)
+        closeBuilderFrame(b);
+
+    ctx->Errno = b->Error;
+
+    if (b->Error != SUCCESS) {
+        freeArenaChunks(doc);
+        doc = NULL;
+    }
+
+    b->Signature = 0;
+    free(b->Frames);
+    free(b);
+
+    return doc;
+}
+
+
+//
+//  The push parser is a state machine over the bytes as they arrive,
+//  raising an event for each value. Tokens that are whole inside one
+//  chunk are used where they are. Only a token cut by the end of a chunk
+//  is copied to Token, and completed there from the next chunks. Names
+//  and strings are unescaped into Name and Text. Stack holds the open
+//  containers, so the parser itself needs memory only for the depth of
+//  the document and its longest token.
+//
+//  JSON_ParserCreate() gives the parser the builder events below, which
+//  build the document. JSON_ParserCreateSax() gives it the caller's.
+//
+#define JSON_PARSER_SIGNATURE 0x7372704A
+
+
+typedef enum _PUSH_STATE {
+
+    PUSH_START,
+    PUSH_FIRST_NAME,
+    PUSH_NAME,
+    PUSH_NAME_STRING,
+    PUSH_COLON,
+    PUSH_FIRST_VALUE,
+    PUSH_VALUE,
+    PUSH_VALUE_STRING,
+    PUSH_NUMBER,
+    PUSH_LITERAL,
+    PUSH_AFTER_VALUE,
+    PUSH_DONE
+
+} PUSH_STATE;
+
+
+typedef struct _JSON_PARSER {
+
+    int Signature;
+    JSON_CONTEXT *Context;
+    JSON_ERROR Error;
+    PUSH_STATE State;
+    int Escape;
+    int Buffered;
+    char *Token;
+    size_t TokenLength;
+    size_t TokenSize;
+    char *Name;
+    size_t NameSize;
+    char *Text;
+    size_t TextSize;
+    char *Stack;
+    int Depth;
+    int StackSize;
+    const JSON_SAX_CALLBACKS *Events;
+    void *User;
+    JSON_BUILDER *Builder;
+
+} JSON_PARSER;
+
+
+static JSON_PARSER *getJsonParser(JSON_PARSER_HANDLE parser)
+{
+    //--------------------------
+    JSON_PARSER *p = parser;
+    //--------------------------
+
+    if (p && p->Signature == JSON_PARSER_SIGNATURE)
+        return p;
+
+    return NULL;
+}
+
+
+static JSON_ERROR pushError(JSON_PARSER *p, JSON_ERROR rc)
+{
+    if (p->Error == SUCCESS)
+        p->Error = rc;
+
+    p->Context->Errno = p->Error;
+
+    return p->Error;
+}
+
+
+//
+//  A callback returned stop, unless it was one of the builder's, which
+//  has set its own error already.
+//
+static int pushEvent(JSON_PARSER *p, int stop)
+{
+    if (stop)
+        return pushError(p, ERROR_STOPPED);
+
+    return SUCCESS;
+}
+
+
+static int appendToken(JSON_PARSER *p, const char *data, size_t length)
+{
+    //--------------------------
+    char *token;
+    size_t size;
+    //--------------------------
+
+    if (p->TokenLength + length + 1 > p->TokenSize) {
+        size = p->TokenSize ? p->TokenSize : 256;
+        while (size < p->TokenLength + length + 1)
+            size *= 2;
+        token = (char *)realloc(p->Token, size);
+        if (!token)
+            return -1;
+        p->Token = token;
+        p->TokenSize = size;
+    }
+
+    memcpy(p->Token + p->TokenLength, data, length);
+    p->TokenLength += length;
+    p->Token[p->TokenLength] = 0;
+
+    return 0;
+}
+
+
+//
+//  Returns the whole token, ending at end in the current chunk. It is
+//  either still where it started, or completed in Token.
+//
+static const char *finishToken(JSON_PARSER *p, const char *start,
+                               const char *end, size_t *length)
+{
+    if (!p->Buffered) {
+        *length = end - start;
+        return start;
+    }
+
+    if (appendToken(p, start, end - start) != 0)
+        return NULL;
+
+    p->Buffered = 0;
+    *length = p->TokenLength;
+    p->TokenLength = 0;
+
+    return p->Token;
+}
+
+
+static int pushContainer(JSON_PARSER *p, char c)
+{
+    //--------------------------
+    char *stack;
+    //--------------------------
+
+    if (p->Depth == p->StackSize) {
+        stack = (char *)realloc(p->Stack, p->StackSize * 2);
+        if (!stack)
+            return pushError(p, ERROR_ALLOC_FAILED);
+        p->Stack = stack;
+        p->StackSize *= 2;
+    }
+
+    p->Stack[p->Depth++] = c;
+
+    return SUCCESS;
+}
+
+
+//
+//  Returns the value for the next member or element of the document
+//  being built, with the name that is waiting for it if in an object.
+//
+static JSON_VALUE *pushValue(JSON_PARSER *p)
+{
+    //--------------------------
+    JSON_BUILDER *b = p->Builder;
+    JSON_VALUE *value;
+    //--------------------------
+
+    value = builderAddValue(b, b->Frames[b->Depth - 1].Type == TYPE_OBJECT ?
+                               p->Name : NULL);
+    if (!value)
+        pushError(p, b->Error);
+
+    return value;
+}
+
+
+//
+//  The events of JSON_ParserCreate(). The root object is the builder's
+//  first frame, and is closed by JSON_BuilderFinish(). Names are taken
+//  from Name when their value arrives.
+//
+static int buildObjectBegin(void *user)
+{
+    //--------------------------
+    JSON_PARSER *p = user;
+    JSON_VALUE *value;
+    //--------------------------
+
+    if (p->Depth == 0)
+        return 0;
+
+    value = pushValue(p);
+    if (!value)
+        return 1;
+
+    value->Type = TYPE_OBJECT;
+    if (pushBuilderFrame(p->Builder, TYPE_OBJECT, &value->Object,
+                         NULL) != SUCCESS) {
+        pushError(p, p->Builder->Error);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int buildArrayBegin(void *user)
+{
+    //--------------------------
+    JSON_PARSER *p = user;
+    JSON_VALUE *value;
+    JSON_ARRAY *array;
+    //--------------------------
+
+    value = pushValue(p);
+    if (!value)
+        return 1;
+
+    array = allocJsonArray(p->Builder->Document);
+    if (!array) {
+        pushError(p, ERROR_ALLOC_FAILED);
+        return 1;
+    }
+
+    value->Type = TYPE_ARRAY;
+    value->Array = array;
+    if (pushBuilderFrame(p->Builder, TYPE_ARRAY, NULL, array) != SUCCESS) {
+        pushError(p, p->Builder->Error);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int buildContainerEnd(void *user)
+{
+    //--------------------------
+    JSON_PARSER *p = user;
+    //--------------------------
+
+    if (p->Depth == 0)
+        return 0;
+
+    if (closeBuilderFrame(p->Builder) != SUCCESS) {
+        pushError(p, p->Builder->Error);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int buildString(void *user, const char *string, size_t length)
+{
+    //--------------------------
+    JSON_PARSER *p = user;
+    JSON_VALUE *value;
+    char *copy;
+    //--------------------------
+
+    value = pushValue(p);
+    if (!value)
+        return 1;
+
+    copy = (char *)jsonAlloc(p->Builder->Document, length + 1);
+    if (!copy) {
+        pushError(p, ERROR_ALLOC_FAILED);
+        return 1;
+    }
+
+    memcpy(copy, string, length + 1);
+    value->Type = TYPE_STRING;
+    value->String = copy;
+
+    return 0;
+}
+
+
+static int buildNumber(void *user, double number)
+{
+    //--------------------------
+    JSON_VALUE *value;
+    //--------------------------
+
+    value = pushValue(user);
+    if (!value)
+        return 1;
+
+    value->Type = TYPE_NUMBER;
+    value->Number = number;
+
+    return 0;
+}
+
+
+static int buildInteger(void *user, int64_t integer)
+{
+    //--------------------------
+    JSON_VALUE *value;
+    //--------------------------
+
+    value = pushValue(user);
+    if (!value)
+        return 1;
+
+    value->Type = TYPE_INTEGER;
+    value->Integer = integer;
+
+    return 0;
+}
+
+
+static int buildBoolean(void *user, int boolean)
+{
+    //--------------------------
+    JSON_VALUE *value;
+    //--------------------------
+
+    value = pushValue(user);
+    if (!value)
+        return 1;
+
+    value->Type = TYPE_BOOLEAN;
+    value->Boolean = boolean;
+
+    return 0;
+}
+
+
+static const JSON_SAX_CALLBACKS build_events = {
+    buildObjectBegin,
+    buildContainerEnd,
+    buildArrayBegin,
+    buildContainerEnd,
+    NULL,
+    buildString,
+    buildNumber,
+    buildInteger,
+    buildBoolean
+};
+
+
+//
+//  Unescapes the string ending at end into Name or Text, and raises its
+//  event.
+//
+static int pushString(JSON_PARSER *p, const char *start, const char *end)
+{
+    //--------------------------
+    const char *text;
+    char **dest;
+    size_t *size;
+    char *buffer;
+    size_t length;
+    long result;
+    //--------------------------
+
+    text = finishToken(p, start, end, &length);
+    if (!text)
+        return pushError(p, ERROR_ALLOC_FAILED);
+
+    if (p->State == PUSH_NAME_STRING) {
+        dest = &p->Name;
+        size = &p->NameSize;
+    }
+    else {
+        dest = &p->Text;
+        size = &p->TextSize;
+    }
+
+    if (length + 1 > *size) {
+        buffer = (char *)realloc(*dest, length + 1);
+        if (!buffer)
+            return pushError(p, ERROR_ALLOC_FAILED);
+        *dest = buffer;
+        *size = length + 1;
+    }
+
+    result = unescapeJsonString(*dest, text, length);
+    if (result < 0)
+        return pushError(p, ERROR_INVALID_STRING);
+
+    (*dest)[result] = 0;
+
+    if (p->State == PUSH_NAME_STRING) {
+        if (p->Events->OnKey)
+            return pushEvent(p, p->Events->OnKey(p->User, p->Name, result));
+    }
+    else if (p->Events->OnString) {
+        return pushEvent(p, p->Events->OnString(p->User, p->Text, result));
+    }
+
+    return SUCCESS;
+}
+
+
+static int pushScalar(JSON_PARSER *p, const char *start, const char *end)
+{
+    //--------------------------
+    const JSON_SAX_CALLBACKS *events = p->Events;
+    const char *text;
+    size_t length;
+    NUMBER_TEXT number;
+    JSON_VALUE value;
+    JSON_ERROR rc;
+    int boolean;
+    //--------------------------
+
+    text = finishToken(p, start, end, &length);
+    if (!text)
+        return pushError(p, ERROR_ALLOC_FAILED);
+
+    if (p->State == PUSH_LITERAL) {
+        if (length == 4 && memcmp(text, "true", 4) == 0)
+            boolean = 1;
+        else if (length == 5 && memcmp(text, "false", 5) == 0)
+            boolean = 0;
+        else
+            return pushError(p, ERROR_INVALID_BOOLEAN);
+
+        if (events->OnBoolean)
+            return pushEvent(p, events->OnBoolean(p->User, boolean));
+        return SUCCESS;
+    }
+
+    if (lexJsonNumber((char *)text, (char *)text + length, &number) !=
+        text + length)
+        return pushError(p, ERROR_INVALID_NUMBER);
+
+    rc = convertJsonNumber(&number, &value);
+    if (rc != SUCCESS)
+        return pushError(p, rc);
+
+    if (value.Type == TYPE_INTEGER) {
+        if (events->OnInteger)
+            return pushEvent(p, events->OnInteger(p->User, value.Integer));
+        value.Number = (double)value.Integer;
+    }
+
+    if (events->OnNumber)
+        return pushEvent(p, events->OnNumber(p->User, value.Number));
+
+    return SUCCESS;
+}
+
 
-    // We didn't find the value, so cleanup.
-FIND_FAILED:
-    free(path_copy);
-    return NULL;
+static inline int isNumberChar(char c)
+{
+    return isJsonDigit(c) || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
 }
 
 
-JSON_TYPE JSON_GetType(JSON_OBJECT_HANDLE object, char *path)
+//
+//  Opens an object or array. Its begin event sees the depth of the
+//  container it is in.
+//
+static int pushBegin(JSON_PARSER *p, char c)
 {
-    //------------------------
-    JSON_VALUE *value;
-    JSON_MEMBER *member;
-    //------------------------
+    //--------------------------
+    int (*event)(void *user);
+    //--------------------------
 
-    JSON_Errno = SUCCESS;
-    member = object;
+    event = (c == '{') ? p->Events->OnObjectBegin : p->Events->OnArrayBegin;
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return TYPE_UNKNOWN;
-    }
+    if (event && pushEvent(p, event(p->User)) != SUCCESS)
+        return p->Error;
 
-    value = findJsonValue(path, member);
+    if (pushContainer(p, c) != SUCCESS)
+        return p->Error;
 
-    if (value != NULL)
-        return value->Type;
-    else
-        return TYPE_UNKNOWN;
+    p->State = (c == '{') ? PUSH_FIRST_NAME : PUSH_FIRST_VALUE;
+
+    return SUCCESS;
 }
 
 
-int JSON_GetBoolean(JSON_OBJECT_HANDLE object, char *path)
+//
+//  Closes the innermost container with c, which must match it.
+//
+static int pushEnd(JSON_PARSER *p, char c)
 {
-    //------------------------
-    JSON_VALUE *value;
-    JSON_MEMBER *member;
-    //------------------------
+    //--------------------------
+    int (*event)(void *user);
+    //--------------------------
 
-    JSON_Errno = SUCCESS;
-    member = object;
+    if (c != (p->Stack[p->Depth - 1] == '{' ? '}' : ']'))
+        return pushError(p, p->Stack[p->Depth - 1] == '{' ?
+                            ERROR_INVALID_OBJECT : ERROR_INVALID_ARRAY);
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return 0;
-    }
+    p->Depth--;
+    p->State = p->Depth ? PUSH_AFTER_VALUE : PUSH_DONE;
 
-    value = findJsonValue(path, object);
+    event = (c == '}') ? p->Events->OnObjectEnd : p->Events->OnArrayEnd;
 
-    if ((value != NULL) && (value->Type == TYPE_BOOLEAN)) {
-        return value->Boolean;
-    }
-    else {
-        JSON_Errno = ERROR_INVALID_BOOLEAN;
-        return -ERROR_INVALID_BOOLEAN;
-    }
+    if (event)
+        return pushEvent(p, event(p->User));
+
+    return SUCCESS;
 }
 
 
-double JSON_GetNumber(JSON_OBJECT_HANDLE object, char *path)
+//
+//  A value starts with c. Containers are opened right away, strings and
+//  scalars once their last byte is seen.
+//
+static int pushValueStart(JSON_PARSER *p, char c)
 {
-    //------------------------
-    JSON_VALUE *value;
-    JSON_MEMBER *member;
-    //------------------------
+    if (c == '"')
+        p->State = PUSH_VALUE_STRING;
+    else if (c == 't' || c == 'f')
+        p->State = PUSH_LITERAL;
+    else if (c == '-' || isJsonDigit(c))
+        p->State = PUSH_NUMBER;
+    else if (c == '{' || c == '[')
+        return pushBegin(p, c);
+    else
+        return pushError(p, ERROR_INVALID_VALUE_TYPE);
 
-    JSON_Errno = SUCCESS;
-    member = object;
+    return SUCCESS;
+}
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return -1;
-    }
 
-    value = findJsonValue(path, member);
+static void initJsonParser(JSON_PARSER *p, JSON_CONTEXT *ctx,
+                           const JSON_SAX_CALLBACKS *events, void *user)
+{
+    memset(p, 0, sizeof(JSON_PARSER));
 
-    if ((value != NULL) && (value->Type == TYPE_NUMBER)) {
-        return value->Number;
-    }
-    else {
-        JSON_Errno = ERROR_INVALID_NUMBER;
-        return 0;
-    }
+    p->Signature = JSON_PARSER_SIGNATURE;
+    p->Context = ctx;
+    p->State = PUSH_START;
+    p->Events = events;
+    p->User = user;
 }
 
 
-char *JSON_GetString(JSON_OBJECT_HANDLE object, char *path)
+static void releaseJsonParser(JSON_PARSER *p)
 {
-    //------------------------
-    JSON_VALUE *value;
-    JSON_MEMBER *member;
-    //------------------------
+    p->Signature = 0;
+    free(p->Token);
+    free(p->Name);
+    free(p->Text);
+    free(p->Stack);
+}
 
-    JSON_Errno = SUCCESS;
-    member = object;
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return NULL;
-    }
+static JSON_PARSER *createJsonParser(JSON_CONTEXT *ctx,
+                                     const JSON_SAX_CALLBACKS *events,
+                                     void *user)
+{
+    //--------------------------
+    JSON_PARSER *p;
+    //--------------------------
 
-    value = findJsonValue(path, member);
+    ctx->Errno = SUCCESS;
 
-    if ((value != NULL) && (value->Type == TYPE_STRING)) {
-        return value->String;
-    }
-    else {
-        JSON_Errno = ERROR_INVALID_STRING;
+    p = (JSON_PARSER *)malloc(sizeof(JSON_PARSER));
+    if (!p) {
+        ctx->Errno = ERROR_ALLOC_FAILED;
         return NULL;
     }
+
+    initJsonParser(p, ctx, events, user);
+
+    return p;
 }
 
 
-JSON_OBJECT_HANDLE JSON_GetObject(JSON_OBJECT_HANDLE object, char *path)
+JSON_PARSER_HANDLE JSON_ParserCreateCtx(JSON_CONTEXT *ctx)
 {
-    //------------------------
-    JSON_VALUE *value;
-    JSON_MEMBER *member;
-    //------------------------
-
-    JSON_Errno = SUCCESS;
-    member = object;
+    //--------------------------
+    JSON_PARSER *p;
+    //--------------------------
 
-    if (!path) {
-        JSON_Errno = ERROR_INVALID_JSON_PATH;
+    p = createJsonParser(ctx, &build_events, NULL);
+    if (!p)
         return NULL;
-    }
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
+    p->User = p;
+    p->Builder = JSON_BuilderBeginCtx(ctx, 0);
+    if (!p->Builder) {
+        free(p);
         return NULL;
     }
 
-    value = findJsonValue(path, member);
+    return p;
+}
 
-    if ((value != NULL) && (value->Type == TYPE_OBJECT)){
-        return value->Object;
-    }
-    else {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return NULL;
-    }
+
+JSON_PARSER_HANDLE JSON_ParserCreate(void)
+{
+    return JSON_ParserCreateCtx(&default_context);
 }
 
 
-JSON_OBJECT_HANDLE JSON_AllocObject(void)
+JSON_PARSER_HANDLE JSON_ParserCreateSaxCtx(JSON_CONTEXT *ctx,
+                                           const JSON_SAX_CALLBACKS *callbacks,
+                                           void *user)
 {
-    //---------------------------
-    JSON_MEMBER *member;
-    //---------------------------
+    if (!callbacks) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return NULL;
+    }
 
-    JSON_Errno = SUCCESS;
+    return createJsonParser(ctx, callbacks, user);
+}
 
-    member = allocJsonMember();
 
-    return member;
+JSON_PARSER_HANDLE JSON_ParserCreateSax(const JSON_SAX_CALLBACKS *callbacks,
+                                        void *user)
+{
+    return JSON_ParserCreateSaxCtx(&default_context, callbacks, user);
 }
 
 
-static JSON_ERROR jsonAddValue(JSON_MEMBER *root_member, char *path, JSON_VALUE *value)
+static JSON_ERROR feedJsonParser(JSON_PARSER *p, const char *buffer,
+                                 size_t length)
 {
-    //-----------------------------
-    char *name1;
-    char *name2;
-    char *path_copy;
-    int member_should_be_object;
-    JSON_ERROR rc = SUCCESS;
-    JSON_MEMBER *found_member;
-    JSON_MEMBER *new_member;
-    //-----------------------------
+    //--------------------------
+    const char *cursor = buffer;
+    const char *end = buffer + length;
+    const char *start = buffer;
+    char c;
+    //--------------------------
 
-    ASSERT(root_member->Signature == JSON_MEMBER_SIGNATURE);
+    if (p->Error != SUCCESS)
+        return pushError(p, p->Error);
 
-    path_copy = strdup(path);
+    if (!buffer && length)
+        return pushError(p, ERROR_INVALID_OBJECT);
 
-    name1 = strtok(path_copy, ".");
+    while (cursor < end) {
 
-    do {
-        name2 = strtok(NULL, ".");
-        if (name2)
-            member_should_be_object = 1;
-        else
-            member_should_be_object = 0;
+        switch (p->State) {
 
-        //  We need to special case the first one, since we'll have an
-        //  empty Member at first.
-        if (!root_member->Name && !root_member->Value) {
+            case PUSH_NAME_STRING:
+            case PUSH_VALUE_STRING:
+
+                while (cursor < end) {
+                    if (p->Escape)
+                        p->Escape = 0;
+                    else if (*cursor == '\\')
+                        p->Escape = 1;
+                    else if (*cursor == '"')
+                        break;
+                    cursor++;
+                }
+                if (cursor == end)
+                    continue;
+
+                if (pushString(p, start, cursor) != SUCCESS)
+                    return p->Error;
+                cursor++;
+                p->State = (p->State == PUSH_NAME_STRING) ? PUSH_COLON :
+                                                            PUSH_AFTER_VALUE;
+                continue;
 
-            root_member->Name = strdup(name1);
+            case PUSH_NUMBER:
+            case PUSH_LITERAL:
 
-            if (member_should_be_object) {
-                root_member->Value->Type = TYPE_OBJECT;
-                root_member->Value->Object = JSON_AllocObject();
-                name1 = name2;
-                root_member  = new_member;
+                while (cursor < end && (p->State == PUSH_NUMBER ?
+                                        isNumberChar(*cursor) :
+                                        (*cursor >= 'a' && *cursor <= 'z')))
+                    cursor++;
+                if (cursor == end)
+                    continue;
+
+                if (pushScalar(p, start, cursor) != SUCCESS)
+                    return p->Error;
+                p->State = PUSH_AFTER_VALUE;
                 continue;
-            }
-            else {
-                root_member->Value = value;
+
+            default:
                 break;
-            }
         }
 
-        found_member = findJsonMemberInObject(root_member, name1);
-        if (!found_member) {
+        c = *cursor++;
 
-            new_member = allocJsonMember();
-            if (!new_member) {
-                rc = ERROR_ALLOC_FAILED;
-                break;
-            }
-            new_member->Name = strdup(name1);
+        if (isJsonBlank(c))
+            continue;
 
-            addJsonMemberToObject(root_member, new_member);
-            if (member_should_be_object) {
-                new_member->Value = allocJsonValue();
-                new_member->Value->Type = TYPE_OBJECT;
-                new_member->Value->Object = allocJsonMember();
-                new_member->Value->Object->Name = strdup(name2);
-                name1 = name2;
-                root_member  = new_member->Value->Object;
-            }
-            else {
-                new_member->Value = value;
-                break;
-            }
-        }
-        // This is a value and there isn't any value in it.
-        else if (!member_should_be_object && !found_member->Value) {
-            found_member->Value = value;
-            break;
-        }
-        else if (!member_should_be_object &&
-                  (found_member->Value->Type == value->Type)) {
-            free(found_member->Value);
-            found_member->Value = value;
-            break;
-        }
-        else if (member_should_be_object &&
-                 (found_member->Value->Type == TYPE_OBJECT)) {
-            name1 = name2;
-            root_member = found_member->Value->Object;
-        }
-        else {
-            rc = ERROR_TYPE_MISMATCH;
-            break;
-        }
+        start = cursor;
 
-    } while (1);
+        switch (p->State) {
 
-    free(path_copy);
+            case PUSH_START:
+                if (c != '{')
+                    return pushError(p, ERROR_INVALID_OBJECT);
+                if (!p->Stack) {
+                    p->Stack = (char *)malloc(32);
+                    if (!p->Stack)
+                        return pushError(p, ERROR_ALLOC_FAILED);
+                    p->StackSize = 32;
+                }
+                if (pushBegin(p, c) != SUCCESS)
+                    return p->Error;
+                break;
 
-    return rc;
-}
+            case PUSH_FIRST_NAME:
+                if (c == '}') {
+                    if (pushEnd(p, c) != SUCCESS)
+                        return p->Error;
+                    break;
+                }
+                // Fall through - anything else must be a name.
+            case PUSH_NAME:
+                if (c != '"')
+                    return pushError(p, ERROR_INVALID_STRING);
+                p->State = PUSH_NAME_STRING;
+                break;
 
+            case PUSH_COLON:
+                if (c != ':')
+                    return pushError(p, ERROR_INVALID_OBJECT);
+                p->State = PUSH_VALUE;
+                break;
 
-JSON_ERROR JSON_AddBoolean(JSON_OBJECT_HANDLE object, char *path, int value)
-{
-    //-----------------------------
-    JSON_VALUE *json_value;
-    JSON_ERROR rc = SUCCESS;
-    JSON_MEMBER *member;
-    //-----------------------------
+            case PUSH_FIRST_VALUE:
+                if (c == ']') {
+                    if (pushEnd(p, c) != SUCCESS)
+                        return p->Error;
+                    break;
+                }
+                // Fall through - anything else must be a value.
+            case PUSH_VALUE:
+                //  Scalars include their first character.
+                if (c != '"' && c != '{' && c != '[')
+                    start = cursor - 1;
+                if (pushValueStart(p, c) != SUCCESS)
+                    return p->Error;
+                break;
 
-    JSON_Errno = SUCCESS;
-    member = object;
+            case PUSH_AFTER_VALUE:
+                if (c == ',')
+                    p->State = (p->Stack[p->Depth - 1] == '{') ? PUSH_NAME :
+                                                                 PUSH_VALUE;
+                else if (pushEnd(p, c) != SUCCESS)
+                    return p->Error;
+                break;
 
-    if (!path) {
-        JSON_Errno = ERROR_INVALID_JSON_PATH;
-        return ERROR_INVALID_JSON_PATH;
+            default:
+                //  Nothing but whitespace may follow the root object.
+                return pushError(p, ERROR_INVALID_OBJECT);
+        }
     }
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return JSON_Errno;
+    //  Keep what there is of a token cut by the end of the chunk.
+    if (p->State == PUSH_NAME_STRING || p->State == PUSH_VALUE_STRING ||
+        p->State == PUSH_NUMBER || p->State == PUSH_LITERAL) {
+        if (appendToken(p, start, end - start) != 0)
+            return pushError(p, ERROR_ALLOC_FAILED);
+        p->Buffered = 1;
     }
 
-    json_value = allocJsonValue();
-    if (!json_value) {
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        return JSON_Errno;
-    }
+    p->Context->Errno = SUCCESS;
 
-    json_value->Type = TYPE_BOOLEAN;
-    json_value->Boolean = value ? 1 : 0;
+    return SUCCESS;
+}
 
-    rc = jsonAddValue(object, path, json_value);
 
-    return rc;
+JSON_ERROR JSON_ParserFeed(JSON_PARSER_HANDLE parser, const char *buffer,
+                           size_t length)
+{
+    //--------------------------
+    JSON_PARSER *p;
+    //--------------------------
+
+    p = getJsonParser(parser);
+    if (!p) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
+    }
+
+    return feedJsonParser(p, buffer, length);
 }
 
 
-JSON_ERROR JSON_AddString(JSON_OBJECT_HANDLE object, char *path, char *value)
+JSON_OBJECT_HANDLE JSON_ParserFinish(JSON_PARSER_HANDLE parser)
 {
-    //-----------------------------
-    JSON_VALUE *json_value;
-    JSON_ERROR rc = SUCCESS;
-    JSON_MEMBER *member;
-    //-----------------------------
-
-    JSON_Errno = SUCCESS;
-    member = object;
+    //--------------------------
+    JSON_PARSER *p;
+    JSON_OBJECT_HANDLE object = NULL;
+    //--------------------------
 
-    if (!path) {
-        JSON_Errno = ERROR_INVALID_JSON_PATH;
-        return ERROR_INVALID_JSON_PATH;
+    p = getJsonParser(parser);
+    if (!p) {
+        default_context.Errno = ERROR_INVALID_OBJECT;
+        return NULL;
     }
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return JSON_Errno;
-    }
+    //  The document must have been complete.
+    if (p->Error == SUCCESS && p->State != PUSH_DONE)
+        pushError(p, ERROR_INVALID_OBJECT);
 
-    json_value = allocJsonValue();
-    if (!json_value) {
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        return JSON_Errno;
+    if (p->Builder) {
+        if (p->Error != SUCCESS)
+            builderError(p->Builder, p->Error);
+        object = JSON_BuilderFinish(p->Builder);
     }
 
-    json_value->Type = TYPE_STRING;
-    json_value->String = strdup(value);
+    p->Context->Errno = p->Error;
 
-    rc = jsonAddValue(object, path, json_value);
+    releaseJsonParser(p);
+    free(p);
 
-    return rc;
+    return object;
 }
 
 
-JSON_ERROR JSON_AddNumber(JSON_OBJECT_HANDLE object, char *path, double value)
+JSON_ERROR JSON_SaxParseCtx(JSON_CONTEXT *ctx, const char *string,
+                            const JSON_SAX_CALLBACKS *callbacks, void *user)
 {
-    //-----------------------------
-    JSON_VALUE *json_value;
-    JSON_ERROR rc = SUCCESS;
-    JSON_MEMBER *member;
-    //-----------------------------
-
-    JSON_Errno = SUCCESS;
-    member = object;
+    //--------------------------
+    JSON_PARSER parser;
+    //--------------------------
 
-    if (!path) {
-        JSON_Errno = ERROR_INVALID_JSON_PATH;
-        return ERROR_INVALID_JSON_PATH;
+    if (!string || !callbacks) {
+        ctx->Errno = ERROR_INVALID_OBJECT;
+        return ERROR_INVALID_OBJECT;
     }
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE) {
-        JSON_Errno = ERROR_INVALID_OBJECT;
-        return JSON_Errno;
-    }
+    initJsonParser(&parser, ctx, callbacks, user);
 
-    json_value = allocJsonValue();
-    if (!json_value) {
-        JSON_Errno = ERROR_ALLOC_FAILED;
-        return JSON_Errno;
-    }
+    feedJsonParser(&parser, string, strlen(string));
 
-    json_value->Type = TYPE_NUMBER;
-    json_value->Number = value;
+    if (parser.Error == SUCCESS && parser.State != PUSH_DONE)
+        pushError(&parser, ERROR_INVALID_OBJECT);
 
-    rc = jsonAddValue(object, path, json_value);
+    ctx->Errno = parser.Error;
 
-    return rc;
+    releaseJsonParser(&parser);
+
+    return ctx->Errno;
+}
+
+
+JSON_ERROR JSON_SaxParse(const char *string, const JSON_SAX_CALLBACKS *callbacks,
+                         void *user)
+{
+    return JSON_SaxParseCtx(&default_context, string, callbacks, user);
 }
 
 
@@ -1472,17 +10430,20 @@ static void dbgPrintJsonValue(JSON_VALUE *value, int *indent_level);
 static void dbgPrintJsonObject(JSON_MEMBER *member, int *indent_level);
 
 
-static void dbgPrintJsonArray(JSON_MEMBER *member, int *indent_level)
+static void dbgPrintJsonArray(JSON_ARRAY *array, int *indent_level)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    //--------------------------
+    size_t i;
+    //--------------------------
+
+    ASSERT_SIGNATURE(array, JSON_ARRAY_SIGNATURE);
 
     printIndent(*indent_level);
     printf("ARRAY [\n");
     (*indent_level)++;
 
-    while (member) {
-        dbgPrintJsonValue(member->Value, indent_level);
-        member = member->Next;
+    for (i = 0; i < array->Count; i++) {
+        dbgPrintJsonValue(&array->Values[i], indent_level);
     }
 
     (*indent_level)--;
@@ -1493,7 +10454,7 @@ static void dbgPrintJsonArray(JSON_MEMBER *member, int *indent_level)
 
 static void dbgPrintJsonValue(JSON_VALUE *value, int *indent_level)
 {
-    ASSERT(value->Signature == JSON_VALUE_SIGNATURE);
+    ASSERT_SIGNATURE(value, JSON_VALUE_SIGNATURE);
 
     printIndent(*indent_level);
     dbgPrintType(value->Type);
@@ -1505,7 +10466,7 @@ static void dbgPrintJsonValue(JSON_VALUE *value, int *indent_level)
             break;
 
         case TYPE_ARRAY:
-            dbgPrintJsonArray(value->Object, indent_level);
+            dbgPrintJsonArray(value->Array, indent_level);
             break;
 
         case TYPE_STRING:
@@ -1526,6 +10487,11 @@ static void dbgPrintJsonValue(JSON_VALUE *value, int *indent_level)
             printf("Number: %f\n", value->Number);
             break;
 
+        case TYPE_INTEGER:
+            printIndent(*indent_level);
+            printf("Integer: %" PRId64 "\n", value->Integer);
+            break;
+
         default:
             break;
     }
@@ -1543,7 +10509,7 @@ static void dbgPrintJsonMember(JSON_MEMBER *member, int *indent_level)
 
 static void dbgPrintJsonObject(JSON_MEMBER *member, int *indent_level)
 {
-    ASSERT(member->Signature == JSON_MEMBER_SIGNATURE);
+    ASSERT_SIGNATURE(member, JSON_MEMBER_SIGNATURE);
 
     printIndent(*indent_level);
     printf("OBJECT {\n");
@@ -1566,11 +10532,11 @@ void JSONDBG_Print(JSON_OBJECT_HANDLE object)
     JSON_MEMBER *member;
     //--------------------------
 
-    JSON_Errno = SUCCESS;
-    member = object;
+    default_context.Errno = SUCCESS;
+    member = getJsonMember(object, NULL);
 
-    if (!object || member->Signature != JSON_MEMBER_SIGNATURE)
-        JSON_Errno = ERROR_INVALID_OBJECT;
+    if (!member)
+        default_context.Errno = ERROR_INVALID_OBJECT;
 
     dbgPrintJsonObject(member, &indent_level);
     printf("\n");
@@ -22,6 +22,10 @@
 #ifndef JSON_H__
 #define JSON_H__
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
 
 //---------------------------------------------------------------------------
 //
@@ -39,6 +43,54 @@
 #define JSON_PRINT
 
 
+//---------------------------------------------------------------------------
+//
+//  Define to include the multi-threaded functions like JSON_ParseBatch().
+//  These need POSIX threads. Undefine this to make the code smaller.
+//---------------------------------------------------------------------------
+#define JSON_THREADS
+
+
+//---------------------------------------------------------------------------
+//
+//  Define to scan for structure with SSE2 or AVX2, picked at runtime,
+//  on x86 CPUs. Undefine this to use only the portable scalar code.
+//---------------------------------------------------------------------------
+#define JSON_SIMD
+
+
+//---------------------------------------------------------------------------
+//
+//  Objects with at least this many members get a hash index of their
+//  member names the first time a lookup scans that far, which makes
+//  lookups and additions on them constant time. Member order is kept.
+//  Undefine this to always walk the members.
+//---------------------------------------------------------------------------
+#define JSON_INDEX_MIN_MEMBERS 32
+
+
+//---------------------------------------------------------------------------
+//
+//  Define, here or on the compiler command line, to have documents count
+//  their parse time and lookups, for JSON_GetStats(). Every lookup
+//  through a document then updates a counter shared by all the threads
+//  reading it, so it is left undefined, with both counters at 0.
+//---------------------------------------------------------------------------
+// #define JSON_STATS_COUNTERS
+
+
+//---------------------------------------------------------------------------
+//
+//  Define to check the signature of every node the library walks, which
+//  stops on handles that are stale or were never from this library.
+//  Left out of release builds, which define NDEBUG, to make the code
+//  smaller and faster.
+//---------------------------------------------------------------------------
+#ifndef NDEBUG
+#define JSON_CHECK_SIGNATURES
+#endif
+
+
 //---------------------------------------------------------------------------
 //
 //  Errors returned by this library.
@@ -55,7 +107,10 @@ typedef enum _JSON_ERROR {
     ERROR_INVALID_ARRAY,
     ERROR_TYPE_MISMATCH,
     ERROR_INVALID_VALUE_TYPE,
-    ERROR_INVALID_JSON_PATH
+    ERROR_INVALID_JSON_PATH,
+    ERROR_WRITE_FAILED,
+    ERROR_STOPPED,
+    ERROR_READ_FAILED
 
 }JSON_ERROR;
 
@@ -64,6 +119,10 @@ typedef enum _JSON_ERROR {
 //
 //  Standard types supported by JSON.
 //
+//  Numbers without a fraction or exponent that fit in 64 bits are kept
+//  exactly as TYPE_INTEGER, all others are TYPE_NUMBER. JSON_GetNumber()
+//  reads both.
+//
 //---------------------------------------------------------------------------
 typedef enum _JSON_TYPE {
 
@@ -72,7 +131,8 @@ typedef enum _JSON_TYPE {
     TYPE_STRING,
     TYPE_BOOLEAN,
     TYPE_ARRAY,
-    TYPE_NUMBER
+    TYPE_NUMBER,
+    TYPE_INTEGER
 
 } JSON_TYPE;
 
@@ -84,6 +144,38 @@ typedef enum _JSON_TYPE {
 //
 //---------------------------------------------------------------------------
 typedef void* JSON_OBJECT_HANDLE;
+typedef void* JSON_PATH_HANDLE;
+typedef void* JSON_BUILDER_HANDLE;
+typedef void* JSON_PARSER_HANDLE;
+typedef void* JSON_NDJSON_HANDLE;
+typedef void* JSON_KEYTABLE_HANDLE;
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_CONTEXT holds the error state of the calls made with it.
+//
+//  The *Ctx() variants of the functions below take one explicitly, so
+//  any number of threads can each parse, stringify and query with their
+//  own context and no locking. The plain functions use a per thread
+//  default context, reported by JSON_GetErrno().
+//
+//---------------------------------------------------------------------------
+typedef struct _JSON_CONTEXT {
+
+    JSON_ERROR Errno;
+
+} JSON_CONTEXT;
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_InitContext()
+//
+//  Prepares a context for use. A zero-initialized context is also valid.
+//
+//---------------------------------------------------------------------------
+void JSON_InitContext(JSON_CONTEXT *ctx);
 
 
 //---------------------------------------------------------------------------
@@ -95,6 +187,287 @@ typedef void* JSON_OBJECT_HANDLE;
 //
 //---------------------------------------------------------------------------
 JSON_OBJECT_HANDLE JSON_Parse(char *string);
+JSON_OBJECT_HANDLE JSON_ParseCtx(JSON_CONTEXT *ctx, char *string);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseArena()
+//
+//  Same as JSON_Parse(), but every node and string of the object is
+//  carved out of large memory chunks owned by the returned handle.
+//  JSON_FreeObject() releases the chunks without walking the object.
+//  Values added later with the JSON_Add*() functions also come out of
+//  the arena when the document handle itself is passed in.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_ParseArena(char *string);
+JSON_OBJECT_HANDLE JSON_ParseArenaCtx(JSON_CONTEXT *ctx, char *string);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_KeyTableCreate()
+//  JSON_KeyTableFree()
+//  JSON_KeyTableCount()
+//
+//  A key table holds one copy of each member name it has seen, to be
+//  shared by the documents of JSON_ParseInterned(). It must be freed
+//  after all documents and paths using it, and may only be used by one
+//  call at a time. JSON_KeyTableCount() returns how many names it holds.
+//
+//---------------------------------------------------------------------------
+JSON_KEYTABLE_HANDLE JSON_KeyTableCreate(void);
+void JSON_KeyTableFree(JSON_KEYTABLE_HANDLE keys);
+size_t JSON_KeyTableCount(JSON_KEYTABLE_HANDLE keys);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseInterned()
+//
+//  Same as JSON_ParseArena(), but all members of the same name point to
+//  a single copy of it, so arrays of many objects of the same shape keep
+//  their names only once. The copies are in keys, or, if keys is NULL,
+//  in a table of the document's own. The names must not be changed.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_ParseInterned(char *string, JSON_KEYTABLE_HANDLE keys);
+JSON_OBJECT_HANDLE JSON_ParseInternedCtx(JSON_CONTEXT *ctx, char *string,
+                                         JSON_KEYTABLE_HANDLE keys);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseInSitu()
+//
+//  Same as JSON_Parse(), but the names and string values of the object
+//  are not copied. They are terminated and unescaped in place and point
+//  into the string passed in, which is modified by the call and must
+//  stay around, unchanged, until JSON_FreeObject() is called on the
+//  returned handle.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_ParseInSitu(char *string);
+JSON_OBJECT_HANDLE JSON_ParseInSituCtx(JSON_CONTEXT *ctx, char *string);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseFile()
+//
+//  Same as JSON_ParseArena(), but parses a file straight from a memory
+//  mapping of it, without reading it into memory first. The file is
+//  left unchanged.
+//
+//  With FILE_IN_SITU the names and string values are not copied, as with
+//  JSON_ParseInSitu(). They point into a private mapping of the file
+//  that stays until JSON_FreeObject() is called on the returned handle.
+//  The file should not be truncated while the document is in use.
+//
+//---------------------------------------------------------------------------
+typedef enum _JSON_FILE_FLAGS {
+
+    FILE_COPY_STRINGS = 0x00,
+    FILE_IN_SITU = 0x01
+
+} JSON_FILE_FLAGS;
+
+
+JSON_OBJECT_HANDLE JSON_ParseFile(const char *path, int flags);
+JSON_OBJECT_HANDLE JSON_ParseFileCtx(JSON_CONTEXT *ctx, const char *path,
+                                     int flags);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseLazy()
+//
+//  Same as JSON_ParseArena(), but only the members of the root object are
+//  parsed. Nested objects and arrays are checked to be closed, and
+//  parsed one level at a time when a getter, JSON_Add* or Stringify first
+//  goes into them. Reading a few values out of a large document costs
+//  little more than finding its structure.
+//
+//  An error inside a nested object or array is only found when it is
+//  read, and is then returned by that call. Since reading changes the
+//  document, a lazy document must not be read by several threads at
+//  once.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_ParseLazy(char *string);
+JSON_OBJECT_HANDLE JSON_ParseLazyCtx(JSON_CONTEXT *ctx, char *string);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseSelect()
+//
+//  Same as JSON_ParseArena(), but only the n paths given are kept, in
+//  the form JSON_CompilePath() takes. Everything else is skipped over
+//  without being allocated or decoded, which makes taking a few fields
+//  out of a large document much faster. Objects on the way to a path
+//  are kept with only the selected members in them, and left out if
+//  none were found. A path that goes into an array keeps all of that
+//  array, so its indices stay the same.
+//
+//  Errors in the values skipped are not found, apart from unbalanced
+//  brackets and unterminated strings.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_ParseSelect(char *string, char **paths, size_t n);
+JSON_OBJECT_HANDLE JSON_ParseSelectCtx(JSON_CONTEXT *ctx, char *string,
+                                       char **paths, size_t n);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParserCreate()
+//  JSON_ParserFeed()
+//  JSON_ParserFinish()
+//
+//  These functions parse a document that arrives in pieces, such as
+//  reads from a socket, without putting it back together first. The
+//  pieces can be cut anywhere, even inside a string or number, and are
+//  not needed after they have been fed. JSON_ParserFinish() frees the
+//  parser and returns the document, which is the same as JSON_Parse()
+//  would have built, or NULL if it was not valid or not complete.
+//
+//---------------------------------------------------------------------------
+JSON_PARSER_HANDLE JSON_ParserCreate(void);
+JSON_PARSER_HANDLE JSON_ParserCreateCtx(JSON_CONTEXT *ctx);
+JSON_ERROR JSON_ParserFeed(JSON_PARSER_HANDLE parser, const char *buffer,
+                           size_t length);
+JSON_OBJECT_HANDLE JSON_ParserFinish(JSON_PARSER_HANDLE parser);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_SAX_CALLBACKS are the events of an event parser, raised in
+//  document order. Any of them may be NULL. Names and strings are
+//  unescaped and NUL terminated, but only valid during the call.
+//  Integers go to OnNumber as doubles if OnInteger is NULL. A callback
+//  that returns non-zero stops the parse with ERROR_STOPPED.
+//
+//---------------------------------------------------------------------------
+typedef struct _JSON_SAX_CALLBACKS {
+
+    int (*OnObjectBegin)(void *user);
+    int (*OnObjectEnd)(void *user);
+    int (*OnArrayBegin)(void *user);
+    int (*OnArrayEnd)(void *user);
+    int (*OnKey)(void *user, const char *name, size_t length);
+    int (*OnString)(void *user, const char *string, size_t length);
+    int (*OnNumber)(void *user, double number);
+    int (*OnInteger)(void *user, int64_t integer);
+    int (*OnBoolean)(void *user, int boolean);
+
+} JSON_SAX_CALLBACKS;
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_SaxParse()
+//  JSON_ParserCreateSax()
+//
+//  Parse a document without building it, calling the callbacks for each
+//  value instead. Memory use depends on the depth of the document, not
+//  its size, and nothing is allocated per value.
+//
+//  JSON_SaxParse() parses a whole string. JSON_ParserCreateSax() returns
+//  a parser that is fed with JSON_ParserFeed() like any other, and whose
+//  JSON_ParserFinish() returns NULL, with an error of SUCCESS if the
+//  document was complete.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_SaxParse(const char *string, const JSON_SAX_CALLBACKS *callbacks,
+                         void *user);
+JSON_ERROR JSON_SaxParseCtx(JSON_CONTEXT *ctx, const char *string,
+                            const JSON_SAX_CALLBACKS *callbacks, void *user);
+JSON_PARSER_HANDLE JSON_ParserCreateSax(const JSON_SAX_CALLBACKS *callbacks,
+                                        void *user);
+JSON_PARSER_HANDLE JSON_ParserCreateSaxCtx(JSON_CONTEXT *ctx,
+                                           const JSON_SAX_CALLBACKS *callbacks,
+                                           void *user);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_NdjsonOpen()
+//  JSON_NdjsonNext()
+//  JSON_NdjsonClose()
+//
+//  These functions read newline delimited JSON, one object per line,
+//  from a file. JSON_NdjsonNext() returns the next record, to be freed
+//  with JSON_FreeObject(), skipping blank lines. It returns NULL at the
+//  end of the file, with an error of SUCCESS, or for a line that does
+//  not parse, with its error, after which reading can go on with the
+//  next line. The file is not closed by JSON_NdjsonClose().
+//
+//---------------------------------------------------------------------------
+JSON_NDJSON_HANDLE JSON_NdjsonOpen(FILE *file);
+JSON_OBJECT_HANDLE JSON_NdjsonNext(JSON_NDJSON_HANDLE reader);
+JSON_OBJECT_HANDLE JSON_NdjsonNextCtx(JSON_CONTEXT *ctx,
+                                      JSON_NDJSON_HANDLE reader);
+void JSON_NdjsonClose(JSON_NDJSON_HANDLE reader);
+
+
+#ifdef JSON_THREADS
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ParseBatch()
+//
+//  Parses n independent documents on a pool of worker threads. Each
+//  out[i] is the handle for inputs[i], or NULL if it failed to parse, in
+//  which case errors[i] says why. errors may be NULL. A threads value of
+//  zero or less uses one thread per online CPU.
+//
+//  Returns SUCCESS if every document parsed, otherwise the error of the
+//  first one that failed.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_ParseBatch(char **inputs, size_t n, JSON_OBJECT_HANDLE *out,
+                           JSON_ERROR *errors, int threads);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_NdjsonForEach()
+//
+//  Parses newline delimited JSON, one object per line, from a file on
+//  a pool of worker threads, and calls the callback with each record.
+//  The file is read in large chunks of whole lines, and only as many
+//  chunks as there are threads are held at once, so memory use does not
+//  depend on the size of the file. A threads value of zero or less uses
+//  one thread per online CPU. Blank lines are skipped.
+//
+//  With ORDER_INPUT the callback gets the records one at a time, in the
+//  order of the file. With ORDER_ANY it is called from several threads
+//  at once, as soon as each record is parsed.
+//
+//  The record is freed when the callback returns. A callback that
+//  returns non-zero stops the reading with ERROR_STOPPED, and a line
+//  that does not parse stops it with its error, which is returned.
+//
+//---------------------------------------------------------------------------
+typedef int (*JSON_RECORD_CALLBACK)(void *user_data, JSON_OBJECT_HANDLE record);
+
+
+typedef enum _JSON_RECORD_ORDER {
+
+    ORDER_INPUT,
+    ORDER_ANY
+
+} JSON_RECORD_ORDER;
+
+
+JSON_ERROR JSON_NdjsonForEach(FILE *file, JSON_RECORD_CALLBACK callback,
+                              void *user_data, int threads,
+                              JSON_RECORD_ORDER order);
+
+#endif
 
 
 #ifdef JSON_PRINT
@@ -116,10 +489,167 @@ void JSON_Print(JSON_OBJECT_HANDLE object);
 //
 //  This function returns a pointer to an ASCII string representation
 //  of the object. You are responsible for free'ing the memory once
-//  you are done with it.
+//  you are done with it. Numbers that are infinite or NaN have no JSON
+//  text, and fail with ERROR_INVALID_NUMBER.
 //
 //---------------------------------------------------------------------------
 char* JSON_Stringify(JSON_OBJECT_HANDLE object);
+char* JSON_StringifyCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_SINK is where JSON_WriteTo() sends its output: a callback, a
+//  FILE or a file descriptor. Set one up with a JSON_Init*Sink()
+//  function.
+//
+//  A callback gets the user data it was set up with and the next block
+//  of output, and returns 0, or anything else to stop the write.
+//
+//---------------------------------------------------------------------------
+typedef int (*JSON_WRITE_CALLBACK)(void *user_data, const char *data,
+                                   size_t length);
+
+
+typedef enum _JSON_SINK_TYPE {
+
+    SINK_CALLBACK,
+    SINK_FILE,
+    SINK_FD
+
+} JSON_SINK_TYPE;
+
+
+typedef struct _JSON_SINK {
+
+    JSON_SINK_TYPE Type;
+    JSON_WRITE_CALLBACK Write;
+    void *UserData;
+    FILE *File;
+    int Fd;
+
+} JSON_SINK;
+
+
+void JSON_InitCallbackSink(JSON_SINK *sink, JSON_WRITE_CALLBACK write,
+                           void *user_data);
+void JSON_InitFileSink(JSON_SINK *sink, FILE *file);
+void JSON_InitFdSink(JSON_SINK *sink, int fd);
+
+
+//---------------------------------------------------------------------------
+//
+//  Output layouts. WRITE_COMPACT is what JSON_Stringify() returns,
+//  WRITE_PRETTY is what JSON_Print() shows.
+//
+//---------------------------------------------------------------------------
+typedef enum _JSON_WRITE_MODE {
+
+    WRITE_COMPACT,
+    WRITE_PRETTY
+
+} JSON_WRITE_MODE;
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_WriteTo()
+//
+//  This function writes the object as JSON text to a sink, through a
+//  fixed size buffer that goes out in large blocks, so the whole text
+//  is never held in memory. On ERROR_WRITE_FAILED some of the text may
+//  already have been written.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_WriteTo(JSON_OBJECT_HANDLE object, JSON_SINK *sink,
+                        JSON_WRITE_MODE mode);
+JSON_ERROR JSON_WriteToCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                           JSON_SINK *sink, JSON_WRITE_MODE mode);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_Serialize()
+//
+//  This function writes the object to a sink as a binary image, which
+//  JSON_Open() can use without parsing it. The image holds no pointers,
+//  so it can be mapped anywhere, and shared by any number of processes.
+//  It is only readable on machines of the same byte order.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_Serialize(JSON_OBJECT_HANDLE object, JSON_SINK *sink);
+JSON_ERROR JSON_SerializeCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                             JSON_SINK *sink);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_Open()
+//  JSON_OpenImage()
+//  JSON_Close()
+//
+//  JSON_Open() maps a file written by JSON_Serialize() read only and
+//  shared, and returns a handle to the document in it. JSON_OpenImage()
+//  does the same for an image already in memory, such as shared memory,
+//  which must be 8 byte aligned and stay mapped until the handle is
+//  closed.
+//
+//  The JSON_Get*() functions read the image where it is. Strings point
+//  into it and must not be changed, and JSON_GetObject() returns handles
+//  into it, valid until JSON_Close(). The document cannot be changed,
+//  stringified or freed with JSON_FreeObject(). Only the header of an
+//  image is checked, so images must come from a trusted source.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_Open(const char *path);
+JSON_OBJECT_HANDLE JSON_OpenCtx(JSON_CONTEXT *ctx, const char *path);
+JSON_OBJECT_HANDLE JSON_OpenImage(const void *image, size_t length);
+JSON_OBJECT_HANDLE JSON_OpenImageCtx(JSON_CONTEXT *ctx, const void *image,
+                                     size_t length);
+void JSON_Close(JSON_OBJECT_HANDLE object);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_ToMsgPack()
+//  JSON_ToCbor()
+//
+//  These functions encode the object as MessagePack or CBOR, straight
+//  from the tree, into a buffer that holds *length bytes. The caller
+//  must free() it. Integers take the smallest encoding that holds them,
+//  and numbers are written as 32 bit floats when that loses nothing.
+//  As with JSON_Stringify(), numbers that are infinite or NaN fail with
+//  ERROR_INVALID_NUMBER.
+//
+//---------------------------------------------------------------------------
+char *JSON_ToMsgPack(JSON_OBJECT_HANDLE object, size_t *length);
+char *JSON_ToMsgPackCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                        size_t *length);
+char *JSON_ToCbor(JSON_OBJECT_HANDLE object, size_t *length);
+char *JSON_ToCborCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                     size_t *length);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_FromMsgPack()
+//  JSON_FromCbor()
+//
+//  These functions decode MessagePack or CBOR into a new document, kept
+//  in an arena like those of JSON_ParseArena(), and freed the same way.
+//  The data must be a single map, and map keys must be strings. Items
+//  JSON has no value for, such as null, binary data and extension types,
+//  fail with ERROR_INVALID_VALUE_TYPE, and strings holding a NUL with
+//  ERROR_INVALID_STRING. CBOR tags are ignored, and indefinite length
+//  arrays and maps are read, but not indefinite length strings.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_FromMsgPack(const void *data, size_t length);
+JSON_OBJECT_HANDLE JSON_FromMsgPackCtx(JSON_CONTEXT *ctx, const void *data,
+                                       size_t length);
+JSON_OBJECT_HANDLE JSON_FromCbor(const void *data, size_t length);
+JSON_OBJECT_HANDLE JSON_FromCborCtx(JSON_CONTEXT *ctx, const void *data,
+                                    size_t length);
 
 
 //---------------------------------------------------------------------------
@@ -133,6 +663,100 @@ char* JSON_Stringify(JSON_OBJECT_HANDLE object);
 void JSON_FreeObject(JSON_OBJECT_HANDLE object);
 
 
+//---------------------------------------------------------------------------
+//
+//  JSON_STATS describes the contents and memory of an object.
+//
+//  Members counts named members, and the values are counted by type,
+//  the object itself included. MaxDepth is 1 for an object holding no
+//  objects or arrays. NameBytes and StringBytes are the lengths of the
+//  member names and string values, without terminators.
+//
+//  Allocations and BytesHeld are the memory blocks and bytes freeing the
+//  object gives back, including the unused ends of arena chunks and the
+//  file a document from JSON_ParseFile() keeps mapped. BytesHeld is what
+//  was asked of malloc(), without its overhead on each allocation. Text
+//  borrowed from the caller and shared key tables are not counted. For
+//  an object inside a document they are only an estimate of its share.
+//
+//  ParseNanoseconds and Lookups are only kept by documents, and only
+//  with JSON_STATS_COUNTERS defined. Parse time includes the containers
+//  of lazy documents parsed when first read. Lookups counts the getter
+//  calls made on the document handle itself.
+//
+//---------------------------------------------------------------------------
+typedef struct _JSON_STATS {
+
+    size_t Objects;
+    size_t Arrays;
+    size_t Strings;
+    size_t Numbers;
+    size_t Integers;
+    size_t Booleans;
+    size_t Members;
+    size_t MaxDepth;
+    size_t NameBytes;
+    size_t StringBytes;
+    size_t Allocations;
+    size_t BytesHeld;
+    uint64_t ParseNanoseconds;
+    uint64_t Lookups;
+
+} JSON_STATS;
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_GetStats()
+//
+//  This function fills in stats for the object, walking all of it. The
+//  containers of lazy documents not read yet count as one object or
+//  array each, and are left unparsed. Images from JSON_Open() fail with
+//  ERROR_INVALID_OBJECT.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_GetStats(JSON_OBJECT_HANDLE object, JSON_STATS *stats);
+JSON_ERROR JSON_GetStatsCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                            JSON_STATS *stats);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_CompilePath()
+//
+//  This function compiles a path like "a.b[3].c" once, for the getters
+//  ending in P. A compiled path is never changed by them, so it can be
+//  shared between threads. Returns NULL if the path is not valid.
+//
+//---------------------------------------------------------------------------
+JSON_PATH_HANDLE JSON_CompilePath(char *path);
+JSON_PATH_HANDLE JSON_CompilePathCtx(JSON_CONTEXT *ctx, char *path);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_CompilePathInterned()
+//
+//  Same as JSON_CompilePath(), but the names in the path are put in the
+//  key table, so lookups in documents parsed with that table match
+//  members by pointer. The path must be freed before the table.
+//
+//---------------------------------------------------------------------------
+JSON_PATH_HANDLE JSON_CompilePathInterned(char *path, JSON_KEYTABLE_HANDLE keys);
+JSON_PATH_HANDLE JSON_CompilePathInternedCtx(JSON_CONTEXT *ctx, char *path,
+                                             JSON_KEYTABLE_HANDLE keys);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_FreePath()
+//
+//  This function frees a path returned by JSON_CompilePath().
+//
+//---------------------------------------------------------------------------
+void JSON_FreePath(JSON_PATH_HANDLE path);
+
+
 //---------------------------------------------------------------------------
 //
 //  JSON_GetType()
@@ -142,6 +766,10 @@ void JSON_FreeObject(JSON_OBJECT_HANDLE object);
 //
 //---------------------------------------------------------------------------
 JSON_TYPE JSON_GetType(JSON_OBJECT_HANDLE object, char *path);
+JSON_TYPE JSON_GetTypeCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path);
+JSON_TYPE JSON_GetTypeP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path);
+JSON_TYPE JSON_GetTypePCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                           JSON_PATH_HANDLE path);
 
 
 //---------------------------------------------------------------------------
@@ -152,6 +780,10 @@ JSON_TYPE JSON_GetType(JSON_OBJECT_HANDLE object, char *path);
 //
 //---------------------------------------------------------------------------
 int JSON_GetBoolean(JSON_OBJECT_HANDLE object, char *name);
+int JSON_GetBooleanCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *name);
+int JSON_GetBooleanP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path);
+int JSON_GetBooleanPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                        JSON_PATH_HANDLE path);
 
 
 //---------------------------------------------------------------------------
@@ -162,6 +794,26 @@ int JSON_GetBoolean(JSON_OBJECT_HANDLE object, char *name);
 //
 //---------------------------------------------------------------------------
 double JSON_GetNumber(JSON_OBJECT_HANDLE object, char *path);
+double JSON_GetNumberCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path);
+double JSON_GetNumberP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path);
+double JSON_GetNumberPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                          JSON_PATH_HANDLE path);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_GetInt64()
+//
+//  This function returns the exact value of an integer member of a JSON
+//  object. Other numbers are only returned if they are whole and in
+//  range.
+//
+//---------------------------------------------------------------------------
+int64_t JSON_GetInt64(JSON_OBJECT_HANDLE object, char *path);
+int64_t JSON_GetInt64Ctx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path);
+int64_t JSON_GetInt64P(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path);
+int64_t JSON_GetInt64PCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                          JSON_PATH_HANDLE path);
 
 
 //---------------------------------------------------------------------------
@@ -173,6 +825,10 @@ double JSON_GetNumber(JSON_OBJECT_HANDLE object, char *path);
 //
 //---------------------------------------------------------------------------
 char *JSON_GetString(JSON_OBJECT_HANDLE object, char *path);
+char *JSON_GetStringCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object, char *path);
+char *JSON_GetStringP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path);
+char *JSON_GetStringPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                         JSON_PATH_HANDLE path);
 
 
 //---------------------------------------------------------------------------
@@ -183,6 +839,11 @@ char *JSON_GetString(JSON_OBJECT_HANDLE object, char *path);
 //
 //---------------------------------------------------------------------------
 JSON_OBJECT_HANDLE JSON_GetObject(JSON_OBJECT_HANDLE object, char *path);
+JSON_OBJECT_HANDLE JSON_GetObjectCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                                     char *path);
+JSON_OBJECT_HANDLE JSON_GetObjectP(JSON_OBJECT_HANDLE object, JSON_PATH_HANDLE path);
+JSON_OBJECT_HANDLE JSON_GetObjectPCtx(JSON_CONTEXT *ctx, JSON_OBJECT_HANDLE object,
+                                      JSON_PATH_HANDLE path);
 
 
 //---------------------------------------------------------------------------
@@ -226,15 +887,95 @@ JSON_ERROR JSON_AddString(JSON_OBJECT_HANDLE object, char *path, char *value);
 JSON_ERROR JSON_AddNumber(JSON_OBJECT_HANDLE object, char *path, double value);
 
 
+//---------------------------------------------------------------------------
+//
+//  JSON_AddInt64()
+//
+//  This function adds an integer value to an object.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_AddInt64(JSON_OBJECT_HANDLE object, char *path, int64_t value);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_BuilderBegin()
+//
+//  This function starts building a new document, which is much faster
+//  than adding its values one path at a time. Values are appended, in
+//  order, to the innermost open object or array: members of objects need
+//  a name, elements of arrays must have NULL. Names are not checked for
+//  duplicates. size_hint is the expected size of the document in bytes,
+//  or 0 if not known.
+//
+//  The first error is kept, and every call after it returns it again,
+//  so it is enough to check the result of JSON_BuilderFinish().
+//
+//---------------------------------------------------------------------------
+JSON_BUILDER_HANDLE JSON_BuilderBegin(size_t size_hint);
+JSON_BUILDER_HANDLE JSON_BuilderBeginCtx(JSON_CONTEXT *ctx, size_t size_hint);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_BuilderBeginObject()
+//  JSON_BuilderBeginArray()
+//  JSON_BuilderEnd()
+//
+//  These functions open a nested object or array, and close the
+//  innermost open one. capacity_hint is the expected number of elements
+//  of the array, or 0 if not known.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_BuilderBeginObject(JSON_BUILDER_HANDLE builder, char *name);
+JSON_ERROR JSON_BuilderBeginArray(JSON_BUILDER_HANDLE builder, char *name,
+                                  size_t capacity_hint);
+JSON_ERROR JSON_BuilderEnd(JSON_BUILDER_HANDLE builder);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_BuilderAddString()
+//  JSON_BuilderAddNumber()
+//  JSON_BuilderAddInt64()
+//  JSON_BuilderAddBoolean()
+//
+//  These functions append a value. A copy of strings is made.
+//
+//---------------------------------------------------------------------------
+JSON_ERROR JSON_BuilderAddString(JSON_BUILDER_HANDLE builder, char *name,
+                                 char *value);
+JSON_ERROR JSON_BuilderAddNumber(JSON_BUILDER_HANDLE builder, char *name,
+                                 double value);
+JSON_ERROR JSON_BuilderAddInt64(JSON_BUILDER_HANDLE builder, char *name,
+                                int64_t value);
+JSON_ERROR JSON_BuilderAddBoolean(JSON_BUILDER_HANDLE builder, char *name,
+                                  int value);
+
+
+//---------------------------------------------------------------------------
+//
+//  JSON_BuilderFinish()
+//
+//  This function ends the build and frees the builder. It returns the
+//  document, to be freed with JSON_FreeObject(), or NULL if any call
+//  failed or an object or array was left open.
+//
+//---------------------------------------------------------------------------
+JSON_OBJECT_HANDLE JSON_BuilderFinish(JSON_BUILDER_HANDLE builder);
+
+
 //---------------------------------------------------------------------------
 //
 //  JSON_GetErrno()
 //
 //  This function returns the JSON specific errno from the last operation
-//  performed.
+//  performed by the calling thread, or the last operation performed
+//  with the given context.
 //
 //---------------------------------------------------------------------------
 JSON_ERROR JSON_GetErrno(void);
+JSON_ERROR JSON_GetErrnoCtx(JSON_CONTEXT *ctx);
 
 
 #ifdef JSON_DBG_PRINT
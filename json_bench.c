@@ -0,0 +1,1893 @@
+//---------------------------------------------------------------------------
+//  json_bench.c
+//
+//  This is a simple benchmark module of the JSON library. The Bench
+//  build configuration builds it, without the unit tests and with
+//  NDEBUG defined, and "--suite" runs the throughput suite.
+//
+//  (c)2023, Michael Becker <michael.f.becker@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful, but
+//  WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+//  General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+//---------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "json.h"
+
+
+#define ASSERT(_test_condition)                                 \
+       if (!(_test_condition)){                                 \
+           printf("ASSERT FAILED! \"%s\" %s:%d\n",              \
+                        #_test_condition, __FILE__, __LINE__);  \
+           abort();                                             \
+       }
+
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+//
+//  Heap in use, to see what a document holds.
+//
+static size_t heapInUse(void)
+{
+    //-----------------------------
+    struct mallinfo2 info;
+    //-----------------------------
+
+    info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+}
+
+
+//
+//  Deterministic pseudo random numbers, so every run and every machine
+//  benchmarks exactly the same input.
+//
+static unsigned int bench_seed = 12345;
+
+static unsigned int benchRand(void)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return (bench_seed >> 16) & 0x7FFF;
+}
+
+
+//
+//  Builds one document with the given number of members, mixing
+//  numbers, strings, booleans, nested objects and arrays.
+//
+static char *makeDocument(int members)
+{
+    //-----------------------------
+    char *doc;
+    size_t size;
+    size_t used = 0;
+    int i;
+    //-----------------------------
+
+    size = 64 + members * 96;
+    doc = malloc(size);
+    ASSERT(doc);
+
+    used += sprintf(doc + used, "{");
+
+    for (i = 0; i < members; i++) {
+
+        if (i)
+            used += sprintf(doc + used, ",");
+
+        switch (benchRand() % 5) {
+            case 0:
+                used += sprintf(doc + used, "\"n%d\":%u.%u", i,
+                                benchRand(), benchRand() % 1000);
+                break;
+            case 1:
+                used += sprintf(doc + used, "\"s%d\":\"value %u\"", i,
+                                benchRand());
+                break;
+            case 2:
+                used += sprintf(doc + used, "\"b%d\":%s", i,
+                                benchRand() % 2 ? "true" : "false");
+                break;
+            case 3:
+                used += sprintf(doc + used, "\"o%d\":{\"id\":%u,\"tag\":\"t%u\"}",
+                                i, benchRand(), benchRand());
+                break;
+            default:
+                used += sprintf(doc + used, "\"a%d\":[%u,%u,%u,%u]", i,
+                                benchRand(), benchRand(), benchRand(),
+                                benchRand());
+                break;
+        }
+    }
+
+    used += sprintf(doc + used, "}");
+    ASSERT(used < size);
+
+    return doc;
+}
+
+
+#define LARGE_DOCUMENT_MEMBERS 100000
+#define PARSE_ITERATIONS 10
+
+
+static void benchParseLarge(void)
+{
+    //-----------------------------
+    char *doc;
+    char *scratch;
+    size_t bytes;
+    JSON_OBJECT_HANDLE object;
+    double start;
+    double parse_time = 0;
+    double arena_time = 0;
+    double in_situ_time = 0;
+    int i;
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    bytes = strlen(doc);
+
+    //  In-situ parsing writes to its input, so it gets a fresh copy.
+    scratch = malloc(bytes + 1);
+    ASSERT(scratch);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        object = JSON_Parse(doc);
+        parse_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+
+        start = now();
+        object = JSON_ParseArena(doc);
+        arena_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+
+        memcpy(scratch, doc, bytes + 1);
+        start = now();
+        object = JSON_ParseInSitu(scratch);
+        in_situ_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+    }
+
+    printf("JSON_Parse: %.1f MB document\n", bytes / 1e6);
+    printf("    JSON_Parse      %8.1f MB/s\n",
+           bytes * PARSE_ITERATIONS / parse_time / 1e6);
+    printf("    JSON_ParseArena %8.1f MB/s\n",
+           bytes * PARSE_ITERATIONS / arena_time / 1e6);
+    printf("    JSON_ParseInSitu%8.1f MB/s\n\n",
+           bytes * PARSE_ITERATIONS / in_situ_time / 1e6);
+
+    free(scratch);
+    free(doc);
+}
+
+//
+//  Bytes held per value of the large document, strings included. Every
+//  value makeDocument() writes is either a member or one of the four
+//  elements of an array.
+//
+static void benchNodeFootprint(void)
+{
+    //-----------------------------
+    char *doc;
+    char *c;
+    size_t nodes = 0;
+    size_t base;
+    size_t held;
+    JSON_OBJECT_HANDLE object;
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+
+    for (c = doc; *c; c++) {
+        if (*c == ':')
+            nodes++;
+        else if (*c == '[')
+            nodes += 4;
+    }
+
+    printf("Memory per value: %zu values\n", nodes);
+
+    base = heapInUse();
+    object = JSON_Parse(doc);
+    ASSERT(object);
+    held = heapInUse() - base;
+    printf("    JSON_Parse      %8.1f MB %8.1f bytes/value\n", held / 1e6,
+           (double)held / nodes);
+    JSON_FreeObject(object);
+
+    base = heapInUse();
+    object = JSON_ParseArena(doc);
+    ASSERT(object);
+    held = heapInUse() - base;
+    printf("    JSON_ParseArena %8.1f MB %8.1f bytes/value\n\n", held / 1e6,
+           (double)held / nodes);
+    JSON_FreeObject(object);
+
+    free(doc);
+}
+
+
+//
+//  Compares the memory JSON_GetStats() reports for the large document
+//  with what the heap says it holds, and times the walk.
+//
+static void benchDocumentStats(void)
+{
+    //-----------------------------
+    char *doc;
+    char *copy;
+    size_t base;
+    size_t held;
+    JSON_OBJECT_HANDLE object;
+    JSON_STATS stats;
+    JSON_STATS parsed;
+    double start;
+    double elapsed;
+    int kind;
+    const char *names[] = {
+        "JSON_Parse", "JSON_ParseArena", "JSON_ParseInSitu", "JSON_ParseLazy"
+    };
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    copy = strdup(doc);
+    ASSERT(copy);
+
+    printf("Document statistics: reported and measured memory\n");
+
+    for (kind = 0; kind < 4; kind++) {
+
+        base = heapInUse();
+        if (kind == 0)
+            object = JSON_Parse(doc);
+        else if (kind == 1)
+            object = JSON_ParseArena(doc);
+        else if (kind == 2)
+            object = JSON_ParseInSitu(copy);
+        else
+            object = JSON_ParseLazy(doc);
+        ASSERT(object);
+        held = heapInUse() - base;
+
+        start = now();
+        ASSERT(JSON_GetStats(object, &stats) == SUCCESS);
+        elapsed = now() - start;
+
+        printf("    %-16s %8.1f MB reported %8.1f MB measured "
+               "%9zu allocations %6.1f ms\n", names[kind],
+               stats.BytesHeld / 1e6, held / 1e6, stats.Allocations,
+               elapsed * 1e3);
+
+        //  The lazy document has not parsed its containers yet.
+        if (kind == 0)
+            parsed = stats;
+
+        JSON_FreeObject(object);
+    }
+
+    printf("    %zu objects, %zu arrays, %zu members, depth %zu, "
+           "%zu string bytes\n\n", parsed.Objects, parsed.Arrays,
+           parsed.Members, parsed.MaxDepth,
+           parsed.NameBytes + parsed.StringBytes);
+
+    free(copy);
+    free(doc);
+}
+
+
+
+//
+//  Parses the large document from a file, read into the heap first as
+//  callers used to, and mapped.
+//
+static void benchParseFile(void)
+{
+    //-----------------------------
+    char path[] = "/tmp/json_bench_XXXXXX";
+    char *doc;
+    char *text;
+    size_t bytes;
+    JSON_OBJECT_HANDLE object;
+    double start;
+    double read_time = 0;
+    double file_time = 0;
+    double in_situ_time = 0;
+    int fd;
+    int i;
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    bytes = strlen(doc);
+
+    fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, doc, bytes) == (ssize_t)bytes);
+    close(fd);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        fd = open(path, O_RDONLY);
+        ASSERT(fd >= 0);
+        text = malloc(bytes + 1);
+        ASSERT(text);
+        ASSERT(read(fd, text, bytes) == (ssize_t)bytes);
+        text[bytes] = 0;
+        close(fd);
+        object = JSON_ParseArena(text);
+        free(text);
+        read_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+
+        start = now();
+        object = JSON_ParseFile(path, FILE_COPY_STRINGS);
+        file_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+
+        start = now();
+        object = JSON_ParseFile(path, FILE_IN_SITU);
+        in_situ_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+    }
+
+    printf("JSON_ParseFile: %.1f MB file\n", bytes / 1e6);
+    printf("    read + JSON_ParseArena  %8.1f MB/s\n",
+           bytes * PARSE_ITERATIONS / read_time / 1e6);
+    printf("    FILE_COPY_STRINGS       %8.1f MB/s\n",
+           bytes * PARSE_ITERATIONS / file_time / 1e6);
+    printf("    FILE_IN_SITU            %8.1f MB/s\n\n",
+           bytes * PARSE_ITERATIONS / in_situ_time / 1e6);
+
+    unlink(path);
+    free(doc);
+}
+
+
+//
+//  Loads the large document as a process would at startup, by parsing
+//  its text and by opening an image of it, and reads a few values.
+//
+#define IMAGE_RECORDS 100000
+
+
+static void benchImage(void)
+{
+    //-----------------------------
+    char path[] = "/tmp/json_bench_XXXXXX";
+    char name[32];
+    char *doc;
+    size_t bytes;
+    JSON_OBJECT_HANDLE object;
+    JSON_SINK sink;
+    struct stat st;
+    double start;
+    double parse_time = 0;
+    double open_time = 0;
+    long found = 0;
+    int fd;
+    int i;
+    int j;
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    bytes = strlen(doc);
+
+    object = JSON_ParseArena(doc);
+    ASSERT(object);
+    fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    JSON_InitFdSink(&sink, fd);
+    ASSERT(JSON_Serialize(object, &sink) == SUCCESS);
+    ASSERT(fstat(fd, &st) == 0);
+    close(fd);
+    JSON_FreeObject(object);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        object = JSON_ParseArena(doc);
+        ASSERT(object);
+        for (j = 0; j < 100; j++) {
+            sprintf(name, "s%d", j * 997);
+            found += JSON_GetString(object, name) != NULL;
+        }
+        JSON_FreeObject(object);
+        parse_time += now() - start;
+
+        start = now();
+        object = JSON_Open(path);
+        ASSERT(object);
+        for (j = 0; j < 100; j++) {
+            sprintf(name, "s%d", j * 997);
+            found -= JSON_GetString(object, name) != NULL;
+        }
+        JSON_Close(object);
+        open_time += now() - start;
+    }
+
+    ASSERT(found == 0);
+
+    printf("JSON_Open: %.1f MB document, %.1f MB image, 100 lookups\n",
+           bytes / 1e6, st.st_size / 1e6);
+    printf("    JSON_ParseArena     %8.3f ms\n",
+           parse_time / PARSE_ITERATIONS * 1e3);
+    printf("    JSON_Open           %8.3f ms\n",
+           open_time / PARSE_ITERATIONS * 1e3);
+
+    //  Records share their member names, which the image holds once.
+    free(doc);
+    doc = malloc(IMAGE_RECORDS * 128 + 32);
+    ASSERT(doc);
+    bytes = sprintf(doc, "{ \"records\" : [ ");
+    for (i = 0; i < IMAGE_RECORDS; i++) {
+        bytes += sprintf(doc + bytes,
+                         "%s{\"identifier\":%d,\"customer_name\":\"c%u\","
+                         "\"is_active\":%s,\"account_balance\":%u}",
+                         i ? "," : "", i, benchRand(),
+                         benchRand() % 2 ? "true" : "false", benchRand());
+    }
+    bytes += sprintf(doc + bytes, " ] }");
+
+    object = JSON_ParseArena(doc);
+    ASSERT(object);
+    fd = open(path, O_WRONLY | O_TRUNC);
+    ASSERT(fd >= 0);
+    JSON_InitFdSink(&sink, fd);
+    ASSERT(JSON_Serialize(object, &sink) == SUCCESS);
+    ASSERT(fstat(fd, &st) == 0);
+    close(fd);
+    JSON_FreeObject(object);
+
+    printf("    %.1f MB of records, %.1f MB image\n\n",
+           bytes / 1e6, st.st_size / 1e6);
+
+    unlink(path);
+    free(doc);
+}
+
+typedef char *(*ENCODER)(JSON_OBJECT_HANDLE, size_t *);
+typedef JSON_OBJECT_HANDLE (*DECODER)(const void *, size_t);
+
+
+static void benchBinaryFormat(const char *name, JSON_OBJECT_HANDLE object,
+                              ENCODER encode, DECODER decode)
+{
+    //-----------------------------
+    char *data;
+    size_t length;
+    JSON_OBJECT_HANDLE decoded;
+    double start;
+    double encode_time = 0;
+    double decode_time = 0;
+    int i;
+    //-----------------------------
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        data = encode(object, &length);
+        encode_time += now() - start;
+        ASSERT(data);
+
+        start = now();
+        decoded = decode(data, length);
+        decode_time += now() - start;
+        ASSERT(decoded);
+
+        JSON_FreeObject(decoded);
+        free(data);
+    }
+
+    printf("    %-8s %8.1f MB %8.3f ms out %8.3f ms in\n", name,
+           length / 1e6, encode_time / PARSE_ITERATIONS * 1e3,
+           decode_time / PARSE_ITERATIONS * 1e3);
+}
+
+
+static void benchBinaryFormats(void)
+{
+    //-----------------------------
+    char *doc;
+    char *text;
+    size_t bytes;
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE parsed;
+    double start;
+    double stringify_time = 0;
+    double parse_time = 0;
+    int i;
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    bytes = strlen(doc);
+
+    object = JSON_ParseArena(doc);
+    ASSERT(object);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        text = JSON_Stringify(object);
+        stringify_time += now() - start;
+        ASSERT(text);
+        free(text);
+
+        start = now();
+        parsed = JSON_ParseArena(doc);
+        parse_time += now() - start;
+        ASSERT(parsed);
+        JSON_FreeObject(parsed);
+    }
+
+    printf("MessagePack / CBOR: %.1f MB document\n", bytes / 1e6);
+    printf("    %-8s %8.1f MB %8.3f ms out %8.3f ms in\n", "JSON",
+           bytes / 1e6, stringify_time / PARSE_ITERATIONS * 1e3,
+           parse_time / PARSE_ITERATIONS * 1e3);
+
+    benchBinaryFormat("MsgPack", object, JSON_ToMsgPack, JSON_FromMsgPack);
+    benchBinaryFormat("CBOR", object, JSON_ToCbor, JSON_FromCbor);
+    printf("\n");
+
+    JSON_FreeObject(object);
+    free(doc);
+}
+
+
+
+//
+//  Parses the large document as it would arrive from a socket, in
+//  chunks of a few KB, and compares it with parsing the whole text.
+//
+static void benchPushParser(void)
+{
+    //-----------------------------
+    char *doc;
+    size_t bytes;
+    size_t offset;
+    size_t size;
+    JSON_OBJECT_HANDLE object;
+    JSON_PARSER_HANDLE parser;
+    double start;
+    double arena_time = 0;
+    double push_time[3] = { 0, 0, 0 };
+    size_t chunks[3] = { 512, 4096, 65536 };
+    int i;
+    int c;
+    //-----------------------------
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    bytes = strlen(doc);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        object = JSON_ParseArena(doc);
+        arena_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+
+        for (c = 0; c < 3; c++) {
+            start = now();
+            parser = JSON_ParserCreate();
+            for (offset = 0; offset < bytes; offset += size) {
+                size = (bytes - offset < chunks[c]) ? bytes - offset : chunks[c];
+                JSON_ParserFeed(parser, doc + offset, size);
+            }
+            object = JSON_ParserFinish(parser);
+            push_time[c] += now() - start;
+            ASSERT(object);
+            JSON_FreeObject(object);
+        }
+    }
+
+    printf("JSON_ParserFeed: %.1f MB document\n", bytes / 1e6);
+    printf("    JSON_ParseArena     %8.1f MB/s\n",
+           bytes * PARSE_ITERATIONS / arena_time / 1e6);
+    for (c = 0; c < 3; c++)
+        printf("    %6d byte chunks   %8.1f MB/s\n", (int)chunks[c],
+               bytes * PARSE_ITERATIONS / push_time[c] / 1e6);
+    printf("\n");
+
+    free(doc);
+}
+
+
+static int countValue(void *user)
+{
+    (*(long *)user)++;
+    return 0;
+}
+
+
+static int countString(void *user, const char *string, size_t length)
+{
+    (void)string;
+    (void)length;
+    (*(long *)user)++;
+    return 0;
+}
+
+
+static int countNumber(void *user, double number)
+{
+    (void)number;
+    (*(long *)user)++;
+    return 0;
+}
+
+
+static int countBoolean(void *user, int boolean)
+{
+    (void)boolean;
+    (*(long *)user)++;
+    return 0;
+}
+
+
+//
+//  Counts the values of the large document with the event parser, which
+//  builds nothing, and compares it with building the document.
+//
+static void benchSaxParse(void)
+{
+    //-----------------------------
+    JSON_SAX_CALLBACKS callbacks;
+    JSON_OBJECT_HANDLE object;
+    char *doc;
+    size_t bytes;
+    double start;
+    double arena_time = 0;
+    double sax_time = 0;
+    long values = 0;
+    int i;
+    //-----------------------------
+
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.OnObjectBegin = countValue;
+    callbacks.OnArrayBegin = countValue;
+    callbacks.OnString = countString;
+    callbacks.OnNumber = countNumber;
+    callbacks.OnBoolean = countBoolean;
+
+    doc = makeDocument(LARGE_DOCUMENT_MEMBERS);
+    bytes = strlen(doc);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+
+        start = now();
+        object = JSON_ParseArena(doc);
+        arena_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+
+        start = now();
+        ASSERT(JSON_SaxParse(doc, &callbacks, &values) == SUCCESS);
+        sax_time += now() - start;
+    }
+
+    printf("JSON_SaxParse: %.1f MB document, %ld values\n", bytes / 1e6,
+           values / PARSE_ITERATIONS);
+    printf("    JSON_ParseArena     %8.1f MB/s\n",
+           bytes * PARSE_ITERATIONS / arena_time / 1e6);
+    printf("    JSON_SaxParse       %8.1f MB/s\n\n",
+           bytes * PARSE_ITERATIONS / sax_time / 1e6);
+
+    free(doc);
+}
+
+
+//
+//  Reads the small values around the large payload of a 200 KB request,
+//  fully parsed, parsed lazily and parsed for just those values.
+//
+static void benchLazyParse(void)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    char *paths[] = { "id", "meta.version" };
+    char *data;
+    char *more;
+    char *doc;
+    size_t bytes;
+    double start;
+    double arena_time;
+    double lazy_time;
+    double select_time;
+    int64_t sum = 0;
+    int requests = 500;
+    int i;
+    //-----------------------------
+
+    data = makeDocument(4000);
+    more = makeDocument(4000);
+    doc = malloc(strlen(data) + strlen(more) + 128);
+    ASSERT(doc);
+    sprintf(doc, "{ \"id\" : 1, \"meta\" : { \"version\" : 3 }, "
+                 "\"data\" : { \"first\" : 5, %s, \"more\" : %s }",
+            data + 1, more);
+    bytes = strlen(doc);
+
+    start = now();
+    for (i = 0; i < requests; i++) {
+        object = JSON_ParseArena(doc);
+        ASSERT(object);
+        sum += JSON_GetInt64(object, "id");
+        sum += JSON_GetInt64(object, "meta.version");
+        JSON_FreeObject(object);
+    }
+    arena_time = now() - start;
+
+    start = now();
+    for (i = 0; i < requests; i++) {
+        object = JSON_ParseLazy(doc);
+        ASSERT(object);
+        sum += JSON_GetInt64(object, "id");
+        sum += JSON_GetInt64(object, "meta.version");
+        JSON_FreeObject(object);
+    }
+    lazy_time = now() - start;
+
+    start = now();
+    for (i = 0; i < requests; i++) {
+        object = JSON_ParseSelect(doc, paths, 2);
+        ASSERT(object);
+        sum += JSON_GetInt64(object, "id");
+        sum += JSON_GetInt64(object, "meta.version");
+        JSON_FreeObject(object);
+    }
+    select_time = now() - start;
+
+    ASSERT(sum == 3 * requests * 4);
+
+    printf("Reading 2 values from a %.0f KB document\n", bytes / 1e3);
+    printf("    JSON_ParseArena     %8.1f K documents/s\n",
+           requests / arena_time / 1e3);
+    printf("    JSON_ParseLazy      %8.1f K documents/s\n",
+           requests / lazy_time / 1e3);
+    printf("    JSON_ParseSelect    %8.1f K documents/s\n\n",
+           requests / select_time / 1e3);
+
+    free(doc);
+    free(more);
+    free(data);
+}
+
+
+//
+//  Stringifies ever larger documents, and writes them to /dev/null
+//  through a sink. With linear time the rates stay flat as the output
+//  grows.
+//
+static void benchStringifyLarge(void)
+{
+    //-----------------------------
+    char *doc;
+    char *text;
+    size_t bytes;
+    JSON_OBJECT_HANDLE object;
+    JSON_SINK sink;
+    double start;
+    double elapsed;
+    double write_elapsed;
+    int members;
+    int fd;
+    //-----------------------------
+
+    fd = open("/dev/null", O_WRONLY);
+    ASSERT(fd >= 0);
+    JSON_InitFdSink(&sink, fd);
+
+    printf("JSON_Stringify / JSON_WriteTo: growing documents\n");
+
+    for (members = LARGE_DOCUMENT_MEMBERS / 16;
+         members <= LARGE_DOCUMENT_MEMBERS * 4; members *= 4) {
+
+        doc = makeDocument(members);
+        object = JSON_Parse(doc);
+        ASSERT(object);
+
+        start = now();
+        text = JSON_Stringify(object);
+        elapsed = now() - start;
+        ASSERT(text);
+
+        start = now();
+        ASSERT(JSON_WriteTo(object, &sink, WRITE_COMPACT) == SUCCESS);
+        write_elapsed = now() - start;
+
+        bytes = strlen(text);
+        printf("    %8.1f MB out %8.1f MB/s %8.1f MB/s\n", bytes / 1e6,
+               bytes / elapsed / 1e6, bytes / write_elapsed / 1e6);
+
+        free(text);
+        JSON_FreeObject(object);
+        free(doc);
+    }
+
+    printf("\n");
+    close(fd);
+}
+
+
+#define TELEMETRY_SAMPLES 20000
+
+
+//
+//  Builds a number dense document, in the shape of telemetry readings:
+//  arrays of timestamps, counters and measurements.
+//
+static char *makeTelemetryDocument(int samples)
+{
+    //-----------------------------
+    char *doc;
+    size_t size;
+    size_t used = 0;
+    int i;
+    //-----------------------------
+
+    size = 64 + samples * 96;
+    doc = malloc(size);
+    ASSERT(doc);
+
+    used += sprintf(doc + used, "{\"time\":[");
+    for (i = 0; i < samples; i++)
+        used += sprintf(doc + used, "%s%u%05u", i ? "," : "",
+                        1700000000 + i, benchRand());
+
+    used += sprintf(doc + used, "],\"count\":[");
+    for (i = 0; i < samples; i++)
+        used += sprintf(doc + used, "%s%u", i ? "," : "", benchRand());
+
+    used += sprintf(doc + used, "],\"value\":[");
+    for (i = 0; i < samples; i++)
+        used += sprintf(doc + used, "%s%s%u.%04u", i ? "," : "",
+                        benchRand() % 4 ? "" : "-", benchRand() % 1000,
+                        benchRand() % 10000);
+
+    used += sprintf(doc + used, "],\"scaled\":[");
+    for (i = 0; i < samples; i++)
+        used += sprintf(doc + used, "%s%u.%ue-%u", i ? "," : "",
+                        benchRand() % 10, benchRand(), benchRand() % 12);
+
+    used += sprintf(doc + used, "]}");
+    ASSERT(used < size);
+
+    return doc;
+}
+
+
+static void benchParseNumbers(void)
+{
+    //-----------------------------
+    char *doc;
+    size_t bytes;
+    JSON_OBJECT_HANDLE object;
+    double start;
+    double parse_time = 0;
+    int i;
+    //-----------------------------
+
+    doc = makeTelemetryDocument(TELEMETRY_SAMPLES);
+    bytes = strlen(doc);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+        start = now();
+        object = JSON_ParseArena(doc);
+        parse_time += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+    }
+
+    printf("JSON_Parse: %.1f MB of numbers\n", bytes / 1e6);
+    printf("    JSON_ParseArena %8.1f MB/s %8.1f M numbers/s\n\n",
+           bytes * PARSE_ITERATIONS / parse_time / 1e6,
+           4.0 * TELEMETRY_SAMPLES * PARSE_ITERATIONS / parse_time / 1e6);
+
+    free(doc);
+}
+
+
+//
+//  Stringifies a document of doubles, and formats the same doubles with
+//  the C library, at round trip precision and the way "%f" used to.
+//
+static void benchStringifyNumbers(void)
+{
+    //-----------------------------
+    char *doc;
+    char *text;
+    char number[64];
+    size_t used;
+    size_t text_bytes = 0;
+    size_t exact_bytes = 0;
+    size_t fixed_bytes = 0;
+    JSON_OBJECT_HANDLE object;
+    double *values;
+    double start;
+    double stringify_time = 0;
+    double exact_time;
+    double fixed_time;
+    int i;
+    //-----------------------------
+
+    values = malloc(sizeof(double) * TELEMETRY_SAMPLES);
+    doc = malloc(64 + TELEMETRY_SAMPLES * 32);
+    ASSERT(values && doc);
+
+    //  Readings with a few decimals, and some small scaled ones.
+    for (i = 0; i < TELEMETRY_SAMPLES; i++) {
+        values[i] = (benchRand() % 1000) + (benchRand() % 10000) / 1e4;
+        if (i % 4 == 0)
+            values[i] = values[i] / 1e6;
+    }
+
+    used = sprintf(doc, "{\"value\":[");
+    for (i = 0; i < TELEMETRY_SAMPLES; i++)
+        used += sprintf(doc + used, "%s%.17g", i ? "," : "", values[i]);
+    sprintf(doc + used, "]}");
+
+    object = JSON_Parse(doc);
+    ASSERT(object);
+
+    for (i = 0; i < PARSE_ITERATIONS; i++) {
+        start = now();
+        text = JSON_Stringify(object);
+        stringify_time += now() - start;
+        ASSERT(text);
+        text_bytes = strlen(text);
+        free(text);
+    }
+    stringify_time /= PARSE_ITERATIONS;
+
+    start = now();
+    for (i = 0; i < TELEMETRY_SAMPLES; i++)
+        exact_bytes += snprintf(number, sizeof(number), "%.17g", values[i]);
+    exact_time = now() - start;
+
+    start = now();
+    for (i = 0; i < TELEMETRY_SAMPLES; i++)
+        fixed_bytes += snprintf(number, sizeof(number), "%f", values[i]);
+    fixed_time = now() - start;
+
+    //  The commas and the {"value":[ ]} around the numbers.
+    exact_bytes += TELEMETRY_SAMPLES - 1 + 12;
+    fixed_bytes += TELEMETRY_SAMPLES - 1 + 12;
+
+    printf("JSON_Stringify: %d doubles\n", TELEMETRY_SAMPLES);
+    printf("    JSON_Stringify  %8.1f M numbers/s %9zu bytes\n",
+           TELEMETRY_SAMPLES / stringify_time / 1e6, text_bytes);
+    printf("    \"%%.17g\"         %8.1f M numbers/s %9zu bytes\n",
+           TELEMETRY_SAMPLES / exact_time / 1e6, exact_bytes);
+    printf("    \"%%f\"            %8.1f M numbers/s %9zu bytes\n\n",
+           TELEMETRY_SAMPLES / fixed_time / 1e6, fixed_bytes);
+
+    JSON_FreeObject(object);
+    free(values);
+    free(doc);
+}
+
+
+#define NDJSON_RECORDS 100000
+
+
+static int countRecord(void *user_data, JSON_OBJECT_HANDLE record)
+{
+    (void)record;
+    __atomic_fetch_add((long *)user_data, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+static void benchNdjson(void)
+{
+    //-----------------------------
+    JSON_NDJSON_HANDLE reader;
+    JSON_OBJECT_HANDLE record;
+    FILE *file;
+    char *line;
+    long bytes;
+    long records;
+    double start;
+    double elapsed;
+    int max_threads;
+    int threads;
+    int i;
+    //-----------------------------
+
+    file = tmpfile();
+    ASSERT(file);
+
+    for (i = 0; i < NDJSON_RECORDS; i++) {
+        line = makeDocument(1 + benchRand() % 20);
+        fprintf(file, "%s\n", line);
+        free(line);
+    }
+    bytes = ftell(file);
+
+    max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+
+    printf("NDJSON: %d records, %.1f MB, %d CPUs\n", NDJSON_RECORDS,
+           bytes / 1e6, max_threads);
+
+    rewind(file);
+    records = 0;
+    start = now();
+    reader = JSON_NdjsonOpen(file);
+    while ((record = JSON_NdjsonNext(reader))) {
+        records++;
+        JSON_FreeObject(record);
+    }
+    JSON_NdjsonClose(reader);
+    elapsed = now() - start;
+    ASSERT(records == NDJSON_RECORDS);
+
+    printf("    JSON_NdjsonNext             %8.1f MB/s\n", bytes / elapsed / 1e6);
+
+    threads = 1;
+
+    while (1) {
+
+        rewind(file);
+        records = 0;
+        start = now();
+        ASSERT(JSON_NdjsonForEach(file, countRecord, &records, threads,
+                                  ORDER_INPUT) == SUCCESS);
+        elapsed = now() - start;
+        ASSERT(records == NDJSON_RECORDS);
+        printf("    ORDER_INPUT, threads %3d: %8.1f MB/s\n", threads,
+               bytes / elapsed / 1e6);
+
+        rewind(file);
+        records = 0;
+        start = now();
+        ASSERT(JSON_NdjsonForEach(file, countRecord, &records, threads,
+                                  ORDER_ANY) == SUCCESS);
+        elapsed = now() - start;
+        ASSERT(records == NDJSON_RECORDS);
+        printf("    ORDER_ANY,   threads %3d: %8.1f MB/s\n", threads,
+               bytes / elapsed / 1e6);
+
+        if (threads == max_threads)
+            break;
+
+        threads *= 2;
+        if (threads > max_threads)
+            threads = max_threads;
+    }
+
+    printf("\n");
+    fclose(file);
+}
+
+
+#define BATCH_DOCUMENTS 20000
+
+
+static void benchParseBatch(void)
+{
+    //-----------------------------
+    char **inputs;
+    JSON_OBJECT_HANDLE *out;
+    size_t total_bytes = 0;
+    double start;
+    double elapsed;
+    double base_rate = 0;
+    double rate;
+    int max_threads;
+    int threads;
+    int i;
+    //-----------------------------
+
+    inputs = malloc(sizeof(char *) * BATCH_DOCUMENTS);
+    out = malloc(sizeof(JSON_OBJECT_HANDLE) * BATCH_DOCUMENTS);
+    ASSERT(inputs && out);
+
+    //  Mostly small documents with the occasional large one.
+    for (i = 0; i < BATCH_DOCUMENTS; i++) {
+        if (i % 100 == 0)
+            inputs[i] = makeDocument(500 + benchRand() % 500);
+        else
+            inputs[i] = makeDocument(1 + benchRand() % 40);
+        total_bytes += strlen(inputs[i]);
+    }
+
+    max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+
+    printf("JSON_ParseBatch: %d documents, %.1f MB, %d CPUs\n",
+           BATCH_DOCUMENTS, total_bytes / 1e6, max_threads);
+
+    threads = 1;
+
+    while (1) {
+
+        start = now();
+        ASSERT(JSON_ParseBatch(inputs, BATCH_DOCUMENTS, out, NULL, threads)
+               == SUCCESS);
+        elapsed = now() - start;
+
+        for (i = 0; i < BATCH_DOCUMENTS; i++)
+            JSON_FreeObject(out[i]);
+
+        rate = BATCH_DOCUMENTS / elapsed;
+        if (threads == 1)
+            base_rate = rate;
+
+        printf("    threads %3d: %10.0f docs/s %8.1f MB/s  speedup %.2fx\n",
+               threads, rate, total_bytes / elapsed / 1e6, rate / base_rate);
+
+        if (threads == max_threads)
+            break;
+
+        threads *= 2;
+        if (threads > max_threads)
+            threads = max_threads;
+    }
+
+    for (i = 0; i < BATCH_DOCUMENTS; i++)
+        free(inputs[i]);
+    free(inputs);
+    free(out);
+}
+
+
+static void benchWideObject(void)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    char path[32];
+    double start;
+    double add_time;
+    double get_time;
+    int sizes[] = { 100, 1000, 10000, 50000 };
+    int members;
+    int n;
+    int i;
+    //-----------------------------
+
+    printf("Wide objects: add and look up every member\n");
+
+    for (n = 0; n < (int)(sizeof(sizes) / sizeof(sizes[0])); n++) {
+        members = sizes[n];
+        object = JSON_AllocObject();
+        ASSERT(JSON_AddInt64(object, "first", 0) == SUCCESS);
+
+        start = now();
+        for (i = 0; i < members; i++) {
+            sprintf(path, "wide.m%d", i);
+            JSON_AddInt64(object, path, i);
+        }
+        add_time = now() - start;
+
+        start = now();
+        for (i = 0; i < members; i++) {
+            sprintf(path, "wide.m%d", (int)(benchRand() % members));
+            JSON_GetInt64(object, path);
+        }
+        get_time = now() - start;
+
+        printf("    %6d members  add %8.2f M/s  get %8.2f M/s\n", members,
+               members / add_time / 1e6, members / get_time / 1e6);
+
+        JSON_FreeObject(object);
+    }
+
+    printf("\n");
+}
+
+
+static void benchPaths(void)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_PATH_HANDLE paths[12];
+    char *names[12];
+    char name[32];
+    char text[1024];
+    size_t length;
+    double start;
+    double string_time;
+    double compiled_time;
+    double sum = 0;
+    int lookups = 1000000;
+    int i;
+    //-----------------------------
+
+    length = sprintf(text, "{ \"id\" : 1, \"sensor\" : {");
+    for (i = 0; i < 12; i++) {
+        length += sprintf(text + length, "%s \"group%d\" : { \"reading\" : %g }",
+                          i ? "," : "", i, i * 1.5 + 1);
+    }
+    sprintf(text + length, " } }");
+
+    object = JSON_Parse(text);
+    ASSERT(object);
+
+    for (i = 0; i < 12; i++) {
+        sprintf(name, "sensor.group%d.reading", i);
+        ASSERT(JSON_GetNumber(object, name) == i * 1.5 + 1);
+        names[i] = strdup(name);
+        paths[i] = JSON_CompilePath(name);
+        ASSERT(paths[i]);
+    }
+
+    start = now();
+    for (i = 0; i < lookups; i++)
+        sum += JSON_GetNumber(object, names[i % 12]);
+    string_time = now() - start;
+
+    start = now();
+    for (i = 0; i < lookups; i++)
+        sum += JSON_GetNumberP(object, paths[i % 12]);
+    compiled_time = now() - start;
+
+    ASSERT(sum > 0);
+
+    printf("Path lookups: 12 paths, 3 levels deep\n");
+    printf("    JSON_GetNumber      %8.2f M lookups/s\n",
+           lookups / string_time / 1e6);
+    printf("    JSON_GetNumberP     %8.2f M lookups/s\n\n",
+           lookups / compiled_time / 1e6);
+
+    for (i = 0; i < 12; i++) {
+        JSON_FreePath(paths[i]);
+        free(names[i]);
+    }
+    JSON_FreeObject(object);
+}
+
+
+static void benchLongArray(void)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    char *text;
+    char path[32];
+    size_t length;
+    double start;
+    double parse_time;
+    double get_time;
+    double sum = 0;
+    int sizes[] = { 1000, 100000, 1000000 };
+    int count;
+    int n;
+    int i;
+    //-----------------------------
+
+    printf("Long arrays: parse, then read every element by index\n");
+
+    for (n = 0; n < (int)(sizeof(sizes) / sizeof(sizes[0])); n++) {
+        count = sizes[n];
+
+        text = malloc(count * 12 + 32);
+        length = sprintf(text, "{ \"samples\" : [ ");
+        for (i = 0; i < count; i++)
+            length += sprintf(text + length, i ? ", %d" : "%d", i);
+        sprintf(text + length, " ] }");
+
+        start = now();
+        object = JSON_ParseArena(text);
+        parse_time = now() - start;
+        ASSERT(object);
+
+        start = now();
+        for (i = 0; i < count; i++) {
+            sprintf(path, "samples[%d]", i);
+            sum += JSON_GetNumber(object, path);
+        }
+        get_time = now() - start;
+
+        printf("    %8d elements  parse %8.2f ms  get %8.2f M/s\n", count,
+               parse_time * 1e3, count / get_time / 1e6);
+
+        JSON_FreeObject(object);
+        free(text);
+    }
+
+    ASSERT(sum > 0);
+    printf("\n");
+}
+
+#define INTERNED_RECORDS 100000
+
+
+static void benchInternedKeys(void)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_KEYTABLE_HANDLE keys;
+    char *text;
+    size_t length;
+    size_t base;
+    size_t held[3];
+    double start;
+    double elapsed[3];
+    int i;
+    //-----------------------------
+
+    text = malloc(INTERNED_RECORDS * 128 + 32);
+    ASSERT(text);
+    length = sprintf(text, "{ \"records\" : [ ");
+    for (i = 0; i < INTERNED_RECORDS; i++) {
+        length += sprintf(text + length,
+                          "%s{\"identifier\":%d,\"customer_name\":\"c%u\","
+                          "\"is_active\":%s,\"account_balance\":%u}",
+                          i ? "," : "", i, benchRand(),
+                          benchRand() % 2 ? "true" : "false", benchRand());
+    }
+    sprintf(text + length, " ] }");
+
+    keys = JSON_KeyTableCreate();
+    ASSERT(keys);
+
+    for (i = 0; i < 3; i++) {
+
+        base = heapInUse();
+        start = now();
+
+        if (i == 0)
+            object = JSON_ParseArena(text);
+        else
+            object = JSON_ParseInterned(text, i == 1 ? NULL : keys);
+
+        elapsed[i] = now() - start;
+        held[i] = heapInUse() - base;
+        ASSERT(object);
+
+        JSON_FreeObject(object);
+    }
+
+    printf("Interned keys: %d records of 4 members, %.1f MB\n",
+           INTERNED_RECORDS, length / 1e6);
+    printf("    JSON_ParseArena          %8.2f ms %8.1f MB\n",
+           elapsed[0] * 1e3, held[0] / 1e6);
+    printf("    JSON_ParseInterned       %8.2f ms %8.1f MB\n",
+           elapsed[1] * 1e3, held[1] / 1e6);
+    printf("    JSON_ParseInterned keys  %8.2f ms %8.1f MB\n\n",
+           elapsed[2] * 1e3, held[2] / 1e6);
+
+    JSON_KeyTableFree(keys);
+    free(text);
+}
+
+
+
+static void benchBuilder(void)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_BUILDER_HANDLE builder;
+    static char names[24][32];
+    double start;
+    double add_time;
+    double build_time;
+    int responses = 20000;
+    int wide = 20000;
+    int i;
+    int j;
+    //-----------------------------
+
+    for (j = 0; j < 16; j++)
+        sprintf(names[j], "field%d", j);
+    for (j = 16; j < 24; j++)
+        sprintf(names[j], "owner.field%d", j);
+
+    //  A typical response: 16 members and a nested object of 8.
+    start = now();
+    for (i = 0; i < responses; i++) {
+        object = JSON_AllocObject();
+        for (j = 0; j < 24; j++) {
+            if (j % 2)
+                JSON_AddString(object, names[j], "some text");
+            else
+                JSON_AddInt64(object, names[j], i + j);
+        }
+        JSON_FreeObject(object);
+    }
+    add_time = now() - start;
+
+    start = now();
+    for (i = 0; i < responses; i++) {
+        builder = JSON_BuilderBegin(0);
+        for (j = 0; j < 24; j++) {
+            if (j == 16)
+                JSON_BuilderBeginObject(builder, "owner");
+            if (j % 2)
+                JSON_BuilderAddString(builder, names[j] + (j < 16 ? 0 : 6),
+                                      "some text");
+            else
+                JSON_BuilderAddInt64(builder, names[j] + (j < 16 ? 0 : 6), i + j);
+        }
+        JSON_BuilderEnd(builder);
+        object = JSON_BuilderFinish(builder);
+        ASSERT(object);
+        JSON_FreeObject(object);
+    }
+    build_time = now() - start;
+
+    printf("Building responses: 24 members, one nested object\n");
+    printf("    JSON_Add*           %8.1f K objects/s\n",
+           responses / add_time / 1e3);
+    printf("    JSON_Builder*       %8.1f K objects/s\n",
+           responses / build_time / 1e3);
+
+    //  One wide object.
+    start = now();
+    object = JSON_AllocObject();
+    for (i = 0; i < wide; i++) {
+        sprintf(names[0], "k%d", i);
+        JSON_AddInt64(object, names[0], i);
+    }
+    add_time = now() - start;
+    JSON_FreeObject(object);
+
+    start = now();
+    builder = JSON_BuilderBegin(0);
+    for (i = 0; i < wide; i++) {
+        sprintf(names[0], "k%d", i);
+        JSON_BuilderAddInt64(builder, names[0], i);
+    }
+    object = JSON_BuilderFinish(builder);
+    build_time = now() - start;
+    ASSERT(object);
+    JSON_FreeObject(object);
+
+    printf("Building one object of %d members\n", wide);
+    printf("    JSON_Add*           %8.2f ms\n", add_time * 1e3);
+    printf("    JSON_Builder*       %8.2f ms\n\n", build_time * 1e3);
+}
+
+
+//---------------------------------------------------------------------------
+//
+//  Throughput suite.
+//
+//  Every corpus is generated here from a fixed seed, so runs on any
+//  machine, of any release, measure exactly the same input. Each
+//  operation repeats until it has run for SUITE_MIN_TIME, and one line
+//  per corpus and operation goes to SUITE_OUTPUT, tab separated, for
+//  releases to be compared by script.
+//
+//---------------------------------------------------------------------------
+#define SUITE_OUTPUT          "bench_output.txt"
+#define SUITE_CORPUS_SIZE     (4 * 1024 * 1024)
+#define SUITE_LOOKUPS         1000
+#define SUITE_MIN_TIME        0.25
+#define SUITE_MIN_ITERATIONS  3
+#define SUITE_DEPTH           200
+
+
+typedef struct _TEXT {
+
+    char *Text;
+    size_t Length;
+    size_t Capacity;
+
+} TEXT;
+
+
+static void appendText(TEXT *t, const char *format, ...)
+{
+    //-----------------------------
+    va_list args;
+    int length;
+    //-----------------------------
+
+    while (1) {
+        va_start(args, format);
+        length = vsnprintf(t->Text + t->Length, t->Capacity - t->Length,
+                           format, args);
+        va_end(args);
+        ASSERT(length >= 0);
+
+        if ((size_t)length < t->Capacity - t->Length)
+            break;
+
+        t->Capacity = t->Capacity ? t->Capacity * 2 : 4096;
+        t->Text = realloc(t->Text, t->Capacity);
+        ASSERT(t->Text);
+    }
+
+    t->Length += length;
+}
+
+
+//
+//  A corpus and the paths its lookups read, which all hold numbers, or
+//  all hold strings.
+//
+typedef struct _CORPUS {
+
+    const char *Name;
+    TEXT Text;
+    char *Paths[SUITE_LOOKUPS];
+    int Strings;
+
+} CORPUS;
+
+
+static void addPath(CORPUS *c, int i, const char *format, int index)
+{
+    //-----------------------------
+    char path[32];
+    //-----------------------------
+
+    snprintf(path, sizeof(path), format, index);
+    c->Paths[i] = strdup(path);
+    ASSERT(c->Paths[i]);
+}
+
+
+static void makeNumberCorpus(CORPUS *c)
+{
+    //-----------------------------
+    int count = 0;
+    int i;
+    //-----------------------------
+
+    c->Name = "numbers";
+    appendText(&c->Text, "{\"values\":[");
+
+    while (c->Text.Length < SUITE_CORPUS_SIZE) {
+        switch (benchRand() % 3) {
+            case 0:
+                appendText(&c->Text, "%s%u", count ? "," : "",
+                           benchRand() * 32768 + benchRand());
+                break;
+            case 1:
+                appendText(&c->Text, "%s-%u.%04u", count ? "," : "",
+                           benchRand(), benchRand() % 10000);
+                break;
+            default:
+                appendText(&c->Text, "%s%u.%ue%d", count ? "," : "",
+                           benchRand() % 10, benchRand(),
+                           (int)(benchRand() % 40) - 20);
+                break;
+        }
+        count++;
+    }
+
+    appendText(&c->Text, "]}");
+
+    for (i = 0; i < SUITE_LOOKUPS; i++)
+        addPath(c, i, "values[%d]", (int)((long)i * count / SUITE_LOOKUPS));
+}
+
+
+static void makeStringCorpus(CORPUS *c)
+{
+    //-----------------------------
+    int count = 0;
+    int i;
+    //-----------------------------
+
+    c->Name = "strings";
+    c->Strings = 1;
+    appendText(&c->Text, "{");
+
+    while (c->Text.Length < SUITE_CORPUS_SIZE) {
+        appendText(&c->Text, "%s\"s%d\":\"%u plain words, a \\\"quote\\\", "
+                   "a tab\\t, caf\xc3\xa9 and \\u00e9 over %u bytes\"",
+                   count ? "," : "", count, benchRand(), benchRand());
+        count++;
+    }
+
+    appendText(&c->Text, "}");
+
+    for (i = 0; i < SUITE_LOOKUPS; i++)
+        addPath(c, i, "s%d", (int)((long)i * count / SUITE_LOOKUPS));
+}
+
+
+//
+//  Chains of SUITE_DEPTH nested objects. Their paths are too long for
+//  addPath(), and all the same apart from the index.
+//
+static void makeDeepCorpus(CORPUS *c)
+{
+    //-----------------------------
+    TEXT path = { 0 };
+    int count = 0;
+    int depth;
+    int i;
+    //-----------------------------
+
+    c->Name = "deep";
+    appendText(&c->Text, "{\"chains\":[");
+
+    while (c->Text.Length < SUITE_CORPUS_SIZE) {
+        appendText(&c->Text, count ? "," : "");
+        for (i = 0; i < SUITE_DEPTH; i++)
+            appendText(&c->Text, "{\"a\":");
+        appendText(&c->Text, "{\"v\":%u}", benchRand());
+        for (i = 0; i < SUITE_DEPTH; i++)
+            appendText(&c->Text, "}");
+        count++;
+    }
+
+    appendText(&c->Text, "]}");
+
+    for (i = 0; i < SUITE_LOOKUPS; i++) {
+        path.Length = 0;
+        appendText(&path, "chains[%d]", (int)((long)i * count / SUITE_LOOKUPS));
+        for (depth = 0; depth < SUITE_DEPTH; depth++)
+            appendText(&path, ".a");
+        appendText(&path, ".v");
+        c->Paths[i] = strdup(path.Text);
+        ASSERT(c->Paths[i]);
+    }
+
+    free(path.Text);
+}
+
+
+static void makeWideCorpus(CORPUS *c)
+{
+    //-----------------------------
+    int count = 0;
+    int i;
+    //-----------------------------
+
+    c->Name = "wide";
+    appendText(&c->Text, "{");
+
+    while (c->Text.Length < SUITE_CORPUS_SIZE) {
+        appendText(&c->Text, "%s\"member_%d\":%u", count ? "," : "", count,
+                   benchRand());
+        count++;
+    }
+
+    appendText(&c->Text, "}");
+
+    for (i = 0; i < SUITE_LOOKUPS; i++)
+        addPath(c, i, "member_%d", (int)((long)i * count / SUITE_LOOKUPS));
+}
+
+
+static void makeArrayCorpus(CORPUS *c)
+{
+    //-----------------------------
+    int count = 0;
+    int i;
+    //-----------------------------
+
+    c->Name = "arrays";
+    appendText(&c->Text, "{\"rows\":[");
+
+    while (c->Text.Length < SUITE_CORPUS_SIZE) {
+        appendText(&c->Text, "%s{\"id\":%d,\"name\":\"n%u\",\"score\":%u.%u,"
+                   "\"tags\":[%u,%u,%u]}", count ? "," : "", count,
+                   benchRand(), benchRand() % 100, benchRand() % 100,
+                   benchRand(), benchRand(), benchRand());
+        count++;
+    }
+
+    appendText(&c->Text, "]}");
+
+    for (i = 0; i < SUITE_LOOKUPS; i++)
+        addPath(c, i, "rows[%d].id", (int)((long)i * count / SUITE_LOOKUPS));
+}
+
+
+static void writeResult(FILE *out, CORPUS *c, const char *operation,
+                        size_t bytes, long iterations, double elapsed)
+{
+    //-----------------------------
+    double ns_per_op;
+    double mb_per_s;
+    //-----------------------------
+
+    ns_per_op = elapsed / iterations * 1e9;
+    mb_per_s = bytes ? bytes * iterations / elapsed / 1e6 : 0;
+
+    fprintf(out, "%s\t%s\t%zu\t%ld\t%.1f\t%.1f\n", c->Name, operation,
+            bytes, iterations, ns_per_op, mb_per_s);
+
+    printf("    %-8s %-15s %14.1f ns/op", c->Name, operation, ns_per_op);
+    if (bytes)
+        printf(" %8.1f MB/s", mb_per_s);
+    printf("\n");
+}
+
+
+static int keepRunning(long iterations, double elapsed)
+{
+    return iterations < SUITE_MIN_ITERATIONS || elapsed < SUITE_MIN_TIME;
+}
+
+
+static void benchCorpus(CORPUS *c, FILE *out)
+{
+    //-----------------------------
+    JSON_OBJECT_HANDLE object;
+    char *text;
+    size_t text_length = 0;
+    double start;
+    double elapsed;
+    double sum = 0;
+    long iterations;
+    long found = 0;
+    int i;
+    //-----------------------------
+
+    for (iterations = 0, elapsed = 0; keepRunning(iterations, elapsed);
+         iterations++) {
+        start = now();
+        object = JSON_Parse(c->Text.Text);
+        elapsed += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+    }
+    writeResult(out, c, "parse", c->Text.Length, iterations, elapsed);
+
+    for (iterations = 0, elapsed = 0; keepRunning(iterations, elapsed);
+         iterations++) {
+        start = now();
+        object = JSON_ParseArena(c->Text.Text);
+        elapsed += now() - start;
+        ASSERT(object);
+        JSON_FreeObject(object);
+    }
+    writeResult(out, c, "parse_arena", c->Text.Length, iterations, elapsed);
+
+    for (iterations = 0, elapsed = 0; keepRunning(iterations, elapsed);
+         iterations++) {
+        object = JSON_Parse(c->Text.Text);
+        ASSERT(object);
+        start = now();
+        JSON_FreeObject(object);
+        elapsed += now() - start;
+    }
+    writeResult(out, c, "free", c->Text.Length, iterations, elapsed);
+
+    object = JSON_Parse(c->Text.Text);
+    ASSERT(object);
+
+    for (iterations = 0, elapsed = 0; keepRunning(iterations, elapsed);
+         iterations++) {
+        start = now();
+        text = JSON_Stringify(object);
+        elapsed += now() - start;
+        ASSERT(text);
+        text_length = strlen(text);
+        free(text);
+    }
+    writeResult(out, c, "stringify", text_length, iterations, elapsed);
+
+    //  Each iteration reads every path once.
+    for (iterations = 0, elapsed = 0; keepRunning(iterations, elapsed);
+         iterations += SUITE_LOOKUPS) {
+        start = now();
+        if (c->Strings) {
+            for (i = 0; i < SUITE_LOOKUPS; i++)
+                found += JSON_GetString(object, c->Paths[i]) != NULL;
+        }
+        else {
+            for (i = 0; i < SUITE_LOOKUPS; i++) {
+                sum += JSON_GetNumber(object, c->Paths[i]);
+                found += JSON_GetErrno() == SUCCESS;
+            }
+        }
+        elapsed += now() - start;
+    }
+    writeResult(out, c, c->Strings ? "get_string" : "get_number", 0,
+                iterations, elapsed);
+
+    //  Every path is there, so a miss would time the wrong thing.
+    ASSERT(found == iterations && (c->Strings || sum != 0));
+
+    JSON_FreeObject(object);
+}
+
+
+static void benchSuite(void)
+{
+    //-----------------------------
+    void (*makers[])(CORPUS *) = {
+        makeNumberCorpus, makeStringCorpus, makeDeepCorpus,
+        makeWideCorpus, makeArrayCorpus
+    };
+    CORPUS corpus;
+    FILE *out;
+    size_t n;
+    int i;
+    //-----------------------------
+
+    out = fopen(SUITE_OUTPUT, "w");
+    ASSERT(out);
+    fprintf(out, "corpus\toperation\tbytes\titerations\tns_per_op\tmb_per_s\n");
+
+    printf("Throughput suite, written to %s\n", SUITE_OUTPUT);
+
+    for (n = 0; n < sizeof(makers) / sizeof(makers[0]); n++) {
+
+        //  The same input whatever ran before.
+        bench_seed = 12345;
+        memset(&corpus, 0, sizeof(corpus));
+        makers[n](&corpus);
+
+        benchCorpus(&corpus, out);
+
+        for (i = 0; i < SUITE_LOOKUPS; i++)
+            free(corpus.Paths[i]);
+        free(corpus.Text.Text);
+    }
+
+    printf("\n");
+    fclose(out);
+}
+
+
+//
+//  With --suite, only the throughput suite runs.
+//
+int main(int argc, char *argv[]) {
+
+    printf("JSON BENCHMARKS\n\n");
+
+    if (argc > 1 && strcmp(argv[1], "--suite") == 0) {
+        benchSuite();
+        return 0;
+    }
+
+    benchParseLarge();
+    benchNodeFootprint();
+    benchDocumentStats();
+    benchParseFile();
+    benchImage();
+    benchBinaryFormats();
+    benchPushParser();
+    benchSaxParse();
+    benchLazyParse();
+    benchStringifyLarge();
+    benchParseNumbers();
+    benchStringifyNumbers();
+    benchWideObject();
+    benchPaths();
+    benchLongArray();
+    benchInternedKeys();
+    benchBuilder();
+    benchParseBatch();
+    benchNdjson();
+    benchSuite();
+
+    return 0;
+}
@@ -22,8 +22,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "json.h"
 
 
@@ -275,6 +279,2326 @@ void test6(void)
 }
 
 
+void test7(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    char *buffer;
+    int b;
+    char *string;
+    char test[] =
+            "{ \"A1\" : [\"Hi A String\", { \"TheAnswer\":42} , [12, 13, 14]],"
+                    " \"x\" : {\"y\" : true}  }";
+    //---------------------------------
+
+    printf("\nTEST 7\n----------------------------\n");
+
+    object = JSON_ParseArena(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    JSON_Print(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    printf("%s\n\n", buffer);
+    free(buffer);
+
+    string = JSON_GetString(object, "A1[0]");
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strcmp(string, "Hi A String") == 0);
+
+    b = JSON_GetNumber(object, "A1[1].TheAnswer");
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(b == 42);
+
+    b = JSON_GetBoolean(object, "x.y");
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(b == 1);
+
+    JSON_AddString(object, "x.z", "Added Later");
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    string = JSON_GetString(object, "x.z");
+    ASSERT(strcmp(string, "Added Later") == 0);
+
+    JSON_FreeObject(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+}
+
+
+static void *test8Worker(void *arg)
+{
+    //---------------------------------
+    JSON_CONTEXT ctx;
+    JSON_OBJECT_HANDLE object;
+    char *buffer;
+    int i;
+    int id = *(int *)arg;
+    char test[128];
+    //---------------------------------
+
+    JSON_InitContext(&ctx);
+
+    for (i = 0; i < 1000; i++) {
+
+        snprintf(test, sizeof(test), "{ \"id\" : %d, \"i\" : {\"n\" : %d} }", id, i);
+
+        object = JSON_ParseCtx(&ctx, test);
+        ASSERT(JSON_GetErrnoCtx(&ctx) == SUCCESS);
+
+        ASSERT(JSON_GetNumberCtx(&ctx, object, "id") == id);
+        ASSERT(JSON_GetNumberCtx(&ctx, object, "i.n") == i);
+        ASSERT(JSON_GetErrnoCtx(&ctx) == SUCCESS);
+
+        JSON_GetStringCtx(&ctx, object, "id");
+        ASSERT(JSON_GetErrnoCtx(&ctx) == ERROR_INVALID_STRING);
+
+        buffer = JSON_StringifyCtx(&ctx, object);
+        ASSERT(JSON_GetErrnoCtx(&ctx) == SUCCESS);
+        free(buffer);
+
+        JSON_FreeObject(object);
+    }
+
+    return NULL;
+}
+
+
+void test8(void)
+{
+    //---------------------------------
+    pthread_t threads[4];
+    int ids[4];
+    int i;
+    JSON_CONTEXT ctx;
+    //---------------------------------
+
+    printf("\nTEST 8\n----------------------------\n");
+
+    for (i = 0; i < 4; i++) {
+        ids[i] = i;
+        ASSERT(pthread_create(&threads[i], NULL, test8Worker, &ids[i]) == 0);
+    }
+
+    for (i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    //  A failure on one context does not leak into another.
+    JSON_InitContext(&ctx);
+    JSON_GetNumberCtx(&ctx, NULL, "x");
+    ASSERT(JSON_GetErrnoCtx(&ctx) == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    printf("Parallel parse with contexts done.\n");
+}
+
+
+void test9(void)
+{
+    //---------------------------------
+    char *inputs[100];
+    JSON_OBJECT_HANDLE out[100];
+    JSON_ERROR errors[100];
+    JSON_ERROR rc;
+    int i;
+    //---------------------------------
+
+    printf("\nTEST 9\n----------------------------\n");
+
+    for (i = 0; i < 100; i++) {
+        inputs[i] = malloc(64);
+        if (i == 37)
+            strcpy(inputs[i], "{ \"bad\" : nope }");
+        else
+            snprintf(inputs[i], 64, "{ \"i\" : %d, \"s\" : \"x%d\" }", i, i);
+    }
+
+    rc = JSON_ParseBatch(inputs, 100, out, errors, 4);
+    ASSERT(rc == ERROR_INVALID_VALUE_TYPE);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_VALUE_TYPE);
+
+    for (i = 0; i < 100; i++) {
+        if (i == 37) {
+            ASSERT(out[i] == NULL);
+            ASSERT(errors[i] == ERROR_INVALID_VALUE_TYPE);
+            continue;
+        }
+        ASSERT(errors[i] == SUCCESS);
+        ASSERT(JSON_GetNumber(out[i], "i") == i);
+        JSON_FreeObject(out[i]);
+    }
+
+    for (i = 0; i < 100; i++)
+        free(inputs[i]);
+
+    printf("Batch parse done.\n");
+}
+
+
+void test10(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    char *string;
+    char *big;
+    size_t used;
+    int i;
+    char test[] =
+            "{\n"
+            "  \"quoted\" : \"say \\\"hi\\\" {not: [an, object]}\",\r\n"
+            "  \"slash\" : \"ends in a backslash \\\\\",\n"
+            "  \"list\" : [ 1 ,\n 2 ],\n"
+            "  \"flag\" : false\n"
+            "}\n";
+    char *bad[] = {
+            "{ \"x\" : \"unterminated }",
+            "{ \"x\" : 1 } trailing",
+            "x{ \"a\" : 1 }",
+            "garbage{ \"a\" : 1 }",
+            "123{ \"a\" : 1 }",
+            ".{ \"a\" : 1 }",
+            "\\{ \"a\" : 1 }",
+            "{ \"x\" : truex }",
+            "{ \"x\" : 1 2 }",
+            "{ \"x\" 1 }",
+            "{ \"x\" : [1, 2 }",
+            "[ 1, 2 ]",
+            "",
+    };
+    //---------------------------------
+
+    printf("\nTEST 10\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    JSON_Print(object);
+
+    string = JSON_GetString(object, "quoted");
+    ASSERT(strcmp(string, "say \"hi\" {not: [an, object]}") == 0);
+
+    string = JSON_GetString(object, "slash");
+    ASSERT(strcmp(string, "ends in a backslash \\") == 0);
+
+    ASSERT(JSON_GetNumber(object, "list[1]") == 2);
+    ASSERT(JSON_GetBoolean(object, "flag") == 0);
+
+    JSON_FreeObject(object);
+
+    for (i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        object = JSON_Parse(bad[i]);
+        ASSERT(object == NULL);
+        ASSERT(JSON_GetErrno() != SUCCESS);
+    }
+
+    //  Long enough that strings and escapes straddle the 64 byte blocks
+    //  the structural scan works on.
+    big = malloc(64 * 1024);
+    used = sprintf(big, "{");
+    for (i = 0; i < 1000; i++) {
+        used += sprintf(big + used, "%s\"k%d\":\"%.*s\\\"%d\"", i ? "," : "",
+                        i, i % 61, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghij", i);
+    }
+    sprintf(big + used, "}");
+
+    object = JSON_Parse(big);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    string = JSON_GetString(object, "k999");
+    ASSERT(strcmp(string, "abcdefghijklmnopqrstuvw\"999") == 0);
+    JSON_FreeObject(object);
+    free(big);
+
+    printf("Structural scan done.\n");
+}
+
+
+void test11(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    char *string;
+    char *buffer;
+    JSON_ERROR rc;
+    char test[] =
+            "{ \"name\" : \"plain\", \"tab\\tkey\" : \"line\\nbreak\","
+            " \"quote\" : \"\\\"\\\\\\/\", \"utf\" : \"\\u00e9\\u20ac\\ud83d\\ude00\","
+            " \"list\" : [ \"a\", \"b\\u0041\" ] }";
+    char copy[sizeof(test)];
+    char bad_escape[] = "{ \"x\" : \"\\q\" }";
+    char bad_surrogate[] = "{ \"x\" : \"\\ud83d\" }";
+    char short_unicode[] = "{ \"x\" : \"\\u12\" }";
+    char nul_string[] = "{ \"x\" : \"a\\u0000b\" }";
+    char nul_name[] = "{ \"a\\u0000b\" : 1 }";
+    JSON_KEYTABLE_HANDLE keys;
+    //---------------------------------
+
+    printf("\nTEST 11\n----------------------------\n");
+
+    memcpy(copy, test, sizeof(test));
+
+    object = JSON_ParseInSitu(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    JSON_Print(object);
+
+    //  Strings point into the buffer that was parsed.
+    string = JSON_GetString(object, "name");
+    ASSERT(strcmp(string, "plain") == 0);
+    ASSERT(string > test && string < test + sizeof(test));
+
+    string = JSON_GetString(object, "tab\tkey");
+    ASSERT(strcmp(string, "line\nbreak") == 0);
+    ASSERT(string > test && string < test + sizeof(test));
+
+    string = JSON_GetString(object, "quote");
+    ASSERT(strcmp(string, "\"\\/") == 0);
+
+    string = JSON_GetString(object, "utf");
+    ASSERT(strcmp(string, "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80") == 0);
+
+    string = JSON_GetString(object, "list[1]");
+    ASSERT(strcmp(string, "bA") == 0);
+
+    //  Added values are owned by the object, the parsed ones are not.
+    rc = JSON_AddString(object, "name", "replaced");
+    ASSERT(rc == SUCCESS);
+    rc = JSON_AddString(object, "added", "new \"one\"");
+    ASSERT(rc == SUCCESS);
+
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    printf("%s\n", buffer);
+    ASSERT(strstr(buffer, "\"tab\\tkey\":\"line\\nbreak\"") != NULL);
+    ASSERT(strstr(buffer, "\"quote\":\"\\\"\\\\/\"") != NULL);
+    ASSERT(strstr(buffer, "\"added\":\"new \\\"one\\\"\"") != NULL);
+    free(buffer);
+
+    JSON_FreeObject(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    //  The copying parsers unescape the same way.
+    object = JSON_Parse(copy);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    string = JSON_GetString(object, "utf");
+    ASSERT(strcmp(string, "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80") == 0);
+    ASSERT(string < copy || string >= copy + sizeof(copy));
+    JSON_FreeObject(object);
+
+    object = JSON_ParseInSitu(bad_escape);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    object = JSON_ParseInSitu(bad_surrogate);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    object = JSON_Parse(short_unicode);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    //  A NUL would cut the string short, so it is not let in.
+    object = JSON_Parse(nul_string);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    object = JSON_Parse(nul_name);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    keys = JSON_KeyTableCreate();
+    object = JSON_ParseInterned(nul_name, keys);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+    JSON_KeyTableFree(keys);
+
+    object = JSON_ParseInSitu(nul_string);
+    ASSERT(object == NULL && JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    printf("In-situ parse done.\n");
+}
+
+
+void test12(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    char *buffer;
+    int i;
+    char test[] =
+            "{ \"id\" : 9007199254740993, \"neg\" : -42, \"zero\" : 0,"
+            " \"max\" : 9223372036854775807, \"min\" : -9223372036854775808,"
+            " \"big\" : 9223372036854775808, \"pi\" : -3.14159,"
+            " \"exp\" : 1.5E+3, \"tiny\" : 5e-324, \"huge\" : 1.7976931348623157e308,"
+            " \"long\" : 0.1000000000000000055511151231257827021181583404541015625,"
+            " \"negzero\" : -0, \"list\" : [ -1, 2.5e-1, 3 ] }";
+    char *numbers[] = {
+            "0.1", "2.2250738585072014e-308", "4.9406564584124654e-324",
+            "9007199254740993.0", "1e23", "8.41e21", "1e-400", "-2.5e-5",
+            "123456789012345678901234567890", "7.2057594037927933e16",
+            "0.000000000000000000000000000001234",
+    };
+    char *bad[] = {
+            "{ \"x\" : - }",
+            "{ \"x\" : 01 }",
+            "{ \"x\" : 1. }",
+            "{ \"x\" : .5 }",
+            "{ \"x\" : 1e }",
+            "{ \"x\" : 1e+ }",
+            "{ \"x\" : --1 }",
+            "{ \"x\" : +1 }",
+            "{ \"x\" : 1.5.2 }",
+            "{ \"x\" : 0x10 }",
+    };
+    char *too_large[] = {
+            "1e400", "-1e400", "9223372036854e775807", "1.8e308",
+            "1797693134862315800000000000000000000000000000000000000000000000"
+            "0000000000000000000000000000000000000000000000000000000000000000"
+            "0000000000000000000000000000000000000000000000000000000000000000"
+            "0000000000000000000000000000000000000000000000000000000000000000"
+            "0000000000000000000000000000000000000000000000000000000000000000",
+    };
+    char doc[512];
+    //---------------------------------
+
+    printf("\nTEST 12\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    JSON_Print(object);
+
+    ASSERT(JSON_GetType(object, "id") == TYPE_INTEGER);
+    ASSERT(JSON_GetInt64(object, "id") == 9007199254740993LL);
+    ASSERT(JSON_GetInt64(object, "neg") == -42);
+    ASSERT(JSON_GetNumber(object, "neg") == -42.0);
+    ASSERT(JSON_GetType(object, "zero") == TYPE_INTEGER);
+    ASSERT(JSON_GetInt64(object, "max") == INT64_MAX);
+    ASSERT(JSON_GetInt64(object, "min") == INT64_MIN);
+    ASSERT(JSON_GetType(object, "big") == TYPE_NUMBER);
+    ASSERT(JSON_GetNumber(object, "big") == 9223372036854775808.0);
+    ASSERT(JSON_GetNumber(object, "pi") == -3.14159);
+    ASSERT(JSON_GetNumber(object, "exp") == 1500.0);
+    ASSERT(JSON_GetInt64(object, "exp") == 1500);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(JSON_GetNumber(object, "tiny") == 5e-324);
+    ASSERT(JSON_GetNumber(object, "huge") == 1.7976931348623157e308);
+    ASSERT(JSON_GetNumber(object, "long") == 0.1);
+    ASSERT(JSON_GetType(object, "negzero") == TYPE_NUMBER);
+    ASSERT(signbit(JSON_GetNumber(object, "negzero")));
+    ASSERT(JSON_GetInt64(object, "list[0]") == -1);
+    ASSERT(JSON_GetNumber(object, "list[1]") == 0.25);
+
+    JSON_GetInt64(object, "pi");
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+
+    //  Integers survive a round trip.
+    ASSERT(JSON_AddInt64(object, "neg", -9007199254740995LL) == SUCCESS);
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    printf("%s\n", buffer);
+    ASSERT(strstr(buffer, "\"id\":9007199254740993,") != NULL);
+    ASSERT(strstr(buffer, "\"neg\":-9007199254740995,") != NULL);
+    ASSERT(strstr(buffer, "\"min\":-9223372036854775808,") != NULL);
+    free(buffer);
+
+    JSON_FreeObject(object);
+
+    //  Same results as the C library.
+    for (i = 0; i < (int)(sizeof(numbers) / sizeof(numbers[0])); i++) {
+        sprintf(doc, "{ \"x\" : %s }", numbers[i]);
+        object = JSON_Parse(doc);
+        ASSERT(JSON_GetErrno() == SUCCESS);
+        ASSERT(JSON_GetNumber(object, "x") == strtod(numbers[i], NULL));
+        JSON_FreeObject(object);
+    }
+
+    for (i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        object = JSON_Parse(bad[i]);
+        ASSERT(object == NULL);
+        ASSERT(JSON_GetErrno() != SUCCESS);
+    }
+
+    //  Numbers beyond the range of a double have no value to keep.
+    for (i = 0; i < (int)(sizeof(too_large) / sizeof(too_large[0])); i++) {
+        sprintf(doc, "{ \"x\" : %s }", too_large[i]);
+        ASSERT(JSON_Parse(doc) == NULL);
+        ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    }
+
+    printf("Number parse done.\n");
+}
+
+
+void test13(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE copy;
+    char *buffer;
+    char path[32];
+    double value;
+    unsigned long long bits;
+    int i;
+    char test[] =
+            "{ \"a\" : 0.1, \"b\" : 1500.0, \"c\" : 1e22, \"d\" : 5e-324,"
+            " \"e\" : -0.0, \"f\" : 123.456, \"g\" : 1e-7, \"h\" : 0.000001,"
+            " \"i\" : 1.7976931348623157e308, \"j\" : 12, \"k\" : -2.5e-5 }";
+    //---------------------------------
+
+    printf("\nTEST 13\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    JSON_Print(object);
+
+    //  Shortest form, whole doubles stay doubles.
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    printf("%s\n", buffer);
+    ASSERT(strcmp(buffer, "{\"a\":0.1,\"b\":1500.0,\"c\":1e22,\"d\":5e-324,"
+                          "\"e\":-0.0,\"f\":123.456,\"g\":1e-7,\"h\":0.000001,"
+                          "\"i\":1.7976931348623157e308,\"j\":12,"
+                          "\"k\":-0.000025}") == 0);
+    free(buffer);
+    JSON_FreeObject(object);
+
+    //  Random doubles read back bit for bit.
+    object = JSON_AllocObject();
+    bits = 0x123456789ABCDEFULL;
+    for (i = 0; i < 1000; i++) {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        memcpy(&value, &bits, sizeof(double));
+        if (isnan(value) || isinf(value))
+            value = i;
+        sprintf(path, "n%d", i);
+        ASSERT(JSON_AddNumber(object, path, value) == SUCCESS);
+    }
+
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    copy = JSON_Parse(buffer);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    for (i = 0; i < 1000; i++) {
+        sprintf(path, "n%d", i);
+        value = JSON_GetNumber(object, path);
+        ASSERT(memcmp(&value, &(double){JSON_GetNumber(copy, path)},
+                      sizeof(double)) == 0);
+        ASSERT(JSON_GetType(copy, path) == TYPE_NUMBER);
+    }
+
+    free(buffer);
+    JSON_FreeObject(copy);
+    JSON_FreeObject(object);
+
+    //  Infinities and NaN have no text, so nothing is written.
+    object = JSON_AllocObject();
+    ASSERT(JSON_AddNumber(object, "a", 1.0) == SUCCESS);
+    ASSERT(JSON_AddNumber(object, "b", INFINITY) == SUCCESS);
+    ASSERT(JSON_Stringify(object) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    ASSERT(JSON_AddNumber(object, "b", NAN) == SUCCESS);
+    ASSERT(JSON_Stringify(object) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    ASSERT(JSON_AddNumber(object, "b", -HUGE_VAL) == SUCCESS);
+    ASSERT(JSON_Stringify(object) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    JSON_FreeObject(object);
+
+    printf("Number format done.\n");
+}
+
+
+void test14(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE copy;
+    char *long_string;
+    char *buffer;
+    char path[32];
+    int i;
+    //---------------------------------
+
+    printf("\nTEST 14\n----------------------------\n");
+
+    //  Far longer than any fixed headroom, and half of it escapes.
+    long_string = malloc(100001);
+    for (i = 0; i < 100000; i++)
+        long_string[i] = (i % 2) ? 'x' : "\"\\\n\t"[(i / 2) % 4];
+    long_string[100000] = 0;
+
+    object = JSON_AllocObject();
+    ASSERT(JSON_AddString(object, "long", long_string) == SUCCESS);
+    for (i = 0; i < 2000; i++) {
+        sprintf(path, "k%d", i);
+        ASSERT(JSON_AddInt64(object, path, i) == SUCCESS);
+    }
+
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strlen(buffer) > 150000);
+
+    copy = JSON_Parse(buffer);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strcmp(JSON_GetString(copy, "long"), long_string) == 0);
+    ASSERT(JSON_GetInt64(copy, "k1999") == 1999);
+
+    free(buffer);
+    free(long_string);
+    JSON_FreeObject(copy);
+    JSON_FreeObject(object);
+
+    printf("Long output done.\n");
+}
+
+
+typedef struct _COLLECTED {
+
+    char *Text;
+    size_t Length;
+    int Calls;
+    int FailAfter;
+
+} COLLECTED;
+
+
+static int collectOutput(void *user_data, const char *data, size_t length)
+{
+    COLLECTED *collected = user_data;
+
+    if (collected->FailAfter && collected->Calls == collected->FailAfter)
+        return -1;
+
+    collected->Text = realloc(collected->Text, collected->Length + length + 1);
+    memcpy(collected->Text + collected->Length, data, length);
+    collected->Length += length;
+    collected->Text[collected->Length] = 0;
+    collected->Calls++;
+
+    return 0;
+}
+
+
+//
+//  Counts the output without keeping it, for texts too large to hold.
+//
+static int countOutput(void *user_data, const char *data, size_t length)
+{
+    size_t *count = user_data;
+
+    (void)data;
+    *count += length;
+
+    return 0;
+}
+
+
+#define SINK_TEST_DEPTH 17000
+
+
+void test15(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_SINK sink;
+    COLLECTED collected = {0};
+    FILE *file;
+    char *buffer;
+    char *text;
+    char path[32];
+    long length;
+    size_t count = 0;
+    int i;
+    char test[] = "{ \"a\" : [ 1, { \"b\" : \"x\" } ], \"c\" : true }";
+    char pretty[] =
+            "{\n"
+            "    \"a\":[\n"
+            "        1,\n"
+            "        {\n"
+            "            \"b\":\"x\"\n"
+            "        }\n"
+            "    ],\n"
+            "    \"c\":true\n"
+            "}";
+    //---------------------------------
+
+    printf("\nTEST 15\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    JSON_InitCallbackSink(&sink, collectOutput, &collected);
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_PRETTY) == SUCCESS);
+    ASSERT(strcmp(collected.Text, pretty) == 0);
+    free(collected.Text);
+    memset(&collected, 0, sizeof(collected));
+
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_COMPACT) == SUCCESS);
+    ASSERT(strcmp(collected.Text, "{\"a\":[1,{\"b\":\"x\"}],\"c\":true}") == 0);
+    free(collected.Text);
+    memset(&collected, 0, sizeof(collected));
+
+    JSON_FreeObject(object);
+
+    //  A document much larger than the buffer goes out in blocks.
+    object = JSON_AllocObject();
+    for (i = 0; i < 1000; i++) {
+        sprintf(path, "member%d", i);
+        ASSERT(JSON_AddString(object, path, "a value long enough to add up "
+                              "to many blocks of output over all members, "
+                              "more than a hundred bytes of it each time") ==
+               SUCCESS);
+    }
+    ASSERT(JSON_AddString(object, "last", test) == SUCCESS);
+
+    buffer = JSON_Stringify(object);
+
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_COMPACT) == SUCCESS);
+    ASSERT(collected.Calls > 1);
+    ASSERT(strcmp(collected.Text, buffer) == 0);
+    free(collected.Text);
+    memset(&collected, 0, sizeof(collected));
+
+    //  Callbacks can stop the write.
+    collected.FailAfter = 1;
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_COMPACT) == ERROR_WRITE_FAILED);
+    ASSERT(JSON_GetErrno() == ERROR_WRITE_FAILED);
+    free(collected.Text);
+
+    //  Files and file descriptors get the same text.
+    file = tmpfile();
+    ASSERT(file);
+    JSON_InitFileSink(&sink, file);
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_COMPACT) == SUCCESS);
+    fflush(file);
+
+    JSON_InitFdSink(&sink, fileno(file));
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_COMPACT) == SUCCESS);
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    ASSERT(length == (long)strlen(buffer) * 2);
+
+    text = malloc(length + 1);
+    rewind(file);
+    ASSERT(fread(text, 1, length, file) == (size_t)length);
+    ASSERT(memcmp(text, buffer, length / 2) == 0);
+    ASSERT(memcmp(text + length / 2, buffer, length / 2) == 0);
+    fclose(file);
+
+    free(text);
+    free(buffer);
+    JSON_FreeObject(object);
+
+    //  Deep enough that one line's indentation is more than the buffer.
+    text = malloc(2 * SINK_TEST_DEPTH + 16);
+    ASSERT(text);
+    length = sprintf(text, "{\"a\":");
+    for (i = 0; i < SINK_TEST_DEPTH; i++)
+        text[length++] = '[';
+    text[length++] = '1';
+    for (i = 0; i < SINK_TEST_DEPTH; i++)
+        text[length++] = ']';
+    strcpy(text + length, "}");
+
+    object = JSON_Parse(text);
+    ASSERT(object);
+    JSON_InitCallbackSink(&sink, countOutput, &count);
+    ASSERT(JSON_WriteTo(object, &sink, WRITE_PRETTY) == SUCCESS);
+    ASSERT(count == (size_t)4 * (SINK_TEST_DEPTH + 1) * (SINK_TEST_DEPTH + 1) +
+                    4 * SINK_TEST_DEPTH + 9);
+    JSON_FreeObject(object);
+    free(text);
+
+    printf("Sink output done.\n");
+}
+
+
+static void *test16Worker(void *arg)
+{
+    //---------------------------------
+    JSON_CONTEXT ctx;
+    JSON_OBJECT_HANDLE object = arg;
+    char path[32];
+    int i;
+    //---------------------------------
+
+    JSON_InitContext(&ctx);
+
+    for (i = 4999; i >= 0; i--) {
+        sprintf(path, "wide.k%d", i);
+        ASSERT(JSON_GetInt64Ctx(&ctx, object, path) == (i == 10 ? 42 : i));
+    }
+    ASSERT(JSON_GetErrnoCtx(&ctx) == SUCCESS);
+
+    return NULL;
+}
+
+
+void test16(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE copy;
+    pthread_t threads[4];
+    char *buffer;
+    char path[32];
+    int i;
+    char test[] = "{ \"a\" : 1, \"b\" : 2, \"c\" : 3, \"d\" : 4, \"e\" : 5, "
+                  "\"f\" : 6, \"g\" : 7, \"h\" : 8, \"i\" : 9, \"j\" : 10, "
+                  "\"k\" : 11, \"l\" : 12, \"m\" : 13, \"n\" : 14, \"o\" : 15, "
+                  "\"p\" : 16, \"q\" : 17, \"r\" : 18, \"s\" : 19, \"t\" : 20, "
+                  "\"u\" : 21, \"v\" : 22, \"w\" : 23, \"x\" : 24, \"y\" : 25, "
+                  "\"z\" : 26, \"A\" : 27, \"B\" : 28, \"C\" : 29, \"D\" : 30, "
+                  "\"E\" : 31, \"F\" : 32, \"G\" : 33, \"a\" : 34, \"H\" : 35 }";
+    //---------------------------------
+
+    printf("\nTEST 16\n----------------------------\n");
+
+    //  Wide objects are found by name and still written in order.
+    object = JSON_AllocObject();
+    ASSERT(JSON_AddInt64(object, "first", -1) == SUCCESS);
+    for (i = 0; i < 5000; i++) {
+        sprintf(path, "wide.k%d", i);
+        ASSERT(JSON_AddInt64(object, path, i) == SUCCESS);
+    }
+    for (i = 0; i < 5000; i++) {
+        sprintf(path, "wide.k%d", i);
+        ASSERT(JSON_GetInt64(object, path) == i);
+    }
+    ASSERT(JSON_GetInt64(object, "first") == -1);
+    JSON_GetInt64(object, "wide.k5000");
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+
+    ASSERT(JSON_AddInt64(object, "wide.k10", 42) == SUCCESS);
+    ASSERT(JSON_GetInt64(object, "wide.k10") == 42);
+
+    buffer = JSON_Stringify(object);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strncmp(buffer, "{\"first\":-1,\"wide\":{\"k0\":0,\"k1\":1,", 34) == 0);
+    ASSERT(strstr(buffer, "\"k10\":42,\"k11\":11,"));
+    ASSERT(strstr(buffer, "\"k4998\":4998,\"k4999\":4999}}"));
+    JSON_FreeObject(object);
+
+    //  Arena documents free their indexes with everything else.
+    copy = JSON_ParseArena(buffer);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(JSON_GetInt64(copy, "wide.k4321") == 4321);
+
+    for (i = 0; i < 4; i++) {
+        ASSERT(pthread_create(&threads[i], NULL, test16Worker, copy) == 0);
+    }
+    for (i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ASSERT(JSON_AddInt64(copy, "wide.k5000", 5000) == SUCCESS);
+    ASSERT(JSON_GetInt64(copy, "wide.k5000") == 5000);
+    JSON_FreeObject(copy);
+    free(buffer);
+
+    //  With repeated names the first one wins, as it does when scanning.
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(JSON_GetNumber(object, "H") == 35);
+    ASSERT(JSON_GetNumber(object, "a") == 1);
+    JSON_FreeObject(object);
+
+    printf("Wide objects done.\n");
+}
+
+
+static void *test17Worker(void *arg)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object = ((void **)arg)[0];
+    JSON_PATH_HANDLE path = ((void **)arg)[1];
+    JSON_CONTEXT ctx;
+    int i;
+    //---------------------------------
+
+    JSON_InitContext(&ctx);
+
+    for (i = 0; i < 10000; i++) {
+        ASSERT(JSON_GetNumberPCtx(&ctx, object, path) == 6);
+    }
+
+    return NULL;
+}
+
+
+void test17(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_PATH_HANDLE path;
+    JSON_PATH_HANDLE paths[8];
+    pthread_t threads[4];
+    void *args[2];
+    char *names[] = { "a", "b.c", "b.d[1]", "b.d[2].e", "b.d[3][1]", "f",
+                      "b.d[2]", "missing" };
+    int i;
+    char test[] = "{ \"a\" : 1, \"b\" : { \"c\" : \"two\", "
+                  "\"d\" : [ 3, 4, { \"e\" : true }, [ 5, 6 ] ] }, "
+                  "\"f\" : 7.5 }";
+    //---------------------------------
+
+    printf("\nTEST 17\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    for (i = 0; i < 8; i++) {
+        paths[i] = JSON_CompilePath(names[i]);
+        ASSERT(paths[i] && JSON_GetErrno() == SUCCESS);
+    }
+
+    //  Compiled paths find the same values as path strings.
+    for (i = 0; i < 8; i++) {
+        ASSERT(JSON_GetTypeP(object, paths[i]) == JSON_GetType(object, names[i]));
+    }
+    ASSERT(JSON_GetInt64P(object, paths[0]) == 1);
+    ASSERT(strcmp(JSON_GetStringP(object, paths[1]), "two") == 0);
+    ASSERT(JSON_GetNumberP(object, paths[2]) == 4);
+    ASSERT(JSON_GetBooleanP(object, paths[3]) == 1);
+    ASSERT(JSON_GetNumberP(object, paths[4]) == 6);
+    ASSERT(JSON_GetNumberP(object, paths[5]) == 7.5);
+    ASSERT(JSON_GetType(object, "b.d[2]") == TYPE_OBJECT);
+
+    JSON_GetNumberP(object, paths[7]);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    JSON_GetStringP(object, paths[0]);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    //  Paths that can never match are refused.
+    ASSERT(JSON_CompilePath(NULL) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_JSON_PATH);
+    ASSERT(JSON_CompilePath("b.d[-1]") == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_JSON_PATH);
+    ASSERT(JSON_CompilePath("b.d[x]") == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_JSON_PATH);
+    JSON_GetNumber(object, "b.d[x]");
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_JSON_PATH);
+    JSON_GetNumberP(object, NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_JSON_PATH);
+    JSON_GetNumberP(NULL, paths[0]);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+
+    //  One compiled path can be shared by many threads.
+    path = JSON_CompilePath("b.d[3][1]");
+    args[0] = object;
+    args[1] = path;
+    for (i = 0; i < 4; i++) {
+        ASSERT(pthread_create(&threads[i], NULL, test17Worker, args) == 0);
+    }
+    for (i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    JSON_FreePath(path);
+    for (i = 0; i < 8; i++) {
+        JSON_FreePath(paths[i]);
+    }
+    JSON_FreeObject(object);
+
+    printf("Compiled paths done.\n");
+}
+
+
+void test18(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE copy;
+    JSON_PATH_HANDLE path;
+    char *text;
+    char *buffer;
+    char name[32];
+    size_t length;
+    int count = 200000;
+    int i;
+    char nested[] = "{ \"m\" : [ [ 1, [ 2, 3 ] ], { \"a\" : [ \"x\", \"y\" ] }, "
+                    "\"s\" ] }";
+    char truncated[] = "{ \"m\" : [ 1, \"two\", [ 3, { \"a\" : [ 4, \"five\", ";
+    //---------------------------------
+
+    printf("\nTEST 18\n----------------------------\n");
+
+    //  Every element of a long array is one step away.
+    text = malloc(count * 8 + 32);
+    length = sprintf(text, "{ \"big\" : [ ");
+    for (i = 0; i < count; i++)
+        length += sprintf(text + length, i ? ", %d" : "%d", i * 3);
+    sprintf(text + length, " ] }");
+
+    object = JSON_Parse(text);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+
+    for (i = 0; i < count; i++) {
+        sprintf(name, "big[%d]", i);
+        ASSERT(JSON_GetInt64(object, name) == i * 3);
+    }
+    JSON_GetInt64(object, "big[200000]");
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+
+    buffer = JSON_Stringify(object);
+    copy = JSON_ParseArena(buffer);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    path = JSON_CompilePath("big[199999]");
+    ASSERT(JSON_GetInt64P(copy, path) == 599997);
+    JSON_FreePath(path);
+
+    free(buffer);
+    free(text);
+    JSON_FreeObject(copy);
+    JSON_FreeObject(object);
+
+    //  Arrays nest in arrays and objects, in all kinds of documents.
+    object = JSON_Parse(nested);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(JSON_GetNumber(object, "m[0][1][1]") == 3);
+    ASSERT(strcmp(JSON_GetString(object, "m[1].a[1]"), "y") == 0);
+    ASSERT(strcmp(JSON_GetString(object, "m[2]"), "s") == 0);
+    ASSERT(JSON_GetType(object, "m[0][1]") == TYPE_ARRAY);
+    JSON_GetNumber(object, "m[0][2]");
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+
+    buffer = JSON_Stringify(object);
+    ASSERT(strcmp(buffer, "{\"m\":[[1,[2,3]],{\"a\":[\"x\",\"y\"]},\"s\"]}") == 0);
+    JSON_FreeObject(object);
+
+    copy = JSON_ParseInSitu(buffer);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strcmp(JSON_GetString(copy, "m[1].a[0]"), "x") == 0);
+    JSON_FreeObject(copy);
+    free(buffer);
+
+    //  A parse that stops inside arrays frees what it built.
+    ASSERT(JSON_Parse(truncated) == NULL);
+    ASSERT(JSON_GetErrno() != SUCCESS);
+    ASSERT(JSON_ParseArena(truncated) == NULL);
+    ASSERT(JSON_GetErrno() != SUCCESS);
+
+    printf("Long arrays done.\n");
+}
+
+
+void test19(void)
+{
+    //---------------------------------
+    JSON_BUILDER_HANDLE builder;
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE copy;
+    char *buffer;
+    char name[32];
+    int i;
+    char expected[] = "{\"id\":7,\"name\":\"a \\\"b\\\"\",\"ok\":true,"
+                      "\"ratio\":0.5,\"tags\":[\"x\",1,[],{}],"
+                      "\"owner\":{\"id\":-2,\"list\":[{\"n\":1},{\"n\":2}]},"
+                      "\"empty\":{}}";
+    //---------------------------------
+
+    printf("\nTEST 19\n----------------------------\n");
+
+    builder = JSON_BuilderBegin(0);
+    ASSERT(builder && JSON_GetErrno() == SUCCESS);
+
+    ASSERT(JSON_BuilderAddInt64(builder, "id", 7) == SUCCESS);
+    ASSERT(JSON_BuilderAddString(builder, "name", "a \"b\"") == SUCCESS);
+    ASSERT(JSON_BuilderAddBoolean(builder, "ok", 1) == SUCCESS);
+    ASSERT(JSON_BuilderAddNumber(builder, "ratio", 0.5) == SUCCESS);
+
+    ASSERT(JSON_BuilderBeginArray(builder, "tags", 2) == SUCCESS);
+    ASSERT(JSON_BuilderAddString(builder, NULL, "x") == SUCCESS);
+    ASSERT(JSON_BuilderAddInt64(builder, NULL, 1) == SUCCESS);
+    ASSERT(JSON_BuilderBeginArray(builder, NULL, 0) == SUCCESS);
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+    ASSERT(JSON_BuilderBeginObject(builder, NULL) == SUCCESS);
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+
+    ASSERT(JSON_BuilderBeginObject(builder, "owner") == SUCCESS);
+    ASSERT(JSON_BuilderAddInt64(builder, "id", -2) == SUCCESS);
+    ASSERT(JSON_BuilderBeginArray(builder, "list", 0) == SUCCESS);
+    for (i = 1; i <= 2; i++) {
+        ASSERT(JSON_BuilderBeginObject(builder, NULL) == SUCCESS);
+        ASSERT(JSON_BuilderAddInt64(builder, "n", i) == SUCCESS);
+        ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+    }
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+
+    ASSERT(JSON_BuilderBeginObject(builder, "empty") == SUCCESS);
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+
+    object = JSON_BuilderFinish(builder);
+    ASSERT(object && JSON_GetErrno() == SUCCESS);
+
+    buffer = JSON_Stringify(object);
+    ASSERT(strcmp(buffer, expected) == 0);
+    free(buffer);
+
+    //  Empty containers, and so the whole text, parse back the same.
+    copy = JSON_Parse(expected);
+    ASSERT(copy);
+    ASSERT(JSON_GetType(copy, "tags[2]") == TYPE_ARRAY);
+    ASSERT(JSON_GetObject(copy, "tags[3]"));
+    buffer = JSON_Stringify(copy);
+    ASSERT(strcmp(buffer, expected) == 0);
+    free(buffer);
+    JSON_FreeObject(copy);
+
+    //  The result is an ordinary document.
+    ASSERT(JSON_GetInt64(object, "owner.list[1].n") == 2);
+    ASSERT(strcmp(JSON_GetString(object, "tags[0]"), "x") == 0);
+    ASSERT(JSON_AddInt64(object, "owner.more", 3) == SUCCESS);
+    ASSERT(JSON_GetInt64(object, "owner.more") == 3);
+    JSON_FreeObject(object);
+
+    //  Wide objects and long arrays.
+    builder = JSON_BuilderBegin(1 << 20);
+    ASSERT(JSON_BuilderBeginArray(builder, "values", 0) == SUCCESS);
+    for (i = 0; i < 10000; i++)
+        ASSERT(JSON_BuilderAddInt64(builder, NULL, i) == SUCCESS);
+    ASSERT(JSON_BuilderEnd(builder) == SUCCESS);
+    for (i = 0; i < 10000; i++) {
+        sprintf(name, "k%d", i);
+        ASSERT(JSON_BuilderAddInt64(builder, name, i) == SUCCESS);
+    }
+    object = JSON_BuilderFinish(builder);
+    ASSERT(object);
+    ASSERT(JSON_GetInt64(object, "values[9999]") == 9999);
+    ASSERT(JSON_GetInt64(object, "k9999") == 9999);
+    JSON_FreeObject(object);
+
+    //  Misuse is reported, and the first error sticks.
+    builder = JSON_BuilderBegin(0);
+    ASSERT(JSON_BuilderEnd(builder) == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_BuilderAddInt64(builder, "a", 1) == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_BuilderFinish(builder) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+
+    builder = JSON_BuilderBegin(0);
+    ASSERT(JSON_BuilderAddInt64(builder, NULL, 1) == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_BuilderFinish(builder) == NULL);
+
+    builder = JSON_BuilderBegin(0);
+    ASSERT(JSON_BuilderBeginArray(builder, "a", 0) == SUCCESS);
+    ASSERT(JSON_BuilderAddInt64(builder, "b", 1) == ERROR_INVALID_ARRAY);
+    ASSERT(JSON_BuilderFinish(builder) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_ARRAY);
+
+    builder = JSON_BuilderBegin(0);
+    ASSERT(JSON_BuilderBeginObject(builder, "open") == SUCCESS);
+    ASSERT(JSON_BuilderFinish(builder) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+
+    //  Nothing added still makes an empty object.
+    object = JSON_BuilderFinish(JSON_BuilderBegin(0));
+    ASSERT(object);
+    buffer = JSON_Stringify(object);
+    ASSERT(strcmp(buffer, "{}") == 0);
+    copy = JSON_Parse(buffer);
+    ASSERT(copy);
+    JSON_FreeObject(copy);
+    free(buffer);
+    JSON_FreeObject(object);
+
+    printf("Builder done.\n");
+}
+
+
+static JSON_OBJECT_HANDLE test20Push(char *text, size_t split, size_t chunk)
+{
+    //---------------------------------
+    JSON_PARSER_HANDLE parser;
+    size_t length = strlen(text);
+    size_t offset;
+    size_t size;
+    //---------------------------------
+
+    parser = JSON_ParserCreate();
+    ASSERT(parser);
+
+    JSON_ParserFeed(parser, text, split);
+    for (offset = split; offset < length; offset += size) {
+        size = (length - offset < chunk) ? length - offset : chunk;
+        JSON_ParserFeed(parser, text + offset, size);
+    }
+
+    return JSON_ParserFinish(parser);
+}
+
+
+void test20(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_PARSER_HANDLE parser;
+    char *expected;
+    char *buffer;
+    size_t length;
+    size_t split;
+    int i;
+    char test[] = "{ \"name\" : \"caf\\u00e9 \\\"\\ud83d\\ude00\\\"\", "
+                  "\"n\" : [ -12, 3.25e-2, 18446744073709551616, true, "
+                  "false, [ { \"x\" : 0 } ] ],\n \"o\" : { \"p\" : -0.0 } }";
+    char *bad[] = {
+        "{ \"a\" : 1 ",
+        "{ \"a\" : tru }",
+        "{ \"a\" : 1.e5 }",
+        "{ \"a\" : 1e400 }",
+        "{ \"a\" : \"\\x\" }",
+        "{ \"a\" : \"\\u0000\" }",
+        "{ \"a\" : [ 1 } }",
+        "{ \"a\" 1 }",
+        "{ \"a\" : 1 } x",
+        "[ 1 ]",
+    };
+    //---------------------------------
+
+    printf("\nTEST 20\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    expected = JSON_Stringify(object);
+    JSON_FreeObject(object);
+
+    //  Wherever the input is cut, the result is the same.
+    length = strlen(test);
+    for (split = 0; split <= length; split++) {
+        object = test20Push(test, split, length);
+        ASSERT(object && JSON_GetErrno() == SUCCESS);
+        buffer = JSON_Stringify(object);
+        ASSERT(strcmp(buffer, expected) == 0);
+        free(buffer);
+        JSON_FreeObject(object);
+    }
+
+    object = test20Push(test, 0, 1);
+    ASSERT(object);
+    buffer = JSON_Stringify(object);
+    ASSERT(strcmp(buffer, expected) == 0);
+    ASSERT(strcmp(JSON_GetString(object, "name"), "caf\xc3\xa9 \"\xf0\x9f\x98\x80\"") == 0);
+    ASSERT(JSON_GetInt64(object, "n[0]") == -12);
+    free(buffer);
+    JSON_FreeObject(object);
+    free(expected);
+
+    //  Bad or incomplete input fails, however it is cut.
+    for (i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        ASSERT(test20Push(bad[i], 0, 3) == NULL);
+        ASSERT(JSON_GetErrno() != SUCCESS);
+    }
+
+    //  After an error, feeding more fails the same way.
+    parser = JSON_ParserCreate();
+    ASSERT(JSON_ParserFeed(parser, "{ \"a\" : x", 9) == ERROR_INVALID_VALUE_TYPE);
+    ASSERT(JSON_ParserFeed(parser, "1 }", 3) == ERROR_INVALID_VALUE_TYPE);
+    ASSERT(JSON_ParserFinish(parser) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_VALUE_TYPE);
+
+    printf("Push parser done.\n");
+}
+
+
+//
+//  Records the events of test21 as text.
+//
+typedef struct _TEST21_EVENTS {
+
+    char Text[1024];
+    size_t Length;
+    int StopAt;
+
+} TEST21_EVENTS;
+
+
+static int test21Record(void *user, const char *format, ...)
+{
+    //---------------------------------
+    TEST21_EVENTS *events = user;
+    va_list args;
+    //---------------------------------
+
+    va_start(args, format);
+    events->Length += vsnprintf(events->Text + events->Length,
+                                sizeof(events->Text) - events->Length,
+                                format, args);
+    va_end(args);
+
+    return events->StopAt && (int)events->Length >= events->StopAt;
+}
+
+
+static int test21ObjectBegin(void *user) { return test21Record(user, "{"); }
+static int test21ObjectEnd(void *user) { return test21Record(user, "}"); }
+static int test21ArrayBegin(void *user) { return test21Record(user, "["); }
+static int test21ArrayEnd(void *user) { return test21Record(user, "]"); }
+
+static int test21Key(void *user, const char *name, size_t length)
+{
+    ASSERT(strlen(name) == length);
+    return test21Record(user, "k:%s ", name);
+}
+
+static int test21String(void *user, const char *string, size_t length)
+{
+    ASSERT(strlen(string) == length);
+    return test21Record(user, "s:%s ", string);
+}
+
+static int test21Number(void *user, double number)
+{
+    return test21Record(user, "n:%g ", number);
+}
+
+static int test21Integer(void *user, int64_t integer)
+{
+    return test21Record(user, "i:%lld ", (long long)integer);
+}
+
+static int test21Boolean(void *user, int boolean)
+{
+    return test21Record(user, "b:%d ", boolean);
+}
+
+
+void test21(void)
+{
+    //---------------------------------
+    JSON_SAX_CALLBACKS callbacks = {
+        test21ObjectBegin, test21ObjectEnd, test21ArrayBegin, test21ArrayEnd,
+        test21Key, test21String, test21Number, test21Integer, test21Boolean
+    };
+    JSON_SAX_CALLBACKS keys_only;
+    JSON_PARSER_HANDLE parser;
+    JSON_OBJECT_HANDLE object;
+    TEST21_EVENTS events;
+    char *buffer;
+    size_t i;
+    char test[] = "{ \"a\\\"b\" : \"x\\u00e9\", \"n\" : [ 1, -2.5, 1e300, "
+                  "true, [ ], { } ], \"o\" : { \"f\" : false } }";
+    char expected[] = "{k:a\"b s:x\xc3\xa9 k:n [i:1 n:-2.5 n:1e+300 b:1 []{}]"
+                      "k:o {k:f b:0 }}";
+    //---------------------------------
+
+    printf("\nTEST 21\n----------------------------\n");
+
+    memset(&events, 0, sizeof(events));
+    ASSERT(JSON_SaxParse(test, &callbacks, &events) == SUCCESS);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strcmp(events.Text, expected) == 0);
+
+    //  The same events, one byte at a time.
+    memset(&events, 0, sizeof(events));
+    parser = JSON_ParserCreateSax(&callbacks, &events);
+    ASSERT(parser);
+    for (i = 0; i < strlen(test); i++)
+        ASSERT(JSON_ParserFeed(parser, test + i, 1) == SUCCESS);
+    ASSERT(JSON_ParserFinish(parser) == NULL);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(strcmp(events.Text, expected) == 0);
+
+    //  Without OnInteger, integers are numbers. Missing events are skipped.
+    memset(&keys_only, 0, sizeof(keys_only));
+    keys_only.OnKey = test21Key;
+    keys_only.OnNumber = test21Number;
+    memset(&events, 0, sizeof(events));
+    ASSERT(JSON_SaxParse(test, &keys_only, &events) == SUCCESS);
+    ASSERT(strcmp(events.Text, "k:a\"b k:n n:1 n:-2.5 n:1e+300 k:o k:f ") == 0);
+
+    //  A callback can stop the parse.
+    memset(&events, 0, sizeof(events));
+    events.StopAt = 10;
+    ASSERT(JSON_SaxParse(test, &callbacks, &events) == ERROR_STOPPED);
+    ASSERT(JSON_GetErrno() == ERROR_STOPPED);
+    ASSERT(strcmp(events.Text, "{k:a\"b s:x\xc3\xa9 ") == 0);
+
+    //  Errors are found as they would be when building.
+    memset(&events, 0, sizeof(events));
+    ASSERT(JSON_SaxParse("{ \"a\" : [ 1, 2 }", &callbacks, &events) ==
+           ERROR_INVALID_ARRAY);
+    ASSERT(JSON_SaxParse("{ \"a\" : [ 1, 2 ]", &callbacks, &events) ==
+           ERROR_INVALID_OBJECT);
+    ASSERT(JSON_SaxParse("{ \"a\" : 1, }", &callbacks, &events) ==
+           ERROR_INVALID_STRING);
+    ASSERT(JSON_SaxParse(test, NULL, &events) == ERROR_INVALID_OBJECT);
+
+    //  The push parser builds empty objects and arrays as well.
+    parser = JSON_ParserCreate();
+    JSON_ParserFeed(parser, test, strlen(test));
+    object = JSON_ParserFinish(parser);
+    ASSERT(object);
+    buffer = JSON_Stringify(object);
+    ASSERT(strstr(buffer, "true,[],{}]"));
+    free(buffer);
+    JSON_FreeObject(object);
+
+    printf("Event parser done.\n");
+}
+
+
+void test22(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE lazy;
+    JSON_OBJECT_HANDLE sub;
+    JSON_PATH_HANDLE path;
+    char *expected;
+    char *buffer;
+    char test[] = "{ \"id\" : 7, \"user\" : { \"name\" : \"ann\", \"tags\" : "
+                  "[ \"a\", \"b\" ], \"address\" : { \"city\" : \"Oslo\" } }, "
+                  "\"items\" : [ { \"n\" : 1 }, { \"n\" : 2, \"sub\" : [ [ 3, "
+                  "4.5 ] ] } ], \"flag\" : true }";
+    char bad[] = "{ \"ok\" : 1, \"bad\" : { \"x\" : tru }, \"deep\" : "
+                 "{ \"y\" : [ 1, ] } }";
+    //---------------------------------
+
+    printf("\nTEST 22\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(object);
+    expected = JSON_Stringify(object);
+    JSON_FreeObject(object);
+
+    lazy = JSON_ParseLazy(test);
+    ASSERT(lazy && JSON_GetErrno() == SUCCESS);
+
+    //  Nested containers are typed without being parsed.
+    ASSERT(JSON_GetType(lazy, "items") == TYPE_ARRAY);
+    ASSERT(JSON_GetInt64(lazy, "id") == 7);
+
+    ASSERT(strcmp(JSON_GetString(lazy, "user.name"), "ann") == 0);
+    ASSERT(strcmp(JSON_GetString(lazy, "user.tags[1]"), "b") == 0);
+    ASSERT(strcmp(JSON_GetString(lazy, "user.address.city"), "Oslo") == 0);
+    ASSERT(JSON_GetInt64(lazy, "items[0].n") == 1);
+    ASSERT(JSON_GetNumber(lazy, "items[1].sub[0][1]") == 4.5);
+    ASSERT(JSON_GetBoolean(lazy, "flag") == 1);
+
+    path = JSON_CompilePath("items[1].n");
+    ASSERT(JSON_GetInt64P(lazy, path) == 2);
+    JSON_FreePath(path);
+
+    sub = JSON_GetObject(lazy, "user.address.city");
+    ASSERT(sub == NULL);
+
+    //  Whatever has been read or not, it is written out the same.
+    buffer = JSON_Stringify(lazy);
+    ASSERT(strcmp(buffer, expected) == 0);
+    free(buffer);
+    JSON_FreeObject(lazy);
+
+    lazy = JSON_ParseLazy(test);
+    buffer = JSON_Stringify(lazy);
+    ASSERT(strcmp(buffer, expected) == 0);
+    free(buffer);
+
+    //  Adding to a nested object parses it first.
+    ASSERT(JSON_AddInt64(lazy, "user.age", 42) == SUCCESS);
+    ASSERT(JSON_GetInt64(lazy, "user.age") == 42);
+    ASSERT(strcmp(JSON_GetString(lazy, "user.name"), "ann") == 0);
+    JSON_FreeObject(lazy);
+    free(expected);
+
+    //  Errors in nested containers are found when they are read.
+    lazy = JSON_ParseLazy(bad);
+    ASSERT(lazy);
+    ASSERT(JSON_GetInt64(lazy, "ok") == 1);
+    ASSERT(JSON_GetBoolean(lazy, "bad.x") == -ERROR_INVALID_BOOLEAN);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_BOOLEAN);
+    ASSERT(JSON_GetBoolean(lazy, "bad.x") == -ERROR_INVALID_BOOLEAN);
+    ASSERT(JSON_GetInt64(lazy, "deep.y[0]") == 0);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_VALUE_TYPE);
+    ASSERT(JSON_Stringify(lazy) == NULL);
+    JSON_FreeObject(lazy);
+
+    //  The structure itself is still checked up front.
+    ASSERT(JSON_ParseLazy("{ \"a\" : [ 1, 2 }") == NULL);
+    ASSERT(JSON_ParseLazy("{ \"a\" : { \"b\" : 1 }") == NULL);
+    ASSERT(JSON_ParseLazy("{ \"a\" : \"b }") == NULL);
+    ASSERT(JSON_ParseLazy(NULL) == NULL);
+
+    printf("Lazy parsing done.\n");
+}
+
+
+void test23(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    char *buffer;
+    char test[] = "{ \"id\" : 7, \"user\" : { \"name\" : \"ann\", \"tags\" : "
+                  "[ \"a\", \"b\" ], \"address\" : { \"city\" : \"Oslo\" } }, "
+                  "\"items\" : [ { \"n\" : 1 }, { \"n\" : 2 } ], "
+                  "\"skip\" : { \"x\" : [ 1, { \"y\" : \"}]\\\"\" } ], "
+                  "\"z\" : tru }, \"na\\u006De\" : \"esc\", \"flag\" : true }";
+    char *paths[] = { "id", "user.name", "user.address.city", "items[1].n",
+                      "user.missing.deep", "name", "flag.not" };
+    char *bad_paths[] = { "id", "[0]" };
+    //---------------------------------
+
+    printf("\nTEST 23\n----------------------------\n");
+
+    object = JSON_ParseSelect(test, paths, 7);
+    ASSERT(object && JSON_GetErrno() == SUCCESS);
+
+    ASSERT(JSON_GetInt64(object, "id") == 7);
+    ASSERT(strcmp(JSON_GetString(object, "user.name"), "ann") == 0);
+    ASSERT(strcmp(JSON_GetString(object, "user.address.city"), "Oslo") == 0);
+    ASSERT(JSON_GetInt64(object, "items[1].n") == 2);
+    ASSERT(JSON_GetType(object, "user.tags") == TYPE_UNKNOWN);
+    ASSERT(JSON_GetType(object, "skip") == TYPE_UNKNOWN);
+
+    //  Escaped names are matched by what they decode to.
+    ASSERT(strcmp(JSON_GetString(object, "name"), "esc") == 0);
+
+    buffer = JSON_Stringify(object);
+    ASSERT(strcmp(buffer, "{\"id\":7,\"user\":{\"name\":\"ann\",\"address\":"
+                          "{\"city\":\"Oslo\"}},\"items\":[{\"n\":1},{\"n\":2}],"
+                          "\"name\":\"esc\"}") == 0);
+    free(buffer);
+    JSON_FreeObject(object);
+
+    //  Nothing selected is an empty object.
+    object = JSON_ParseSelect(test, NULL, 0);
+    ASSERT(object);
+    buffer = JSON_Stringify(object);
+    ASSERT(strcmp(buffer, "{}") == 0);
+    free(buffer);
+    JSON_FreeObject(object);
+
+    ASSERT(JSON_ParseSelect(test, bad_paths, 2) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_JSON_PATH);
+
+    //  Selected values are still checked, skipped ones only for structure.
+    ASSERT(JSON_ParseSelect("{ \"id\" : tru }", paths, 1) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_BOOLEAN);
+    ASSERT(JSON_ParseSelect("{ \"a\" : [ 1, { \"b\" : 2 ] }", paths, 1) == NULL);
+    ASSERT(JSON_ParseSelect("{ \"a\" : \"b }", paths, 1) == NULL);
+    ASSERT(JSON_ParseSelect("{ \"a\" : 1 \"id\" : 2 }", paths, 1) == NULL);
+    ASSERT(JSON_ParseSelect(NULL, paths, 1) == NULL);
+
+    printf("Selective parsing done.\n");
+}
+
+
+typedef struct _TEST24_STATE {
+
+    int64_t Next;
+    int64_t Sum;
+    int64_t StopAt;
+    int InOrder;
+
+} TEST24_STATE;
+
+
+static int test24Record(void *user_data, JSON_OBJECT_HANDLE record)
+{
+    TEST24_STATE *state = (TEST24_STATE *)user_data;
+    int64_t n = JSON_GetInt64(record, "n");
+
+    if (state->Next != n)
+        state->InOrder = 0;
+    state->Next = n + 1;
+
+    return n == state->StopAt;
+}
+
+
+static int test24Any(void *user_data, JSON_OBJECT_HANDLE record)
+{
+    TEST24_STATE *state = (TEST24_STATE *)user_data;
+
+    __atomic_fetch_add(&state->Sum, JSON_GetInt64(record, "n"),
+                       __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+void test24(void)
+{
+    //---------------------------------
+    JSON_NDJSON_HANDLE reader;
+    JSON_OBJECT_HANDLE record;
+    TEST24_STATE state;
+    FILE *file;
+    char *big;
+    int records = 200000;
+    int i;
+    //---------------------------------
+
+    printf("\nTEST 24\n----------------------------\n");
+
+    //  Blank lines, CRLF, a line longer than a chunk and no final newline.
+    file = tmpfile();
+    ASSERT(file);
+    big = malloc(3 * 1024 * 1024);
+    ASSERT(big);
+    memset(big, 'x', 3 * 1024 * 1024 - 1);
+    big[3 * 1024 * 1024 - 1] = 0;
+
+    for (i = 0; i < records; i++) {
+        if (i == 1000)
+            fprintf(file, "{ \"n\" : %d, \"big\" : \"%s\" }\n", i, big);
+        else if (i % 3 == 0)
+            fprintf(file, "{ \"n\" : %d }\r\n\n", i);
+        else if (i < records - 1)
+            fprintf(file, "  {\"n\":%d,\"s\":\"line\"}\n", i);
+        else
+            fprintf(file, "{\"n\":%d}", i);
+    }
+
+    //  One record at a time.
+    rewind(file);
+    reader = JSON_NdjsonOpen(file);
+    ASSERT(reader);
+    for (i = 0; (record = JSON_NdjsonNext(reader)); i++) {
+        ASSERT(JSON_GetInt64(record, "n") == i);
+        if (i == 1000)
+            ASSERT(strlen(JSON_GetString(record, "big")) == strlen(big));
+        JSON_FreeObject(record);
+    }
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    ASSERT(i == records);
+    JSON_NdjsonClose(reader);
+
+    //  In order on several threads.
+    rewind(file);
+    memset(&state, 0, sizeof(state));
+    state.InOrder = 1;
+    state.StopAt = -1;
+    ASSERT(JSON_NdjsonForEach(file, test24Record, &state, 4, ORDER_INPUT) ==
+           SUCCESS);
+    ASSERT(state.InOrder && state.Next == records);
+
+    //  Stopped by the callback.
+    rewind(file);
+    memset(&state, 0, sizeof(state));
+    state.InOrder = 1;
+    state.StopAt = 150000;
+    ASSERT(JSON_NdjsonForEach(file, test24Record, &state, 4, ORDER_INPUT) ==
+           ERROR_STOPPED);
+    ASSERT(state.InOrder && state.Next == 150001);
+
+    //  In any order.
+    rewind(file);
+    memset(&state, 0, sizeof(state));
+    ASSERT(JSON_NdjsonForEach(file, test24Any, &state, 0, ORDER_ANY) ==
+           SUCCESS);
+    ASSERT(state.Sum == (int64_t)records * (records - 1) / 2);
+    fclose(file);
+
+    //  A bad line stops the records after it.
+    file = tmpfile();
+    ASSERT(file);
+    fprintf(file, "{\"n\":0}\n{\"n\":1}\n{\"n\":tru}\n{\"n\":3}\n");
+    rewind(file);
+    memset(&state, 0, sizeof(state));
+    state.InOrder = 1;
+    state.StopAt = -1;
+    ASSERT(JSON_NdjsonForEach(file, test24Record, &state, 2, ORDER_INPUT) ==
+           ERROR_INVALID_BOOLEAN);
+    ASSERT(state.InOrder && state.Next == 2);
+
+    //  Reading one at a time goes on after it.
+    rewind(file);
+    reader = JSON_NdjsonOpen(file);
+    record = JSON_NdjsonNext(reader);
+    JSON_FreeObject(record);
+    record = JSON_NdjsonNext(reader);
+    JSON_FreeObject(record);
+    ASSERT(JSON_NdjsonNext(reader) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_BOOLEAN);
+    record = JSON_NdjsonNext(reader);
+    ASSERT(record && JSON_GetInt64(record, "n") == 3);
+    JSON_FreeObject(record);
+    ASSERT(JSON_NdjsonNext(reader) == NULL);
+    ASSERT(JSON_GetErrno() == SUCCESS);
+    JSON_NdjsonClose(reader);
+    fclose(file);
+
+    free(big);
+
+    printf("NDJSON reading done.\n");
+}
+
+
+void test25(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE mapped;
+    char path[] = "/tmp/json_test_XXXXXX";
+    char test[] = "{ \"name\" : \"ann\\n\", \"n\" : [ 1, 2.5, true ], "
+                  "\"sub\" : { \"s\" : \"\\u00e9t\\u00e9\" } }";
+    char reread[sizeof(test)];
+    char *expected;
+    char *buffer;
+    FILE *file;
+    int fd;
+    //---------------------------------
+
+    printf("\nTEST 25\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(object);
+    expected = JSON_Stringify(object);
+    JSON_FreeObject(object);
+
+    fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, test, strlen(test)) == (ssize_t)strlen(test));
+    close(fd);
+
+    mapped = JSON_ParseFile(path, FILE_COPY_STRINGS);
+    ASSERT(mapped && JSON_GetErrno() == SUCCESS);
+    buffer = JSON_Stringify(mapped);
+    ASSERT(strcmp(buffer, expected) == 0);
+    free(buffer);
+    JSON_FreeObject(mapped);
+
+    //  In place, the strings are read from the mapping.
+    mapped = JSON_ParseFile(path, FILE_IN_SITU);
+    ASSERT(mapped && JSON_GetErrno() == SUCCESS);
+    ASSERT(strcmp(JSON_GetString(mapped, "name"), "ann\n") == 0);
+    ASSERT(strcmp(JSON_GetString(mapped, "sub.s"), "\xc3\xa9t\xc3\xa9") == 0);
+    ASSERT(JSON_AddString(mapped, "sub.t", "added") == SUCCESS);
+    ASSERT(strcmp(JSON_GetString(mapped, "sub.t"), "added") == 0);
+    JSON_FreeObject(mapped);
+
+    //  And the file is left as it was.
+    file = fopen(path, "r");
+    ASSERT(file);
+    ASSERT(fread(reread, 1, sizeof(reread), file) == strlen(test));
+    ASSERT(memcmp(reread, test, strlen(test)) == 0);
+    fclose(file);
+
+    file = fopen(path, "w");
+    ASSERT(file);
+    fprintf(file, "{ \"a\" : tru }");
+    fclose(file);
+    ASSERT(JSON_ParseFile(path, FILE_IN_SITU) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_BOOLEAN);
+
+    file = fopen(path, "w");
+    ASSERT(file);
+    fclose(file);
+    ASSERT(JSON_ParseFile(path, FILE_COPY_STRINGS) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+
+    unlink(path);
+    ASSERT(JSON_ParseFile(path, FILE_COPY_STRINGS) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_READ_FAILED);
+
+    free(expected);
+
+    printf("File parsing done.\n");
+}
+
+
+#define IMAGE_TEST_NAME \
+        "a_member_name_long_enough_to_show_whether_it_is_written_again"
+
+
+void test26(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE image;
+    JSON_OBJECT_HANDLE sub;
+    JSON_SINK sink;
+    COLLECTED output = { 0 };
+    char path[] = "/tmp/json_test_XXXXXX";
+    char name[32];
+    char test[] = "{ \"id\" : 7, \"pi\" : 3.25, \"ok\" : true, \"no\" : false, "
+                  "\"dup\" : 1, \"dup\" : 2, "
+                  "\"s\" : \"caf\\u00e9\", \"user\" : { \"name\" : \"ann\", "
+                  "\"tags\" : [ \"a\", \"b\" ] }, \"m\" : [ [ 1, 2 ], "
+                  "[ { \"x\" : -9223372036854775807 } ] ] }";
+    char one_row[] = "{ \"rows\" : [ { \"" IMAGE_TEST_NAME "\" : 1 } ] }";
+    char rows[] = "{ \"rows\" : [ { \"" IMAGE_TEST_NAME "\" : 1 }, "
+                  "{ \"" IMAGE_TEST_NAME "\" : 2 }, "
+                  "{ \"" IMAGE_TEST_NAME "\" : 3 } ] }";
+    size_t length;
+    void *aligned;
+    int fd;
+    int i;
+    //---------------------------------
+
+    printf("\nTEST 26\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(object);
+
+    //  Wide enough for a hash table of its names.
+    sub = JSON_GetObject(object, "m[1][0]");
+    for (i = 0; i < 100; i++) {
+        sprintf(name, "k%d", i);
+        ASSERT(JSON_AddInt64(sub, name, i) == SUCCESS);
+    }
+
+    fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    JSON_InitFdSink(&sink, fd);
+    ASSERT(JSON_Serialize(object, &sink) == SUCCESS);
+    close(fd);
+
+    JSON_InitCallbackSink(&sink, collectOutput, &output);
+    ASSERT(JSON_Serialize(object, &sink) == SUCCESS);
+
+    image = JSON_Open(path);
+    ASSERT(image && JSON_GetErrno() == SUCCESS);
+
+    ASSERT(JSON_GetInt64(image, "id") == 7);
+    ASSERT(JSON_GetNumber(image, "id") == 7.0);
+    ASSERT(JSON_GetNumber(image, "pi") == 3.25);
+    ASSERT(JSON_GetBoolean(image, "ok") == 1);
+    ASSERT(JSON_GetBoolean(image, "no") == 0);
+    ASSERT(JSON_GetInt64(image, "dup") == JSON_GetInt64(object, "dup"));
+    ASSERT(strcmp(JSON_GetString(image, "s"), "caf\xc3\xa9") == 0);
+    ASSERT(strcmp(JSON_GetString(image, "user.name"), "ann") == 0);
+    ASSERT(strcmp(JSON_GetString(image, "user.tags[1]"), "b") == 0);
+    ASSERT(JSON_GetInt64(image, "m[0][1]") == 2);
+    ASSERT(JSON_GetInt64(image, "m[1][0].x") == -9223372036854775807LL);
+    ASSERT(JSON_GetType(image, "user.tags") == TYPE_ARRAY);
+    ASSERT(JSON_GetType(image, "m[1]") == TYPE_ARRAY);
+    ASSERT(JSON_GetType(image, "m[1][0]") == TYPE_OBJECT);
+    ASSERT(JSON_GetType(image, "user.tags[2]") == TYPE_UNKNOWN);
+    ASSERT(JSON_GetType(image, "missing") == TYPE_UNKNOWN);
+    ASSERT(JSON_GetString(image, "id") == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    for (i = 0; i < 100; i++) {
+        sprintf(name, "m[1][0].k%d", i);
+        ASSERT(JSON_GetInt64(image, name) == i);
+    }
+
+    //  Objects in the image are handles themselves.
+    sub = JSON_GetObject(image, "m[1][0]");
+    ASSERT(sub);
+    ASSERT(JSON_GetInt64(sub, "k42") == 42);
+    sub = JSON_GetObject(image, "user.tags");
+    ASSERT(sub == NULL);
+
+    //  It cannot be changed.
+    ASSERT(JSON_AddInt64(image, "id", 8) == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_Stringify(image) == NULL);
+    JSON_Close(image);
+
+    //  The same image from memory.
+    aligned = malloc(output.Length);
+    ASSERT(aligned);
+    memcpy(aligned, output.Text, output.Length);
+    image = JSON_OpenImage(aligned, output.Length);
+    ASSERT(image);
+    ASSERT(strcmp(JSON_GetString(image, "user.tags[0]"), "a") == 0);
+    JSON_Close(image);
+
+    ASSERT(JSON_OpenImage(aligned, output.Length - 8) == NULL);
+    ((char *)aligned)[0] ^= 1;
+    ASSERT(JSON_OpenImage(aligned, output.Length) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+    free(aligned);
+
+    //  An empty object has no members.
+    free(output.Text);
+    memset(&output, 0, sizeof(output));
+    sub = JSON_AllocObject();
+    ASSERT(JSON_Serialize(sub, &sink) == SUCCESS);
+    JSON_FreeObject(sub);
+    aligned = malloc(output.Length);
+    ASSERT(aligned);
+    memcpy(aligned, output.Text, output.Length);
+    image = JSON_OpenImage(aligned, output.Length);
+    ASSERT(image);
+    ASSERT(JSON_GetType(image, "id") == TYPE_UNKNOWN);
+    JSON_Close(image);
+    free(aligned);
+
+    //  Names are written once, however many members have them.
+    free(output.Text);
+    memset(&output, 0, sizeof(output));
+    sub = JSON_Parse(one_row);
+    ASSERT(JSON_Serialize(sub, &sink) == SUCCESS);
+    JSON_FreeObject(sub);
+    length = output.Length;
+
+    free(output.Text);
+    memset(&output, 0, sizeof(output));
+    sub = JSON_Parse(rows);
+    ASSERT(JSON_Serialize(sub, &sink) == SUCCESS);
+    JSON_FreeObject(sub);
+    ASSERT(output.Length - length < 2 * strlen(IMAGE_TEST_NAME));
+
+    aligned = malloc(output.Length);
+    ASSERT(aligned);
+    memcpy(aligned, output.Text, output.Length);
+    image = JSON_OpenImage(aligned, output.Length);
+    ASSERT(image);
+    ASSERT(JSON_GetInt64(image, "rows[2]." IMAGE_TEST_NAME) == 3);
+    ASSERT(JSON_GetInt64(image, "rows[0]." IMAGE_TEST_NAME) == 1);
+    JSON_Close(image);
+    free(aligned);
+
+    unlink(path);
+    ASSERT(JSON_Open(path) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_READ_FAILED);
+
+    free(output.Text);
+    JSON_FreeObject(object);
+
+    printf("Binary images done.\n");
+}
+
+
+void test27(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE decoded;
+    char *expected;
+    char *text;
+    char *data;
+    size_t length;
+    char test[] = "{ \"id\" : 7, \"pi\" : 3.25, \"tenth\" : 0.1, \"ok\" : true, "
+                  "\"no\" : false, \"neg\" : -200, \"big\" : 4294967296, "
+                  "\"min\" : -9223372036854775808, \"s\" : \"caf\\u00e9\", "
+                  "\"long\" : \"0123456789012345678901234567890123456789\", "
+                  "\"user\" : { \"name\" : \"ann\", \"tags\" : [ \"a\", \"b\" ] }, "
+                  "\"m\" : [ [ 1, 2 ], [ { \"x\" : -1 } ] ] }";
+    const unsigned char msgpack[] = { 0x81, 0xa1, 'a', 0x01 };
+    const unsigned char cbor[] = { 0xa1, 0x61, 'a', 0x01 };
+    const unsigned char cbor_open[] = { 0xbf, 0x61, 'a', 0x9f, 0xc1, 0x01,
+                                        0xf9, 0x3e, 0x00, 0x1b, 0xff, 0xff,
+                                        0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                        0xff, 0xff };
+    const unsigned char msgpack_nil[] = { 0x81, 0xa1, 'a', 0xc0 };
+    const unsigned char msgpack_nul[] = { 0x81, 0xa1, 'a', 0xa1, 0x00 };
+    const unsigned char msgpack_array[] = { 0x91, 0x01 };
+    const unsigned char msgpack_huge[] = { 0x81, 0xa1, 'a', 0xdd, 0xff, 0xff,
+                                           0xff, 0xff };
+    const unsigned char cbor_null[] = { 0xa1, 0x61, 'a', 0xf6 };
+    const unsigned char cbor_key[] = { 0xa1, 0x01, 0x01 };
+    //---------------------------------
+
+    printf("\nTEST 27\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(object);
+    expected = JSON_Stringify(object);
+    ASSERT(expected);
+
+    //  Both formats give back the same tree.
+    data = JSON_ToMsgPack(object, &length);
+    ASSERT(data && length < strlen(expected));
+    decoded = JSON_FromMsgPack(data, length);
+    ASSERT(decoded);
+    text = JSON_Stringify(decoded);
+    ASSERT(strcmp(text, expected) == 0);
+    ASSERT(JSON_GetType(decoded, "pi") == TYPE_NUMBER);
+    ASSERT(JSON_GetInt64(decoded, "min") == INT64_MIN);
+    free(text);
+    free(data);
+    JSON_FreeObject(decoded);
+
+    data = JSON_ToCbor(object, &length);
+    ASSERT(data && length < strlen(expected));
+    decoded = JSON_FromCbor(data, length);
+    ASSERT(decoded);
+    text = JSON_Stringify(decoded);
+    ASSERT(strcmp(text, expected) == 0);
+    free(text);
+
+    //  Anything cut short, or in the other format, fails.
+    ASSERT(JSON_FromCbor(data, length - 1) == NULL);
+    ASSERT(JSON_FromMsgPack(data, length) == NULL);
+    free(data);
+    JSON_FreeObject(decoded);
+
+    free(expected);
+    JSON_FreeObject(object);
+
+    //  The smallest encodings.
+    object = JSON_Parse("{ \"a\" : 1 }");
+    ASSERT(object);
+    data = JSON_ToMsgPack(object, &length);
+    ASSERT(length == sizeof(msgpack) && memcmp(data, msgpack, length) == 0);
+    free(data);
+    data = JSON_ToCbor(object, &length);
+    ASSERT(length == sizeof(cbor) && memcmp(data, cbor, length) == 0);
+    free(data);
+    JSON_FreeObject(object);
+
+    //  Indefinite lengths, tags, half floats and integers past INT64_MAX.
+    decoded = JSON_FromCbor(cbor_open, sizeof(cbor_open));
+    ASSERT(decoded);
+    ASSERT(JSON_GetInt64(decoded, "a[0]") == 1);
+    ASSERT(JSON_GetNumber(decoded, "a[1]") == 1.5);
+    ASSERT(JSON_GetType(decoded, "a[2]") == TYPE_NUMBER);
+    ASSERT(JSON_GetNumber(decoded, "a[2]") == 18446744073709551615.0);
+    JSON_FreeObject(decoded);
+
+    //  An empty object is an empty map.
+    object = JSON_AllocObject();
+    data = JSON_ToMsgPack(object, &length);
+    ASSERT(length == 1 && (unsigned char)data[0] == 0x80);
+    decoded = JSON_FromMsgPack(data, length);
+    ASSERT(decoded);
+    text = JSON_Stringify(decoded);
+    ASSERT(strcmp(text, "{}") == 0);
+    free(text);
+    free(data);
+    JSON_FreeObject(decoded);
+    JSON_FreeObject(object);
+
+    //  Infinities and NaN are not written, as they would not read back.
+    object = JSON_AllocObject();
+    ASSERT(JSON_AddNumber(object, "x", INFINITY) == SUCCESS);
+    ASSERT(JSON_ToMsgPack(object, &length) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    ASSERT(JSON_AddNumber(object, "x", NAN) == SUCCESS);
+    ASSERT(JSON_ToCbor(object, &length) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_NUMBER);
+    JSON_FreeObject(object);
+
+    ASSERT(JSON_FromMsgPack(msgpack_nil, sizeof(msgpack_nil)) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_VALUE_TYPE);
+    ASSERT(JSON_FromMsgPack(msgpack_nul, sizeof(msgpack_nul)) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_STRING);
+    ASSERT(JSON_FromMsgPack(msgpack_array, sizeof(msgpack_array)) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_FromMsgPack(msgpack_huge, sizeof(msgpack_huge)) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_ARRAY);
+    ASSERT(JSON_FromCbor(cbor_null, sizeof(cbor_null)) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_VALUE_TYPE);
+    ASSERT(JSON_FromCbor(cbor_key, sizeof(cbor_key)) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+    ASSERT(JSON_FromCbor(NULL, 0) == NULL);
+
+    printf("MessagePack and CBOR done.\n");
+}
+
+
+void test28(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE other;
+    JSON_KEYTABLE_HANDLE keys;
+    JSON_PATH_HANDLE path;
+    char *expected;
+    char *text;
+    char test[] = "{ \"rows\" : [ { \"id\" : 1, \"name\" : \"a\" }, "
+                  "{ \"id\" : 2, \"name\" : \"b\" }, "
+                  "{ \"\\u0069d\" : 3, \"name\" : \"c\" } ], "
+                  "\"count\" : 3 }";
+    char more[] = "{ \"rows\" : [ { \"id\" : 4, \"extra\" : true } ] }";
+    char bad[] = "{ \"rows\" : [ { \"\\x\" : 1 } ] }";
+    //---------------------------------
+
+    printf("\nTEST 28\n----------------------------\n");
+
+    //  A document of its own table reads like any other.
+    object = JSON_ParseInterned(test, NULL);
+    ASSERT(object);
+    other = JSON_Parse(test);
+    ASSERT(other);
+    expected = JSON_Stringify(other);
+    text = JSON_Stringify(object);
+    ASSERT(strcmp(text, expected) == 0);
+    ASSERT(JSON_GetInt64(object, "rows[2].id") == 3);
+    ASSERT(strcmp(JSON_GetString(object, "rows[1].name"), "b") == 0);
+    free(text);
+    free(expected);
+    JSON_FreeObject(other);
+    JSON_FreeObject(object);
+
+    //  A shared table keeps each name once, escaped or not.
+    keys = JSON_KeyTableCreate();
+    ASSERT(keys);
+    object = JSON_ParseInterned(test, keys);
+    ASSERT(object);
+    ASSERT(JSON_KeyTableCount(keys) == 4);
+    other = JSON_ParseInterned(more, keys);
+    ASSERT(other);
+    ASSERT(JSON_KeyTableCount(keys) == 5);
+
+    path = JSON_CompilePathInterned("rows[0].id", keys);
+    ASSERT(path);
+    ASSERT(JSON_GetInt64P(object, path) == 1);
+    ASSERT(JSON_GetInt64P(other, path) == 4);
+    JSON_FreePath(path);
+    path = JSON_CompilePathInterned("rows[0].missing", keys);
+    ASSERT(path);
+    ASSERT(JSON_GetTypeP(other, path) == TYPE_UNKNOWN);
+    JSON_FreePath(path);
+    ASSERT(JSON_KeyTableCount(keys) == 6);
+
+    //  Names can still be added to the documents.
+    ASSERT(JSON_AddInt64(object, "count", 4) == SUCCESS);
+    ASSERT(JSON_AddInt64(object, "total", 10) == SUCCESS);
+    ASSERT(JSON_GetInt64(object, "count") == 4);
+    ASSERT(JSON_GetInt64(object, "total") == 10);
+
+    ASSERT(JSON_ParseInterned(bad, keys) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_STRING);
+
+    JSON_FreeObject(other);
+    JSON_FreeObject(object);
+    JSON_KeyTableFree(keys);
+
+    //  Only a key table will do.
+    object = JSON_AllocObject();
+    ASSERT(JSON_ParseInterned(test, object) == NULL);
+    ASSERT(JSON_GetErrno() == ERROR_INVALID_OBJECT);
+    JSON_FreeObject(object);
+
+    printf("Interned keys done.\n");
+}
+
+
+void test29(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE inner;
+    JSON_STATS stats;
+    JSON_STATS arena_stats;
+    size_t allocations;
+    char test[] = "{ \"name\" : \"x\", \"n\" : 1.5, \"i\" : 2, "
+                  "\"b\" : true, \"a\" : [ 1, { \"c\" : \"de\" } ] }";
+    //---------------------------------
+
+    printf("\nTEST 29\n----------------------------\n");
+
+    object = JSON_Parse(test);
+    ASSERT(object);
+    ASSERT(JSON_GetStats(object, &stats) == SUCCESS);
+    ASSERT(stats.Objects == 2);
+    ASSERT(stats.Arrays == 1);
+    ASSERT(stats.Strings == 2);
+    ASSERT(stats.Numbers == 1);
+    ASSERT(stats.Integers == 2);
+    ASSERT(stats.Booleans == 1);
+    ASSERT(stats.Members == 6);
+    ASSERT(stats.MaxDepth == 3);
+    ASSERT(stats.NameBytes == 9);
+    ASSERT(stats.StringBytes == 3);
+    ASSERT(stats.Allocations > 0);
+    ASSERT(stats.BytesHeld > stats.Allocations);
+    ASSERT(stats.ParseNanoseconds == 0 && stats.Lookups == 0);
+
+    //  Every new member is another allocation.
+    allocations = stats.Allocations;
+    ASSERT(JSON_AddInt64(object, "j", 3) == SUCCESS);
+    ASSERT(JSON_GetStats(object, &stats) == SUCCESS);
+    ASSERT(stats.Allocations > allocations);
+    ASSERT(stats.Integers == 3);
+
+    //  Objects inside count on their own.
+    inner = JSON_GetObject(object, "a[1]");
+    ASSERT(inner);
+    ASSERT(JSON_GetStats(inner, &stats) == SUCCESS);
+    ASSERT(stats.Objects == 1 && stats.Members == 1);
+    ASSERT(stats.MaxDepth == 1 && stats.StringBytes == 2);
+    JSON_FreeObject(object);
+
+    //  An arena document holds its chunks.
+    object = JSON_ParseArena(test);
+    ASSERT(object);
+    ASSERT(JSON_GetString(object, "name"));
+    ASSERT(JSON_GetNumber(object, "a[0]") == 1);
+    ASSERT(JSON_GetStats(object, &arena_stats) == SUCCESS);
+    ASSERT(arena_stats.Objects == 2 && arena_stats.Members == 6);
+    ASSERT(arena_stats.Allocations == 1);
+    ASSERT(arena_stats.BytesHeld >= 16 * 1024);
+#ifdef JSON_STATS_COUNTERS
+    ASSERT(arena_stats.Lookups == 2);
+    ASSERT(arena_stats.ParseNanoseconds > 0);
+#endif
+    JSON_FreeObject(object);
+
+    //  Lazy containers count once until they are read.
+    object = JSON_ParseLazy(test);
+    ASSERT(object);
+    ASSERT(JSON_GetStats(object, &stats) == SUCCESS);
+    ASSERT(stats.Objects == 1 && stats.Arrays == 1);
+    ASSERT(stats.Members == 5 && stats.MaxDepth == 2);
+    ASSERT(strcmp(JSON_GetString(object, "a[1].c"), "de") == 0);
+    ASSERT(JSON_GetStats(object, &stats) == SUCCESS);
+    ASSERT(stats.Objects == 2 && stats.Members == 6);
+    ASSERT(stats.MaxDepth == 3);
+    JSON_FreeObject(object);
+
+    ASSERT(JSON_GetStats(NULL, &stats) == ERROR_INVALID_OBJECT);
+    object = JSON_AllocObject();
+    ASSERT(JSON_GetStats(object, NULL) == ERROR_INVALID_OBJECT);
+    JSON_FreeObject(object);
+
+    printf("Statistics done.\n");
+}
+
+
+void test30(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    JSON_OBJECT_HANDLE decoded;
+    JSON_KEYTABLE_HANDLE keys;
+    char *expected;
+    char *text;
+    char *again;
+    char *data;
+    size_t length;
+    int i;
+    int kind;
+    char test[] = "{ \"a\" : [ ], \"b\" : { }, \"c\" : [ [ ], { }, "
+                  "{ \"d\" : [ ] } ], \"e\" : 1 }";
+    char empty[] = "{ }";
+    char copy[sizeof(test)];
+    char *select[] = { "missing" };
+    //---------------------------------
+
+    printf("\nTEST 30\n----------------------------\n");
+
+    object = JSON_Parse(empty);
+    ASSERT(object);
+    text = JSON_Stringify(object);
+    ASSERT(strcmp(text, "{}") == 0);
+    free(text);
+    JSON_FreeObject(object);
+
+    object = JSON_Parse(test);
+    ASSERT(object);
+    expected = JSON_Stringify(object);
+    ASSERT(strcmp(expected, "{\"a\":[],\"b\":{},\"c\":[[],{},"
+                  "{\"d\":[]}],\"e\":1}") == 0);
+    ASSERT(JSON_GetType(object, "a") == TYPE_ARRAY);
+    ASSERT(JSON_GetType(object, "a[0]") == TYPE_UNKNOWN);
+    ASSERT(JSON_GetInt64(object, "e") == 1);
+
+    JSON_FreeObject(object);
+
+    //  What is written parses back to the same.
+    object = JSON_Parse(expected);
+    ASSERT(object);
+    again = JSON_Stringify(object);
+    ASSERT(strcmp(again, expected) == 0);
+    free(again);
+    JSON_FreeObject(object);
+
+    //  Every way of parsing builds the same tree.
+    keys = JSON_KeyTableCreate();
+    ASSERT(keys);
+    for (kind = 0; kind < 6; kind++) {
+        memcpy(copy, test, sizeof(test));
+        if (kind == 0)
+            object = JSON_Parse(expected);
+        else if (kind == 1)
+            object = JSON_ParseArena(copy);
+        else if (kind == 2)
+            object = JSON_ParseInSitu(copy);
+        else if (kind == 3)
+            object = JSON_ParseInterned(copy, keys);
+        else if (kind == 4)
+            object = JSON_ParseLazy(copy);
+        else
+            object = test20Push(test, 5, strlen(test));
+        ASSERT(object);
+        ASSERT(JSON_GetType(object, "c[2].d") == TYPE_ARRAY);
+        text = JSON_Stringify(object);
+        ASSERT(strcmp(text, expected) == 0);
+        free(text);
+
+        //  So do the binary formats.
+        for (i = 0; i < 2; i++) {
+            data = i ? JSON_ToCbor(object, &length) :
+                       JSON_ToMsgPack(object, &length);
+            ASSERT(data);
+            decoded = i ? JSON_FromCbor(data, length) :
+                          JSON_FromMsgPack(data, length);
+            ASSERT(decoded);
+            text = JSON_Stringify(decoded);
+            ASSERT(strcmp(text, expected) == 0);
+            JSON_FreeObject(decoded);
+            decoded = JSON_Parse(text);
+            ASSERT(decoded);
+            JSON_FreeObject(decoded);
+            free(text);
+            free(data);
+        }
+
+        JSON_FreeObject(object);
+    }
+    JSON_KeyTableFree(keys);
+
+    //  Selecting nothing leaves an empty object, which parses again.
+    object = JSON_ParseSelect(test, select, 1);
+    ASSERT(object);
+    text = JSON_Stringify(object);
+    ASSERT(strcmp(text, "{}") == 0);
+    JSON_FreeObject(object);
+    object = JSON_Parse(text);
+    ASSERT(object);
+    JSON_FreeObject(object);
+    free(text);
+    memcpy(copy, empty, sizeof(empty));
+    object = JSON_ParseSelect(copy, select, 1);
+    ASSERT(object);
+    JSON_FreeObject(object);
+
+    free(expected);
+
+    printf("Empty containers done.\n");
+}
+
+
+//
+//  Adding through objects that are not there yet makes them.
+//
+void test31(void)
+{
+    //---------------------------------
+    JSON_OBJECT_HANDLE object;
+    char *text;
+    int arena;
+    char empty[] = "{ }";
+    char expected[] =
+            "{\"a\":{\"b\":{\"c\":1.0,\"d\":\"two\"},\"e\":true},"
+            "\"f\":{\"g\":3}}";
+    //---------------------------------
+
+    printf("\nTEST 31\n----------------------------\n");
+
+    for (arena = 0; arena < 2; arena++) {
+
+        if (arena)
+            object = JSON_ParseArena(empty);
+        else
+            object = JSON_AllocObject();
+        ASSERT(object);
+
+        ASSERT(JSON_AddNumber(object, "a.b.c", 1) == SUCCESS);
+        ASSERT(JSON_AddString(object, "a.b.d", "two") == SUCCESS);
+        ASSERT(JSON_AddBoolean(object, "a.e", 1) == SUCCESS);
+        ASSERT(JSON_AddInt64(object, "f.g", 3) == SUCCESS);
+
+        ASSERT(JSON_GetNumber(object, "a.b.c") == 1);
+        ASSERT(strcmp(JSON_GetString(object, "a.b.d"), "two") == 0);
+        ASSERT(JSON_GetBoolean(object, "a.e") == 1);
+        ASSERT(JSON_GetInt64(object, "f.g") == 3);
+
+        //  A number is not an object to add through.
+        ASSERT(JSON_AddNumber(object, "a.b.c.x", 4) == ERROR_TYPE_MISMATCH);
+
+        text = JSON_Stringify(object);
+        ASSERT(text);
+        printf("%s\n", text);
+        ASSERT(strcmp(text, expected) == 0);
+        free(text);
+
+        JSON_FreeObject(object);
+    }
+
+    printf("Nested add done.\n");
+}
+
+
 int main(void) {
 
     printf("JSON UNIT TESTS\n\n");
@@ -285,6 +2609,31 @@ int main(void) {
     test4();
     test5();
     test6();
+    test7();
+    test8();
+    test9();
+    test10();
+    test11();
+    test12();
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
+    test30();
+    test31();
 
     printf("JSON Tests Pass.\n");
 